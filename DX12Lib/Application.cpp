@@ -95,8 +95,7 @@ int Application::Run(std::shared_ptr<DXRenderer> pApp)
 
     Events::InputDevice::Instance().AddInputObserver(pApp.get());
 
-    TaskGPU* uploadTask = _currentFrame->CreateTask(D3D12_COMMAND_LIST_TYPE_COPY, nullptr);
-    if (!pApp->LoadContent(uploadTask))
+    if (!pApp->LoadContent())
     {
         return 1;
     }
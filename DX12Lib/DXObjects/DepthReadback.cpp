@@ -0,0 +1,162 @@
+#include "stdafx.h"
+
+#include "DepthReadback.h"
+
+#include "Scene/Viewport.h"
+
+using namespace DirectX;
+
+namespace Core
+{
+    DepthReadback::DepthReadback()
+        : _DXDevice(Device::GetDXDevice())
+        , _depthHeap(nullptr)
+        , _targetHeap(nullptr)
+        , _depthDescriptorSize(0)
+        , _target{}
+        , _readback(nullptr)
+        , _footprint{}
+        , _regionSize(0)
+        , _viewProjections{}
+        , _isWritten{}
+        , _width(0)
+        , _height(0)
+    {
+    }
+
+    DepthReadback::~DepthReadback()
+    {
+        _DXDevice = nullptr;
+        _depthHeap = nullptr;
+        _targetHeap = nullptr;
+    }
+
+    void DepthReadback::Create(uint32_t width, uint32_t height)
+    {
+        _width = width;
+        _height = height;
+        _isWritten.fill(false);
+
+        D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+        heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+        heapDesc.NumDescriptors = BACK_BUFFER_COUNT;
+        heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+        _DXDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&_depthHeap));
+        _depthDescriptorSize = _DXDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+        heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+        heapDesc.NumDescriptors = 1;
+        heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+        _DXDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&_targetHeap));
+
+        ResourceDescription targetDesc(CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_FLOAT, width, height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET));
+        _target.SetResourceDescription(targetDesc);
+        _target.CreateCommitedResource(D3D12_RESOURCE_STATE_RENDER_TARGET);
+        _target.SetName("Depth Readback Target");
+
+        D3D12_RENDER_TARGET_VIEW_DESC targetViewDesc = {};
+        targetViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+        targetViewDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
+        _DXDevice->CreateRenderTargetView(_target.GetDXResource().Get(), &targetViewDesc, _targetHeap->GetCPUDescriptorHandleForHeapStart());
+
+        // The rows of the copies are aligned to 256 bytes
+        const D3D12_RESOURCE_DESC dxTargetDesc = targetDesc.CreateDXResourceDescription();
+        _DXDevice->GetCopyableFootprints(&dxTargetDesc, 0, 1, 0, &_footprint, nullptr, nullptr, &_regionSize);
+        _regionSize = (_regionSize + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~static_cast<UINT64>(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+
+        ResourceDescription readbackDesc;
+        readbackDesc.SetResourceType(EResourceType::ReadBack | EResourceType::Buffer);
+        readbackDesc.SetSize({ static_cast<uint32_t>(BACK_BUFFER_COUNT * _regionSize), 1 });
+        readbackDesc.SetStride(1);
+        readbackDesc.SetFormat(DXGI_FORMAT::DXGI_FORMAT_UNKNOWN);
+        _readback = std::make_shared<Resource>(readbackDesc);
+        _readback->CreateCommitedResource(D3D12_RESOURCE_STATE_COPY_DEST);
+        _readback->SetName("Depth Readback");
+    }
+
+    void DepthReadback::Downsample(uint32_t frameIndex, Resource& depthTexture, const XMMATRIX& viewProjection, GraphicsCommandList& commandList)
+    {
+        if (!_readback)
+        {
+            return;
+        }
+
+        frameIndex %= BACK_BUFFER_COUNT;
+
+        // The descriptor of the frame index was last read by the frame completed before
+        D3D12_SHADER_RESOURCE_VIEW_DESC depthViewDesc = {};
+        depthViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+        depthViewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        depthViewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        depthViewDesc.Texture2D.MipLevels = 1;
+        const CD3DX12_CPU_DESCRIPTOR_HANDLE depthView(_depthHeap->GetCPUDescriptorHandleForHeapStart(), frameIndex, _depthDescriptorSize);
+        _DXDevice->CreateShaderResourceView(depthTexture.GetDXResource().Get(), &depthViewDesc, depthView);
+
+        commandList.TransitionBarrier(depthTexture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        commandList.TransitionBarrier(_target, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+        D3D12_CPU_DESCRIPTOR_HANDLE targetView = _targetHeap->GetCPUDescriptorHandleForHeapStart();
+        commandList.SetRenderTarget(&targetView, nullptr);
+        commandList.SetViewport(Viewport({ static_cast<float>(_width), static_cast<float>(_height) }));
+
+        const uint32_t size[2] = { _width, _height };
+        commandList.SetConstants(0, 2, size);
+        commandList.SetDescriptorHeaps({ _depthHeap.Get() });
+        commandList.SetDescriptorTable(1, CD3DX12_GPU_DESCRIPTOR_HANDLE(_depthHeap->GetGPUDescriptorHandleForHeapStart(), frameIndex, _depthDescriptorSize));
+
+        commandList.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        commandList.Draw(3);
+
+        commandList.TransitionBarrier(depthTexture, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+        commandList.TransitionBarrier(_target, D3D12_RESOURCE_STATE_COPY_SOURCE);
+
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = _footprint;
+        footprint.Offset = frameIndex * _regionSize;
+        commandList.CopyTextureToBuffer(_target, *_readback, footprint);
+
+        XMStoreFloat4x4(&_viewProjections[frameIndex], viewProjection);
+        _isWritten[frameIndex] = true;
+    }
+
+    bool DepthReadback::Read(uint32_t frameIndex, std::vector<float>& depth, XMMATRIX& viewProjection)
+    {
+        frameIndex %= BACK_BUFFER_COUNT;
+        if (!_readback || !_isWritten[frameIndex])
+        {
+            return false;
+        }
+
+        const D3D12_RANGE range = { static_cast<SIZE_T>(frameIndex * _regionSize), static_cast<SIZE_T>((frameIndex + 1) * _regionSize) };
+
+        void* data = nullptr;
+        if (FAILED(_readback->GetDXResource()->Map(0, &range, &data)))
+        {
+            return false;
+        }
+
+        depth.resize(static_cast<size_t>(_width) * _height);
+        const uint8_t* region = static_cast<const uint8_t*>(data) + range.Begin;
+        for (uint32_t row = 0; row < _height; ++row)
+        {
+            memcpy(&depth[row * _width], region + row * _footprint.Footprint.RowPitch, _width * sizeof(float));
+        }
+
+        const D3D12_RANGE writtenRange = { 0, 0 };
+        _readback->GetDXResource()->Unmap(0, &writtenRange);
+
+        viewProjection = XMLoadFloat4x4(&_viewProjections[frameIndex]);
+        _isWritten[frameIndex] = false;
+
+        return true;
+    }
+
+    uint32_t DepthReadback::GetWidth() const
+    {
+        return _width;
+    }
+
+    uint32_t DepthReadback::GetHeight() const
+    {
+        return _height;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "DXObjects/GraphicsCommandList.h"
+#include "DXObjects/SwapChain.h"
+
+#include <array>
+
+namespace Core
+{
+    // The depth of the frames downsampled on the GPU into a small R32_FLOAT target, every texel the farthest
+    // depth of the block it covers, and copied into the readback region of the frame. Read on the CPU
+    // once the frame completed, with the matrix the depth was rendered with
+    class DepthReadback
+    {
+    public:
+        DepthReadback();
+        ~DepthReadback();
+
+        DepthReadback(const DepthReadback& copy) = delete;
+        DepthReadback& operator=(const DepthReadback& copy) = delete;
+
+        // Size of the downsampled depth, the depth buffers may be of any size
+        void Create(uint32_t width, uint32_t height);
+
+        // With the downsample pipeline set, after the passes writing the depth of the frame
+        void Downsample(uint32_t frameIndex, Resource& depthTexture, const DirectX::XMMATRIX& viewProjection, GraphicsCommandList& commandList);
+        // The depth the frame index downsampled the last time it was used, row by row. False if it
+        // downsampled nothing since the last read
+        bool Read(uint32_t frameIndex, std::vector<float>& depth, DirectX::XMMATRIX& viewProjection);
+
+        uint32_t GetWidth() const;
+        uint32_t GetHeight() const;
+
+    private:
+        ComPtr<ID3D12Device2> _DXDevice;
+
+        // Shader visible, the depth of every frame in flight is read through its own descriptor
+        ComPtr<ID3D12DescriptorHeap> _depthHeap;
+        ComPtr<ID3D12DescriptorHeap> _targetHeap;
+        UINT _depthDescriptorSize;
+
+        Resource _target;
+        // A region of the footprint for every frame in flight
+        std::shared_ptr<Resource> _readback;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT _footprint;
+        UINT64 _regionSize;
+
+        std::array<DirectX::XMFLOAT4X4, BACK_BUFFER_COUNT> _viewProjections;
+        std::array<bool, BACK_BUFFER_COUNT> _isWritten;
+
+        uint32_t _width;
+        uint32_t _height;
+    };
+}
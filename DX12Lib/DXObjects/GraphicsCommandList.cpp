@@ -11,11 +11,15 @@ namespace Core
 {
     GraphicsCommandList::GraphicsCommandList()
         : _commandList(nullptr)
+        , _pipeline(nullptr)
+        , _vertexLayout(MeshFormat::VertexLayout::Float)
     {
     }
 
     GraphicsCommandList::GraphicsCommandList(ComPtr<ID3D12GraphicsCommandList> DXCommandList)
         : _commandList(DXCommandList)
+        , _pipeline(nullptr)
+        , _vertexLayout(MeshFormat::VertexLayout::Float)
     {
     }
 
@@ -57,9 +61,9 @@ namespace Core
         _commandList->BeginQuery(queryHeap.Get(), type, index);
     }
 
-    void GraphicsCommandList::ResolveQueryData(ComPtr<ID3D12QueryHeap> queryHeap, D3D12_QUERY_TYPE type, UINT64 index, Resource& destination, UINT64 offset)
+    void GraphicsCommandList::ResolveQueryData(ComPtr<ID3D12QueryHeap> queryHeap, D3D12_QUERY_TYPE type, UINT64 index, Resource& destination, UINT64 offset, UINT count)
     {
-        _commandList->ResolveQueryData(queryHeap.Get(), type, index, 1, destination.GetDXResource().Get(), offset);
+        _commandList->ResolveQueryData(queryHeap.Get(), type, index, count, destination.GetDXResource().Get(), offset);
     }
 
     void GraphicsCommandList::EndQuery(ComPtr<ID3D12QueryHeap> queryHeap, D3D12_QUERY_TYPE type, UINT64 index)
@@ -89,6 +93,14 @@ namespace Core
         _commandList->CopyResource(destinationResource.GetDXResource().Get(), sourceResource.GetDXResource().Get());
     }
 
+    void GraphicsCommandList::CopyTextureToBuffer(Resource& texture, Resource& buffer, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint)
+    {
+        const CD3DX12_TEXTURE_COPY_LOCATION destination(buffer.GetDXResource().Get(), footprint);
+        const CD3DX12_TEXTURE_COPY_LOCATION source(texture.GetDXResource().Get(), 0);
+
+        _commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    }
+
     void GraphicsCommandList::SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY primitiveTopology)
     {
         _commandList->IASetPrimitiveTopology(primitiveTopology);
@@ -121,6 +133,9 @@ namespace Core
     void GraphicsCommandList::SetPipelineState(const RootSignature& rootSignature)
     {
         _commandList->SetPipelineState(rootSignature.GetPipelineState().Get());
+
+        _pipeline = &rootSignature;
+        _vertexLayout = MeshFormat::VertexLayout::Float;
     }
 
     void GraphicsCommandList::SetGraphicsRootSignature(const RootSignature& rootSignature)
@@ -128,6 +143,31 @@ namespace Core
         _commandList->SetGraphicsRootSignature(rootSignature.GetRootSignature().Get());
     }
 
+    bool GraphicsCommandList::SetVertexLayout(MeshFormat::VertexLayout vertexLayout)
+    {
+        if (_vertexLayout == vertexLayout)
+        {
+            return true;
+        }
+
+        const RootSignature* variant = _pipeline ? _pipeline->GetVariant(vertexLayout) : nullptr;
+        if (!variant)
+        {
+            return false;
+        }
+
+        // The variants share the root signature, so the bound root arguments stay valid
+        _commandList->SetPipelineState(variant->GetPipelineState().Get());
+        _vertexLayout = vertexLayout;
+
+        return true;
+    }
+
+    bool GraphicsCommandList::IsPositionOnly() const
+    {
+        return _pipeline && _pipeline->IsPositionOnly();
+    }
+
     void GraphicsCommandList::ClearRTV(D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView, const FLOAT color[4], Viewport* viewport)
     {
         UINT numRects = viewport ? 1 : 0;
@@ -198,6 +238,9 @@ namespace Core
     void GraphicsCommandList::Reset(ID3D12CommandAllocator* commandAllocator, ID3D12PipelineState* pipelineState)
     {
         _commandList->Reset(commandAllocator, pipelineState);
+
+        _pipeline = nullptr;
+        _vertexLayout = MeshFormat::VertexLayout::Float;
     }
 
     void GraphicsCommandList::Close()
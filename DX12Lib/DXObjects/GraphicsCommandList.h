@@ -22,13 +22,15 @@ namespace Core
         void SetPredication(Resource* buffer, UINT64 offset, D3D12_PREDICATION_OP operation);
 
         void BeginQuery(ComPtr<ID3D12QueryHeap> queryHeap, D3D12_QUERY_TYPE type, UINT64 index);
-        void ResolveQueryData(ComPtr<ID3D12QueryHeap> queryHeap, D3D12_QUERY_TYPE type, UINT64 index, Resource& destination, UINT64 offset);
+        void ResolveQueryData(ComPtr<ID3D12QueryHeap> queryHeap, D3D12_QUERY_TYPE type, UINT64 index, Resource& destination, UINT64 offset, UINT count = 1);
         void EndQuery(ComPtr<ID3D12QueryHeap> queryHeap, D3D12_QUERY_TYPE type, UINT64 index);
 
         void TransitionBarrier(Resource& resource, D3D12_RESOURCE_STATES stateAfter, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, bool flushBarriers = false);
         void AliasingBarrier(const std::shared_ptr<Resource> & = nullptr, const std::shared_ptr<Resource>& afterResource = nullptr, bool flushBarriers = false);
 
         void CopyResource(Resource& sourceResource, Resource& destinationResource);
+        // The first subresource of the texture into the buffer at the footprint
+        void CopyTextureToBuffer(Resource& texture, Resource& buffer, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint);
 
         // Input Assembly
         void SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY primitiveTopology);
@@ -42,6 +44,11 @@ namespace Core
         void SetViewport(const Viewport& viewport);
         void SetPipelineState(const RootSignature& rootSignature);
         void SetGraphicsRootSignature(const RootSignature& rootSignature);
+        // Switches to the variant of the current pipeline that reads the given vertex layout.
+        // Returns false if the current pipeline has no such variant
+        bool SetVertexLayout(MeshFormat::VertexLayout vertexLayout);
+        // True if the current pipeline reads only the vertex positions
+        bool IsPositionOnly() const;
 
         void ClearRTV(D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView, const FLOAT color[4], Viewport* viewport = nullptr);
         void ClearDSV(D3D12_CPU_DESCRIPTOR_HANDLE depthStencilView, D3D12_CLEAR_FLAGS clearFlags = D3D12_CLEAR_FLAG_DEPTH, FLOAT depth = 1.0f, UINT8 stencil = 0, Viewport* viewport = nullptr);
@@ -62,5 +69,8 @@ namespace Core
 
     private:
         ComPtr<ID3D12GraphicsCommandList> _commandList;
+
+        const RootSignature* _pipeline;
+        MeshFormat::VertexLayout _vertexLayout;
     };
 } // namespace Core
@@ -2,14 +2,51 @@
 
 #include "OcclusionQuery.h"
 
-#include "Scene/Volumes/FrustumVolume.h"
+#include "DXObjects/SwapChain.h"
+#include "Scene/Mesh.h"
 #include "Scene/Volumes/AABBVolume.h"
 
+using namespace DirectX;
+
+namespace
+{
+    constexpr UINT64 RESULT_SIZE = sizeof(UINT64);
+
+    // Written from the CPU, read by the GPU in place
+    std::shared_ptr<Core::Resource> CreateDynamicBuffer(size_t size, const std::string& name)
+    {
+        Core::ResourceDescription desc;
+        desc.SetResourceType(Core::EResourceType::Dynamic | Core::EResourceType::Buffer);
+        desc.SetSize({ static_cast<uint32_t>(size), 1 });
+        desc.SetStride(1);
+        desc.SetFormat(DXGI_FORMAT::DXGI_FORMAT_UNKNOWN);
+
+        std::shared_ptr<Core::Resource> buffer = std::make_shared<Core::Resource>(desc);
+        buffer->CreateCommitedResource(D3D12_RESOURCE_STATE_GENERIC_READ);
+        buffer->SetName(name);
+
+        return buffer;
+    }
+}
+
 namespace Core
 {
     OcclusionQuery::OcclusionQuery()
         : _DXDevice(Device::GetDXDevice())
         , _queryHeap(nullptr)
+        , _queryResults(nullptr)
+        , _readbackResults(nullptr)
+        , _cubeVertexBuffer(nullptr)
+        , _cubeIndexBuffer(nullptr)
+        , _boxBuffer(nullptr)
+        , _boxes(nullptr)
+        , _cubeVBO{}
+        , _boxVBO{}
+        , _cubeIBO{}
+        , _slotCount(0)
+        , _frameIndex(0)
+        , _firstSlot(INVALID_SLOT)
+        , _lastSlot(0)
     {
     }
 
@@ -19,61 +56,199 @@ namespace Core
         _queryHeap = nullptr;
     }
 
-    void OcclusionQuery::Create(int numObjects)
+    uint32_t OcclusionQuery::AllocateSlot()
     {
-        // Describe and create a heap for occlusion queries.
+        if (ASSERT(!_queryHeap, "The occlusion query slots must be allocated before Create"))
+        {
+            return INVALID_SLOT;
+        }
+
+        return _slotCount++;
+    }
+
+    void OcclusionQuery::Create()
+    {
+        if (_slotCount == 0)
+        {
+            return;
+        }
+
         D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
-        queryHeapDesc.Count = numObjects;
+        queryHeapDesc.Count = _slotCount;
         queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_OCCLUSION;
         _DXDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&_queryHeap));
 
-        for (int i = 0; i < numObjects; ++i)
+        ResourceDescription desc(CD3DX12_RESOURCE_DESC::Buffer(_slotCount * RESULT_SIZE));
+        _queryResults = std::make_shared<Resource>(desc);
+        _queryResults->CreateCommitedResource(D3D12_RESOURCE_STATE_PREDICATION);
+        _queryResults->SetName("Query Results");
+
+        ResourceDescription readbackDesc;
+        readbackDesc.SetResourceType(EResourceType::ReadBack | EResourceType::Buffer);
+        readbackDesc.SetSize({ static_cast<uint32_t>(BACK_BUFFER_COUNT * _slotCount * RESULT_SIZE), 1 });
+        readbackDesc.SetStride(1);
+        readbackDesc.SetFormat(DXGI_FORMAT::DXGI_FORMAT_UNKNOWN);
+        _readbackResults = std::make_shared<Resource>(readbackDesc);
+        _readbackResults->CreateCommitedResource(D3D12_RESOURCE_STATE_COPY_DEST);
+        _readbackResults->SetName("Query Readback");
+        _results.assign(_slotCount, 1);
+        _readbackRanges.assign(BACK_BUFFER_COUNT, { 1, 0 });
+
+        // The unit cube, every proxy is an instance of it
+        std::shared_ptr<Mesh> cube = AABBVolume(XMVectorZero(), XMVectorSplatOne()).CreateMesh();
+
+        std::span<const uint8_t> positions = cube->GetPositions();
+        _cubeVertexBuffer = CreateDynamicBuffer(positions.size(), "Occlusion Cube VB");
+        memcpy(_cubeVertexBuffer->Map(), positions.data(), positions.size());
+
+        _cubeVBO.BufferLocation = _cubeVertexBuffer->OffsetGPU(0);
+        _cubeVBO.SizeInBytes = static_cast<UINT>(positions.size());
+        _cubeVBO.StrideInBytes = cube->GetPositionStride();
+
+        size_t indexBytes = cube->GetIndexCount() * cube->GetIndexStride();
+        _cubeIndexBuffer = CreateDynamicBuffer(indexBytes, "Occlusion Cube IB");
+        memcpy(_cubeIndexBuffer->Map(), cube->GetIndexData(), indexBytes);
+
+        _cubeIBO.BufferLocation = _cubeIndexBuffer->OffsetGPU(0);
+        _cubeIBO.Format = cube->GetIndexFormat();
+        _cubeIBO.SizeInBytes = static_cast<UINT>(indexBytes);
+
+        _boxBuffer = CreateDynamicBuffer(_slotCount * sizeof(Box), "Occlusion Boxes");
+        _boxes = static_cast<Box*>(_boxBuffer->Map());
+
+        _boxVBO.BufferLocation = _boxBuffer->OffsetGPU(0);
+        _boxVBO.SizeInBytes = static_cast<UINT>(_slotCount * sizeof(Box));
+        _boxVBO.StrideInBytes = sizeof(Box);
+
+        _isTested.assign(_slotCount, 0);
+    }
+
+    uint32_t OcclusionQuery::GetSlotCount() const
+    {
+        return _slotCount;
+    }
+
+    void OcclusionQuery::Begin(uint32_t frameIndex, GraphicsCommandList& commandList)
+    {
+        _frameIndex = frameIndex % BACK_BUFFER_COUNT;
+        _firstSlot = INVALID_SLOT;
+        _lastSlot = 0;
+
+        if (!_queryHeap)
+        {
+            return;
+        }
+
+        commandList.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        commandList.SetVertexBuffer(0, _cubeVBO);
+        commandList.SetVertexBuffer(1, _boxVBO);
+        commandList.SetIndexBuffer(_cubeIBO);
+    }
+
+    void OcclusionQuery::SetBox(uint32_t slot, const XMFLOAT3& aabbMin, const XMFLOAT3& aabbMax)
+    {
+        if (slot < _slotCount && _boxes)
         {
-            ResourceDescription desc(CD3DX12_RESOURCE_DESC::Buffer(8));
-            _queryResults.emplace_back(desc);
-            _queryResults.back().CreateCommitedResource(D3D12_RESOURCE_STATE_PREDICATION);
-            _queryResults.back().SetName("Query Result " + std::to_string(i));
+            _boxes[slot] = { aabbMin, aabbMax };
         }
     }
 
-    void OcclusionQuery::Run(const ISceneNode* node, GraphicsCommandList& commandList, const FrustumVolume& frustum)
+    void OcclusionQuery::Run(std::span<const uint32_t> slots, GraphicsCommandList& commandList)
     {
-        int index = -1;
-        for (int i = 0; i < _queryResources.size(); ++i)
+        if (slots.empty() || slots.front() >= _slotCount || !_queryHeap)
+        {
+            return;
+        }
+
+        const uint32_t slot = slots.front();
+        commandList.BeginQuery(_queryHeap, D3D12_QUERY_TYPE_BINARY_OCCLUSION, slot);
+        for (uint32_t box : slots)
         {
-            if (_queryResources[i] == node)
+            if (box < _slotCount)
             {
-                index = i;
+                commandList.DrawIndexed(AABBVolume::INDEX_COUNT, 1, 0, 0, box);
             }
         }
+        commandList.EndQuery(_queryHeap, D3D12_QUERY_TYPE_BINARY_OCCLUSION, slot);
 
-        if (index == -1)
+        _isTested[slot] = 1;
+        _firstSlot = std::min(_firstSlot, slot);
+        _lastSlot = std::max(_lastSlot, slot);
+    }
+
+    void OcclusionQuery::End(GraphicsCommandList& commandList)
+    {
+        if (!_queryHeap)
         {
-            _queryResources.push_back(node);
-            index = _queryResources.size() - 1;
+            return;
         }
 
-        commandList.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        _readbackRanges[_frameIndex] = { _firstSlot, _lastSlot };
+        if (_firstSlot > _lastSlot)
+        {
+            return;
+        }
 
-        commandList.BeginQuery(_queryHeap, D3D12_QUERY_TYPE_BINARY_OCCLUSION, index);
-        node->TestAABB(commandList);
-        commandList.EndQuery(_queryHeap, D3D12_QUERY_TYPE_BINARY_OCCLUSION, index);
+        // The slots of the range the frame did not test get empty queries, so the whole range
+        // holds results of this frame. Their nodes are not drawn with the predication
+        for (uint32_t slot = _firstSlot; slot <= _lastSlot; ++slot)
+        {
+            if (!_isTested[slot])
+            {
+                commandList.BeginQuery(_queryHeap, D3D12_QUERY_TYPE_BINARY_OCCLUSION, slot);
+                commandList.EndQuery(_queryHeap, D3D12_QUERY_TYPE_BINARY_OCCLUSION, slot);
+            }
+            _isTested[slot] = 0;
+        }
+
+        commandList.TransitionBarrier(*_queryResults, D3D12_RESOURCE_STATE_COPY_DEST);
+        commandList.ResolveQueryData(_queryHeap, D3D12_QUERY_TYPE_BINARY_OCCLUSION, _firstSlot, *_queryResults, _firstSlot * RESULT_SIZE, _lastSlot - _firstSlot + 1);
+        commandList.TransitionBarrier(*_queryResults, D3D12_RESOURCE_STATE_PREDICATION);
 
-        commandList.TransitionBarrier(_queryResults[index], D3D12_RESOURCE_STATE_COPY_DEST);
-        commandList.ResolveQueryData(_queryHeap, D3D12_QUERY_TYPE_BINARY_OCCLUSION, index, _queryResults[index], 0);
-        commandList.TransitionBarrier(_queryResults[index], D3D12_RESOURCE_STATE_PREDICATION);
+        // Read back once the frame completed, the readback buffer stays in the copy destination state
+        const UINT64 regionOffset = static_cast<UINT64>(_frameIndex) * _slotCount * RESULT_SIZE;
+        commandList.ResolveQueryData(_queryHeap, D3D12_QUERY_TYPE_BINARY_OCCLUSION, _firstSlot, *_readbackResults, regionOffset + _firstSlot * RESULT_SIZE, _lastSlot - _firstSlot + 1);
     }
 
-    void OcclusionQuery::SetPredication(const ISceneNode* node, GraphicsCommandList& commandList)
+    std::span<const UINT64> OcclusionQuery::ReadResults(uint32_t frameIndex)
     {
-        for (int i = 0; i < _queryResources.size(); ++i)
+        if (!_queryHeap)
         {
-            if (_queryResources[i] == node)
+            return _results;
+        }
+
+        frameIndex %= BACK_BUFFER_COUNT;
+
+        const auto [first, last] = _readbackRanges[frameIndex];
+        if (first <= last)
+        {
+            const SIZE_T regionOffset = static_cast<SIZE_T>(frameIndex) * _slotCount * RESULT_SIZE;
+            const D3D12_RANGE range = { regionOffset + first * RESULT_SIZE, regionOffset + (last + 1) * RESULT_SIZE };
+
+            void* data = nullptr;
+            if (SUCCEEDED(_readbackResults->GetDXResource()->Map(0, &range, &data)))
             {
-                commandList.SetPredication(&_queryResults[i], 0, D3D12_PREDICATION_OP_EQUAL_ZERO);
-                return;
+                memcpy(&_results[first], static_cast<const uint8_t*>(data) + range.Begin, range.End - range.Begin);
+
+                const D3D12_RANGE writtenRange = { 0, 0 };
+                _readbackResults->GetDXResource()->Unmap(0, &writtenRange);
             }
+
+            _readbackRanges[frameIndex] = { 1, 0 };
+        }
+
+        return _results;
+    }
+
+    void OcclusionQuery::SetPredication(uint32_t slot, GraphicsCommandList& commandList)
+    {
+        if (slot < _slotCount && _queryResults)
+        {
+            commandList.SetPredication(_queryResults.get(), slot * RESULT_SIZE, D3D12_PREDICATION_OP_EQUAL_ZERO);
+        }
+        else
+        {
+            commandList.SetPredication(nullptr, 0, D3D12_PREDICATION_OP_EQUAL_ZERO);
         }
-        commandList.SetPredication(nullptr, 0, D3D12_PREDICATION_OP_EQUAL_ZERO);
     }
 }
@@ -1,29 +1,80 @@
 #pragma once
 
 #include "DXObjects/GraphicsCommandList.h"
-#include "Scene/ISceneNode.h"
-
-class ISceneNode;
-class FrustumVolume;
 
 namespace Core
 {
+    // Binary occlusion queries of the scene nodes. Every node gets a slot once while the scene is
+    // loaded, the query, the predication result and the proxy box of the node live at that slot.
+    // The proxies are instances of a shared unit cube scaled to the boxes, the results of a frame
+    // are resolved into a single buffer with one copy, and into the readback region of the frame
     class OcclusionQuery
     {
     public:
+        static constexpr uint32_t INVALID_SLOT = 0xFFFFFFFF;
+
         OcclusionQuery();
         ~OcclusionQuery();
 
-        void Create(int numObjects = 256);
+        OcclusionQuery(const OcclusionQuery& copy) = delete;
+        OcclusionQuery& operator=(const OcclusionQuery& copy) = delete;
+
+        // While the scene is loaded, before Create
+        uint32_t AllocateSlot();
+        // For the slots allocated so far
+        void Create();
+        uint32_t GetSlotCount() const;
+
+        // Binds the unit cube, before the tests of a frame. The frame index selects the readback region
+        void Begin(uint32_t frameIndex, GraphicsCommandList& commandList);
+        void SetBox(uint32_t slot, const DirectX::XMFLOAT3& aabbMin, const DirectX::XMFLOAT3& aabbMax);
+        // Draws the boxes of the slots as instances of the unit cube inside the query of the first slot
+        void Run(std::span<const uint32_t> slots, GraphicsCommandList& commandList);
+        // Resolves the range of slots tested since Begin
+        void End(GraphicsCommandList& commandList);
+
+        // Results of the queries resolved the last time the frame index was used, by slot. Only once
+        // the GPU completed that frame, the slots the frame did not resolve keep older results
+        std::span<const UINT64> ReadResults(uint32_t frameIndex);
 
-        void Run(const ISceneNode* node, GraphicsCommandList& commandList, const FrustumVolume& frustum);
-        void SetPredication(const ISceneNode* node, GraphicsCommandList& commandList);
+        // Draws unconditionally for INVALID_SLOT
+        void SetPredication(uint32_t slot, GraphicsCommandList& commandList);
 
     private:
+        // Instance data of the proxy, the unit cube is scaled from min to max
+        struct Box
+        {
+            DirectX::XMFLOAT3 min;
+            DirectX::XMFLOAT3 max;
+        };
+
         ComPtr<ID3D12Device2> _DXDevice;
 
         ComPtr<ID3D12QueryHeap> _queryHeap;
-        std::vector<const ISceneNode*> _queryResources;
-        std::vector<Resource> _queryResults;
+        // 8 bytes per slot
+        std::shared_ptr<Resource> _queryResults;
+        // A region of 8 bytes per slot for every frame in flight
+        std::shared_ptr<Resource> _readbackResults;
+        std::vector<UINT64> _results;
+
+        std::shared_ptr<Resource> _cubeVertexBuffer;
+        std::shared_ptr<Resource> _cubeIndexBuffer;
+        // Mapped for the lifetime of the queries, written by SetBox like the model constants
+        std::shared_ptr<Resource> _boxBuffer;
+        Box* _boxes;
+
+        D3D12_VERTEX_BUFFER_VIEW _cubeVBO;
+        D3D12_VERTEX_BUFFER_VIEW _boxVBO;
+        D3D12_INDEX_BUFFER_VIEW _cubeIBO;
+
+        uint32_t _slotCount;
+
+        // Range of the slots tested since Begin
+        uint32_t _frameIndex;
+        uint32_t _firstSlot;
+        uint32_t _lastSlot;
+        std::vector<uint8_t> _isTested;
+        // Range of the slots resolved into every readback region, empty if first > last
+        std::vector<std::pair<uint32_t, uint32_t>> _readbackRanges;
     };
 }
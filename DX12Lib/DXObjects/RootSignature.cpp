@@ -15,6 +15,10 @@ namespace Core
             { "float3", DXGI_FORMAT_R32G32B32_FLOAT },
             { "float2", DXGI_FORMAT_R32G32_FLOAT },
             { "float", DXGI_FORMAT_R32_FLOAT },
+            { "half2", DXGI_FORMAT_R16G16_FLOAT },
+            { "unorm16x4", DXGI_FORMAT_R16G16B16A16_UNORM },
+            { "snorm16x2", DXGI_FORMAT_R16G16_SNORM },
+            { "unorm8x4", DXGI_FORMAT_R8G8B8A8_UNORM },
         };
 
         DXGI_FORMAT ParseFormat(const std::string& str)
@@ -249,6 +253,24 @@ namespace Core
         return _isGraphicsPipeline;
     }
 
+    bool RootSignature::IsPositionOnly() const
+    {
+        return _isPositionOnly;
+    }
+
+    const RootSignature* RootSignature::GetVariant(MeshFormat::VertexLayout vertexLayout) const
+    {
+        switch (vertexLayout)
+        {
+        case MeshFormat::VertexLayout::Float:
+            return this;
+        case MeshFormat::VertexLayout::Packed:
+            return _packedVariant.get();
+        }
+
+        return nullptr;
+    }
+
     void RootSignature::Parse(const std::string& filepath)
     {
         auto device = Core::Device::GetDXDevice();
@@ -296,6 +318,12 @@ namespace Core
                 inputLayout[i].Format = ParseFormat(layout["Format"].asCString());
                 inputLayout[i].AlignedByteOffset = layout["Offset"].asUInt();
                 inputLayout[i].InputSlot = layout["Stream"].asUInt();
+                // The elements of an instance stream advance once per instance
+                if (!layout["InstanceStepRate"].isNull())
+                {
+                    inputLayout[i].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA;
+                    inputLayout[i].InstanceDataStepRate = layout["InstanceStepRate"].asUInt();
+                }
             }
         }
 
@@ -327,12 +355,14 @@ namespace Core
         {
             pipelineStateStreamDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShaderBlob.Get());
         }
-        pipelineStateStreamDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+        pipelineStateStreamDesc.DSVFormat = jsonRoot["DepthBuffer"].isNull() ? DXGI_FORMAT_UNKNOWN : DXGI_FORMAT_D32_FLOAT;
         Json::Value renderTargets = jsonRoot["RenderTargets"];
+        // The targets other than the back buffer name their formats
+        Json::Value renderTargetFormats = jsonRoot["RenderTargetFormats"];
         pipelineStateStreamDesc.NumRenderTargets = renderTargets.size();
         for (int i = 0; i < renderTargets.size(); ++i)
         {
-            pipelineStateStreamDesc.RTVFormats[i] = DXGI_FORMAT_R8G8B8A8_UNORM;
+            pipelineStateStreamDesc.RTVFormats[i] = i < renderTargetFormats.size() ? ParseFormat(renderTargetFormats[i].asCString()) : DXGI_FORMAT_R8G8B8A8_UNORM;
         }
         pipelineStateStreamDesc.SampleDesc.Count = 1; // must be the same sample description as the swapChain and depth/stencil buffer
         pipelineStateStreamDesc.SampleMask = 0xffffffff; // sample mask has to do with multi-sampling. 0xffffffff means point sampling is done
@@ -340,6 +370,15 @@ namespace Core
         Helper::throwIfFailed(device->CreateGraphicsPipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&_pipelineState)));
 
         delete[] inputLayout;
+
+        _isPositionOnly = jsonRoot["PositionOnly"].asBool();
+
+        // Same technique for the meshes stored in the packed vertex layout
+        if (!jsonRoot["PackedVariant"].isNull())
+        {
+            _packedVariant = std::make_shared<RootSignature>();
+            _packedVariant->Parse(jsonRoot["PackedVariant"].asCString());
+        }
     }
 
     D3D12_BLEND_DESC RootSignature::ParseBlendDescription(const std::string& filepath)
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Scene/MeshFormat.h"
+
 // TODO: Implement parsing of Compute graphics pipeline
 
 namespace Core
@@ -11,6 +13,12 @@ namespace Core
         ComPtr<ID3D12PipelineState> GetPipelineState() const;
 
         bool IsGraphicsPipeline() const;
+        // The technique reads only the vertex positions, so the meshes bind their position streams
+        bool IsPositionOnly() const;
+
+        // Pipeline with the same root signature and shaders for another vertex layout,
+        // nullptr if the technique doesn't have one
+        const RootSignature* GetVariant(MeshFormat::VertexLayout vertexLayout) const;
 
         void Parse(const std::string& filepath);
 
@@ -23,6 +31,9 @@ namespace Core
         ComPtr<ID3D12PipelineState> _pipelineState;
 
         bool _isGraphicsPipeline;
+        bool _isPositionOnly = false;
+
+        std::shared_ptr<RootSignature> _packedVariant;
     };
 } // namespace Core
 
@@ -30,6 +30,7 @@ DXRenderer::DXRenderer(HWND windowHandle)
     : _DXDevice(Device::GetDXDevice())
     , _windowHandle(windowHandle)
     , _contentLoaded(false)
+    , _isFirstFrameRendered(false)
     , _ambient(nullptr)
     , _isCameraMoving(false)
     , _deltaTime(0.0f)
@@ -45,12 +46,15 @@ void DXRenderer::SetScene(const std::string& filepath)
     _scenePath = filepath;
 }
 
-bool DXRenderer::LoadContent(TaskGPU* loadTask)
+bool DXRenderer::LoadContent()
 {
+    _loadClock.Reset();
+
     _renderPipeline.Parse("PipelineDescriptions\\TriangleRenderPipeline.tech");
     _AABBpipeline.Parse("PipelineDescriptions\\AABBRenderPipeline.tech");
     _depthPrepassPipeline.Parse("PipelineDescriptions\\DepthPretestPipeline.tech");
     _occlusionPipeline.Parse("PipelineDescriptions\\OcclusionCullingPipeline.tech");
+    _depthDownsamplePipeline.Parse("PipelineDescriptions\\DepthDownsamplePipeline.tech");
 
 #if defined(_DEBUG)
     _statsQuery.Create();
@@ -90,27 +94,8 @@ bool DXRenderer::LoadContent(TaskGPU* loadTask)
         val->Down = { 0.3f, 0.0f, 0.3f, 1.0f };
     }
 
-    // Load scene
-    {
-        loadTask->SetName("Upload Data");
-        Core::GraphicsCommandList* commandList = loadTask->GetCommandLists().front();
-
-        _scene.LoadScene(_scenePath, *commandList);
-
-        commandList->Close();
-
-        std::vector<ID3D12CommandList*> comLists;
-        comLists.reserve(loadTask->GetCommandLists().size());
-        for (auto cl : loadTask->GetCommandLists())
-        {
-            comLists.push_back(cl->GetDXCommandList().Get());
-        }
-
-        loadTask->GetCommandQueue()->ExecuteCommandLists(comLists.size(), comLists.data());
-        loadTask->GetCommandQueue()->Signal(loadTask->GetFence()->GetFence().Get(), loadTask->GetFenceValue());
-    }
-
-    Sleep(2000);
+    // Only the hierarchy, the meshes and textures are streamed while the scene is rendered
+    _scene.LoadScene(_scenePath);
 
     _contentLoaded = true;
     return _contentLoaded;
@@ -136,6 +121,13 @@ void DXRenderer::OnUpdate(Events::UpdateEvent& updateEvent)
         int fps = frameCount / totalTime;
 
         std::wstring fpsText = L"FPS: " + std::to_wstring(fps);
+
+        const SceneLoadProgress& progress = _scene.GetLoadProgress();
+        if (!progress.IsFinished())
+        {
+            fpsText += L" | Loading " + std::to_wstring(progress.residentUploadCount * 100 / progress.uploadCount) + L"%";
+        }
+
         ::SetWindowText(_windowHandle, fpsText.c_str());
 
         frameCount = 0;
@@ -154,6 +146,58 @@ void DXRenderer::OnUpdate(Events::UpdateEvent& updateEvent)
         OutputDebugStringA(d.c_str());
         d = "PS invocs: " + std::to_string(stat.PSInvocations) + "\n";
         OutputDebugStringA(d.c_str());
+
+        const VertexFetchStatistics& fetchStats = _scene.GetVertexFetchStatistics();
+        if (fetchStats.frameCount > 0)
+        {
+            d = "Vertex bytes per frame: " + std::to_string(fetchStats.fetchedBytes / fetchStats.frameCount)
+                + " (" + std::to_string(fetchStats.interleavedBytes / fetchStats.frameCount) + " without position streams)\n";
+            OutputDebugStringA(d.c_str());
+        }
+        _scene.ResetVertexFetchStatistics();
+
+        const TransformStatistics& transformStats = _scene.GetTransformStatistics();
+        if (transformStats.frameCount > 0)
+        {
+            d = "Global transforms updated per frame: " + std::to_string(transformStats.updatedCount / transformStats.frameCount)
+                + " in " + std::to_string(transformStats.updateMilliseconds / transformStats.frameCount) + " ms\n";
+            OutputDebugStringA(d.c_str());
+            d = "Node AABBs moved per frame: " + std::to_string(transformStats.movedCount / transformStats.frameCount) + " in the BVH, "
+                + std::to_string(transformStats.dynamicMovedCount / transformStats.frameCount) + " in the loose octree, "
+                + std::to_string(transformStats.boundsMilliseconds / transformStats.frameCount) + " ms\n";
+            OutputDebugStringA(d.c_str());
+        }
+        _scene.ResetTransformStatistics();
+
+        const TraversalStatistics& traversalStats = _scene.GetTraversalStatistics();
+        if (traversalStats.frameCount > 0)
+        {
+            d = "Bounds tested per frame: " + std::to_string(traversalStats.visitedCount / traversalStats.frameCount)
+                + " against " + std::to_string(traversalStats.planeTestCount / traversalStats.frameCount) + " planes"
+                + ", outside the PVS: " + std::to_string(traversalStats.pvsHiddenCount / traversalStats.frameCount)
+                + ", visible nodes: " + std::to_string(traversalStats.visibleCount / traversalStats.frameCount)
+                + " culled in " + std::to_string(traversalStats.cullMilliseconds / traversalStats.frameCount) + " ms"
+                + ", too small: " + std::to_string(traversalStats.smallCount / traversalStats.frameCount)
+                + " saving " + std::to_string(traversalStats.smallTriangleCount / traversalStats.frameCount) + " triangles"
+                + ", software occluded: " + std::to_string(traversalStats.occludedCount / traversalStats.frameCount)
+                + " by " + std::to_string(traversalStats.occluderTriangleCount / traversalStats.frameCount) + " triangles in "
+                + std::to_string(traversalStats.occlusionMilliseconds / traversalStats.frameCount) + " ms"
+                + ", occlusion queries: " + std::to_string(traversalStats.queryCount / traversalStats.frameCount)
+                + " over " + std::to_string(traversalStats.queriedNodeCount / traversalStats.frameCount) + " nodes"
+                + ", read back " + std::to_string(traversalStats.readbackCount / traversalStats.frameCount)
+                + " after " + std::to_string(traversalStats.readbackCount > 0 ? static_cast<double>(traversalStats.readbackLatencyFrames) / traversalStats.readbackCount : 0.0) + " frames"
+                + ", draws skipped: " + std::to_string(traversalStats.skippedDrawCount / traversalStats.frameCount)
+                + ", reprojection occluded: " + std::to_string(traversalStats.reprojectedOccludedCount / traversalStats.frameCount)
+                + " with " + std::to_string(traversalStats.reprojectionHoleCount / traversalStats.frameCount) + " disoccluded texels in "
+                + std::to_string(traversalStats.reprojectionMilliseconds / traversalStats.frameCount) + " ms"
+                + ", nodes drawn: " + std::to_string(traversalStats.drawnCount / traversalStats.frameCount)
+                + " in " + std::to_string(traversalStats.traversalMilliseconds / traversalStats.frameCount) + " ms, BVH rebuilds: "
+                + std::to_string(traversalStats.rebuildCount)
+                + ", views culled together: " + std::to_string(traversalStats.multiViewCount / traversalStats.frameCount)
+                + " in " + std::to_string(traversalStats.multiViewCullMilliseconds / traversalStats.frameCount) + " ms\n";
+            OutputDebugStringA(d.c_str());
+        }
+        _scene.ResetTraversalStatistics();
 #endif
     }
 
@@ -165,6 +209,21 @@ void DXRenderer::OnRender(Events::RenderEvent& renderEvent, Frame& frame)
     frame.WaitCPU();
     frame.ResetGPU();
 
+    // The occlusion results of the frame are complete after the wait
+    _scene.BeginFrame(frame.Index);
+    _scene.UpdateLoading();
+    _scene.UpdateTransforms();
+    // Once for the depth prepass, occlusion and main passes
+    _scene.CullView(_camera, _visibleList);
+
+    if (!_isFirstFrameRendered)
+    {
+        _isFirstFrameRendered = true;
+
+        _loadClock.Tick();
+        Logger::Log(LogType::Info, "First frame after " + std::to_string(_loadClock.GetTotalMilliSeconds()) + " ms");
+    }
+
     auto rtv = frame._targetHeap->GetCPUDescriptorHandleForHeapStart();
     auto dsv = frame._depthHeap->GetCPUDescriptorHandleForHeapStart();
 
@@ -206,7 +265,7 @@ void DXRenderer::OnRender(Events::RenderEvent& renderEvent, Frame& frame)
         commandList->SetConstants(0, sizeof(XMMATRIX) / 4, &viewProjMatrix);
         commandList->SetCBV(2, _ambient->OffsetGPU(0));
 
-        _scene.DrawOccluders(*commandList, _camera);
+        _scene.DrawOccluders(*commandList, _visibleList);
 
         PIXEndEvent(commandList->GetDXCommandList().Get());
         commandList->Close();
@@ -230,7 +289,7 @@ void DXRenderer::OnRender(Events::RenderEvent& renderEvent, Frame& frame)
         XMMATRIX viewProjMatrix = XMMatrixMultiply(_camera.View(), _camera.Projection());
         commandList->SetConstants(0, sizeof(XMMATRIX) / 4, &viewProjMatrix);
 
-        _scene.RunOcclusion(*commandList, _camera.GetViewFrustum());
+        _scene.RunOcclusion(*commandList, _visibleList);
 
         PIXEndEvent(commandList->GetDXCommandList().Get());
         commandList->Close();
@@ -258,7 +317,7 @@ void DXRenderer::OnRender(Events::RenderEvent& renderEvent, Frame& frame)
         commandList->SetConstants(0, sizeof(XMMATRIX) / 4, &viewProjMatrix);
         commandList->SetCBV(2, _ambient->OffsetGPU(0));
 
-        _scene.Draw(*commandList, _camera);
+        _scene.Draw(*commandList, _visibleList);
 
 #if defined(_DEBUG)
         _statsQuery.EndQuery(*commandList);
@@ -275,6 +334,26 @@ void DXRenderer::OnRender(Events::RenderEvent& renderEvent, Frame& frame)
         commandList->Close();
     }
 
+    // Downsample the depth for the reprojected occlusion of the next frames
+    if (_scene.GetOcclusionMode() == OcclusionMode::Reprojected)
+    {
+        TaskGPU* task = frame.CreateTask(D3D12_COMMAND_LIST_TYPE_DIRECT, &_depthDownsamplePipeline);
+        task->SetName("depth readback");
+        task->AddDependency("render");
+
+        Core::GraphicsCommandList* commandList = task->GetCommandLists().front();
+        PIXBeginEvent(commandList->GetDXCommandList().Get(), 4, "Depth Readback");
+
+        commandList->SetPipelineState(_depthDownsamplePipeline);
+        commandList->SetGraphicsRootSignature(_depthDownsamplePipeline);
+
+        XMMATRIX viewProjMatrix = XMMatrixMultiply(_camera.View(), _camera.Projection());
+        _scene.DownsampleDepth(*commandList, frame._depthTexture, viewProjMatrix);
+
+        PIXEndEvent(commandList->GetDXCommandList().Get());
+        commandList->Close();
+    }
+
     // Present
     {
         TaskGPU* task = frame.CreateTask(D3D12_COMMAND_LIST_TYPE_DIRECT, nullptr);
@@ -320,8 +399,71 @@ void DXRenderer::OnKeyPressed(Events::KeyEvent& e)
     case DIKeyCode::DIK_ESCAPE:
         ::SendMessage(_windowHandle, WM_DESTROY, 0, 0);
         break;
+    case DIKeyCode::DIK_O:
+        switch (_scene.GetOcclusionMode())
+        {
+        case OcclusionMode::Predicated:
+            _scene.SetOcclusionMode(OcclusionMode::Coherent);
+            break;
+        case OcclusionMode::Coherent:
+            _scene.SetOcclusionMode(OcclusionMode::Reprojected);
+            break;
+        case OcclusionMode::Reprojected:
+            _scene.SetOcclusionMode(OcclusionMode::Predicated);
+            break;
+        }
+        break;
+#if defined(_DEBUG)
+    case DIKeyCode::DIK_V:
+        _BenchmarkMultiView();
+        break;
+#endif
+    }
+}
+
+#if defined(_DEBUG)
+void DXRenderer::_BenchmarkMultiView()
+{
+    constexpr int RUN_COUNT = 100;
+    constexpr uint32_t VIEW_COUNTS[] = { 1, 4, 8 };
+
+    std::vector<MultiViewNode> nodes;
+    for (uint32_t viewCount : VIEW_COUNTS)
+    {
+        // Slices of the view depth like the shadow cascades
+        std::vector<Camera> cameras(viewCount, _camera);
+        std::vector<const Camera*> views;
+        for (uint32_t v = 0; v < viewCount; ++v)
+        {
+            const float nearZ = _camera.GetNearZ() + (_camera.GetFarZ() - _camera.GetNearZ()) * v / viewCount;
+            const float farZ = _camera.GetNearZ() + (_camera.GetFarZ() - _camera.GetNearZ()) * (v + 1) / viewCount;
+            cameras[v].SetLens(_camera.GetFOV(), nearZ, farZ);
+            views.push_back(&cameras[v]);
+        }
+
+        HighResolutionClock clock;
+        for (int run = 0; run < RUN_COUNT; ++run)
+        {
+            for (const Camera* view : views)
+            {
+                _scene.CullViews(std::span(&view, 1), nodes);
+            }
+        }
+        clock.Tick();
+        const double separateMilliseconds = clock.GetDeltaMilliseconds() / RUN_COUNT;
+
+        for (int run = 0; run < RUN_COUNT; ++run)
+        {
+            _scene.CullViews(views, nodes);
+        }
+        clock.Tick();
+        const double multiMilliseconds = clock.GetDeltaMilliseconds() / RUN_COUNT;
+
+        Logger::Log(LogType::Info, std::to_string(viewCount) + " views culled one by one in " + std::to_string(separateMilliseconds)
+            + " ms, together in " + std::to_string(multiMilliseconds) + " ms");
     }
 }
+#endif
 
 void DXRenderer::OnMouseMoved(Events::MouseMoveEvent& e)
 {
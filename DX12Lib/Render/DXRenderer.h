@@ -8,6 +8,7 @@
 #include "Scene/Camera.h"
 #include "Scene/Scene.h"
 #include "Render/Frame.h"
+#include "Utility/HighResolutionClock.h"
 #include "Window/IWindowEventListener.h"
 
 class DXRenderer : public Core::Events::IWindowEventListener
@@ -17,7 +18,7 @@ public:
     ~DXRenderer();
 
     virtual void SetScene(const std::string& filepath);
-    virtual bool LoadContent(TaskGPU* loadTask);
+    virtual bool LoadContent();
     virtual void UnloadContent();
 
     virtual void OnUpdate(Core::Events::UpdateEvent& e) override;
@@ -31,6 +32,11 @@ public:
     virtual void OnResize(Core::Events::ResizeEvent& e) override {}
 
 private:
+#if defined(_DEBUG)
+    // Logs the time to cull 1, 4 and 8 depth slices of the camera view together and one by one
+    void _BenchmarkMultiView();
+#endif
+
     ComPtr<ID3D12Device2> _DXDevice;
     HWND _windowHandle;
 
@@ -38,6 +44,7 @@ private:
     Core::RootSignature _AABBpipeline;
     Core::RootSignature _depthPrepassPipeline;
     Core::RootSignature _occlusionPipeline;
+    Core::RootSignature _depthDownsamplePipeline;
 
     std::shared_ptr<Core::Resource> _ambient;
 
@@ -47,11 +54,16 @@ private:
     std::string _scenePath;
     Scene _scene;
     Camera _camera;
+    VisibleList _visibleList;
     bool _isCameraMoving;
     float _deltaTime;
 
     bool _contentLoaded;
 
+    // Time from LoadContent to the first frame
+    HighResolutionClock _loadClock;
+    bool _isFirstFrameRendered;
+
 #if defined(_DEBUG)
     Core::StatisticsQuery _statsQuery;
 #endif
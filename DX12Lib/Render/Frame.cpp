@@ -75,7 +75,8 @@ void Frame::Init(const Core::SwapChain& swapChain)
         Core::ResourceDescription desc = _swapChainTexture.GetResourceDescription();
 
         desc.SetFlags(D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
-        desc.SetFormat(DXGI_FORMAT_D32_FLOAT);
+        // Typeless so the depth is also read as R32_FLOAT by the depth readback
+        desc.SetFormat(DXGI_FORMAT_R32_TYPELESS);
 
         D3D12_CLEAR_VALUE clearValue;
         clearValue.Format = DXGI_FORMAT_D32_FLOAT;
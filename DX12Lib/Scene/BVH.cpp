@@ -0,0 +1,700 @@
+#include "stdafx.h"
+
+#include "BVH.h"
+
+#include "Scene/Volumes/FrustumCuller.h"
+
+#include <bit>
+#include <cfloat>
+#include <immintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t BIN_COUNT = 16;
+    constexpr uint32_t MAX_LEAF_SIZE = 8;
+    // Costs of visiting an inner node and of testing an item, the items of a leaf are tested in a SIMD batch
+    constexpr float TRAVERSAL_COST = 1.0f;
+    constexpr float ITEM_COST = 0.25f;
+    // Bounds the traversal stack, the subtrees below split at the median halve every level
+    constexpr uint32_t MAX_DEPTH = 64;
+    constexpr uint32_t MEDIAN_SPLIT_DEPTH = 40;
+    constexpr double REBUILD_RATIO = 1.5;
+
+    // A node to cull and the planes its parent was not inside of
+    struct CullEntry
+    {
+        uint32_t node;
+        uint32_t planeMask;
+    };
+
+    // A node to cull for several views, the views and their planes its parent was not inside of
+    struct MultiCullEntry
+    {
+        uint32_t node;
+        uint32_t viewMask;
+        uint8_t planeMasks[MultiFrustumCuller::MAX_VIEW_COUNT];
+    };
+
+    // The views of the entry it is not inside of, the plane masks compared to 0 at once
+    uint32_t GetStraddledViews(const MultiCullEntry& entry)
+    {
+        static_assert(MultiFrustumCuller::MAX_VIEW_COUNT == 8, "The plane masks are loaded as 8 bytes");
+
+        const __m128i planeMasks = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(entry.planeMasks));
+        const uint32_t insideViews = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(planeMasks, _mm_setzero_si128())));
+
+        return entry.viewMask & ~insideViews;
+    }
+
+    const BVH::Bounds EMPTY_BOUNDS = { XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX), XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+
+    struct BuildItem
+    {
+        BVH::Bounds bounds;
+        float centroid[3];
+        uint32_t index;
+    };
+
+    struct BuildTask
+    {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+        uint32_t depth;
+    };
+
+    struct Bin
+    {
+        BVH::Bounds bounds = EMPTY_BOUNDS;
+        uint32_t count = 0;
+    };
+
+    void Grow(BVH::Bounds& bounds, const XMFLOAT3& min, const XMFLOAT3& max)
+    {
+        bounds.min = XMFLOAT3(std::min(bounds.min.x, min.x), std::min(bounds.min.y, min.y), std::min(bounds.min.z, min.z));
+        bounds.max = XMFLOAT3(std::max(bounds.max.x, max.x), std::max(bounds.max.y, max.y), std::max(bounds.max.z, max.z));
+    }
+
+    void Grow(BVH::Bounds& bounds, const BVH::Bounds& other)
+    {
+        Grow(bounds, other.min, other.max);
+    }
+
+    // Half the surface area, only the ratios matter
+    float GetArea(const BVH::Bounds& bounds)
+    {
+        float x = bounds.max.x - bounds.min.x;
+        float y = bounds.max.y - bounds.min.y;
+        float z = bounds.max.z - bounds.min.z;
+
+        return (x < 0.0f || y < 0.0f || z < 0.0f) ? 0.0f : x * y + y * z + z * x;
+    }
+
+    float GetAxis(const XMFLOAT3& vector, uint32_t axis)
+    {
+        return (&vector.x)[axis];
+    }
+
+    uint32_t GetBin(float centroid, float min, float scale)
+    {
+        return std::min(BIN_COUNT - 1, static_cast<uint32_t>((centroid - min) * scale));
+    }
+
+    // Orders the items of the range into the two children and returns the size of the first,
+    // 0 if the range stays a leaf
+    uint32_t Partition(std::vector<BuildItem>& items, const BuildTask& task, const BVH::Bounds& bounds, const BVH::Bounds& centroidBounds)
+    {
+        auto first = items.begin() + task.first;
+        auto last = first + task.count;
+
+        const float extent[3] =
+        {
+            centroidBounds.max.x - centroidBounds.min.x,
+            centroidBounds.max.y - centroidBounds.min.y,
+            centroidBounds.max.z - centroidBounds.min.z
+        };
+
+        float bestCost = FLT_MAX;
+        uint32_t bestAxis = 0;
+        uint32_t bestBin = BIN_COUNT;
+
+        // All the axes are binned in one pass over the items
+        Bin bins[3][BIN_COUNT];
+        float scales[3];
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            scales[axis] = extent[axis] > 0.0f ? BIN_COUNT / extent[axis] : 0.0f;
+        }
+
+        if (task.depth < MEDIAN_SPLIT_DEPTH)
+        {
+            for (auto item = first; item != last; ++item)
+            {
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    Bin& bin = bins[axis][GetBin(item->centroid[axis], GetAxis(centroidBounds.min, axis), scales[axis])];
+                    Grow(bin.bounds, item->bounds);
+                    ++bin.count;
+                }
+            }
+        }
+
+        for (uint32_t axis = 0; axis < 3 && task.depth < MEDIAN_SPLIT_DEPTH; ++axis)
+        {
+            if (extent[axis] <= 0.0f)
+            {
+                continue;
+            }
+
+            // Split after bin i: the area and count of the bins up to i against the rest
+            float leftAreas[BIN_COUNT - 1];
+            uint32_t leftCounts[BIN_COUNT - 1];
+            BVH::Bounds left = EMPTY_BOUNDS;
+            uint32_t leftCount = 0;
+            for (uint32_t i = 0; i < BIN_COUNT - 1; ++i)
+            {
+                Grow(left, bins[axis][i].bounds);
+                leftCount += bins[axis][i].count;
+                leftAreas[i] = GetArea(left);
+                leftCounts[i] = leftCount;
+            }
+
+            BVH::Bounds right = EMPTY_BOUNDS;
+            uint32_t rightCount = 0;
+            for (uint32_t i = BIN_COUNT - 1; i > 0; --i)
+            {
+                Grow(right, bins[axis][i].bounds);
+                rightCount += bins[axis][i].count;
+
+                float cost = leftAreas[i - 1] * leftCounts[i - 1] + GetArea(right) * rightCount;
+                if (leftCounts[i - 1] > 0 && rightCount > 0 && cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = i - 1;
+                }
+            }
+        }
+
+        if (bestBin == BIN_COUNT)
+        {
+            // Coincident centroids or a deep subtree, any split does, the leaves just stay small
+            if (task.count <= MAX_LEAF_SIZE)
+            {
+                return 0;
+            }
+
+            uint32_t axis = static_cast<uint32_t>(std::max_element(extent, extent + 3) - extent);
+            auto middle = first + task.count / 2;
+            std::nth_element(first, middle, last, [axis](const BuildItem& a, const BuildItem& b)
+            {
+                return a.centroid[axis] < b.centroid[axis];
+            });
+
+            return task.count / 2;
+        }
+
+        const float area = GetArea(bounds);
+        const float splitCost = area > 0.0f ? TRAVERSAL_COST + ITEM_COST * bestCost / area : TRAVERSAL_COST;
+        if (task.count <= MAX_LEAF_SIZE && ITEM_COST * task.count <= splitCost)
+        {
+            return 0;
+        }
+
+        const float min = GetAxis(centroidBounds.min, bestAxis);
+        const float scale = scales[bestAxis];
+        auto middle = std::partition(first, last, [=](const BuildItem& item)
+        {
+            return GetBin(item.centroid[bestAxis], min, scale) <= bestBin;
+        });
+
+        return static_cast<uint32_t>(middle - first);
+    }
+}
+
+BVH::BVH()
+    : _hasDirty(false)
+    , _cost(0.0)
+    , _builtCost(0.0)
+{
+}
+
+BVH::~BVH()
+{
+}
+
+void BVH::Build(std::vector<Item> items)
+{
+    _nodes.clear();
+    _parents.clear();
+    _items.clear();
+    _hasDirty = false;
+    _cost = 0.0;
+
+    uint32_t itemCount = 0;
+    for (const Item& item : items)
+    {
+        itemCount = std::max(itemCount, item.index + 1);
+    }
+
+    _itemBounds.assign(itemCount, EMPTY_BOUNDS);
+    _itemLeaves.assign(itemCount, INVALID_INDEX);
+
+    if (items.empty())
+    {
+        _itemBoxes.Resize(0);
+        _isDirty.clear();
+        _lastPlanes.clear();
+        _visibleItems.clear();
+        _builtCost = 0.0;
+        return;
+    }
+
+    std::vector<float> minSizes(itemCount, 0.0f);
+    std::vector<BuildItem> buildItems(items.size());
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        const Bounds& bounds = items[i].bounds;
+
+        buildItems[i].bounds = bounds;
+        buildItems[i].centroid[0] = (bounds.min.x + bounds.max.x) * 0.5f;
+        buildItems[i].centroid[1] = (bounds.min.y + bounds.max.y) * 0.5f;
+        buildItems[i].centroid[2] = (bounds.min.z + bounds.max.z) * 0.5f;
+        buildItems[i].index = items[i].index;
+
+        _itemBounds[items[i].index] = bounds;
+        minSizes[items[i].index] = items[i].minSize;
+    }
+
+    _nodes.reserve(2 * items.size());
+    _parents.reserve(2 * items.size());
+    _items.reserve(items.size());
+
+    _nodes.emplace_back();
+    _parents.push_back(INVALID_INDEX);
+
+    std::vector<BuildTask> tasks;
+    tasks.push_back({ 0, 0, static_cast<uint32_t>(buildItems.size()), 0 });
+
+    while (!tasks.empty())
+    {
+        BuildTask task = tasks.back();
+        tasks.pop_back();
+
+        Bounds bounds = EMPTY_BOUNDS;
+        Bounds centroidBounds = EMPTY_BOUNDS;
+        for (uint32_t i = task.first; i < task.first + task.count; ++i)
+        {
+            const BuildItem& item = buildItems[i];
+            const XMFLOAT3 centroid(item.centroid[0], item.centroid[1], item.centroid[2]);
+
+            Grow(bounds, item.bounds);
+            Grow(centroidBounds, centroid, centroid);
+        }
+
+        uint32_t leftCount = task.count > 1 ? Partition(buildItems, task, bounds, centroidBounds) : 0;
+
+        Node& node = _nodes[task.node];
+        node.aabbMin = bounds.min;
+        node.aabbMax = bounds.max;
+
+        if (leftCount == 0)
+        {
+            node.offset = static_cast<uint32_t>(_items.size());
+            node.count = task.count;
+
+            for (uint32_t i = task.first; i < task.first + task.count; ++i)
+            {
+                _items.push_back(buildItems[i].index);
+                _itemLeaves[buildItems[i].index] = task.node;
+            }
+        }
+        else
+        {
+            const uint32_t child = static_cast<uint32_t>(_nodes.size());
+            node.offset = child;
+            node.count = 0;
+
+            _nodes.emplace_back();
+            _nodes.emplace_back();
+            _parents.push_back(task.node);
+            _parents.push_back(task.node);
+
+            tasks.push_back({ child, task.first, leftCount, task.depth + 1 });
+            tasks.push_back({ child + 1, task.first + leftCount, task.count - leftCount, task.depth + 1 });
+        }
+    }
+
+    for (const Node& node : _nodes)
+    {
+        _cost += _GetNodeCost(node);
+    }
+
+    _itemBoxes.Resize(_items.size());
+    for (size_t i = 0; i < _items.size(); ++i)
+    {
+        _itemBoxes.Set(i, _itemBounds[_items[i]].min, _itemBounds[_items[i]].max);
+        _itemBoxes.minSize[i] = minSizes[_items[i]];
+    }
+
+    _isDirty.assign(_nodes.size(), 0);
+    _lastPlanes.assign(_nodes.size(), 0);
+    _builtCost = _GetCost();
+    _UpdateVisibleItems();
+}
+
+void BVH::SetBounds(uint32_t item, const Bounds& bounds)
+{
+    if (ASSERT(item < _itemLeaves.size() && _itemLeaves[item] != INVALID_INDEX, "The item is not in the BVH"))
+    {
+        return;
+    }
+
+    _itemBounds[item] = bounds;
+
+    const Node& leaf = _nodes[_itemLeaves[item]];
+    for (uint32_t i = leaf.offset; i < leaf.offset + leaf.count; ++i)
+    {
+        if (_items[i] == item)
+        {
+            _itemBoxes.Set(i, bounds.min, bounds.max);
+        }
+    }
+
+    // The ancestors of a dirty node are already dirty
+    for (uint32_t node = _itemLeaves[item]; node != INVALID_INDEX && !_isDirty[node]; node = _parents[node])
+    {
+        _isDirty[node] = 1;
+    }
+    _hasDirty = true;
+}
+
+void BVH::SetMinSize(uint32_t item, float minSize)
+{
+    if (item >= _itemLeaves.size() || _itemLeaves[item] == INVALID_INDEX)
+    {
+        return;
+    }
+
+    const Node& leaf = _nodes[_itemLeaves[item]];
+    for (uint32_t i = leaf.offset; i < leaf.offset + leaf.count; ++i)
+    {
+        if (_items[i] == item)
+        {
+            _itemBoxes.minSize[i] = minSize;
+        }
+    }
+}
+
+void BVH::Refit()
+{
+    if (!_hasDirty)
+    {
+        return;
+    }
+
+    // The children follow their parent, so they are refitted first
+    for (size_t i = _nodes.size(); i-- > 0;)
+    {
+        if (!_isDirty[i])
+        {
+            continue;
+        }
+
+        Node& node = _nodes[i];
+        _cost -= _GetNodeCost(node);
+
+        Bounds bounds = EMPTY_BOUNDS;
+        if (node.count > 0)
+        {
+            for (uint32_t j = 0; j < node.count; ++j)
+            {
+                Grow(bounds, _itemBounds[_items[node.offset + j]]);
+            }
+        }
+        else
+        {
+            Grow(bounds, _nodes[node.offset].aabbMin, _nodes[node.offset].aabbMax);
+            Grow(bounds, _nodes[node.offset + 1].aabbMin, _nodes[node.offset + 1].aabbMax);
+        }
+
+        node.aabbMin = bounds.min;
+        node.aabbMax = bounds.max;
+
+        _cost += _GetNodeCost(node);
+        _isDirty[i] = 0;
+    }
+
+    _hasDirty = false;
+}
+
+bool BVH::NeedsRebuild() const
+{
+    return !_nodes.empty() && _GetCost() > REBUILD_RATIO * _builtCost;
+}
+
+size_t BVH::SetPotentiallyVisible(std::span<const uint8_t> isVisible)
+{
+    _isItemVisible.assign(isVisible.begin(), isVisible.end());
+
+    return _UpdateVisibleItems();
+}
+
+FrustumTestCount BVH::Cull(const FrustumVolume& frustum, std::vector<uint32_t>& items) const
+{
+    items.clear();
+
+    if (_nodes.empty())
+    {
+        return {};
+    }
+
+    return Cull(FrustumCuller(frustum), 0, items);
+}
+
+void BVH::Split(uint32_t count, std::vector<uint32_t>& subtrees) const
+{
+    subtrees.clear();
+
+    if (_nodes.empty())
+    {
+        return;
+    }
+
+    // A level at a time, the leaves are carried over as they are
+    subtrees.push_back(0);
+    std::vector<uint32_t> nextSubtrees;
+    while (subtrees.size() < count)
+    {
+        nextSubtrees.clear();
+        for (uint32_t subtree : subtrees)
+        {
+            const Node& node = _nodes[subtree];
+            if (node.count == 0)
+            {
+                nextSubtrees.push_back(node.offset);
+                nextSubtrees.push_back(node.offset + 1);
+            }
+            else
+            {
+                nextSubtrees.push_back(subtree);
+            }
+        }
+
+        if (nextSubtrees.size() == subtrees.size())
+        {
+            break;
+        }
+        subtrees.swap(nextSubtrees);
+    }
+}
+
+FrustumTestCount BVH::Cull(const FrustumCuller& culler, uint32_t subtree, std::vector<uint32_t>& items, std::vector<uint32_t>* smallItems) const
+{
+    FrustumTestCount testCount;
+
+    // Both children are pushed, so the stack never holds more than a node per level plus one.
+    // The children inherit the planes their parent straddles, none once it is inside
+    CullEntry stack[MAX_DEPTH + 1];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = { subtree, FrustumVolume::ALL_PLANES };
+
+    while (stackSize > 0)
+    {
+        CullEntry entry = stack[--stackSize];
+        const Node& node = _nodes[entry.node];
+
+        const uint32_t visibleItems = _visibleItems[entry.node];
+        if (visibleItems == 0)
+        {
+            continue;
+        }
+
+        if (entry.planeMask != 0)
+        {
+            const XMFLOAT3 center(0.5f * (node.aabbMin.x + node.aabbMax.x), 0.5f * (node.aabbMin.y + node.aabbMax.y), 0.5f * (node.aabbMin.z + node.aabbMax.z));
+            const XMFLOAT3 extent(0.5f * (node.aabbMax.x - node.aabbMin.x), 0.5f * (node.aabbMax.y - node.aabbMin.y), 0.5f * (node.aabbMax.z - node.aabbMin.z));
+
+            ++testCount.boundsCount;
+            if (culler.Classify(center, extent, entry.planeMask, _lastPlanes[entry.node], testCount.planeCount) == FrustumIntersection::Outside)
+            {
+                continue;
+            }
+        }
+
+        if (node.count == 0)
+        {
+            stack[stackSize++] = { node.offset + 1, entry.planeMask };
+            stack[stackSize++] = { node.offset, entry.planeMask };
+        }
+        else if (!culler.IsScreenSizeCulled() && (entry.planeMask == 0 || node.count == 1))
+        {
+            // The leaf bounds of a single item are the item bounds
+            for (uint32_t bits = visibleItems; bits != 0; bits &= bits - 1)
+            {
+                items.push_back(_items[node.offset + std::countr_zero(bits)]);
+            }
+        }
+        else
+        {
+            // The screen size is tested on every item, the planes only if the leaf straddles them
+            const uint32_t planeMask = node.count > 1 ? entry.planeMask : 0;
+
+            uint64_t visibleMask;
+            uint64_t smallMask;
+            culler.Cull(_itemBoxes, node.offset, node.count, planeMask, &visibleMask, nullptr, &smallMask);
+            visibleMask &= visibleItems;
+            smallMask &= visibleItems;
+            if (planeMask != 0)
+            {
+                testCount.boundsCount += node.count;
+                testCount.planeCount += node.count * std::popcount(planeMask);
+            }
+
+            for (; visibleMask != 0; visibleMask &= visibleMask - 1)
+            {
+                items.push_back(_items[node.offset + std::countr_zero(visibleMask)]);
+            }
+            for (; smallItems && smallMask != 0; smallMask &= smallMask - 1)
+            {
+                smallItems->push_back(_items[node.offset + std::countr_zero(smallMask)]);
+            }
+        }
+    }
+
+    return testCount;
+}
+
+FrustumTestCount BVH::Cull(const MultiFrustumCuller& culler, uint32_t subtree, std::vector<uint32_t>& items, std::vector<uint32_t>& viewMasks) const
+{
+    FrustumTestCount testCount;
+
+    MultiCullEntry stack[MAX_DEPTH + 1];
+    uint32_t stackSize = 0;
+    stack[stackSize] = { subtree, culler.GetAllViews() };
+    std::fill(std::begin(stack[stackSize].planeMasks), std::end(stack[stackSize].planeMasks), static_cast<uint8_t>(FrustumVolume::ALL_PLANES));
+    ++stackSize;
+
+    while (stackSize > 0)
+    {
+        MultiCullEntry entry = stack[--stackSize];
+        const Node& node = _nodes[entry.node];
+
+        // The other views see all of the node
+        uint32_t straddledViews = GetStraddledViews(entry);
+        if (straddledViews != 0)
+        {
+            const XMFLOAT3 center(0.5f * (node.aabbMin.x + node.aabbMax.x), 0.5f * (node.aabbMin.y + node.aabbMax.y), 0.5f * (node.aabbMin.z + node.aabbMax.z));
+            const XMFLOAT3 extent(0.5f * (node.aabbMax.x - node.aabbMin.x), 0.5f * (node.aabbMax.y - node.aabbMin.y), 0.5f * (node.aabbMax.z - node.aabbMin.z));
+
+            ++testCount.boundsCount;
+            entry.viewMask = (entry.viewMask & ~straddledViews) | culler.Classify(center, extent, straddledViews, entry.planeMasks, testCount.planeCount);
+            if (entry.viewMask == 0)
+            {
+                continue;
+            }
+
+            straddledViews = GetStraddledViews(entry);
+        }
+
+        if (node.count == 0)
+        {
+            stack[stackSize] = entry;
+            stack[stackSize++].node = node.offset + 1;
+            stack[stackSize] = entry;
+            stack[stackSize++].node = node.offset;
+        }
+        else if (straddledViews == 0 || node.count == 1)
+        {
+            // The leaf bounds of a single item are the item bounds
+            items.insert(items.end(), _items.begin() + node.offset, _items.begin() + node.offset + node.count);
+            viewMasks.insert(viewMasks.end(), node.count, entry.viewMask);
+        }
+        else
+        {
+            // Every item loaded once for all the straddled views, the others see all the items
+            const uint32_t insideViews = entry.viewMask & ~straddledViews;
+
+            uint32_t leafMasks[MAX_LEAF_SIZE];
+            culler.Cull(_itemBoxes, node.offset, node.count, straddledViews, entry.planeMasks, leafMasks);
+            testCount.boundsCount += node.count;
+            for (uint32_t views = straddledViews; views != 0; views &= views - 1)
+            {
+                testCount.planeCount += node.count * std::popcount(static_cast<uint32_t>(entry.planeMasks[std::countr_zero(views)]));
+            }
+
+            for (uint32_t i = 0; i < node.count; ++i)
+            {
+                if ((leafMasks[i] | insideViews) != 0)
+                {
+                    items.push_back(_items[node.offset + i]);
+                    viewMasks.push_back(leafMasks[i] | insideViews);
+                }
+            }
+        }
+    }
+
+    return testCount;
+}
+
+size_t BVH::GetNodeCount() const
+{
+    return _nodes.size();
+}
+
+size_t BVH::GetItemCount() const
+{
+    return _items.size();
+}
+
+double BVH::_GetCost() const
+{
+    Bounds root = EMPTY_BOUNDS;
+    Grow(root, _nodes[0].aabbMin, _nodes[0].aabbMax);
+
+    const float area = GetArea(root);
+    return area > 0.0f ? _cost / area : 0.0;
+}
+
+size_t BVH::_UpdateVisibleItems()
+{
+    _visibleItems.assign(_nodes.size(), 0);
+
+    size_t hiddenCount = 0;
+
+    // The children follow their parent
+    for (size_t i = _nodes.size(); i-- > 0;)
+    {
+        const Node& node = _nodes[i];
+        if (node.count == 0)
+        {
+            _visibleItems[i] = _visibleItems[node.offset] != 0 || _visibleItems[node.offset + 1] != 0;
+            continue;
+        }
+
+        for (uint32_t j = 0; j < node.count; ++j)
+        {
+            const uint32_t item = _items[node.offset + j];
+            if (_isItemVisible.empty() || (item < _isItemVisible.size() && _isItemVisible[item]))
+            {
+                _visibleItems[i] |= 1 << j;
+            }
+            else
+            {
+                ++hiddenCount;
+            }
+        }
+    }
+
+    return hiddenCount;
+}
+
+double BVH::_GetNodeCost(const Node& node) const
+{
+    Bounds bounds = EMPTY_BOUNDS;
+    Grow(bounds, node.aabbMin, node.aabbMax);
+
+    return GetArea(bounds) * (node.count > 0 ? ITEM_COST * node.count : TRAVERSAL_COST);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Scene/Volumes/FrustumCuller.h"
+
+// Bounding volume hierarchy over the world space AABBs of the scene nodes. Built top down with
+// the binned surface area heuristic into a flat array in which the children of a node are a
+// pair placed after it, so the culling rejects whole subtrees and the refit is a single
+// backwards sweep. The items are addressed by the indices the caller built the tree with
+class BVH
+{
+public:
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+    struct Bounds
+    {
+        DirectX::XMFLOAT3 min;
+        DirectX::XMFLOAT3 max;
+    };
+
+    struct Item
+    {
+        Bounds bounds;
+        uint32_t index;
+        float minSize = 0.0f;           // Screen size of the item, see CullBoxes
+    };
+
+    BVH();
+    ~BVH();
+
+    BVH(const BVH& copy) = delete;
+    BVH& operator=(const BVH& copy) = delete;
+
+    void Build(std::vector<Item> items);
+
+    // Moves an item, the tree bounds follow on the next Refit
+    void SetBounds(uint32_t item, const Bounds& bounds);
+    // The items not in the tree are skipped, their nodes are culled elsewhere
+    void SetMinSize(uint32_t item, float minSize);
+    void Refit();
+    // The refits loosened the tree enough for a rebuild to pay off
+    bool NeedsRebuild() const;
+    // The single view culling skips the items not set in isVisible, by item index, and the subtrees
+    // without any visible item before testing them. Empty makes all of them visible. Kept through the
+    // builds. The number of items skipped
+    size_t SetPotentiallyVisible(std::span<const uint8_t> isVisible);
+
+    // Items whose bounds intersect the frustum
+    FrustumTestCount Cull(const FrustumVolume& frustum, std::vector<uint32_t>& items) const;
+
+    // Disjoint subtrees covering the tree, at least count of them unless the tree has fewer
+    // leaves, so the culling can be split across threads
+    void Split(uint32_t count, std::vector<uint32_t>& subtrees) const;
+    // Appends the potentially visible items of the subtree whose bounds intersect the frustum. The plane
+    // that rejected a node is tried first on it the next time, the threads culling disjoint subtrees write
+    // apart. With the screen size of the culler set, the items too small go to smallItems instead
+    FrustumTestCount Cull(const FrustumCuller& culler, uint32_t subtree, std::vector<uint32_t>& items, std::vector<uint32_t>* smallItems = nullptr) const;
+    // The same for several views in one traversal, with the mask of the views every item is in. The
+    // nodes are tested once per view they straddle, the leaves are loaded once for all the views.
+    // The potentially visible items are of a single view, all the items are culled here
+    FrustumTestCount Cull(const MultiFrustumCuller& culler, uint32_t subtree, std::vector<uint32_t>& items, std::vector<uint32_t>& viewMasks) const;
+
+    size_t GetNodeCount() const;
+    size_t GetItemCount() const;
+
+private:
+    struct Node
+    {
+        DirectX::XMFLOAT3 aabbMin;
+        uint32_t offset;                // First child for inner nodes, first entry of _items for leaves
+        DirectX::XMFLOAT3 aabbMax;
+        uint32_t count;                 // Items of the leaf, 0 for inner nodes
+    };
+
+    // SAH cost of the tree relative to the root area
+    double _GetCost() const;
+    double _GetNodeCost(const Node& node) const;
+    // The number of items skipped
+    size_t _UpdateVisibleItems();
+
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _parents;
+    // Bytes rather than bits, as in TransformStore
+    std::vector<uint8_t> _isDirty;
+    bool _hasDirty;
+    // Plane that last rejected every node, a hint the culling updates
+    mutable std::vector<uint8_t> _lastPlanes;
+
+    // Leaf order, the leaves reference ranges of it
+    std::vector<uint32_t> _items;
+    // The item bounds in leaf order, for the batch culling of the leaves
+    CullBoxes _itemBoxes;
+    // By item index
+    std::vector<Bounds> _itemBounds;
+    std::vector<uint32_t> _itemLeaves;
+    // By item index, empty if all the items are potentially visible
+    std::vector<uint8_t> _isItemVisible;
+    // By node, a bit per item of the leaves potentially visible, and for the inner nodes 1 if any item below is
+    std::vector<uint8_t> _visibleItems;
+
+    // Sum of the SAH node costs, kept up to date by the refits
+    double _cost;
+    double _builtCost;
+};
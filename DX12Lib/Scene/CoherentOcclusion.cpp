@@ -0,0 +1,162 @@
+#include "stdafx.h"
+
+#include "CoherentOcclusion.h"
+
+CoherentOcclusion::CoherentOcclusion()
+    : _frame(1)
+    , _frameIndex(0)
+{
+}
+
+CoherentOcclusion::~CoherentOcclusion()
+{
+}
+
+void CoherentOcclusion::Create(uint32_t slotCount, uint32_t frameCount)
+{
+    _nodes.assign(slotCount, {});
+    _issued.assign(std::max(frameCount, 1u), {});
+    _frame = 1;
+    _frameIndex = 0;
+}
+
+OcclusionReadback CoherentOcclusion::BeginFrame(uint32_t frameIndex, std::span<const UINT64> results)
+{
+    OcclusionReadback readback;
+    if (_issued.empty())
+    {
+        return readback;
+    }
+
+    ++_frame;
+    _frameIndex = frameIndex % _issued.size();
+
+    IssuedQueries& issued = _issued[_frameIndex];
+    for (const OcclusionBatch& query : issued.queries)
+    {
+        const uint32_t querySlot = issued.slots[query.first];
+        const bool isVisible = querySlot < results.size() && results[querySlot] != 0;
+
+        for (uint32_t i = query.first; i < query.first + query.count; ++i)
+        {
+            NodeState& state = _nodes[issued.slots[i]];
+            state.isPending = 0;
+
+            if (query.count == 1)
+            {
+                state.isVisible = isVisible;
+                state.isAlone = 0;
+            }
+            else
+            {
+                // Some of the batch are visible, which ones is known after their own queries
+                state.isAlone = isVisible;
+            }
+        }
+
+        ++readback.queryCount;
+        readback.latencyFrames += _frame - issued.frame;
+    }
+
+    issued.slots.clear();
+    issued.queries.clear();
+
+    return readback;
+}
+
+void CoherentOcclusion::Update(std::span<const OcclusionCandidate> candidates, std::vector<uint8_t>& isDrawn,
+    std::vector<uint32_t>& queryCandidates, std::vector<OcclusionBatch>& queries)
+{
+    isDrawn.assign(candidates.size(), 1);
+    queryCandidates.clear();
+    queries.clear();
+
+    if (_issued.empty())
+    {
+        return;
+    }
+
+    _issued[_frameIndex].frame = _frame;
+    _invisible.clear();
+
+    for (uint32_t i = 0; i < candidates.size(); ++i)
+    {
+        // Without a query slot the node is always drawn
+        if (candidates[i].slot >= _nodes.size())
+        {
+            continue;
+        }
+
+        NodeState& state = _nodes[candidates[i].slot];
+
+        // Outside of the frustum the last frame, the old result may be stale
+        const bool isEntering = state.lastFrustumFrame + 1 < _frame;
+        if (isEntering)
+        {
+            state.isVisible = 1;
+            state.isAlone = 0;
+        }
+        state.lastFrustumFrame = _frame;
+
+        isDrawn[i] = state.isVisible;
+        if (state.isPending)
+        {
+            continue;
+        }
+
+        if (state.isVisible)
+        {
+            // The offset by slot spreads the queries of the nodes that became visible together
+            if (isEntering || _frame - state.lastQueryFrame >= VISIBLE_QUERY_INTERVAL + (candidates[i].slot & 3))
+            {
+                _Issue(candidates, std::span<const uint32_t>(&i, 1), queryCandidates, queries);
+            }
+        }
+        else if (state.isAlone)
+        {
+            _Issue(candidates, std::span<const uint32_t>(&i, 1), queryCandidates, queries);
+        }
+        else
+        {
+            _invisible.push_back(i);
+        }
+    }
+
+    // The invisible nodes of a group, in front to back order, up to a batch per query
+    std::stable_sort(_invisible.begin(), _invisible.end(), [&candidates](uint32_t a, uint32_t b)
+    {
+        return candidates[a].group < candidates[b].group;
+    });
+
+    for (size_t first = 0; first < _invisible.size();)
+    {
+        size_t last = first + 1;
+        while (last < _invisible.size() && last - first < MAX_BATCH_SIZE && candidates[_invisible[last]].group == candidates[_invisible[first]].group)
+        {
+            ++last;
+        }
+
+        _Issue(candidates, std::span<const uint32_t>(&_invisible[first], last - first), queryCandidates, queries);
+        first = last;
+    }
+}
+
+void CoherentOcclusion::_Issue(std::span<const OcclusionCandidate> candidates, std::span<const uint32_t> batch,
+    std::vector<uint32_t>& queryCandidates, std::vector<OcclusionBatch>& queries)
+{
+    IssuedQueries& issued = _issued[_frameIndex];
+
+    queries.push_back({ static_cast<uint32_t>(queryCandidates.size()), static_cast<uint32_t>(batch.size()) });
+    issued.queries.push_back({ static_cast<uint32_t>(issued.slots.size()), static_cast<uint32_t>(batch.size()) });
+
+    for (uint32_t candidate : batch)
+    {
+        const uint32_t slot = candidates[candidate].slot;
+        queryCandidates.push_back(candidate);
+        issued.slots.push_back(slot);
+
+        NodeState& state = _nodes[slot];
+        state.isPending = 1;
+        state.lastQueryFrame = _frame;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// A node inside the frustum, for the coherent occlusion
+struct OcclusionCandidate
+{
+    uint32_t slot;                      // Occlusion query slot of the node
+    uint32_t group;                     // The parent, the invisible nodes of a group share their queries
+};
+
+// A query over consecutive entries of a node list, the boxes of the nodes are drawn inside it
+struct OcclusionBatch
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+// The queries whose results came back
+struct OcclusionReadback
+{
+    size_t queryCount = 0;
+    uint64_t latencyFrames = 0;         // Sum over the queries of the frames from the issue to the readback
+};
+
+// Occlusion culling coherent over the frames, after CHC++. The query results are read back a few
+// frames late and the nodes keep the visibility of their last result meanwhile. The visible nodes are
+// drawn and queried again every few frames. The invisible ones are not drawn at all and queried again as
+// soon as their last result came back, several nodes of the same parent in one query; if such a query
+// finds some of them visible, they are queried alone next. A node entering the frustum is drawn and
+// queried at once.
+// No D3D12 objects, the queries are issued by the caller
+class CoherentOcclusion
+{
+public:
+    static constexpr uint32_t VISIBLE_QUERY_INTERVAL = 8;
+    static constexpr uint32_t MAX_BATCH_SIZE = 8;
+
+    CoherentOcclusion();
+    ~CoherentOcclusion();
+
+    // Every node visible, frameCount frame indices in flight
+    void Create(uint32_t slotCount, uint32_t frameCount);
+
+    // The results by slot of the queries issued the last time the frame index was used, once the
+    // frame completed. Once per frame before Update
+    OcclusionReadback BeginFrame(uint32_t frameIndex, std::span<const UINT64> results);
+    // Whether every candidate is drawn, and the queries of the frame over the candidate indices
+    void Update(std::span<const OcclusionCandidate> candidates, std::vector<uint8_t>& isDrawn,
+        std::vector<uint32_t>& queryCandidates, std::vector<OcclusionBatch>& queries);
+
+private:
+    struct NodeState
+    {
+        uint32_t lastFrustumFrame = 0;
+        uint32_t lastQueryFrame = 0;
+        uint8_t isVisible = 1;
+        uint8_t isPending = 0;          // A query of the node is in flight
+        uint8_t isAlone = 0;            // Queried without its group next
+    };
+
+    // The queries issued with a frame index, over the slots of their nodes
+    struct IssuedQueries
+    {
+        uint32_t frame = 0;
+        std::vector<uint32_t> slots;
+        std::vector<OcclusionBatch> queries;
+    };
+
+    void _Issue(std::span<const OcclusionCandidate> candidates, std::span<const uint32_t> batch,
+        std::vector<uint32_t>& queryCandidates, std::vector<OcclusionBatch>& queries);
+
+    std::vector<NodeState> _nodes;
+    std::vector<IssuedQueries> _issued;
+
+    // Counts from 1, a node never inside the frustum has frame 0
+    uint32_t _frame;
+    uint32_t _frameIndex;
+
+    // Kept across the frames for their allocations
+    std::vector<uint32_t> _invisible;
+};
@@ -0,0 +1,163 @@
+#include "stdafx.h"
+
+#include "CompiledScene.h"
+
+#include <cmath>
+
+bool CompiledScene::Parse(std::span<const uint8_t> data, const std::string& filepath)
+{
+    if (ASSERT(data.size() >= sizeof(SceneFormat::Header), "Not a compiled scene: " + filepath))
+    {
+        return false;
+    }
+
+    const SceneFormat::Header* header = reinterpret_cast<const SceneFormat::Header*>(data.data());
+    if (ASSERT(header->magic == SceneFormat::MAGIC, "Not a compiled scene: " + filepath)
+        || ASSERT(header->version == SceneFormat::VERSION, "Unsupported compiled scene version " + std::to_string(header->version) + " in " + filepath + ", recompile it"))
+    {
+        return false;
+    }
+
+    const uint64_t cellCount = static_cast<uint64_t>(header->cellCounts[0]) * header->cellCounts[1] * header->cellCounts[2];
+    if (ASSERT(cellCount <= UINT32_MAX, "Corrupted visibility grid in " + filepath))
+    {
+        return false;
+    }
+
+    std::span<const char> strings;
+    bool isValid = _GetBlock(data, header->nodesOffset, header->nodeCount, _nodes)
+        && _GetBlock(data, header->lodsOffset, header->lodCount, _lods)
+        && _GetBlock(data, header->meshesOffset, header->meshCount, _meshes)
+        && _GetBlock(data, header->materialsOffset, header->materialCount, _materials)
+        && _GetBlock(data, header->stringsOffset, header->stringsSize, strings)
+        && _GetBlock(data, header->cellsOffset, static_cast<uint32_t>(cellCount), _cells)
+        && _GetBlock(data, header->pvsOffset, header->pvsSize, _visibilitySets);
+    if (ASSERT(isValid, "Compiled scene block is out of bounds in " + filepath)
+        || ASSERT(!strings.empty() && strings.back() == '\0', "Corrupted strings in " + filepath))
+    {
+        return false;
+    }
+    _strings = strings;
+
+    auto isValidString = [this](uint32_t offset) { return offset < _strings.size(); };
+
+    for (uint32_t i = 0; i < _nodes.size(); ++i)
+    {
+        const SceneFormat::Node& node = _nodes[i];
+        bool isValidNode = (node.parent == SceneFormat::INVALID_INDEX || node.parent < i)
+            && static_cast<uint64_t>(node.firstLOD) + node.lodCount <= _lods.size()
+            && (node.material == SceneFormat::INVALID_INDEX || node.material < _materials.size())
+            && isValidString(node.nameOffset);
+        if (ASSERT(isValidNode, "Corrupted node " + std::to_string(i) + " in " + filepath))
+        {
+            return false;
+        }
+    }
+
+    for (const SceneFormat::LOD& lod : _lods)
+    {
+        if (ASSERT(lod.mesh < _meshes.size(), "LOD references a missing mesh in " + filepath))
+        {
+            return false;
+        }
+    }
+
+    for (const SceneFormat::MeshReference& mesh : _meshes)
+    {
+        if (ASSERT(isValidString(mesh.nameOffset), "Corrupted mesh reference in " + filepath))
+        {
+            return false;
+        }
+    }
+
+    for (const SceneFormat::Material& material : _materials)
+    {
+        if (ASSERT(isValidString(material.diffuseOffset), "Corrupted material in " + filepath))
+        {
+            return false;
+        }
+    }
+
+    // The sets are decoded with bounds checks when the camera enters their cells
+    for (const SceneFormat::VisibilityCell& cell : _cells)
+    {
+        if (ASSERT(cell.pvsOffset <= _visibilitySets.size(), "Corrupted visibility cell in " + filepath))
+        {
+            return false;
+        }
+    }
+
+    for (int axis = 0; axis < 3 && !_cells.empty(); ++axis)
+    {
+        if (ASSERT(header->cellSize[axis] > 0.0f && std::isfinite(header->cellOrigin[axis]), "Corrupted visibility grid in " + filepath))
+        {
+            return false;
+        }
+    }
+
+    if (ASSERT(isValidString(header->nameOffset), "Corrupted scene name in " + filepath))
+    {
+        return false;
+    }
+    _nameOffset = header->nameOffset;
+    _header = *header;
+
+    return true;
+}
+
+std::string CompiledScene::GetName() const
+{
+    return GetString(_nameOffset);
+}
+
+std::span<const SceneFormat::Node> CompiledScene::GetNodes() const
+{
+    return _nodes;
+}
+
+std::span<const SceneFormat::LOD> CompiledScene::GetLODs(const SceneFormat::Node& node) const
+{
+    return _lods.subspan(node.firstLOD, node.lodCount);
+}
+
+const SceneFormat::MeshReference& CompiledScene::GetMesh(uint32_t index) const
+{
+    return _meshes[index];
+}
+
+const SceneFormat::Material& CompiledScene::GetMaterial(uint32_t index) const
+{
+    return _materials[index];
+}
+
+const char* CompiledScene::GetString(uint32_t offset) const
+{
+    return _strings.data() + offset;
+}
+
+const SceneFormat::Header& CompiledScene::GetHeader() const
+{
+    return _header;
+}
+
+std::span<const SceneFormat::VisibilityCell> CompiledScene::GetVisibilityCells() const
+{
+    return _cells;
+}
+
+std::span<const uint8_t> CompiledScene::GetVisibilitySets() const
+{
+    return _visibilitySets;
+}
+
+template<typename T>
+bool CompiledScene::_GetBlock(std::span<const uint8_t> data, uint64_t offset, uint32_t count, std::span<const T>& outBlock) const
+{
+    if (offset > data.size() || count > (data.size() - offset) / sizeof(T) || offset % alignof(T) != 0)
+    {
+        return false;
+    }
+
+    outBlock = std::span<const T>(reinterpret_cast<const T*>(data.data() + offset), count);
+    return true;
+}
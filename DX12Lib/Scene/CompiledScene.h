@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Scene/SceneFormat.h"
+
+// Validated view of a compiled scene hierarchy (see SceneFormat.h), either a mapped
+// .scenebin file or a scene package entry. The data must outlive the view
+class CompiledScene
+{
+public:
+    CompiledScene() = default;
+    ~CompiledScene() = default;
+
+    // Checks the blocks, indices and string offsets once, so the getters don't have to
+    bool Parse(std::span<const uint8_t> data, const std::string& filepath);
+
+    std::string GetName() const;
+
+    // Depth first order, the parent of a node always precedes it
+    std::span<const SceneFormat::Node> GetNodes() const;
+    std::span<const SceneFormat::LOD> GetLODs(const SceneFormat::Node& node) const;
+    const SceneFormat::MeshReference& GetMesh(uint32_t index) const;
+    const SceneFormat::Material& GetMaterial(uint32_t index) const;
+    const char* GetString(uint32_t offset) const;
+
+    // The baked potentially visible sets, x fastest, no cells if the scene has none. The grid is in the header
+    const SceneFormat::Header& GetHeader() const;
+    std::span<const SceneFormat::VisibilityCell> GetVisibilityCells() const;
+    std::span<const uint8_t> GetVisibilitySets() const;
+
+private:
+    template<typename T>
+    bool _GetBlock(std::span<const uint8_t> data, uint64_t offset, uint32_t count, std::span<const T>& outBlock) const;
+
+    std::span<const SceneFormat::Node> _nodes;
+    std::span<const SceneFormat::LOD> _lods;
+    std::span<const SceneFormat::MeshReference> _meshes;
+    std::span<const SceneFormat::Material> _materials;
+    std::span<const char> _strings;
+    std::span<const SceneFormat::VisibilityCell> _cells;
+    std::span<const uint8_t> _visibilitySets;
+    SceneFormat::Header _header = {};
+    uint32_t _nameOffset = 0;
+};
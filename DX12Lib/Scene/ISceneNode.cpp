@@ -2,21 +2,21 @@
 
 #include "ISceneNode.h"
 
+#include "Scene/Scene.h"
+
 using namespace DirectX;
 
 ISceneNode::ISceneNode()
     : _scene(nullptr)
     , _parent(nullptr)
-    , _childNodes{}
-    , _transform{}
+    , _handle{}
 {
 }
 
 ISceneNode::ISceneNode(Scene* scene, ISceneNode* parent)
     : _scene(scene)
     , _parent(parent)
-    , _childNodes{}
-    , _transform(XMMatrixIdentity())
+    , _handle{}
 {
 }
 
@@ -28,21 +28,26 @@ ISceneNode::~ISceneNode()
 
 XMMATRIX ISceneNode::GetLocalTransform() const
 {
-    return _transform;
+    return _scene->_transforms.GetLocalTransform(_scene->_GetNodeData(_handle).transformIndex);
 }
 
 void ISceneNode::SetLocalTransform(const XMMATRIX& transform)
 {
-    _transform = transform;
+    _scene->_transforms.SetLocalTransform(_scene->_GetNodeData(_handle).transformIndex, transform);
 }
 
 XMMATRIX ISceneNode::GetGlobalTransform() const
 {
-    XMMATRIX globalTransform = _transform;
-    if (_parent)
-    {
-        globalTransform *= _parent->GetGlobalTransform();
-    }
+    return _scene->_transforms.GetGlobalTransform(_scene->_GetNodeData(_handle).transformIndex);
+}
+
+PoolHandle ISceneNode::GetHandle() const
+{
+    return _handle;
+}
 
-    return globalTransform;
+void ISceneNode::_CreateTransform(const XMMATRIX& transform)
+{
+    uint32_t parent = _parent ? _scene->_GetNodeData(_parent->_handle).transformIndex : TransformStore::INVALID_INDEX;
+    _scene->_GetNodeData(_handle).transformIndex = _scene->_transforms.Add(parent, transform);
 }
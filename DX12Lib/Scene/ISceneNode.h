@@ -1,11 +1,18 @@
 #pragma once
 
+#include "Utility/Pool.h"
 #include "Volumes/AABBVolume.h"
 #include "Volumes/FrustumVolume.h"
 
-class Camera;
 class Scene;
 class FrustumVolume;
+class CompiledScene;
+struct AssetReference;
+
+namespace SceneFormat
+{
+    struct Node;
+} // namespace SceneFormat
 
 namespace Core
 {
@@ -19,31 +26,39 @@ public:
     ISceneNode(Scene* scene, ISceneNode* parent = nullptr);
     virtual ~ISceneNode();
 
+    // The transforms live in the transform store of the scene
     DirectX::XMMATRIX GetLocalTransform() const;
+    // The global transforms of the subtree are recomputed by Scene::UpdateTransforms
     void SetLocalTransform(const DirectX::XMMATRIX& transform);
-
+    // Valid since the last Scene::UpdateTransforms
     DirectX::XMMATRIX GetGlobalTransform() const;
 
-    virtual void RunOcclusion(Core::GraphicsCommandList& commandList, const FrustumVolume& frustum) const = 0;
-    virtual void Draw(Core::GraphicsCommandList& commandList, const Camera& camera) const = 0;
-    virtual void DrawOccluders(Core::GraphicsCommandList& commandList, const Camera& camera) const = 0;
-    virtual void DrawOccludees(Core::GraphicsCommandList& commandList, const Camera& camera) const = 0;
+    // The node alone with the LOD Scene::CullView selected for it
+    virtual void Draw(Core::GraphicsCommandList& commandList, uint32_t lod) const = 0;
     virtual void DrawAABB(Core::GraphicsCommandList& commandList) const = 0;
-    virtual void TestAABB(Core::GraphicsCommandList& commandList) const = 0;
 
-    virtual const AABBVolume& GetAABB() const = 0;
+    virtual AABBVolume GetAABB() const = 0;
     virtual bool IsOccluder() const = 0;
 
-    virtual void LoadNode(const std::string& filepath, Core::GraphicsCommandList& commandList) = 0;
+    PoolHandle GetHandle() const;
+
+    // Reads the JSON node file or package entry, then the children it references. The GPU data
+    // is requested from the scene loader and streamed in later
+    virtual void LoadNode(const AssetReference& reference) = 0;
+    // Only this node, the scene builds the hierarchy of a compiled scene
+    virtual void LoadNode(const CompiledScene& compiledScene, const SceneFormat::Node& desc) = 0;
 
 protected:
     friend Scene;
 
+    // Adds the node to the transform store, after its parent
+    void _CreateTransform(const DirectX::XMMATRIX& transform);
+
+    // Names and the rest of the node objects are the cold data, the passes read
+    // the node data array of the scene
     std::string _name;
 
     Scene* _scene;
     ISceneNode* _parent;
-    std::vector<std::shared_ptr<ISceneNode>> _childNodes;
-
-    DirectX::XMMATRIX _transform;
+    PoolHandle _handle;
 };
@@ -0,0 +1,322 @@
+#include "stdafx.h"
+
+#include "LooseOctree.h"
+
+#include "Scene/Volumes/AABBVolume.h"
+#include "Scene/Volumes/FrustumVolume.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    struct CellKey
+    {
+        uint32_t level;
+        uint32_t x;
+        uint32_t y;
+        uint32_t z;
+        uint32_t planeMask;             // The planes the parent straddles
+    };
+
+    bool Overlaps(const LooseOctree::Bounds& a, const LooseOctree::Bounds& b)
+    {
+        return a.min.x <= b.max.x && a.max.x >= b.min.x
+            && a.min.y <= b.max.y && a.max.y >= b.min.y
+            && a.min.z <= b.max.z && a.max.z >= b.min.z;
+    }
+}
+
+LooseOctree::LooseOctree()
+    : _origin(0.0f, 0.0f, 0.0f)
+    , _size(0.0f)
+    , _depth(0)
+    , _looseness(2.0f)
+    , _count(0)
+{
+}
+
+LooseOctree::~LooseOctree()
+{
+}
+
+void LooseOctree::Create(const Bounds& bounds, uint32_t depth, float looseness)
+{
+    LOG_WARNING(depth <= MAX_DEPTH, "Loose octree depth clamped to " + std::to_string(MAX_DEPTH));
+    LOG_WARNING(looseness >= 1.0f, "Loose octree looseness clamped to 1");
+
+    _depth = std::min(depth, MAX_DEPTH);
+    _looseness = std::max(looseness, 1.0f);
+    _origin = bounds.min;
+    _size = std::max({ bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z, FLT_MIN });
+
+    _levelOffsets.resize(_depth + 1);
+    uint32_t cellCount = 0;
+    for (uint32_t level = 0; level <= _depth; ++level)
+    {
+        _levelOffsets[level] = cellCount;
+        cellCount += 1u << (3 * level);
+    }
+
+    _cells.assign(cellCount, { INVALID_INDEX, 0 });
+    _cellPlanes.assign(cellCount, 0);
+    _objects.clear();
+    _objectPlanes.clear();
+    _count = 0;
+}
+
+void LooseOctree::Insert(uint32_t item, const Bounds& bounds)
+{
+    if (item >= _objects.size())
+    {
+        _objects.resize(item + 1, { {}, INVALID_INDEX, INVALID_INDEX, INVALID_INDEX });
+        _objectPlanes.resize(item + 1, 0);
+    }
+
+    if (ASSERT(_objects[item].cell == INVALID_INDEX, "The item is already in the octree"))
+    {
+        return;
+    }
+
+    _objects[item].bounds = bounds;
+    _Link(item, _FindCell(bounds));
+    ++_count;
+}
+
+void LooseOctree::Remove(uint32_t item)
+{
+    if (!Contains(item))
+    {
+        return;
+    }
+
+    _Unlink(item);
+    --_count;
+}
+
+void LooseOctree::Move(uint32_t item, const Bounds& bounds)
+{
+    if (ASSERT(Contains(item), "The item is not in the octree"))
+    {
+        return;
+    }
+
+    _objects[item].bounds = bounds;
+
+    // Most moves stay in the loose bounds of the same cell
+    uint32_t cell = _FindCell(bounds);
+    if (cell != _objects[item].cell)
+    {
+        _Unlink(item);
+        _Link(item, cell);
+    }
+}
+
+bool LooseOctree::Contains(uint32_t item) const
+{
+    return item < _objects.size() && _objects[item].cell != INVALID_INDEX;
+}
+
+FrustumTestCount LooseOctree::Query(const FrustumVolume& frustum, std::vector<uint32_t>& items) const
+{
+    FrustumTestCount testCount;
+    testCount.boundsCount = _Query([&frustum, &testCount](const Bounds& bounds, uint32_t& planeMask, uint8_t& lastPlane)
+    {
+        return Classify(frustum, AABBVolume(XMLoadFloat3(&bounds.min), XMLoadFloat3(&bounds.max)), planeMask, lastPlane, testCount.planeCount);
+    }, items);
+
+    return testCount;
+}
+
+size_t LooseOctree::Query(const Bounds& box, std::vector<uint32_t>& items) const
+{
+    return _Query([&box](const Bounds& bounds, uint32_t& planeMask, uint8_t& lastPlane)
+    {
+        return Overlaps(box, bounds) ? FrustumIntersection::Intersecting : FrustumIntersection::Outside;
+    }, items);
+}
+
+size_t LooseOctree::GetCount() const
+{
+    return _count;
+}
+
+uint32_t LooseOctree::_FindCell(const Bounds& bounds) const
+{
+    const float halfExtent = 0.5f * std::max({ bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z });
+    const float center[3] =
+    {
+        0.5f * (bounds.min.x + bounds.max.x) - _origin.x,
+        0.5f * (bounds.min.y + bounds.max.y) - _origin.y,
+        0.5f * (bounds.min.z + bounds.max.z) - _origin.z
+    };
+
+    // The deepest level whose cells reach far enough out
+    uint32_t level = _depth;
+    float edge = _size / static_cast<float>(1u << _depth);
+    while (level > 0 && halfExtent > 0.5f * (_looseness - 1.0f) * edge)
+    {
+        --level;
+        edge *= 2.0f;
+    }
+
+    uint32_t coordinates[3];
+    const uint32_t cellsPerAxis = 1u << level;
+    for (uint32_t axis = 0; axis < 3; ++axis)
+    {
+        float coordinate = std::floor(center[axis] / edge);
+        if (coordinate < 0.0f || coordinate >= static_cast<float>(cellsPerAxis))
+        {
+            // Outside of the root cube, the root is not bounded
+            return 0;
+        }
+        coordinates[axis] = static_cast<uint32_t>(coordinate);
+    }
+
+    return _GetCell(level, coordinates[0], coordinates[1], coordinates[2]);
+}
+
+uint32_t LooseOctree::_GetCell(uint32_t level, uint32_t x, uint32_t y, uint32_t z) const
+{
+    return _levelOffsets[level] + (((z << level) + y) << level) + x;
+}
+
+void LooseOctree::_Link(uint32_t item, uint32_t cell)
+{
+    Object& object = _objects[item];
+    object.cell = cell;
+    object.previous = INVALID_INDEX;
+    object.next = _cells[cell].first;
+
+    if (object.next != INVALID_INDEX)
+    {
+        _objects[object.next].previous = item;
+    }
+    _cells[cell].first = item;
+
+    _AddToSubtrees(cell, 1);
+}
+
+void LooseOctree::_Unlink(uint32_t item)
+{
+    Object& object = _objects[item];
+    const uint32_t cell = object.cell;
+
+    if (object.previous != INVALID_INDEX)
+    {
+        _objects[object.previous].next = object.next;
+    }
+    else
+    {
+        _cells[cell].first = object.next;
+    }
+
+    if (object.next != INVALID_INDEX)
+    {
+        _objects[object.next].previous = object.previous;
+    }
+
+    object.cell = INVALID_INDEX;
+
+    _AddToSubtrees(cell, -1);
+}
+
+void LooseOctree::_AddToSubtrees(uint32_t cell, int32_t count)
+{
+    uint32_t level = static_cast<uint32_t>(std::upper_bound(_levelOffsets.begin(), _levelOffsets.end(), cell) - _levelOffsets.begin()) - 1;
+    uint32_t index = cell - _levelOffsets[level];
+
+    uint32_t x = index & ((1u << level) - 1);
+    uint32_t y = (index >> level) & ((1u << level) - 1);
+    uint32_t z = index >> (2 * level);
+
+    // The ancestors count the object too, so the queries skip the empty subtrees
+    for (;;)
+    {
+        _cells[_GetCell(level, x, y, z)].subtreeCount += static_cast<uint32_t>(count);
+        if (level == 0)
+        {
+            break;
+        }
+
+        --level;
+        x >>= 1;
+        y >>= 1;
+        z >>= 1;
+    }
+}
+
+template<typename Test>
+size_t LooseOctree::_Query(const Test& test, std::vector<uint32_t>& items) const
+{
+    if (_cells.empty() || _cells[0].subtreeCount == 0)
+    {
+        return 0;
+    }
+
+    size_t testedCount = 0;
+
+    // Every cell popped pushes at most its 8 children
+    CellKey stack[MAX_DEPTH * 7 + 1];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = { 0, 0, 0, 0, FrustumVolume::ALL_PLANES };
+
+    while (stackSize > 0)
+    {
+        const CellKey key = stack[--stackSize];
+        const uint32_t cellIndex = _GetCell(key.level, key.x, key.y, key.z);
+        const Cell& cell = _cells[cellIndex];
+
+        // The root also holds the objects outside of it, so it is never rejected
+        uint32_t planeMask = key.planeMask;
+        if (key.level > 0 && planeMask != 0)
+        {
+            const float edge = _size / static_cast<float>(1u << key.level);
+            const float margin = 0.5f * (_looseness - 1.0f) * edge;
+
+            Bounds looseBounds;
+            looseBounds.min = XMFLOAT3(_origin.x + key.x * edge - margin, _origin.y + key.y * edge - margin, _origin.z + key.z * edge - margin);
+            looseBounds.max = XMFLOAT3(looseBounds.min.x + edge + 2.0f * margin, looseBounds.min.y + edge + 2.0f * margin, looseBounds.min.z + edge + 2.0f * margin);
+
+            ++testedCount;
+            if (test(looseBounds, planeMask, _cellPlanes[cellIndex]) == FrustumIntersection::Outside)
+            {
+                continue;
+            }
+        }
+
+        for (uint32_t item = cell.first; item != INVALID_INDEX; item = _objects[item].next)
+        {
+            if (planeMask == 0)
+            {
+                items.push_back(item);
+                continue;
+            }
+
+            uint32_t objectPlaneMask = planeMask;
+            ++testedCount;
+            if (test(_objects[item].bounds, objectPlaneMask, _objectPlanes[item]) != FrustumIntersection::Outside)
+            {
+                items.push_back(item);
+            }
+        }
+
+        if (key.level == _depth)
+        {
+            continue;
+        }
+
+        for (uint32_t child = 0; child < 8; ++child)
+        {
+            const CellKey childKey = { key.level + 1, 2 * key.x + (child & 1), 2 * key.y + ((child >> 1) & 1), 2 * key.z + (child >> 2), planeMask };
+            if (_cells[_GetCell(childKey.level, childKey.x, childKey.y, childKey.z)].subtreeCount > 0)
+            {
+                stack[stackSize++] = childKey;
+            }
+        }
+    }
+
+    return testedCount;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Scene/BVH.h"
+
+// Spatial index for the objects moving every frame. The cells of a level are stored densely, so an
+// object goes straight to the cell of its centre on the level its size fits: the cells accept the
+// objects reaching out of them by up to (looseness - 1) / 2 cell edges. The objects of a cell are
+// linked through their item index, so insert, remove and move never search
+class LooseOctree
+{
+public:
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFF;
+    // 37449 cells over the 6 levels
+    static constexpr uint32_t MAX_DEPTH = 5;
+
+    using Bounds = BVH::Bounds;
+
+    LooseOctree();
+    ~LooseOctree();
+
+    LooseOctree(const LooseOctree& copy) = delete;
+    LooseOctree& operator=(const LooseOctree& copy) = delete;
+
+    // Removes every object. The root cell is the cube around the bounds, the objects outside of it
+    // stay in the root
+    void Create(const Bounds& bounds, uint32_t depth, float looseness);
+
+    void Insert(uint32_t item, const Bounds& bounds);
+    void Remove(uint32_t item);
+    void Move(uint32_t item, const Bounds& bounds);
+    bool Contains(uint32_t item) const;
+
+    // Append the items whose bounds intersect the volume. The frustum planes a cell is inside of are
+    // not tested on its objects and descendants, and the plane that last rejected a cell or an
+    // object is tried first
+    FrustumTestCount Query(const FrustumVolume& frustum, std::vector<uint32_t>& items) const;
+    // Returns the number of bounds tested
+    size_t Query(const Bounds& box, std::vector<uint32_t>& items) const;
+
+    size_t GetCount() const;
+
+private:
+    struct Cell
+    {
+        uint32_t first;                 // Item of the first object
+        uint32_t subtreeCount;          // Objects of the cell and all its descendants
+    };
+
+    struct Object
+    {
+        Bounds bounds;
+        uint32_t cell;
+        uint32_t previous;
+        uint32_t next;
+    };
+
+    uint32_t _FindCell(const Bounds& bounds) const;
+    uint32_t _GetCell(uint32_t level, uint32_t x, uint32_t y, uint32_t z) const;
+    void _Link(uint32_t item, uint32_t cell);
+    void _Unlink(uint32_t item);
+    void _AddToSubtrees(uint32_t cell, int32_t count);
+
+    // The test classifies a box against the planes of the mask, the planes are ignored by the box queries
+    template<typename Test>
+    size_t _Query(const Test& test, std::vector<uint32_t>& items) const;
+
+    DirectX::XMFLOAT3 _origin;
+    float _size;
+    uint32_t _depth;
+    float _looseness;
+
+    // Index of the first cell of every level, the cells of a level in x, y, z order
+    std::vector<uint32_t> _levelOffsets;
+    std::vector<Cell> _cells;
+    // By item index
+    std::vector<Object> _objects;
+    size_t _count;
+
+    // Plane that last rejected every cell and object, hints the frustum queries update
+    mutable std::vector<uint8_t> _cellPlanes;
+    mutable std::vector<uint8_t> _objectPlanes;
+};
@@ -2,247 +2,275 @@
 
 #include "Mesh.h"
 
+#include "Utility/HighResolutionClock.h"
+#include "Utility/MappedFile.h"
+
+#include <cstring>
+
 using namespace DirectX;
 
 namespace
 {
-    void readPosition(FbxMesh* fbxMesh, int polygonIndex, int vertexIndex, XMFLOAT3& outPosition)
+    static_assert(sizeof(VertexData) == sizeof(MeshFormat::Vertex), "VertexData doesn't match the cooked mesh layout");
+
+    std::span<const uint8_t> AsBytes(const std::vector<UINT>& indices)
     {
-        FbxVector4 position = fbxMesh->GetControlPointAt(fbxMesh->GetPolygonVertex(polygonIndex, vertexIndex));
-        outPosition = { (float)position.mData[0], (float)position.mData[1], (float)position.mData[2] };
+        return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(indices.data()), indices.size() * sizeof(UINT));
     }
 
-    void readNormal(FbxMesh* fbxMesh, int controlPointIndex, int vertexIndex, XMFLOAT3& outNormal)
+    // Written so that no sum or product of the corrupted header values can wrap
+    bool IsInBounds(uint64_t offset, uint64_t size, size_t fileSize)
     {
-        ASSERT((fbxMesh->GetElementNormalCount() >= 1), "Invalid normals number");
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+}
 
-        FbxGeometryElementNormal* vertexNormal = fbxMesh->GetElementNormal(0);
-        switch (vertexNormal->GetMappingMode())
-        {
-        case FbxGeometryElement::eByControlPoint:
-            switch (vertexNormal->GetReferenceMode())
-            {
-            case FbxGeometryElement::eDirect:
-            {
-                outNormal.x = static_cast<float>(vertexNormal->GetDirectArray().GetAt(controlPointIndex).mData[0]);
-                outNormal.y = static_cast<float>(vertexNormal->GetDirectArray().GetAt(controlPointIndex).mData[1]);
-                outNormal.z = static_cast<float>(vertexNormal->GetDirectArray().GetAt(controlPointIndex).mData[2]);
-            }
-            break;
+void Mesh::SetVertices(const std::vector<VertexData>& vertexData)
+{
+    _rawVertexData = vertexData;
+    _vertices = _rawVertexData;
+    _vertexLayout = MeshFormat::VertexLayout::Float;
 
-            case FbxGeometryElement::eIndexToDirect:
-            {
-                int index = vertexNormal->GetIndexArray().GetAt(controlPointIndex);
-                outNormal.x = static_cast<float>(vertexNormal->GetDirectArray().GetAt(index).mData[0]);
-                outNormal.y = static_cast<float>(vertexNormal->GetDirectArray().GetAt(index).mData[1]);
-                outNormal.z = static_cast<float>(vertexNormal->GetDirectArray().GetAt(index).mData[2]);
-            }
-            break;
+    _BuildPositions();
+}
 
-            default:
-                throw std::exception("Invalid Reference");
-            }
-            break;
+std::span<const VertexData> Mesh::GetVertices() const
+{
+    return _vertices;
+}
 
-        case FbxGeometryElement::eByPolygonVertex:
-            switch (vertexNormal->GetReferenceMode())
-            {
-            case FbxGeometryElement::eDirect:
-            {
-                outNormal.x = static_cast<float>(vertexNormal->GetDirectArray().GetAt(vertexIndex).mData[0]);
-                outNormal.y = static_cast<float>(vertexNormal->GetDirectArray().GetAt(vertexIndex).mData[1]);
-                outNormal.z = static_cast<float>(vertexNormal->GetDirectArray().GetAt(vertexIndex).mData[2]);
-            }
-            break;
+MeshFormat::VertexLayout Mesh::GetVertexLayout() const
+{
+    return _vertexLayout;
+}
 
-            case FbxGeometryElement::eIndexToDirect:
-            {
-                int index = vertexNormal->GetIndexArray().GetAt(vertexIndex);
-                outNormal.x = static_cast<float>(vertexNormal->GetDirectArray().GetAt(index).mData[0]);
-                outNormal.y = static_cast<float>(vertexNormal->GetDirectArray().GetAt(index).mData[1]);
-                outNormal.z = static_cast<float>(vertexNormal->GetDirectArray().GetAt(index).mData[2]);
-            }
-            break;
+size_t Mesh::GetVertexCount() const
+{
+    return _vertexLayout == MeshFormat::VertexLayout::Packed ? _packedVertices.size() : _vertices.size();
+}
 
-            default:
-                throw std::exception("Invalid Reference");
-            }
-            break;
-        }
+std::span<const MeshFormat::PackedVertex> Mesh::GetPackedVertices() const
+{
+    return _packedVertices;
+}
+
+std::span<const uint32_t> Mesh::GetColors() const
+{
+    return _colors;
+}
+
+uint32_t Mesh::GetUniformColor() const
+{
+    return _uniformColor;
+}
+
+std::span<const uint8_t> Mesh::GetPositions() const
+{
+    return _positions;
+}
+
+UINT Mesh::GetPositionStride() const
+{
+    return MeshFormat::GetPositionStride(_vertexLayout);
+}
+
+void Mesh::SetIndices(const std::vector<UINT>& indexData)
+{
+    _rawIndexData = indexData;
+    _indices = AsBytes(_rawIndexData);
+    _indexStride = sizeof(UINT);
+}
+
+const void* Mesh::GetIndexData() const
+{
+    return _indices.data();
+}
+
+size_t Mesh::GetIndexCount() const
+{
+    return _indices.size() / _indexStride;
+}
+
+UINT Mesh::GetIndexStride() const
+{
+    return _indexStride;
+}
+
+DXGI_FORMAT Mesh::GetIndexFormat() const
+{
+    return _indexStride == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
+void Mesh::LoadMesh(const std::string& filepath)
+{
+    HighResolutionClock clock;
+
+    bool isBinary = _LoadBinaryMesh(filepath);
+    if (!isBinary)
+    {
+        _LoadTextMesh(filepath);
     }
 
-    void readColor(fbxsdk::FbxMesh* fbxMesh, int polygonIndex, int controlPointIndex, int vertexIndex, XMFLOAT4& outColor)
+    if (_positions.empty())
     {
-        outColor = { 0.5f, 0.5f, 0.5f, 1.0f };
+        _BuildPositions();
+    }
 
-        FbxSurfaceLambert* mat = nullptr;
-        for (int l = 0; l < fbxMesh->GetElementMaterialCount(); l++)
-        {
-            FbxGeometryElementMaterial* leVtxc = fbxMesh->GetElementMaterial(l);
+    _LogLoad(filepath, isBinary, clock);
+}
 
-            auto mapM = leVtxc->GetMappingMode();
-            switch (leVtxc->GetMappingMode())
-            {
-            default:
-                break;
-            case FbxGeometryElement::eByControlPoint:
-                OutputDebugStringA("eByControlPoint\n");
-                switch (leVtxc->GetReferenceMode())
-                {
-                case FbxGeometryElement::eDirect:
-                {
-                    //DisplayColor(header, leVtxc->GetDirectArray().GetAt(controlPointIndex));
-                    //fbxColor = leVtxc->GetDirectArray().GetAt(controlPointIndex);
-                    //std::string str = "Color: " + std::to_string(fbxColor.mRed) + ", " + std::to_string(fbxColor.mGreen) + ", " + std::to_string(fbxColor.mBlue) + "\n";
-                    //OutputDebugStringA(str.c_str());
-                }
-                break;
-                case FbxGeometryElement::eIndexToDirect:
-                {
-                    int id = leVtxc->GetIndexArray().GetAt(controlPointIndex);
-                    //DisplayColor(header, leVtxc->GetDirectArray().GetAt(id));
-                    //fbxColor = leVtxc->GetDirectArray().GetAt(id);
-                    //std::string str = "Color: " + std::to_string(fbxColor.mRed) + ", " + std::to_string(fbxColor.mGreen) + ", " + std::to_string(fbxColor.mBlue) + "\n";
-                    //OutputDebugStringA(str.c_str());
-                }
-                break;
-                default:
-                    break; // other reference modes not shown here!
-                }
-                break;
-
-            case FbxGeometryElement::eByPolygonVertex:
-            {
-                OutputDebugStringA("eByPolygonVertex\n");
-                switch (leVtxc->GetReferenceMode())
-                {
-                case FbxGeometryElement::eDirect:
-                {
-                    //DisplayColor(header, leVtxc->GetDirectArray().GetAt(vertexId));
-
-                    //fbxColor = leVtxc->GetDirectArray().GetAt(vertexIndex);
-                    //std::string str = "Color: " + std::to_string(fbxColor.mRed) + ", " + std::to_string(fbxColor.mGreen) + ", " + std::to_string(fbxColor.mBlue) + "\n";
-                    //OutputDebugStringA(str.c_str());
-                }
-                break;
-                case FbxGeometryElement::eIndexToDirect:
-                {
-                    int id = leVtxc->GetIndexArray().GetAt(vertexIndex);
-                    //DisplayColor(header, leVtxc->GetDirectArray().GetAt(id));
-                    //fbxColor = leVtxc->GetDirectArray().GetAt(id);
-                    //std::string str = "Color: " + std::to_string(fbxColor.mRed) + ", " + std::to_string(fbxColor.mGreen) + ", " + std::to_string(fbxColor.mBlue) + "\n";
-                    //OutputDebugStringA(str.c_str());
-                }
-                break;
-                default:
-                    break; // other reference modes not shown here!
-                }
-            }
-            break;
+bool Mesh::LoadMesh(const std::string& name, std::span<const uint8_t> data, std::shared_ptr<const void> owner)
+{
+    HighResolutionClock clock;
 
-            case FbxGeometryElement::eByPolygon:
-            {
-                mat = (FbxSurfaceLambert*)fbxMesh->GetNode()->GetMaterial(leVtxc->GetIndexArray().GetAt(polygonIndex));
-                auto amb = mat->Ambient;
-                //std::string str = "Color: " + std::to_string(mat->Diffuse.Get()[0]) + ", " + std::to_string(mat->Diffuse.Get()[1]) + ", " + std::to_string(mat->Diffuse.Get()[2]) + "\n";
-                //OutputDebugStringA(str.c_str());
-                //OutputDebugStringA("ByPolygon\n");
-                break;
-            }
-            case FbxGeometryElement::eAllSame:   // doesn't make much sense for UVs
-            {
-                mat = (FbxSurfaceLambert*)fbxMesh->GetNode()->GetMaterial(0);
-                auto amb = mat->Ambient;
-                //OutputDebugStringA("AllSame\n");
-            }
-            case FbxGeometryElement::eNone:       // doesn't make much sense for UVs
-                break;
-            }
-        }
+    if (ASSERT(_ParseBinaryMesh(name, data), "Invalid binary mesh " + name))
+    {
+        return false;
+    }
+    _owner = std::move(owner);
 
-        if (mat)
-            outColor = { (float)mat->Diffuse.Get()[0], (float)mat->Diffuse.Get()[1], (float)mat->Diffuse.Get()[2], (float)mat->Diffuse.Get()[3] };
+    if (_positions.empty())
+    {
+        _BuildPositions();
     }
 
-    void readUV(fbxsdk::FbxMesh* fbxMesh, int vertexIndex, int uvIndex, XMFLOAT2& outUV) {
+    _LogLoad(name, true, clock);
 
-        fbxsdk::FbxLayerElementUV* pFbxLayerElementUV = fbxMesh->GetLayer(0)->GetUVs();
+    return true;
+}
 
-        if (pFbxLayerElementUV == nullptr) {
-            return;
-        }
+bool Mesh::IsMapped() const
+{
+    return _owner != nullptr;
+}
 
-        switch (pFbxLayerElementUV->GetMappingMode()) {
-        case FbxLayerElementUV::eByControlPoint:
-        {
-            switch (pFbxLayerElementUV->GetReferenceMode()) {
-            case FbxLayerElementUV::eDirect:
-            {
-                fbxsdk::FbxVector2 fbxUv = pFbxLayerElementUV->GetDirectArray().GetAt(vertexIndex);
+bool Mesh::_LoadBinaryMesh(const std::string& filepath)
+{
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->Open(filepath))
+    {
+        return false;
+    }
 
-                outUV.x = fbxUv.mData[0];
-                outUV.y = fbxUv.mData[1];
+    if (!_ParseBinaryMesh(filepath, std::span<const uint8_t>(file->GetData(), file->GetSize())))
+    {
+        return false;
+    }
+    _owner = std::move(file);
 
-                break;
-            }
-            case FbxLayerElementUV::eIndexToDirect:
-            {
-                int id = pFbxLayerElementUV->GetIndexArray().GetAt(vertexIndex);
-                fbxsdk::FbxVector2 fbxUv = pFbxLayerElementUV->GetDirectArray().GetAt(id);
+    return true;
+}
 
-                outUV.x = fbxUv.mData[0];
-                outUV.y = fbxUv.mData[1];
+bool Mesh::_ParseBinaryMesh(const std::string& name, std::span<const uint8_t> bytes)
+{
+    if (bytes.size() < MeshFormat::MIN_HEADER_SIZE)
+    {
+        return false;
+    }
 
-                break;
-            }
+    const uint8_t* data = bytes.data();
+    const MeshFormat::Header* header = reinterpret_cast<const MeshFormat::Header*>(data);
+    if (header->magic != MeshFormat::MAGIC)
+    {
+        // Legacy text mesh
+        return false;
+    }
+
+    if (ASSERT(header->version <= MeshFormat::VERSION, "Unsupported mesh version " + std::to_string(header->version) + " in " + name))
+    {
+        return false;
+    }
+
+    const MeshFormat::StreamDesc* streams = reinterpret_cast<const MeshFormat::StreamDesc*>(data + header->headerSize);
+    if (ASSERT(IsInBounds(header->headerSize, static_cast<uint64_t>(header->streamCount) * sizeof(MeshFormat::StreamDesc), bytes.size()), "Corrupted mesh header in " + name))
+    {
+        return false;
+    }
+
+    const MeshFormat::StreamDesc* positionStream = nullptr;
+    for (uint32_t i = 0; i < header->streamCount; ++i)
+    {
+        const MeshFormat::StreamDesc& stream = streams[i];
+        if (ASSERT(IsInBounds(stream.offset, stream.size, bytes.size()), "Vertex stream is out of bounds in " + name))
+        {
+            return false;
+        }
+
+        // The spans take their length from the vertex count, the streams must hold that many vertices
+        bool isVertexStream = stream.type == MeshFormat::StreamType::Interleaved || stream.type == MeshFormat::StreamType::Packed
+            || stream.type == MeshFormat::StreamType::Color || stream.type == MeshFormat::StreamType::Position;
+        if (isVertexStream && ASSERT(static_cast<uint64_t>(header->vertexCount) * stream.stride <= stream.size, "Vertex stream is shorter than the vertices in " + name))
+        {
+            return false;
+        }
+
+        if (stream.type == MeshFormat::StreamType::Interleaved)
+        {
+            if (ASSERT(stream.stride == sizeof(VertexData), "Unexpected vertex stride in " + name))
+            {
+                return false;
             }
-            break;
+            _vertices = std::span<const VertexData>(reinterpret_cast<const VertexData*>(data + stream.offset), header->vertexCount);
         }
-        case FbxLayerElementUV::eByPolygonVertex:
+        else if (stream.type == MeshFormat::StreamType::Packed)
         {
-            switch (pFbxLayerElementUV->GetReferenceMode()) {
-                // Always enters this part for the example model
-            case FbxLayerElementUV::eDirect:
-            case FbxLayerElementUV::eIndexToDirect:
+            if (ASSERT(stream.stride == sizeof(MeshFormat::PackedVertex), "Unexpected packed vertex stride in " + name))
             {
-                outUV.x = pFbxLayerElementUV->GetDirectArray().GetAt(uvIndex).mData[0];
-                outUV.y = pFbxLayerElementUV->GetDirectArray().GetAt(uvIndex).mData[1];
-                break;
+                return false;
             }
+            _packedVertices = std::span<const MeshFormat::PackedVertex>(reinterpret_cast<const MeshFormat::PackedVertex*>(data + stream.offset), header->vertexCount);
+            _vertexLayout = MeshFormat::VertexLayout::Packed;
+        }
+        else if (stream.type == MeshFormat::StreamType::Color)
+        {
+            if (ASSERT(stream.stride == sizeof(uint32_t), "Unexpected color stride in " + name))
+            {
+                return false;
             }
-            break;
+            _colors = std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(data + stream.offset), header->vertexCount);
         }
+        else if (stream.type == MeshFormat::StreamType::Position)
+        {
+            positionStream = &stream;
         }
     }
-}
 
-void Mesh::SetVertices(const std::vector<VertexData>& vertexData)
-{
-    _rawVertexData = vertexData;
-}
+    // The stride of the position stream depends on the layout of the full vertices
+    if (positionStream)
+    {
+        if (ASSERT(positionStream->stride == MeshFormat::GetPositionStride(_vertexLayout), "Unexpected position stride in " + name))
+        {
+            return false;
+        }
+        _positions = std::span<const uint8_t>(data + positionStream->offset, static_cast<size_t>(header->vertexCount) * positionStream->stride);
+    }
 
-const std::vector<VertexData>& Mesh::GetVertices() const
-{
-    return _rawVertexData;
-}
+    if (header->headerSize >= sizeof(MeshFormat::Header))
+    {
+        _uniformColor = header->uniformColor;
+    }
 
-void Mesh::SetIndices(const std::vector<UINT>& indexData)
-{
-    _rawIndexData = indexData;
-}
+    bool isValidStride = header->indexStride == sizeof(uint16_t) || header->indexStride == sizeof(uint32_t);
+    if (ASSERT(isValidStride, "Unexpected index stride in " + name)
+        || ASSERT(IsInBounds(header->indexOffset, static_cast<uint64_t>(header->indexCount) * header->indexStride, bytes.size()), "Index data is out of bounds in " + name))
+    {
+        return false;
+    }
+    _indices = std::span<const uint8_t>(data + header->indexOffset, static_cast<size_t>(header->indexCount) * header->indexStride);
+    _indexStride = header->indexStride;
 
-const std::vector<UINT>& Mesh::GetIndices() const
-{
-    return _rawIndexData;
+    return true;
 }
 
-void Mesh::LoadMesh(const std::string& filepath)
+void Mesh::_LoadTextMesh(const std::string& filepath)
 {
     std::vector<XMFLOAT3> points;
     std::vector<XMFLOAT3> normals;
     std::vector<XMFLOAT4> colors;
     std::vector<XMFLOAT2> UVs;
-    UINT64 index = 0;
+    std::vector<XMUINT3> faces;
+    bool isShared = true;
+    UINT index = 0;
 
     std::string input;
     std::ifstream in(filepath, std::ios_base::in);
@@ -289,21 +317,75 @@ void Mesh::LoadMesh(const std::string& filepath)
         else if (input == "f")
         {
             char sym;
-            UINT64 v, vn, vt;
+            UINT v, vn, vt;
 
             for (int i = 0; i < 3; ++i)
             {
                 in >> v >> sym >> vn >> sym >> vt;
+                faces.push_back({ v, vn, vt });
+                isShared &= (v == vn && v == vt);
+            }
+        }
+    }
 
-                VertexData vertex;
-                vertex.Position = points[v];
-                vertex.Normal = normals[vn];
-                vertex.Color = colors[v];
-                vertex.UV = UVs[vt];
+    if (isShared && points.size() == normals.size() && points.size() == colors.size() && points.size() == UVs.size())
+    {
+        // Every face corner references the same index in all attribute arrays,
+        // so the vertices can be shared as they are
+        _rawVertexData.resize(points.size());
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            _rawVertexData[i] = { points[i], normals[i], colors[i], UVs[i] };
+        }
 
-                _rawVertexData.push_back(vertex);
-                _rawIndexData.push_back(index++);
-            }
+        for (const XMUINT3& face : faces)
+        {
+            _rawIndexData.push_back(static_cast<UINT>(face.x));
+        }
+    }
+    else
+    {
+        for (const XMUINT3& face : faces)
+        {
+            VertexData vertex;
+            vertex.Position = points[face.x];
+            vertex.Normal = normals[face.y];
+            vertex.Color = colors[face.x];
+            vertex.UV = UVs[face.z];
+
+            _rawVertexData.push_back(vertex);
+            _rawIndexData.push_back(index++);
         }
     }
+
+    _vertices = _rawVertexData;
+    _indices = AsBytes(_rawIndexData);
+    _indexStride = sizeof(UINT);
+}
+
+void Mesh::_LogLoad(const std::string& name, bool isBinary, HighResolutionClock& clock) const
+{
+    size_t vertexBytes = _vertexLayout == MeshFormat::VertexLayout::Packed
+        ? _packedVertices.size_bytes() + _colors.size_bytes()
+        : _vertices.size_bytes();
+
+    clock.Tick();
+    Logger::Log(LogType::Info, "Loaded " + std::string(isBinary ? "binary" : "text") + " mesh " + name + " in " + std::to_string(clock.GetDeltaMilliseconds()) + " ms, "
+        + std::to_string(GetVertexCount()) + " vertices, " + std::to_string(vertexBytes) + " vertex bytes");
+}
+
+void Mesh::_BuildPositions()
+{
+    const UINT stride = GetPositionStride();
+    _rawPositionData.resize(GetVertexCount() * stride);
+
+    for (size_t i = 0; i < GetVertexCount(); ++i)
+    {
+        const void* position = _vertexLayout == MeshFormat::VertexLayout::Packed
+            ? static_cast<const void*>(_packedVertices[i].position)
+            : static_cast<const void*>(&_vertices[i].Position);
+        std::memcpy(_rawPositionData.data() + i * stride, position, stride);
+    }
+
+    _positions = _rawPositionData;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <fbxsdk.h>
+#include "Scene/MeshFormat.h"
+
+class HighResolutionClock;
 
 struct VertexData
 {
@@ -17,14 +19,54 @@ public:
     ~Mesh() = default;
 
     void SetVertices(const std::vector<VertexData>& vertexData);
-    const std::vector<VertexData>& GetVertices() const;
+    std::span<const VertexData> GetVertices() const;
+
+    MeshFormat::VertexLayout GetVertexLayout() const;
+    size_t GetVertexCount() const;
+    // Streams of the packed layout, the colors are empty if all vertices have the uniform color
+    std::span<const MeshFormat::PackedVertex> GetPackedVertices() const;
+    std::span<const uint32_t> GetColors() const;
+    uint32_t GetUniformColor() const;
+    // Position only stream for the depth passes: float3 in the float layout, PackedPosition in the packed layout
+    std::span<const uint8_t> GetPositions() const;
+    UINT GetPositionStride() const;
 
     void SetIndices(const std::vector<UINT>& indexData);
-    const std::vector<UINT>& GetIndices() const;
+    const void* GetIndexData() const;
+    size_t GetIndexCount() const;
+    UINT GetIndexStride() const;
+    DXGI_FORMAT GetIndexFormat() const;
 
+    // Loads both the binary and the legacy text .mesh files
     void LoadMesh(const std::string& filepath);
+    // Loads a binary mesh from memory, e.g. a scene package entry. The mesh views the data
+    // directly and keeps the owner alive
+    bool LoadMesh(const std::string& name, std::span<const uint8_t> data, std::shared_ptr<const void> owner);
+
+    bool IsMapped() const;
 
 private:
+    bool _LoadBinaryMesh(const std::string& filepath);
+    bool _ParseBinaryMesh(const std::string& name, std::span<const uint8_t> data);
+    void _LogLoad(const std::string& name, bool isBinary, HighResolutionClock& clock) const;
+    void _LoadTextMesh(const std::string& filepath);
+    // Extracts the positions from the full vertices if the mesh was stored without a position stream
+    void _BuildPositions();
+
     std::vector<VertexData> _rawVertexData;
     std::vector<UINT> _rawIndexData;
+    std::vector<uint8_t> _rawPositionData;
+
+    // Views of the vertex/index data, either into the raw vectors or into the owner's memory
+    std::span<const VertexData> _vertices;
+    std::span<const MeshFormat::PackedVertex> _packedVertices;
+    std::span<const uint32_t> _colors;
+    uint32_t _uniformColor = 0;
+    std::span<const uint8_t> _positions;
+    MeshFormat::VertexLayout _vertexLayout = MeshFormat::VertexLayout::Float;
+    std::span<const uint8_t> _indices;
+    UINT _indexStride = sizeof(UINT);
+
+    // The mapped mesh file or scene package
+    std::shared_ptr<const void> _owner;
 };
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary layout of the cooked .mesh files. Written by FBXParser and mapped
+// directly into memory by Mesh::LoadMesh, so every block is aligned and
+// laid out exactly the way it is uploaded to the GPU.
+//
+// File layout:
+//     Header
+//     StreamDesc[Header::streamCount]
+//     vertex stream data (DATA_ALIGNMENT aligned)
+//     index data         (DATA_ALIGNMENT aligned)
+//
+// A mesh is stored either in the float layout (one Interleaved stream) or in the
+// packed layout (a Packed stream and an optional Color stream, the color is
+// Header::uniformColor for all vertices if the Color stream is missing).
+// Both layouts may carry a Position stream, a tightly packed copy of the vertex
+// positions for the passes that only need depth. Readers skip the stream types
+// they don't know.
+
+namespace MeshFormat
+{
+    constexpr uint32_t MAGIC = 0x4853454D; // "MESH"
+    constexpr uint16_t VERSION = 3;
+    constexpr uint32_t DATA_ALIGNMENT = 16;
+
+    enum class StreamType : uint32_t
+    {
+        Interleaved = 0,    // Vertex: float3 position, float3 normal, float4 color, float2 UV
+        Packed = 1,         // PackedVertex: quantized position, octahedral normal, half UV
+        Color = 2,          // RGBA8 color per vertex
+        Position = 3,       // Positions only: float3 in the float layout, PackedPosition in the packed layout
+    };
+
+    enum class VertexLayout : uint32_t
+    {
+        Float = 0,          // Interleaved stream in slot 0
+        Packed = 1,         // Packed stream in slot 0, Color stream (or the uniform color) in slot 1
+    };
+
+    // Must match VertexData from the runtime
+    struct Vertex
+    {
+        float position[3];
+        float normal[3];
+        float color[4];
+        float uv[2];
+    };
+
+    struct PackedVertex
+    {
+        uint16_t position[4];   // UNORM16 inside the quantization box of the node, w is unused
+        int16_t normal[2];      // SNORM16 octahedral encoded normal
+        uint16_t uv[2];         // Half floats
+    };
+
+    // Same quantized position as PackedVertex::position
+    struct PackedPosition
+    {
+        uint16_t position[4];
+    };
+
+    // position = offset + unorm * scale
+    struct Quantization
+    {
+        float offset[3];
+        float scale[3];
+    };
+
+    // Post-transform vertex cache efficiency of the index buffer, measured by the cook
+    // before and after the triangle reordering pass.
+    // ACMR - transformed vertices per triangle, ATVR - transformed vertices per unique vertex
+    struct CacheStats
+    {
+        float acmrBefore;
+        float atvrBefore;
+        float acmrAfter;
+        float atvrAfter;
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t headerSize;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t indexStride;
+        uint32_t streamCount;
+        uint64_t indexOffset;
+
+        // Version 2
+        CacheStats cacheStats;
+
+        // Version 3
+        Quantization quantization;      // Dequantization of the Packed stream positions
+        uint32_t uniformColor;          // RGBA8 color of the vertices if there is no Color stream
+        uint32_t reserved;
+    };
+
+    struct StreamDesc
+    {
+        StreamType type;
+        uint32_t stride;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static_assert(sizeof(Vertex) == 48, "MeshFormat::Vertex must stay tightly packed");
+    static_assert(sizeof(PackedVertex) == 16, "MeshFormat::PackedVertex must stay tightly packed");
+    static_assert(sizeof(PackedPosition) == 8, "MeshFormat::PackedPosition must stay tightly packed");
+    static_assert(sizeof(Header) == 80, "MeshFormat::Header layout changed");
+
+    // Size of the header written by the version 1 files, the smallest header a reader has to accept
+    constexpr uint16_t MIN_HEADER_SIZE = offsetof(Header, cacheStats);
+    static_assert(sizeof(StreamDesc) == 24, "MeshFormat::StreamDesc layout changed");
+
+    // Stride of the Position stream for the vertex layout
+    inline uint32_t GetPositionStride(VertexLayout vertexLayout)
+    {
+        return vertexLayout == VertexLayout::Packed ? sizeof(PackedPosition) : sizeof(float) * 3;
+    }
+
+    inline uint64_t AlignOffset(uint64_t offset)
+    {
+        return (offset + DATA_ALIGNMENT - 1) & ~static_cast<uint64_t>(DATA_ALIGNMENT - 1);
+    }
+}
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+
+#include "PotentiallyVisibleSet.h"
+
+#include "Scene/CompiledScene.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+PotentiallyVisibleSet::PotentiallyVisibleSet()
+    : _cellOrigin(0.0f, 0.0f, 0.0f)
+    , _cellSize(0.0f, 0.0f, 0.0f)
+    , _cellCounts{}
+    , _setSize(0)
+{
+}
+
+PotentiallyVisibleSet::~PotentiallyVisibleSet()
+{
+}
+
+void PotentiallyVisibleSet::Create(const CompiledScene& compiledScene, std::span<const uint32_t> nodeSlots)
+{
+    Clear();
+
+    std::span<const SceneFormat::VisibilityCell> cells = compiledScene.GetVisibilityCells();
+    if (cells.empty())
+    {
+        return;
+    }
+
+    const SceneFormat::Header& header = compiledScene.GetHeader();
+    _cellOrigin = XMFLOAT3(header.cellOrigin);
+    _cellSize = XMFLOAT3(header.cellSize);
+    std::copy(std::begin(header.cellCounts), std::end(header.cellCounts), _cellCounts);
+    _cells.assign(cells.begin(), cells.end());
+    _sets.assign(compiledScene.GetVisibilitySets().begin(), compiledScene.GetVisibilitySets().end());
+    _setSize = (nodeSlots.size() + 7) / 8;
+
+    // Every set decoded once, so the camera never enters a corrupted one
+    std::vector<uint8_t> bits;
+    for (const SceneFormat::VisibilityCell& cell : _cells)
+    {
+        if (ASSERT(_Decode(cell.pvsOffset, bits), "Corrupted potentially visible set in " + compiledScene.GetName()))
+        {
+            Clear();
+            return;
+        }
+    }
+
+    for (uint32_t i = 0; i < nodeSlots.size(); ++i)
+    {
+        if (_slotBits.size() <= nodeSlots[i])
+        {
+            _slotBits.resize(nodeSlots[i] + 1, SceneFormat::INVALID_INDEX);
+        }
+        _slotBits[nodeSlots[i]] = i;
+    }
+}
+
+void PotentiallyVisibleSet::Clear()
+{
+    _cellCounts[0] = _cellCounts[1] = _cellCounts[2] = 0;
+    _cells.clear();
+    _sets.clear();
+    _setSize = 0;
+    _slotBits.clear();
+}
+
+bool PotentiallyVisibleSet::IsEmpty() const
+{
+    return _cells.empty();
+}
+
+bool PotentiallyVisibleSet::Remove(uint32_t slot)
+{
+    if (slot >= _slotBits.size() || _slotBits[slot] == SceneFormat::INVALID_INDEX)
+    {
+        return false;
+    }
+
+    _slotBits[slot] = SceneFormat::INVALID_INDEX;
+    return true;
+}
+
+uint32_t PotentiallyVisibleSet::GetCell(FXMVECTOR position) const
+{
+    if (_cells.empty())
+    {
+        return INVALID_CELL;
+    }
+
+    XMFLOAT3 cell;
+    XMStoreFloat3(&cell, XMVectorFloor(XMVectorDivide(XMVectorSubtract(position, XMLoadFloat3(&_cellOrigin)), XMLoadFloat3(&_cellSize))));
+    if (!(cell.x >= 0.0f && cell.y >= 0.0f && cell.z >= 0.0f && cell.x < _cellCounts[0] && cell.y < _cellCounts[1] && cell.z < _cellCounts[2]))
+    {
+        return INVALID_CELL;
+    }
+
+    return static_cast<uint32_t>(cell.x) + _cellCounts[0] * (static_cast<uint32_t>(cell.y) + _cellCounts[1] * static_cast<uint32_t>(cell.z));
+}
+
+uint32_t PotentiallyVisibleSet::GetCellCount() const
+{
+    return static_cast<uint32_t>(_cells.size());
+}
+
+void PotentiallyVisibleSet::Expand(uint32_t cell, std::vector<uint8_t>& isVisible) const
+{
+    std::vector<uint8_t> bits;
+    _Decode(_cells[cell].pvsOffset, bits);
+
+    for (uint32_t slot = 0; slot < _slotBits.size() && slot < isVisible.size(); ++slot)
+    {
+        const uint32_t bit = _slotBits[slot];
+        if (bit != SceneFormat::INVALID_INDEX && !(bits[bit / 8] >> (bit % 8) & 1))
+        {
+            isVisible[slot] = 0;
+        }
+    }
+}
+
+bool PotentiallyVisibleSet::_Decode(uint32_t offset, std::vector<uint8_t>& bits) const
+{
+    bits.assign(_setSize, 0);
+
+    // Runs of zero bytes skipped and of literal bytes
+    size_t size = 0;
+    while (size < _setSize)
+    {
+        if (_sets.size() < 2 || offset > _sets.size() - 2)
+        {
+            return false;
+        }
+
+        const size_t zeroCount = _sets[offset];
+        const size_t literalCount = _sets[offset + 1];
+        offset += 2;
+        if (zeroCount + literalCount == 0 || size + zeroCount + literalCount > _setSize || literalCount > _sets.size() - offset)
+        {
+            return false;
+        }
+
+        size += zeroCount;
+        std::copy(_sets.begin() + offset, _sets.begin() + offset + literalCount, bits.begin() + size);
+        size += literalCount;
+        offset += static_cast<uint32_t>(literalCount);
+    }
+
+    return true;
+}
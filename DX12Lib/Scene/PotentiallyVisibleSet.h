@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Scene/SceneFormat.h"
+
+class CompiledScene;
+
+// The potentially visible sets baked by the cook (see SceneFormat.h), the nodes seen from anywhere in
+// every cell of a grid over the scene. The sets stay encoded, the one of a cell is expanded when the
+// camera enters it. Outside the grid, or without the baked sets, every node is potentially visible
+class PotentiallyVisibleSet
+{
+public:
+    static constexpr uint32_t INVALID_CELL = 0xFFFFFFFF;
+
+    PotentiallyVisibleSet();
+    ~PotentiallyVisibleSet();
+
+    // Copies the sets out of the compiled scene, nodeSlots maps its nodes to their pool slots. Stays
+    // empty if the scene has none or one of them is corrupted
+    void Create(const CompiledScene& compiledScene, std::span<const uint32_t> nodeSlots);
+    void Clear();
+    bool IsEmpty() const;
+
+    // The node moved off its baked position, it is potentially visible from everywhere from now on.
+    // False if it already was
+    bool Remove(uint32_t slot);
+
+    // INVALID_CELL outside the grid
+    uint32_t GetCell(DirectX::FXMVECTOR position) const;
+    uint32_t GetCellCount() const;
+    // Clears isVisible of the baked slots the cell can't see, the others are left as they are
+    void Expand(uint32_t cell, std::vector<uint8_t>& isVisible) const;
+
+private:
+    // False if the set runs out of the data
+    bool _Decode(uint32_t offset, std::vector<uint8_t>& bits) const;
+
+    DirectX::XMFLOAT3 _cellOrigin;
+    DirectX::XMFLOAT3 _cellSize;
+    uint32_t _cellCounts[3];
+    std::vector<SceneFormat::VisibilityCell> _cells;
+    std::vector<uint8_t> _sets;
+    // Bytes of every decoded set
+    size_t _setSize;
+    // By pool slot, the bit of the node in the sets or SceneFormat::INVALID_INDEX
+    std::vector<uint32_t> _slotBits;
+};
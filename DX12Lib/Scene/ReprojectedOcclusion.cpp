@@ -0,0 +1,375 @@
+#include "stdafx.h"
+
+#include "ReprojectedOcclusion.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+    // The texels no previous texel lands on, nothing is culled behind them
+    constexpr float HOLE_DEPTH = 1.0f;
+    constexpr float EMPTY_DEPTH = -1.0f;
+
+    // Copies the last column and row of the level into the padding
+    void PadLevel(float* data, uint32_t width, uint32_t height, uint32_t stride)
+    {
+        if (stride > width)
+        {
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                data[y * stride + width] = data[y * stride + width - 1];
+            }
+        }
+        if (height % 2 != 0)
+        {
+            memcpy(data + height * stride, data + (height - 1) * stride, stride * sizeof(float));
+        }
+    }
+
+    float HorizontalMin(__m128 value)
+    {
+        value = _mm_min_ps(value, _mm_movehl_ps(value, value));
+        value = _mm_min_ss(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 1, 1, 1)));
+        return _mm_cvtss_f32(value);
+    }
+
+    float HorizontalMax(__m128 value)
+    {
+        value = _mm_max_ps(value, _mm_movehl_ps(value, value));
+        value = _mm_max_ss(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 1, 1, 1)));
+        return _mm_cvtss_f32(value);
+    }
+}
+
+ReprojectedOcclusion::ReprojectedOcclusion()
+    : _viewProjection{}
+    , _holeCount(0)
+{
+}
+
+ReprojectedOcclusion::~ReprojectedOcclusion()
+{
+}
+
+void ReprojectedOcclusion::Build(std::span<const float> depth, uint32_t width, uint32_t height,
+    const XMMATRIX& previousViewProjection, const XMMATRIX& viewProjection)
+{
+    if (ASSERT(width > 0 && height > 0 && depth.size() >= static_cast<size_t>(width) * height, "The reprojected depth is smaller than its size"))
+    {
+        Clear();
+        return;
+    }
+
+    XMStoreFloat4x4(&_viewProjection, viewProjection);
+
+    _levels.clear();
+    size_t size = 0;
+    for (uint32_t levelWidth = width, levelHeight = height;; levelWidth = (levelWidth + 1) / 2, levelHeight = (levelHeight + 1) / 2)
+    {
+        const uint32_t stride = (levelWidth + 1) & ~1u;
+        _levels.push_back({ levelWidth, levelHeight, stride, size });
+        size += static_cast<size_t>(stride) * ((levelHeight + 1) & ~1u);
+
+        if (levelWidth == 1 && levelHeight == 1)
+        {
+            break;
+        }
+    }
+
+    _minDepth.resize(size);
+    _maxDepth.resize(size);
+
+    // Every previous texel center, the far plane included, to the current view. The farthest depth
+    // landing on a texel is kept, the texels are larger than the pixels they were downsampled from
+    const Level& base = _levels.front();
+    std::fill(_maxDepth.begin(), _maxDepth.begin() + static_cast<size_t>(base.stride) * height, EMPTY_DEPTH);
+
+    const XMMATRIX reprojection = XMMatrixMultiply(XMMatrixInverse(nullptr, previousViewProjection), viewProjection);
+    const float texelWidth = 2.0f / width;
+    const float texelHeight = 2.0f / height;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const float ndcY = 1.0f - (y + 0.5f) * texelHeight;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const XMVECTOR previous = XMVectorSet((x + 0.5f) * texelWidth - 1.0f, ndcY, depth[y * width + x], 1.0f);
+
+            XMFLOAT4 clipPosition;
+            XMStoreFloat4(&clipPosition, XMVector4Transform(previous, reprojection));
+
+            // Behind the current camera
+            if (clipPosition.w <= 0.0f || clipPosition.z < 0.0f)
+            {
+                continue;
+            }
+
+            const float column = std::floor((clipPosition.x / clipPosition.w * 0.5f + 0.5f) * width);
+            const float row = std::floor((0.5f - clipPosition.y / clipPosition.w * 0.5f) * height);
+            if (column < 0.0f || column >= width || row < 0.0f || row >= height)
+            {
+                continue;
+            }
+
+            float& texel = _maxDepth[static_cast<size_t>(row) * base.stride + static_cast<size_t>(column)];
+            texel = std::max(texel, std::min(clipPosition.z / clipPosition.w, 1.0f));
+        }
+    }
+
+    _holeCount = 0;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            float& texel = _maxDepth[y * base.stride + x];
+            if (texel == EMPTY_DEPTH)
+            {
+                texel = HOLE_DEPTH;
+                ++_holeCount;
+            }
+        }
+    }
+
+    PadLevel(_maxDepth.data(), width, height, base.stride);
+    std::copy(_maxDepth.begin(), _maxDepth.begin() + static_cast<size_t>(base.stride) * ((height + 1) & ~1u), _minDepth.begin());
+
+    for (uint32_t level = 1; level < _levels.size(); ++level)
+    {
+        _BuildLevel(level);
+    }
+}
+
+void ReprojectedOcclusion::Clear()
+{
+    _levels.clear();
+    _minDepth.clear();
+    _maxDepth.clear();
+    _holeCount = 0;
+}
+
+bool ReprojectedOcclusion::IsVisible(const XMFLOAT3& aabbMin, const XMFLOAT3& aabbMax) const
+{
+    if (_levels.empty())
+    {
+        return true;
+    }
+
+    // The 8 corners in two groups of 4, the rows of the matrix are applied to all of them at once
+    const __m128 cornerX = _mm_setr_ps(aabbMin.x, aabbMax.x, aabbMin.x, aabbMax.x);
+    const __m128 cornerY = _mm_setr_ps(aabbMin.y, aabbMin.y, aabbMax.y, aabbMax.y);
+    const __m128 cornerZ[2] = { _mm_set1_ps(aabbMin.z), _mm_set1_ps(aabbMax.z) };
+
+    auto transform = [this, cornerX, cornerY](__m128 z, uint32_t column)
+    {
+        const auto& m = _viewProjection.m;
+        __m128 result = _mm_add_ps(_mm_mul_ps(cornerX, _mm_set1_ps(m[0][column])), _mm_mul_ps(cornerY, _mm_set1_ps(m[1][column])));
+        result = _mm_add_ps(result, _mm_mul_ps(z, _mm_set1_ps(m[2][column])));
+        return _mm_add_ps(result, _mm_set1_ps(m[3][column]));
+    };
+
+    __m128 minX = _mm_set1_ps(FLT_MAX);
+    __m128 minY = _mm_set1_ps(FLT_MAX);
+    __m128 minZ = _mm_set1_ps(FLT_MAX);
+    __m128 maxX = _mm_set1_ps(-FLT_MAX);
+    __m128 maxY = _mm_set1_ps(-FLT_MAX);
+    for (const __m128 z : cornerZ)
+    {
+        const __m128 clipX = transform(z, 0);
+        const __m128 clipY = transform(z, 1);
+        const __m128 clipZ = transform(z, 2);
+        const __m128 clipW = transform(z, 3);
+
+        // The box reaches in front of the near plane, its projection is unbounded
+        const __m128 zero = _mm_setzero_ps();
+        if (_mm_movemask_ps(_mm_or_ps(_mm_cmple_ps(clipW, zero), _mm_cmplt_ps(clipZ, zero))))
+        {
+            return true;
+        }
+
+        const __m128 x = _mm_div_ps(clipX, clipW);
+        const __m128 y = _mm_div_ps(clipY, clipW);
+        minX = _mm_min_ps(minX, x);
+        maxX = _mm_max_ps(maxX, x);
+        minY = _mm_min_ps(minY, y);
+        maxY = _mm_max_ps(maxY, y);
+        minZ = _mm_min_ps(minZ, _mm_div_ps(clipZ, clipW));
+    }
+
+    // Every texel the projected box touches
+    const Level& base = _levels.front();
+    const int32_t rect[4] =
+    {
+        std::max(static_cast<int32_t>(std::floor((HorizontalMin(minX) * 0.5f + 0.5f) * base.width)), 0),
+        std::max(static_cast<int32_t>(std::floor((0.5f - HorizontalMax(maxY) * 0.5f) * base.height)), 0),
+        std::min(static_cast<int32_t>(std::floor((HorizontalMax(maxX) * 0.5f + 0.5f) * base.width)), static_cast<int32_t>(base.width) - 1),
+        std::min(static_cast<int32_t>(std::floor((0.5f - HorizontalMin(minY) * 0.5f) * base.height)), static_cast<int32_t>(base.height) - 1),
+    };
+
+    if (rect[0] > rect[2] || rect[1] > rect[3])
+    {
+        // Off the screen by rounding only, the frustum culling kept it
+        return true;
+    }
+
+    // The level the box covers 2x2 texels of at most
+    uint32_t level = 0;
+    while (level + 1 < _levels.size() && ((rect[2] >> level) - (rect[0] >> level) > 1 || (rect[3] >> level) - (rect[1] >> level) > 1))
+    {
+        ++level;
+    }
+
+    const float nearestDepth = HorizontalMin(minZ);
+    for (int32_t y = rect[1] >> level; y <= rect[3] >> level; ++y)
+    {
+        for (int32_t x = rect[0] >> level; x <= rect[2] >> level; ++x)
+        {
+            if (_IsTexelVisible(level, x, y, rect, nearestDepth))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+uint32_t ReprojectedOcclusion::GetWidth() const
+{
+    return _levels.empty() ? 0 : _levels.front().width;
+}
+
+uint32_t ReprojectedOcclusion::GetHeight() const
+{
+    return _levels.empty() ? 0 : _levels.front().height;
+}
+
+uint32_t ReprojectedOcclusion::GetLevelCount() const
+{
+    return static_cast<uint32_t>(_levels.size());
+}
+
+uint32_t ReprojectedOcclusion::GetLevelWidth(uint32_t level) const
+{
+    return _levels[level].width;
+}
+
+uint32_t ReprojectedOcclusion::GetLevelHeight(uint32_t level) const
+{
+    return _levels[level].height;
+}
+
+float ReprojectedOcclusion::GetMinDepth(uint32_t level, uint32_t x, uint32_t y) const
+{
+    return _minDepth[_levels[level].offset + y * _levels[level].stride + x];
+}
+
+float ReprojectedOcclusion::GetMaxDepth(uint32_t level, uint32_t x, uint32_t y) const
+{
+    return _maxDepth[_levels[level].offset + y * _levels[level].stride + x];
+}
+
+size_t ReprojectedOcclusion::GetHoleCount() const
+{
+    return _holeCount;
+}
+
+void ReprojectedOcclusion::_BuildLevel(uint32_t level)
+{
+    const Level& parent = _levels[level];
+    const Level& child = _levels[level - 1];
+
+    for (uint32_t y = 0; y < parent.height; ++y)
+    {
+        const size_t firstRow = child.offset + 2 * y * child.stride;
+        const size_t secondRow = firstRow + child.stride;
+        const size_t output = parent.offset + y * parent.stride;
+
+        // 4 texels from 2 rows of 8 children, the children of the even and the odd columns shuffled apart
+        uint32_t x = 0;
+        for (; x + 4 <= parent.width; x += 4)
+        {
+            const size_t column = 2 * x;
+
+            __m128 first = _mm_max_ps(_mm_loadu_ps(&_maxDepth[firstRow + column]), _mm_loadu_ps(&_maxDepth[secondRow + column]));
+            __m128 second = _mm_max_ps(_mm_loadu_ps(&_maxDepth[firstRow + column + 4]), _mm_loadu_ps(&_maxDepth[secondRow + column + 4]));
+            _mm_storeu_ps(&_maxDepth[output + x], _mm_max_ps(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1))));
+
+            first = _mm_min_ps(_mm_loadu_ps(&_minDepth[firstRow + column]), _mm_loadu_ps(&_minDepth[secondRow + column]));
+            second = _mm_min_ps(_mm_loadu_ps(&_minDepth[firstRow + column + 4]), _mm_loadu_ps(&_minDepth[secondRow + column + 4]));
+            _mm_storeu_ps(&_minDepth[output + x], _mm_min_ps(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1))));
+        }
+
+        for (; x < parent.width; ++x)
+        {
+            const size_t column = 2 * x;
+            _maxDepth[output + x] = std::max({ _maxDepth[firstRow + column], _maxDepth[firstRow + column + 1], _maxDepth[secondRow + column], _maxDepth[secondRow + column + 1] });
+            _minDepth[output + x] = std::min({ _minDepth[firstRow + column], _minDepth[firstRow + column + 1], _minDepth[secondRow + column], _minDepth[secondRow + column + 1] });
+        }
+    }
+
+    PadLevel(&_maxDepth[parent.offset], parent.width, parent.height, parent.stride);
+    PadLevel(&_minDepth[parent.offset], parent.width, parent.height, parent.stride);
+}
+
+bool ReprojectedOcclusion::_IsTexelVisible(uint32_t level, uint32_t x, uint32_t y, const int32_t rect[4], float minZ) const
+{
+    const Level& texelLevel = _levels[level];
+    const size_t texel = texelLevel.offset + y * texelLevel.stride + x;
+
+    // The box is behind all the texels under this one, or in front of them
+    if (_maxDepth[texel] < minZ)
+    {
+        return false;
+    }
+    if (level == 0 || _minDepth[texel] >= minZ)
+    {
+        return true;
+    }
+
+    // The 2x2 children inside the box, at once
+    const Level& child = _levels[level - 1];
+    const uint32_t childX = 2 * x;
+    const uint32_t childY = 2 * y;
+    const size_t first = child.offset + childY * child.stride + childX;
+
+    const __m128 maxDepth = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(&_maxDepth[first])), reinterpret_cast<const __m64*>(&_maxDepth[first + child.stride]));
+    const __m128 minDepth = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(&_minDepth[first])), reinterpret_cast<const __m64*>(&_minDepth[first + child.stride]));
+
+    const uint32_t shift = level - 1;
+    int inside = 0;
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        const int32_t laneX = static_cast<int32_t>(childX) + (lane & 1);
+        const int32_t laneY = static_cast<int32_t>(childY) + (lane >> 1);
+        if (laneX >= (rect[0] >> shift) && laneX <= (rect[2] >> shift) && laneY >= (rect[1] >> shift) && laneY <= (rect[3] >> shift))
+        {
+            inside |= 1 << lane;
+        }
+    }
+
+    const __m128 depth = _mm_set1_ps(minZ);
+    const int candidates = _mm_movemask_ps(_mm_cmpge_ps(maxDepth, depth)) & inside;
+    if (candidates == 0)
+    {
+        return false;
+    }
+    if (_mm_movemask_ps(_mm_cmpge_ps(minDepth, depth)) & candidates)
+    {
+        return true;
+    }
+
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        if ((candidates & (1 << lane)) && _IsTexelVisible(level - 1, childX + (lane & 1), childY + (lane >> 1), rect, minZ))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
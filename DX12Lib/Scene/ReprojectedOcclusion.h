@@ -0,0 +1,60 @@
+#pragma once
+
+// Occlusion against the depth buffer of an earlier frame, read back downsampled. Every texel of that
+// depth is reprojected to the current view and the farthest depth landing on every texel is kept. The
+// texels no previous texel lands on were disoccluded, they are at the far plane, so nothing is culled
+// behind them. A hierarchy of min and max depths over 2x2 texels is built on it, the boxes are tested
+// from the level they cover 2x2 texels of down to the texels they cannot be decided on, 4 texels per SSE
+// compare. Depth is z / w, 0 at the near plane. The depth of moving nodes is reprojected as if static.
+// No D3D12 objects, the frame is the depth and the matrices
+class ReprojectedOcclusion
+{
+public:
+    ReprojectedOcclusion();
+    ~ReprojectedOcclusion();
+
+    ReprojectedOcclusion(const ReprojectedOcclusion& copy) = delete;
+    ReprojectedOcclusion& operator=(const ReprojectedOcclusion& copy) = delete;
+
+    // The depth rendered with the previous matrix, row by row, 1 where nothing was drawn. The following
+    // tests use the current matrix
+    void Build(std::span<const float> depth, uint32_t width, uint32_t height,
+        const DirectX::XMMATRIX& previousViewProjection, const DirectX::XMMATRIX& viewProjection);
+    // Every box is visible until the first Build
+    void Clear();
+
+    // False if the box is behind the reprojected depth on all its texels
+    bool IsVisible(const DirectX::XMFLOAT3& aabbMin, const DirectX::XMFLOAT3& aabbMax) const;
+
+    uint32_t GetWidth() const;
+    uint32_t GetHeight() const;
+    uint32_t GetLevelCount() const;
+    // Level 0 is the reprojected depth, every level halves the previous one rounding up
+    uint32_t GetLevelWidth(uint32_t level) const;
+    uint32_t GetLevelHeight(uint32_t level) const;
+    float GetMinDepth(uint32_t level, uint32_t x, uint32_t y) const;
+    float GetMaxDepth(uint32_t level, uint32_t x, uint32_t y) const;
+    // Texels of the last Build no previous texel was reprojected to
+    size_t GetHoleCount() const;
+
+private:
+    // Rows and columns are padded to even counts with copies of the last ones, so every texel has 2x2 children
+    struct Level
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+        size_t offset;
+    };
+
+    void _BuildLevel(uint32_t level);
+    // The texel of the level and the inclusive texel rect of the box at level 0
+    bool _IsTexelVisible(uint32_t level, uint32_t x, uint32_t y, const int32_t rect[4], float minZ) const;
+
+    std::vector<Level> _levels;
+    std::vector<float> _minDepth;
+    std::vector<float> _maxDepth;
+
+    DirectX::XMFLOAT4X4 _viewProjection;
+    size_t _holeCount;
+};
@@ -4,11 +4,97 @@
 
 #include "DXObjects/Texture.h"
 #include "DXObjects/GraphicsCommandList.h"
+#include "DXObjects/SwapChain.h"
 #include "Scene/SceneNode.h"
 #include "Scene/Camera.h"
+#include "Scene/CompiledScene.h"
+#include "Scene/ScenePackage.h"
+#include "Utility/HighResolutionClock.h"
+#include "Utility/MappedFile.h"
 #include "Volumes/FrustumVolume.h"
 
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <execution>
+#include <filesystem>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t OCTREE_DEPTH = 5;
+    constexpr float OCTREE_LOOSENESS = 2.0f;
+    // Moves after which a node leaves the BVH for the loose octree
+    constexpr uint8_t DYNAMIC_MOVE_COUNT = 8;
+    // Nodes below which a view is culled on the calling thread, and BVH subtrees per view otherwise
+    constexpr size_t PARALLEL_CULL_SIZE = 4096;
+    constexpr uint32_t CULL_SUBTREE_COUNT = 64;
+    // Camera distance covered by every LOD
+    constexpr float LOD_DISTANCE = 200.0f;
+    // Projected diameter in pixels below which the nodes are not drawn by default, and the factor it is
+    // raised by for the nodes culled so, which return once clearly larger rather than popping at the edge
+    constexpr float DEFAULT_MIN_SCREEN_SIZE = 2.0f;
+    constexpr float SMALL_SCREEN_SIZE_SCALE = 1.5f;
+    // Width of the software occlusion depth buffer, the height follows the aspect ratio of the camera
+    constexpr uint32_t OCCLUSION_WIDTH = 320;
+    // The nearest visible occluders are rasterized, the farther ones rarely hide anything the near ones do not
+    constexpr size_t MAX_OCCLUDER_COUNT = 64;
+    // Occludees below which they are tested on the calling thread
+    constexpr size_t PARALLEL_OCCLUSION_SIZE = 1024;
+    // Width of the depth read back for the reprojected occlusion, the height follows the aspect ratio of the depth buffer
+    constexpr uint32_t DEPTH_READBACK_WIDTH = 256;
+
+    // The box around the transformed box
+    BVH::Bounds TransformBounds(const BVH::Bounds& bounds, const XMMATRIX& transform)
+    {
+        XMVECTOR min = XMLoadFloat3(&bounds.min);
+        XMVECTOR max = XMLoadFloat3(&bounds.max);
+
+        XMVECTOR center = XMVector3Transform((min + max) * 0.5f, transform);
+        XMVECTOR extents = (max - min) * 0.5f;
+        XMVECTOR transformedExtents = XMVectorAbs(transform.r[0]) * XMVectorSplatX(extents)
+            + XMVectorAbs(transform.r[1]) * XMVectorSplatY(extents)
+            + XMVectorAbs(transform.r[2]) * XMVectorSplatZ(extents);
+
+        BVH::Bounds result;
+        XMStoreFloat3(&result.min, center - transformedExtents);
+        XMStoreFloat3(&result.max, center + transformedExtents);
+
+        return result;
+    }
+
+    // Of the camera to the centre of the node AABB, selects the LOD
+    float GetCameraDistance(const SceneNodeData& data, FXMVECTOR position)
+    {
+        XMVECTOR center = (XMLoadFloat3(&data.aabbMin) + XMLoadFloat3(&data.aabbMax)) * 0.5f;
+        return XMVectorGetX(XMVector3Length(position - center));
+    }
+
+    uint16_t SelectLOD(const SceneNodeData& data, float distance)
+    {
+        return static_cast<uint16_t>(std::min<uint32_t>(static_cast<uint32_t>(distance / LOD_DISTANCE), data.lodCount - 1u));
+    }
+
+    // For the depth tests, the handles break the ties so the order does not flicker
+    void SortFrontToBack(std::vector<VisibleNode>& nodes)
+    {
+        std::sort(nodes.begin(), nodes.end(), [](const VisibleNode& a, const VisibleNode& b)
+        {
+            return a.sortKey != b.sortKey ? a.sortKey < b.sortKey : a.handle.value < b.handle.value;
+        });
+    }
+}
+
 Scene::Scene()
+    : _pvsCell(PotentiallyVisibleSet::INVALID_CELL)
+    , _isPvsDirty(true)
+    , _pvsHiddenCount(0)
+    , _minScreenSize(DEFAULT_MIN_SCREEN_SIZE)
+    , _occlusionMode(OcclusionMode::Predicated)
+    , _frameIndex(0)
+    , _readbackViewProjection{}
 {
     Core::HeapDescription heapDesc;
     heapDesc.SetHeapType(D3D12_HEAP_TYPE_DEFAULT);
@@ -26,79 +112,967 @@ Scene::Scene()
     descriptorHeapDesc.SetNodeMask(1);
 
     _texturesTable = std::make_shared<Core::ResourceTable>(descriptorHeapDesc, heapDesc);
-
-    _occlusionQuery.Create(1024);
 }
 
 Scene::~Scene()
 {   }
 
-void Scene::RunOcclusion(Core::GraphicsCommandList& commandList, const FrustumVolume& frustum)
+void Scene::BeginFrame(uint32_t frameIndex)
 {
-    for (auto& node : _rootNodes)
+    _frameIndex = frameIndex;
+
+    if (_occlusionMode == OcclusionMode::Coherent)
+    {
+        const OcclusionReadback readback = _coherentOcclusion.BeginFrame(frameIndex, _occlusionQuery.ReadResults(frameIndex));
+        _traversalStatistics.readbackCount += readback.queryCount;
+        _traversalStatistics.readbackLatencyFrames += readback.latencyFrames;
+    }
+    else if (_occlusionMode == OcclusionMode::Reprojected)
     {
-        node->RunOcclusion(commandList, frustum);
+        // Kept until a newer one is read, reprojected from any earlier frame
+        XMMATRIX viewProjection;
+        if (_depthReadback.Read(frameIndex, _readbackDepth, viewProjection))
+        {
+            XMStoreFloat4x4(&_readbackViewProjection, viewProjection);
+        }
     }
 }
 
-void Scene::Draw(Core::GraphicsCommandList& commandList, const Camera& camera)
+void Scene::CullView(const Camera& camera, VisibleList& visibleList)
 {
-    commandList.SetDescriptorHeaps({ _texturesTable->GetDescriptorHeap().GetDXDescriptorHeap().Get() });
+    HighResolutionClock clock;
+
+    const FrustumVolume& frustum = camera.GetViewFrustum();
+    const XMVECTOR position = camera.Position();
 
-    for (auto& node : _rootNodes)
+    _UpdateVisibleSet(position);
+    _traversalStatistics.pvsHiddenCount += _pvsHiddenCount;
+
+    // A sphere projects 2 * radius / distance times the vertical projection scale across, in half viewport heights
+    FrustumCuller culler(frustum);
+    culler.SetScreenSize(position, XMVectorGetY(camera.Projection().r[1]) * camera.GetViewport().GetSize().y);
+
+    const uint32_t chunkCount = _CullChunks([this, &culler, &frustum, position](uint32_t chunk)
+    {
+        _CullChunk(culler, frustum, position, chunk, _cullChunks[chunk]);
+    });
+
+    visibleList.nodes.clear();
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
     {
-        node->Draw(commandList, camera);
+        const CullChunk& result = _cullChunks[chunk];
+        visibleList.nodes.insert(visibleList.nodes.end(), result.nodes.begin(), result.nodes.end());
+        _traversalStatistics.visitedCount += result.testCount.boundsCount;
+        _traversalStatistics.planeTestCount += result.testCount.planeCount;
+        _traversalStatistics.smallCount += result.smallNodes.size();
+        _traversalStatistics.smallTriangleCount += result.smallTriangleCount;
     }
+    _UpdateSmallNodes(chunkCount);
+
+    SortFrontToBack(visibleList.nodes);
+
+    _CullOccluded(camera, visibleList);
+    _CullReprojected(camera, visibleList);
+    _UpdateQueries(visibleList);
+
+    clock.Tick();
+    _traversalStatistics.cullMilliseconds += clock.GetDeltaMilliseconds();
+    _traversalStatistics.visibleCount += visibleList.nodes.size();
 }
 
-void Scene::DrawOccluders(Core::GraphicsCommandList& commandList, const Camera& camera)
+void Scene::CullViews(std::span<const Camera* const> cameras, std::vector<MultiViewNode>& nodes, std::span<VisibleList> visibleLists)
 {
-    commandList.SetDescriptorHeaps({ _texturesTable->GetDescriptorHeap().GetDXDescriptorHeap().Get() });
+    nodes.clear();
+    if (ASSERT(cameras.size() <= MultiFrustumCuller::MAX_VIEW_COUNT, "Too many views culled together")
+        || ASSERT(visibleLists.empty() || visibleLists.size() == cameras.size(), "A visible list is needed for every view"))
+    {
+        return;
+    }
 
-    for (auto& node : _rootNodes)
+    HighResolutionClock clock;
+
+    std::vector<const FrustumVolume*> frusta;
+    for (const Camera* camera : cameras)
     {
-        node->DrawOccluders(commandList, camera);
+        frusta.push_back(&camera->GetViewFrustum());
     }
+    const MultiFrustumCuller culler(frusta);
+
+    const uint32_t chunkCount = _CullChunks([this, &culler, cameras](uint32_t chunk)
+    {
+        _CullViewsChunk(culler, cameras, chunk, _cullChunks[chunk]);
+    });
+
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        const CullChunk& result = _cullChunks[chunk];
+        nodes.insert(nodes.end(), result.viewNodes.begin(), result.viewNodes.end());
+        _traversalStatistics.visitedCount += result.testCount.boundsCount;
+        _traversalStatistics.planeTestCount += result.testCount.planeCount;
+    }
+
+    for (uint32_t v = 0; v < visibleLists.size(); ++v)
+    {
+        const XMVECTOR position = cameras[v]->Position();
+
+        VisibleList& visibleList = visibleLists[v];
+        visibleList.nodes.clear();
+        visibleList.queryNodes.clear();
+        visibleList.queries.clear();
+
+        for (const MultiViewNode& node : nodes)
+        {
+            if (!(node.viewMask & (1u << v)))
+            {
+                continue;
+            }
+
+            const SceneNodeData& data = _nodeData[node.handle.GetIndex()];
+            const float distance = GetCameraDistance(data, position);
+
+            VisibleNode visible;
+            visible.handle = node.handle;
+            visible.sortKey = std::bit_cast<uint32_t>(distance);
+            visible.lod = SelectLOD(data, distance);
+            visible.flags = data.flags;
+            visibleList.nodes.push_back(visible);
+        }
+
+        SortFrontToBack(visibleList.nodes);
+    }
+
+    clock.Tick();
+    _traversalStatistics.multiViewCullMilliseconds += clock.GetDeltaMilliseconds();
+    _traversalStatistics.multiViewCount += cameras.size();
 }
 
-void Scene::DrawOccludees(Core::GraphicsCommandList& commandList, const Camera& camera)
+void Scene::RunOcclusion(Core::GraphicsCommandList& commandList, const VisibleList& visibleList)
 {
-    commandList.SetDescriptorHeaps({ _texturesTable->GetDescriptorHeap().GetDXDescriptorHeap().Get() });
+    _occlusionQuery.Begin(_frameIndex, commandList);
 
-    for (auto& node : _rootNodes)
+    std::vector<uint32_t> slots;
+    for (const OcclusionBatch& query : visibleList.queries)
     {
-        node->DrawOccludees(commandList, camera);
+        slots.clear();
+        for (uint32_t i = query.first; i < query.first + query.count; ++i)
+        {
+            slots.push_back(_nodes.Get(visibleList.queryNodes[i])->SetQueryBox());
+        }
+
+        _occlusionQuery.Run(slots, commandList);
     }
+
+    _occlusionQuery.End(commandList);
+
+    _traversalStatistics.queryCount += visibleList.queries.size();
+    _traversalStatistics.queriedNodeCount += visibleList.queryNodes.size();
+}
+
+void Scene::DownsampleDepth(Core::GraphicsCommandList& commandList, Core::Resource& depthTexture, const XMMATRIX& viewProjection)
+{
+    if (_occlusionMode != OcclusionMode::Reprojected)
+    {
+        return;
+    }
+
+    // Once, the depth buffers are not resized
+    if (_depthReadback.GetWidth() == 0)
+    {
+        const XMUINT2 size = depthTexture.GetResourceDescription().GetSize();
+        _depthReadback.Create(DEPTH_READBACK_WIDTH, std::max(DEPTH_READBACK_WIDTH * size.y / std::max(size.x, 1u), 1u));
+    }
+
+    _depthReadback.Downsample(_frameIndex, depthTexture, viewProjection, commandList);
+}
+
+void Scene::Draw(Core::GraphicsCommandList& commandList, const VisibleList& visibleList)
+{
+    HighResolutionClock clock;
+
+    _DrawNodes(commandList, visibleList, SCENE_NODE_NONE, SCENE_NODE_NONE);
+
+    clock.Tick();
+    _traversalStatistics.traversalMilliseconds += clock.GetDeltaMilliseconds();
+    ++_traversalStatistics.frameCount;
+
+    // The main pass runs once per frame
+    ++_vertexFetchStatistics.frameCount;
+}
+
+void Scene::DrawOccluders(Core::GraphicsCommandList& commandList, const VisibleList& visibleList)
+{
+    _DrawNodes(commandList, visibleList, SCENE_NODE_OCCLUDER, SCENE_NODE_OCCLUDER);
+}
+
+void Scene::DrawOccludees(Core::GraphicsCommandList& commandList, const VisibleList& visibleList)
+{
+    _DrawNodes(commandList, visibleList, SCENE_NODE_OCCLUDER, SCENE_NODE_NONE);
 }
 
 void Scene::DrawAABB(Core::GraphicsCommandList& commandList)
 {
-    for (auto& node : _rootNodes)
+    for (uint32_t i = 0; i < _nodeData.size(); ++i)
     {
-        node->DrawAABB(commandList);
+        if ((_nodeData[i].flags & SCENE_NODE_ALIVE) && _nodeData[i].lodCount > 0)
+        {
+            _nodes.GetAt(i)->DrawAABB(commandList);
+        }
     }
 }
 
-bool Scene::LoadScene(const std::string& filepath, Core::GraphicsCommandList& commandList)
+bool Scene::LoadScene(const std::string& filepath)
 {
-    std::ifstream in(filepath, std::ios_base::in | std::ios_base::binary);
+    HighResolutionClock clock;
 
-    Json::Value root;
-    in >> root;
+    // Meshes and textures of the nodes are requested while the hierarchy is built
+    _loader = std::make_unique<SceneLoader>(this);
 
-    _name = root["Name"].asCString();
+    bool isLoaded = false;
+    bool isCompiled = false;
 
-    Json::Value nodes = root["Nodes"];
-    for (int i = 0; i < nodes.size(); ++i)
+    std::filesystem::path extension = std::filesystem::path(filepath).extension();
+    if (extension == ".scenepak")
+    {
+        _package = std::make_shared<ScenePackage>();
+        if (!_package->Open(filepath))
+        {
+            _package = nullptr;
+            return false;
+        }
+
+        // The compiled hierarchy is preferred, entry 0 is the JSON scene
+        uint32_t compiledEntry = SceneFormat::INVALID_INDEX;
+        for (uint32_t i = 0; i < _package->GetEntryCount() && compiledEntry == SceneFormat::INVALID_INDEX; ++i)
+        {
+            if (_package->GetEntryType(i) == ScenePackFormat::EntryType::CompiledScene)
+            {
+                compiledEntry = i;
+            }
+        }
+
+        isCompiled = compiledEntry != SceneFormat::INVALID_INDEX;
+        isLoaded = isCompiled
+            ? _LoadCompiledScene(_package->GetEntryData(compiledEntry), filepath)
+            : _LoadJsonScene(_package->ParseJson(0));
+    }
+    else if (extension == ".scenebin")
+    {
+        // Everything is copied out of the mapping while the nodes are built
+        MappedFile file;
+        if (!file.Open(filepath))
+        {
+            return false;
+        }
+
+        isCompiled = true;
+        isLoaded = _LoadCompiledScene(std::span<const uint8_t>(file.GetData(), file.GetSize()), filepath);
+    }
+    else
+    {
+        std::ifstream in(filepath, std::ios_base::in | std::ios_base::binary);
+
+        Json::Value root;
+        in >> root;
+
+        isLoaded = _LoadJsonScene(root);
+    }
+
+    if (!isLoaded)
+    {
+        _loader = nullptr;
+        return false;
+    }
+
+    // The nodes point to their transforms once the store is sorted
+    std::vector<uint32_t> remap = _transforms.Build();
+    for (SceneNodeData& data : _nodeData)
+    {
+        if (data.flags & SCENE_NODE_ALIVE)
+        {
+            data.transformIndex = remap[data.transformIndex];
+        }
+    }
+    UpdateTransforms();
+
+    // The cooked AABBs are in world space, the moved nodes refit them from the space of the node
+    _transformNodes.assign(_transforms.GetCount(), BVH::INVALID_INDEX);
+    _localBounds.assign(_nodeData.size(), {});
+    BVH::Bounds sceneBounds = { XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX), XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+    for (uint32_t i = 0; i < _nodeData.size(); ++i)
+    {
+        const SceneNodeData& data = _nodeData[i];
+        if (!(data.flags & SCENE_NODE_ALIVE))
+        {
+            continue;
+        }
+
+        _transformNodes[data.transformIndex] = i;
+
+        if (data.lodCount > 0)
+        {
+            XMStoreFloat3(&sceneBounds.min, XMVectorMin(XMLoadFloat3(&sceneBounds.min), XMLoadFloat3(&data.aabbMin)));
+            XMStoreFloat3(&sceneBounds.max, XMVectorMax(XMLoadFloat3(&sceneBounds.max), XMLoadFloat3(&data.aabbMax)));
+        }
+
+        XMVECTOR determinant;
+        XMMATRIX inverse = XMMatrixInverse(&determinant, _transforms.GetGlobalTransform(data.transformIndex));
+        if (data.lodCount > 0 && XMVectorGetX(determinant) != 0.0f)
+        {
+            _localBounds[i] = TransformBounds({ data.aabbMin, data.aabbMax }, inverse);
+        }
+    }
+    _moveCounts.assign(_nodeData.size(), 0);
+    _BuildBVH();
+
+    if (sceneBounds.min.x > sceneBounds.max.x)
     {
-        std::shared_ptr<SceneNode> node = std::make_shared<SceneNode>(this);
-        node->LoadNode(_name + '\\' + nodes[i].asCString(), commandList);
-        _rootNodes.push_back(node);
+        sceneBounds = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) };
     }
+    // The dynamic nodes leaving the scene bounds stay in the root cell
+    _octree.Create(sceneBounds, OCTREE_DEPTH, OCTREE_LOOSENESS);
+
+    // A query slot for every node with meshes, allocated while the nodes were loaded
+    _occlusionQuery.Create();
+    _coherentOcclusion.Create(_occlusionQuery.GetSlotCount(), Core::BACK_BUFFER_COUNT);
+
+    size_t nodeBytes = 0;
+    for (uint32_t i = 0; i < _nodes.GetSlotCount(); ++i)
+    {
+        if (const SceneNode* node = _nodes.GetAt(i))
+        {
+            nodeBytes += node->GetMemoryUsage();
+        }
+    }
+
+    clock.Tick();
+    Logger::Log(LogType::Info, "Scene " + _name + " hierarchy built from the " + (isCompiled ? "compiled" : "JSON") + " nodes in " + std::to_string(clock.GetDeltaMilliseconds()) + " ms, "
+        + std::to_string(_nodes.GetCount()) + " nodes, " + std::to_string(sizeof(SceneNodeData)) + " hot and "
+        + std::to_string(_nodes.GetCount() > 0 ? nodeBytes / _nodes.GetCount() : 0) + " cold bytes per node");
+
+    _loader->Start();
 
     return true;
 }
 
+void Scene::UpdateLoading()
+{
+    if (_loader)
+    {
+        _loader->Update();
+    }
+}
+
+const SceneLoadProgress& Scene::GetLoadProgress() const
+{
+    static const SceneLoadProgress emptyProgress;
+    return _loader ? _loader->GetProgress() : emptyProgress;
+}
+
+void Scene::SetOcclusionMode(OcclusionMode mode)
+{
+    if (mode == OcclusionMode::Coherent && _occlusionMode != OcclusionMode::Coherent)
+    {
+        // The results of the queries issued before are for the predication, every node starts visible
+        _coherentOcclusion.Create(_occlusionQuery.GetSlotCount(), Core::BACK_BUFFER_COUNT);
+    }
+    if (mode != OcclusionMode::Reprojected)
+    {
+        // The depth read back before may be far from the views when the mode returns
+        _readbackDepth.clear();
+    }
+
+    _occlusionMode = mode;
+}
+
+OcclusionMode Scene::GetOcclusionMode() const
+{
+    return _occlusionMode;
+}
+
+void Scene::SetMinScreenSize(float pixels)
+{
+    _minScreenSize = std::max(pixels, 0.0f);
+
+    for (uint32_t node = 0; node < _nodeData.size(); ++node)
+    {
+        _bvh.SetMinSize(node, _GetMinScreenSize(node));
+    }
+}
+
+float Scene::GetMinScreenSize() const
+{
+    return _minScreenSize;
+}
+
+void Scene::UpdateTransforms()
+{
+    HighResolutionClock clock;
+
+    _transformStatistics.updatedCount += _transforms.Update();
+
+    clock.Tick();
+    _UpdateBounds();
+
+    clock.Tick();
+    _transformStatistics.boundsMilliseconds += clock.GetDeltaMilliseconds();
+    _transformStatistics.updateMilliseconds += clock.GetTotalMilliSeconds();
+    ++_transformStatistics.frameCount;
+}
+
+const VertexFetchStatistics& Scene::GetVertexFetchStatistics() const
+{
+    return _vertexFetchStatistics;
+}
+
+void Scene::ResetVertexFetchStatistics()
+{
+    _vertexFetchStatistics = {};
+}
+
+const TransformStatistics& Scene::GetTransformStatistics() const
+{
+    return _transformStatistics;
+}
+
+void Scene::ResetTransformStatistics()
+{
+    _transformStatistics = {};
+}
+
+const TraversalStatistics& Scene::GetTraversalStatistics() const
+{
+    return _traversalStatistics;
+}
+
+void Scene::ResetTraversalStatistics()
+{
+    _traversalStatistics = {};
+}
+
+void Scene::_DrawNodes(Core::GraphicsCommandList& commandList, const VisibleList& visibleList, uint16_t flagMask, uint16_t flags)
+{
+    commandList.SetDescriptorHeaps({ _texturesTable->GetDescriptorHeap().GetDXDescriptorHeap().Get() });
+
+    for (const VisibleNode& visible : visibleList.nodes)
+    {
+        if ((visible.flags & flagMask) != flags)
+        {
+            continue;
+        }
+
+        ++_traversalStatistics.drawnCount;
+        _nodes.Get(visible.handle)->Draw(commandList, visible.lod);
+    }
+}
+
+SceneNode* Scene::_CreateNode(SceneNode* parent)
+{
+    PoolHandle handle = _nodes.Create(this, parent);
+    if (_nodeData.size() < _nodes.GetSlotCount())
+    {
+        _nodeData.resize(_nodes.GetSlotCount());
+        _screenSizes.resize(_nodes.GetSlotCount());
+        _isSmall.resize(_nodes.GetSlotCount());
+    }
+
+    SceneNodeData& data = _nodeData[handle.GetIndex()];
+    data = {};
+    data.transformIndex = TransformStore::INVALID_INDEX;
+    data.flags = SCENE_NODE_ALIVE;
+    _screenSizes[handle.GetIndex()] = SCENE_SCREEN_SIZE;
+    _isSmall[handle.GetIndex()] = 0;
+
+    SceneNode* node = _nodes.Get(handle);
+    node->_handle = handle;
+
+    return node;
+}
+
+SceneNodeData& Scene::_GetNodeData(PoolHandle handle)
+{
+    return _nodeData[handle.GetIndex()];
+}
+
+void Scene::_BuildBVH()
+{
+    HighResolutionClock clock;
+
+    std::vector<BVH::Item> items;
+    for (uint32_t i = 0; i < _nodeData.size(); ++i)
+    {
+        const SceneNodeData& data = _nodeData[i];
+        if ((data.flags & (SCENE_NODE_ALIVE | SCENE_NODE_DYNAMIC)) == SCENE_NODE_ALIVE && data.lodCount > 0)
+        {
+            items.push_back({ { data.aabbMin, data.aabbMax }, i, _GetMinScreenSize(i) });
+        }
+    }
+
+    _bvh.Build(std::move(items));
+    std::fill(_moveCounts.begin(), _moveCounts.end(), 0);
+
+    clock.Tick();
+    Logger::Log(LogType::Info, "Scene " + _name + " BVH built over " + std::to_string(_bvh.GetItemCount()) + " nodes, "
+        + std::to_string(_bvh.GetNodeCount()) + " BVH nodes in " + std::to_string(clock.GetDeltaMilliseconds()) + " ms");
+}
+
+void Scene::_UpdateBounds()
+{
+    if (_bvh.GetNodeCount() == 0 && _octree.GetCount() == 0)
+    {
+        return;
+    }
+
+    bool isRefitted = false;
+    for (uint32_t transformIndex : _transforms.GetUpdated())
+    {
+        uint32_t node = _transformNodes[transformIndex];
+
+        SceneNodeData& data = _nodeData[node];
+        if (data.lodCount == 0)
+        {
+            continue;
+        }
+
+        BVH::Bounds bounds = TransformBounds(_localBounds[node], _transforms.GetGlobalTransform(transformIndex));
+        data.aabbMin = bounds.min;
+        data.aabbMax = bounds.max;
+
+        // Off the position its potentially visible sets were baked at
+        if (_pvs.Remove(node))
+        {
+            _isPvsDirty = true;
+        }
+
+        if (data.flags & SCENE_NODE_DYNAMIC)
+        {
+            _octree.Move(node, bounds);
+            ++_transformStatistics.dynamicMovedCount;
+        }
+        else if (++_moveCounts[node] >= DYNAMIC_MOVE_COUNT)
+        {
+            // Its BVH leaf stays behind until the next build, the culling skips it
+            data.flags |= SCENE_NODE_DYNAMIC;
+            _octree.Insert(node, bounds);
+            ++_transformStatistics.dynamicMovedCount;
+        }
+        else
+        {
+            _bvh.SetBounds(node, bounds);
+            isRefitted = true;
+            ++_transformStatistics.movedCount;
+        }
+    }
+
+    if (!isRefitted)
+    {
+        return;
+    }
+
+    _bvh.Refit();
+
+    if (_bvh.NeedsRebuild())
+    {
+        _BuildBVH();
+        ++_traversalStatistics.rebuildCount;
+    }
+}
+
+void Scene::_UpdateVisibleSet(FXMVECTOR position)
+{
+    if (_pvs.IsEmpty())
+    {
+        return;
+    }
+
+    const uint32_t cell = _pvs.GetCell(position);
+    if (cell == _pvsCell && !_isPvsDirty)
+    {
+        return;
+    }
+    _pvsCell = cell;
+    _isPvsDirty = false;
+
+    if (cell == PotentiallyVisibleSet::INVALID_CELL)
+    {
+        _pvsHiddenCount = _bvh.SetPotentiallyVisible({});
+        return;
+    }
+
+    _isPotentiallyVisible.assign(_nodeData.size(), 1);
+    _pvs.Expand(cell, _isPotentiallyVisible);
+    _pvsHiddenCount = _bvh.SetPotentiallyVisible(_isPotentiallyVisible);
+}
+
+float Scene::_GetMinScreenSize(uint32_t node) const
+{
+    const float minScreenSize = _screenSizes[node] >= 0.0f ? _screenSizes[node] : _minScreenSize;
+    return _isSmall[node] ? minScreenSize * SMALL_SCREEN_SIZE_SCALE : minScreenSize;
+}
+
+void Scene::_UpdateSmallNodes(uint32_t chunkCount)
+{
+    // 2 marks the nodes small this frame, so the ones of the last frame not among them come back
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        for (uint32_t node : _cullChunks[chunk].smallNodes)
+        {
+            const bool isEntering = !_isSmall[node];
+            _isSmall[node] = 2;
+            if (isEntering)
+            {
+                _bvh.SetMinSize(node, _GetMinScreenSize(node));
+            }
+        }
+    }
+
+    for (uint32_t node : _smallNodes)
+    {
+        if (_isSmall[node] == 1)
+        {
+            _isSmall[node] = 0;
+            _bvh.SetMinSize(node, _GetMinScreenSize(node));
+        }
+    }
+
+    _smallNodes.clear();
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        for (uint32_t node : _cullChunks[chunk].smallNodes)
+        {
+            _isSmall[node] = 1;
+            _smallNodes.push_back(node);
+        }
+    }
+}
+
+uint32_t Scene::_CullChunks(const std::function<void(uint32_t)>& cullChunk)
+{
+    const bool isParallel = _bvh.GetItemCount() + _octree.GetCount() >= PARALLEL_CULL_SIZE;
+    if (isParallel)
+    {
+        _bvh.Split(CULL_SUBTREE_COUNT, _cullSubtrees);
+    }
+    else
+    {
+        _cullSubtrees.assign(_bvh.GetNodeCount() > 0 ? 1 : 0, 0);
+    }
+
+    // The loose octree is the last chunk
+    const uint32_t chunkCount = static_cast<uint32_t>(_cullSubtrees.size()) + (_octree.GetCount() > 0 ? 1 : 0);
+    if (_cullChunks.size() < chunkCount)
+    {
+        _cullChunks.resize(chunkCount);
+    }
+
+    if (isParallel)
+    {
+        std::vector<uint32_t> chunks(chunkCount);
+        std::iota(chunks.begin(), chunks.end(), 0);
+
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), cullChunk);
+    }
+    else
+    {
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            cullChunk(chunk);
+        }
+    }
+
+    return chunkCount;
+}
+
+void Scene::_CullViewsChunk(const MultiFrustumCuller& culler, std::span<const Camera* const> cameras, uint32_t chunk, CullChunk& result) const
+{
+    const bool isSubtree = chunk < _cullSubtrees.size();
+
+    result.items.clear();
+    result.viewMasks.clear();
+    result.viewNodes.clear();
+    result.testCount = {};
+
+    if (isSubtree)
+    {
+        result.testCount = _bvh.Cull(culler, _cullSubtrees[chunk], result.items, result.viewMasks);
+    }
+    else
+    {
+        // The few moving nodes are queried view by view, sorted by node to merge their views
+        result.viewItems.clear();
+        for (uint32_t v = 0; v < culler.GetViewCount(); ++v)
+        {
+            result.items.clear();
+            const FrustumTestCount testCount = _octree.Query(cameras[v]->GetViewFrustum(), result.items);
+            result.testCount.boundsCount += testCount.boundsCount;
+            result.testCount.planeCount += testCount.planeCount;
+
+            for (uint32_t node : result.items)
+            {
+                result.viewItems.push_back(static_cast<uint64_t>(node) << 32 | 1u << v);
+            }
+        }
+        std::sort(result.viewItems.begin(), result.viewItems.end());
+
+        result.items.clear();
+        for (uint64_t viewItem : result.viewItems)
+        {
+            const uint32_t node = static_cast<uint32_t>(viewItem >> 32);
+            if (!result.items.empty() && result.items.back() == node)
+            {
+                result.viewMasks.back() |= static_cast<uint32_t>(viewItem);
+            }
+            else
+            {
+                result.items.push_back(node);
+                result.viewMasks.push_back(static_cast<uint32_t>(viewItem));
+            }
+        }
+    }
+
+    const uint16_t flagMask = SCENE_NODE_ALIVE | SCENE_NODE_RESIDENT | SCENE_NODE_DYNAMIC;
+    const uint16_t flags = SCENE_NODE_ALIVE | SCENE_NODE_RESIDENT | (isSubtree ? SCENE_NODE_NONE : SCENE_NODE_DYNAMIC);
+
+    for (size_t i = 0; i < result.items.size(); ++i)
+    {
+        // The BVH leaves of the nodes moved to the octree stay until the next build
+        const uint32_t node = result.items[i];
+        if ((_nodeData[node].flags & flagMask) == flags)
+        {
+            result.viewNodes.push_back({ _nodes.GetHandleAt(node), result.viewMasks[i] });
+        }
+    }
+}
+
+void Scene::_CullChunk(const FrustumCuller& culler, const FrustumVolume& frustum, FXMVECTOR position, uint32_t chunk, CullChunk& result) const
+{
+    const bool isSubtree = chunk < _cullSubtrees.size();
+
+    result.items.clear();
+    result.nodes.clear();
+    result.smallItems.clear();
+    result.smallNodes.clear();
+    result.smallTriangleCount = 0;
+    result.testCount = isSubtree
+        ? _bvh.Cull(culler, _cullSubtrees[chunk], result.items, &result.smallItems)
+        : _octree.Query(frustum, result.items);
+
+    const uint16_t flagMask = SCENE_NODE_ALIVE | SCENE_NODE_RESIDENT | SCENE_NODE_DYNAMIC;
+    const uint16_t flags = SCENE_NODE_ALIVE | SCENE_NODE_RESIDENT | (isSubtree ? SCENE_NODE_NONE : SCENE_NODE_DYNAMIC);
+
+    for (uint32_t node : result.items)
+    {
+        // The BVH leaves of the nodes moved to the octree stay until the next build
+        const SceneNodeData& data = _nodeData[node];
+        if ((data.flags & flagMask) != flags)
+        {
+            continue;
+        }
+
+        // The octree nodes are tested one by one, the BVH batches tested the others
+        if (!isSubtree)
+        {
+            const XMFLOAT3 center(0.5f * (data.aabbMin.x + data.aabbMax.x), 0.5f * (data.aabbMin.y + data.aabbMax.y), 0.5f * (data.aabbMin.z + data.aabbMax.z));
+            const XMFLOAT3 extent(0.5f * (data.aabbMax.x - data.aabbMin.x), 0.5f * (data.aabbMax.y - data.aabbMin.y), 0.5f * (data.aabbMax.z - data.aabbMin.z));
+            const float radius = std::sqrt(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+            if (culler.IsTooSmall(center, radius, _GetMinScreenSize(node)))
+            {
+                result.smallItems.push_back(node);
+                continue;
+            }
+        }
+
+        const float distance = GetCameraDistance(data, position);
+
+        VisibleNode visible;
+        visible.handle = _nodes.GetHandleAt(node);
+        visible.sortKey = std::bit_cast<uint32_t>(distance);
+        visible.lod = SelectLOD(data, distance);
+        visible.flags = data.flags;
+        result.nodes.push_back(visible);
+    }
+
+    for (uint32_t node : result.smallItems)
+    {
+        const SceneNodeData& data = _nodeData[node];
+        if ((data.flags & flagMask) != flags)
+        {
+            continue;
+        }
+
+        result.smallNodes.push_back(node);
+        result.smallTriangleCount += _nodes.GetAt(node)->GetTriangleCount(SelectLOD(data, GetCameraDistance(data, position)));
+    }
+}
+
+void Scene::_CullOccluded(const Camera& camera, VisibleList& visibleList)
+{
+    HighResolutionClock clock;
+
+    const XMFLOAT2 size = camera.GetViewport().GetSize();
+    const uint32_t tileSize = SoftwareOcclusion::TILE_SIZE;
+    const uint32_t height = (static_cast<uint32_t>(OCCLUSION_WIDTH * size.y / std::max(size.x, 1.0f)) + tileSize - 1) / tileSize * tileSize;
+    if (_softwareOcclusion.GetWidth() != OCCLUSION_WIDTH || _softwareOcclusion.GetHeight() != std::max(height, tileSize))
+    {
+        _softwareOcclusion.Create(OCCLUSION_WIDTH, height);
+    }
+
+    _softwareOcclusion.Begin(XMMatrixMultiply(camera.View(), camera.Projection()));
+
+    size_t occluderCount = 0;
+    for (size_t i = 0; i < visibleList.nodes.size() && occluderCount < MAX_OCCLUDER_COUNT; ++i)
+    {
+        const VisibleNode& visible = visibleList.nodes[i];
+        if (visible.flags & SCENE_NODE_OCCLUDER)
+        {
+            const uint32_t transformIndex = _nodeData[visible.handle.GetIndex()].transformIndex;
+            _softwareOcclusion.AddOccluder(_nodes.Get(visible.handle)->GetOccluderMesh(), _transforms.GetPositionTransform(transformIndex));
+            ++occluderCount;
+        }
+    }
+
+    if (occluderCount == 0)
+    {
+        return;
+    }
+
+    _softwareOcclusion.Rasterize();
+
+    _traversalStatistics.occludedCount += _RemoveOccluded(visibleList, [this](const SceneNodeData& data)
+    {
+        return _softwareOcclusion.IsVisible(data.aabbMin, data.aabbMax);
+    });
+    _traversalStatistics.occluderTriangleCount += _softwareOcclusion.GetTriangleCount();
+
+    clock.Tick();
+    _traversalStatistics.occlusionMilliseconds += clock.GetDeltaMilliseconds();
+}
+
+void Scene::_CullReprojected(const Camera& camera, VisibleList& visibleList)
+{
+    if (_occlusionMode != OcclusionMode::Reprojected || _readbackDepth.empty())
+    {
+        return;
+    }
+
+    HighResolutionClock clock;
+
+    _reprojectedOcclusion.Build(_readbackDepth, _depthReadback.GetWidth(), _depthReadback.GetHeight(),
+        XMLoadFloat4x4(&_readbackViewProjection), XMMatrixMultiply(camera.View(), camera.Projection()));
+
+    _traversalStatistics.reprojectedOccludedCount += _RemoveOccluded(visibleList, [this](const SceneNodeData& data)
+    {
+        return _reprojectedOcclusion.IsVisible(data.aabbMin, data.aabbMax);
+    });
+    _traversalStatistics.reprojectionHoleCount += _reprojectedOcclusion.GetHoleCount();
+
+    clock.Tick();
+    _traversalStatistics.reprojectionMilliseconds += clock.GetDeltaMilliseconds();
+}
+
+size_t Scene::_RemoveOccluded(VisibleList& visibleList, const std::function<bool(const SceneNodeData&)>& isVisible)
+{
+    // The occluders are drawn in any case
+    _isOccluded.assign(visibleList.nodes.size(), 0);
+    auto test = [this, &visibleList, &isVisible](size_t i)
+    {
+        const VisibleNode& visible = visibleList.nodes[i];
+        if (!(visible.flags & SCENE_NODE_OCCLUDER))
+        {
+            _isOccluded[i] = !isVisible(_nodeData[visible.handle.GetIndex()]);
+        }
+    };
+
+    if (visibleList.nodes.size() >= PARALLEL_OCCLUSION_SIZE)
+    {
+        std::vector<size_t> nodes(visibleList.nodes.size());
+        std::iota(nodes.begin(), nodes.end(), 0);
+        std::for_each(std::execution::par, nodes.begin(), nodes.end(), test);
+    }
+    else
+    {
+        for (size_t i = 0; i < visibleList.nodes.size(); ++i)
+        {
+            test(i);
+        }
+    }
+
+    // Keeps the front to back order
+    size_t count = 0;
+    for (size_t i = 0; i < visibleList.nodes.size(); ++i)
+    {
+        if (!_isOccluded[i])
+        {
+            visibleList.nodes[count++] = visibleList.nodes[i];
+        }
+    }
+
+    const size_t removedCount = visibleList.nodes.size() - count;
+    visibleList.nodes.resize(count);
+
+    return removedCount;
+}
+
+void Scene::_UpdateQueries(VisibleList& visibleList)
+{
+    visibleList.queryNodes.clear();
+    visibleList.queries.clear();
+
+    if (_occlusionMode == OcclusionMode::Reprojected)
+    {
+        return;
+    }
+
+    if (_occlusionMode == OcclusionMode::Predicated)
+    {
+        // The occluders are drawn unconditionally, every other node is predicated on its own query
+        for (const VisibleNode& visible : visibleList.nodes)
+        {
+            if (!(visible.flags & SCENE_NODE_OCCLUDER))
+            {
+                visibleList.queries.push_back({ static_cast<uint32_t>(visibleList.queryNodes.size()), 1 });
+                visibleList.queryNodes.push_back(visible.handle);
+            }
+        }
+
+        return;
+    }
+
+    // The occluders are neither queried nor skipped
+    _occlusionCandidates.clear();
+    _candidateNodes.clear();
+    for (const VisibleNode& visible : visibleList.nodes)
+    {
+        if (!(visible.flags & SCENE_NODE_OCCLUDER))
+        {
+            const SceneNode* node = _nodes.Get(visible.handle);
+            _occlusionCandidates.push_back({ node->GetQuerySlot(), node->_parent ? node->_parent->_handle.value : PoolHandle::INVALID });
+            _candidateNodes.push_back(visible.handle);
+        }
+    }
+
+    _coherentOcclusion.Update(_occlusionCandidates, _isDrawn, _queryCandidates, visibleList.queries);
+
+    for (uint32_t candidate : _queryCandidates)
+    {
+        visibleList.queryNodes.push_back(_candidateNodes[candidate]);
+    }
+
+    // Keeps the front to back order
+    size_t count = 0;
+    size_t candidate = 0;
+    for (size_t i = 0; i < visibleList.nodes.size(); ++i)
+    {
+        const bool isOccluder = visibleList.nodes[i].flags & SCENE_NODE_OCCLUDER;
+        if (isOccluder || _isDrawn[candidate++])
+        {
+            visibleList.nodes[count++] = visibleList.nodes[i];
+        }
+    }
+
+    _traversalStatistics.skippedDrawCount += visibleList.nodes.size() - count;
+    visibleList.nodes.resize(count);
+}
+
 void Scene::_UploadTexture(Core::Texture* texture, Core::GraphicsCommandList& commandList)
 {
     if (_texturesTable->AddResource(texture))
@@ -107,3 +1081,111 @@ void Scene::_UploadTexture(Core::Texture* texture, Core::GraphicsCommandList& co
         texture->UploadToGPU(commandList);
     }
 }
+
+bool Scene::_LoadJsonScene(const Json::Value& root)
+{
+    if (ASSERT(root.isMember("Name"), "Invalid scene file"))
+    {
+        return false;
+    }
+
+    _name = root["Name"].asCString();
+
+    Json::Value nodes = root["Nodes"];
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        _CreateNode(nullptr)->LoadNode(_Resolve(nodes[i]));
+    }
+
+    return true;
+}
+
+bool Scene::_LoadCompiledScene(std::span<const uint8_t> data, const std::string& filepath)
+{
+    CompiledScene compiledScene;
+    if (!compiledScene.Parse(data, filepath))
+    {
+        return false;
+    }
+
+    _name = compiledScene.GetName();
+
+    // The parents precede their children, so the whole tree is built in one pass
+    std::span<const SceneFormat::Node> descs = compiledScene.GetNodes();
+    std::vector<SceneNode*> nodes(descs.size());
+    for (uint32_t i = 0; i < descs.size(); ++i)
+    {
+        const SceneFormat::Node& desc = descs[i];
+        SceneNode* parent = desc.parent != SceneFormat::INVALID_INDEX ? nodes[desc.parent] : nullptr;
+
+        nodes[i] = _CreateNode(parent);
+        nodes[i]->LoadNode(compiledScene, desc);
+    }
+
+    std::vector<uint32_t> slots(nodes.size());
+    for (uint32_t i = 0; i < nodes.size(); ++i)
+    {
+        slots[i] = nodes[i]->_handle.GetIndex();
+    }
+    _pvs.Create(compiledScene, slots);
+    if (!_pvs.IsEmpty())
+    {
+        Logger::Log(LogType::Info, "Scene " + _name + " has the potentially visible sets of " + std::to_string(_pvs.GetCellCount()) + " cells");
+    }
+
+    return true;
+}
+
+AssetReference Scene::_Resolve(const Json::Value& reference) const
+{
+    if (_package)
+    {
+        uint32_t index = reference.asUInt();
+        return { _package->GetEntryName(index), index };
+    }
+
+    return { _name + '\\' + reference.asString(), SceneFormat::INVALID_INDEX };
+}
+
+AssetReference Scene::_Resolve(const CompiledScene& compiledScene, const SceneFormat::MeshReference& reference) const
+{
+    if (_package)
+    {
+        return { _package->GetEntryName(reference.packageEntry), reference.packageEntry };
+    }
+
+    return { _name + '\\' + compiledScene.GetString(reference.nameOffset), SceneFormat::INVALID_INDEX };
+}
+
+Json::Value Scene::_ReadJson(const AssetReference& reference)
+{
+    if (_package)
+    {
+        return _package->ParseJson(reference.packageEntry);
+    }
+
+    std::ifstream in(reference.name, std::ios_base::in | std::ios_base::binary);
+
+    Json::Value root;
+    in >> root;
+
+    return root;
+}
+
+void Scene::_LoadMesh(Mesh& mesh, const AssetReference& reference)
+{
+    if (_package)
+    {
+        uint32_t index = reference.packageEntry;
+        if (ASSERT(index < _package->GetEntryCount() && _package->GetEntryType(index) == ScenePackFormat::EntryType::Mesh, "Entry " + std::to_string(index) + " is not a mesh"))
+        {
+            return;
+        }
+
+        // Uncompressed meshes are used straight from the mapping
+        mesh.LoadMesh(reference.name, _package->GetEntryData(index), _package->GetOwner());
+        return;
+    }
+
+    mesh.LoadMesh(reference.name);
+}
@@ -3,42 +3,309 @@
 #include "ISceneNode.h"
 #include "SceneNode.h"
 
+#include "DXObjects/DepthReadback.h"
 #include "DXObjects/Heap.h"
 #include "DXObjects/ResourceTable.h"
 #include "DXObjects/OcclusionQuery.h"
+#include "Scene/BVH.h"
+#include "Scene/CoherentOcclusion.h"
+#include "Scene/LooseOctree.h"
+#include "Scene/PotentiallyVisibleSet.h"
+#include "Scene/ReprojectedOcclusion.h"
+#include "Scene/SceneFormat.h"
+#include "Scene/SceneLoader.h"
+#include "Scene/SceneNodeData.h"
+#include "Scene/SoftwareOcclusion.h"
+#include "Scene/TransformStore.h"
+#include "Utility/Pool.h"
+
+#include <functional>
 
 class FrustumVolume;
 class DescriptorHeap;
+class ScenePackage;
+class CompiledScene;
 class Texture;
 
+// Vertex buffer bytes bound by the draws, accumulated over the frames since the last reset.
+// Every vertex of a bound buffer is assumed to be fetched once per draw
+struct VertexFetchStatistics
+{
+    uint64_t frameCount = 0;
+    uint64_t fetchedBytes = 0;          // With the position streams in the depth only passes
+    uint64_t interleavedBytes = 0;      // The same draws with the full vertices bound
+};
+
+// Global transform work since the last reset
+struct TransformStatistics
+{
+    uint64_t frameCount = 0;
+    uint64_t updatedCount = 0;              // Global transforms recomputed by UpdateTransforms
+    uint64_t movedCount = 0;                // Node AABBs refitted in the BVH
+    uint64_t dynamicMovedCount = 0;         // Node AABBs moved in the loose octree
+    double updateMilliseconds = 0.0;
+    double boundsMilliseconds = 0.0;        // Part of the update spent on the node AABBs
+};
+
+// CPU time of the culling and the main pass draws since the last reset
+struct TraversalStatistics
+{
+    uint64_t frameCount = 0;
+    uint64_t visitedCount = 0;              // Bounds tested against the frustum, BVH nodes and items
+    uint64_t planeTestCount = 0;            // Frustum planes tested, the planes of the parents the bounds are inside of skipped
+    uint64_t pvsHiddenCount = 0;            // Static nodes skipped outside the baked potentially visible set of the camera cell
+    uint64_t visibleCount = 0;              // Nodes in the visible lists
+    uint64_t occluderTriangleCount = 0;     // Triangles rasterized by the software occlusion
+    uint64_t occludedCount = 0;             // Nodes inside the frustums removed by the software occlusion
+    uint64_t queryCount = 0;                // Hardware occlusion queries issued
+    uint64_t queriedNodeCount = 0;          // Boxes drawn inside them
+    uint64_t readbackCount = 0;             // Query results read back by the coherent occlusion
+    uint64_t readbackLatencyFrames = 0;     // Frames from the issue of these queries to their readback, summed
+    uint64_t skippedDrawCount = 0;          // Nodes inside the frustum not drawn after their queries found them hidden
+    uint64_t reprojectedOccludedCount = 0;  // Nodes removed by the reprojected depth of an earlier frame
+    uint64_t reprojectionHoleCount = 0;     // Disoccluded texels of the reprojected depth
+    uint64_t smallCount = 0;                // Nodes inside the frustums too small on the screen to draw
+    uint64_t smallTriangleCount = 0;        // Triangles of the LODs they would have been drawn with
+    uint64_t drawnCount = 0;
+    uint64_t rebuildCount = 0;              // BVH rebuilds after the refits degraded it
+    uint64_t multiViewCount = 0;            // Views culled together by CullViews
+    double cullMilliseconds = 0.0;
+    double occlusionMilliseconds = 0.0;     // Part of the culling spent on the software occlusion
+    double reprojectionMilliseconds = 0.0;  // Part of the culling spent on the reprojected depth
+    double traversalMilliseconds = 0.0;
+    double multiViewCullMilliseconds = 0.0;
+};
+
+// A node inside the frustum of a view, with the LOD selected for it
+struct VisibleNode
+{
+    PoolHandle handle;
+    uint32_t sortKey;                   // Bits of the distance to the camera, which order as integers
+    uint16_t lod;
+    uint16_t flags;                     // SceneNodeFlags when the node was culled
+};
+
+// A node inside the frustum of at least one of the views culled together, bit v for the view v
+struct MultiViewNode
+{
+    PoolHandle handle;
+    uint32_t viewMask;
+};
+
+// The nodes a view sees in a frame, front to back. Culled once by Scene::CullView for all the passes of the view
+struct VisibleList
+{
+    std::vector<VisibleNode> nodes;
+    // The hardware occlusion queries of the frame, every query over consecutive query nodes
+    std::vector<PoolHandle> queryNodes;
+    std::vector<OcclusionBatch> queries;
+};
+
+enum class OcclusionMode
+{
+    Predicated,                         // Every occludee queried every frame, its draw predicated on the result of the frame
+    Coherent,                           // The results read back frames later, see CoherentOcclusion
+    Reprojected,                        // No queries, the depth of an earlier frame is read back, see ReprojectedOcclusion
+};
+
+// A node, material or mesh referenced by the scene: a file in the scene directory or a scene package entry
+struct AssetReference
+{
+    std::string name;                                       // File path or entry name, keys the mesh registry
+    uint32_t packageEntry = SceneFormat::INVALID_INDEX;
+};
+
 class Scene
 {
 public:
+    // The screen size of a node without its own, the one of the scene is used
+    static constexpr float SCENE_SCREEN_SIZE = -1.0f;
+
     Scene();
     ~Scene();
 
-    void RunOcclusion(Core::GraphicsCommandList& commandList, const FrustumVolume& frustum);
-    void Draw(Core::GraphicsCommandList& commandList, const Camera& camera);
-    void DrawOccluders(Core::GraphicsCommandList& commandList, const Camera& camera);
-    void DrawOccludees(Core::GraphicsCommandList& commandList, const Camera& camera);
+    // Reads back the occlusion results or the depth of the last frame with the index, once the GPU
+    // completed it. Once per frame before CullView
+    void BeginFrame(uint32_t frameIndex);
+
+    // The resident nodes inside the frustum of the camera with their LODs, once per view per frame
+    // after UpdateTransforms and before the passes are recorded. With the potentially visible sets
+    // baked, the static nodes the cell of the camera can't see are skipped before any frustum test
+    // and the BVH subtrees of only such nodes are not traversed. Large scenes are culled in chunks
+    // on worker threads. The nodes projecting smaller than their screen size are culled in the same
+    // batches, the size is raised for the nodes culled so until they are seen again, for a single
+    // view. The occluders are then rasterized on the CPU and the nodes they hide removed. In the
+    // coherent occlusion mode the nodes the last query results found hidden are removed too, for a
+    // single view culled once per frame
+    void CullView(const Camera& camera, VisibleList& visibleList);
+
+    // The resident nodes inside the frusta of up to MultiFrustumCuller::MAX_VIEW_COUNT cameras, for the views
+    // rendered together such as shadow cascades or split screen. The scene is traversed once for all of them
+    // and every node listed once with the views it is in. The visible lists, one per camera if any, get the
+    // nodes of every view with the LODs for its camera, front to back. The potentially visible sets, the
+    // occlusion and the screen size culling are for the main view of CullView
+    void CullViews(std::span<const Camera* const> cameras, std::vector<MultiViewNode>& nodes, std::span<VisibleList> visibleLists = {});
+
+    void RunOcclusion(Core::GraphicsCommandList& commandList, const VisibleList& visibleList);
+    // For the reprojected occlusion mode, with the depth downsample pipeline set after the passes of the frame
+    void DownsampleDepth(Core::GraphicsCommandList& commandList, Core::Resource& depthTexture, const DirectX::XMMATRIX& viewProjection);
+    void Draw(Core::GraphicsCommandList& commandList, const VisibleList& visibleList);
+    void DrawOccluders(Core::GraphicsCommandList& commandList, const VisibleList& visibleList);
+    void DrawOccludees(Core::GraphicsCommandList& commandList, const VisibleList& visibleList);
     void DrawAABB(Core::GraphicsCommandList& commandList);
 
-    bool LoadScene(const std::string& filepath, Core::GraphicsCommandList& commandList);
+    // Loads a cooked .scene file with its directory, a compiled .scenebin file or a .scenepak package.
+    // Only the hierarchy is built here, the meshes and textures are streamed by UpdateLoading
+    bool LoadScene(const std::string& filepath);
+    // Called once per frame, the nodes are drawn as soon as their data is resident
+    void UpdateLoading();
+    const SceneLoadProgress& GetLoadProgress() const;
+
+    // Recomputes the global transforms of the nodes moved since the last call, once per frame before the passes
+    void UpdateTransforms();
+
+    void SetOcclusionMode(OcclusionMode mode);
+    OcclusionMode GetOcclusionMode() const;
+    // The projected diameter in pixels below which the nodes are not drawn, unless their own is set. 0 draws them all
+    void SetMinScreenSize(float pixels);
+    float GetMinScreenSize() const;
+
+    const VertexFetchStatistics& GetVertexFetchStatistics() const;
+    void ResetVertexFetchStatistics();
+    const TransformStatistics& GetTransformStatistics() const;
+    void ResetTransformStatistics();
+    const TraversalStatistics& GetTraversalStatistics() const;
+    void ResetTraversalStatistics();
 
     friend class ISceneNode;
     friend class SceneNode;
+    friend class SceneLoader;
 
 private:
+    // The nodes of a culling task: a BVH subtree, or the loose octree after the subtrees
+    struct CullChunk
+    {
+        std::vector<uint32_t> items;
+        std::vector<VisibleNode> nodes;
+        FrustumTestCount testCount;
+        // The nodes inside the frustum too small to draw, with the triangles they would have been drawn with
+        std::vector<uint32_t> smallItems;
+        std::vector<uint32_t> smallNodes;
+        uint64_t smallTriangleCount;
+        // Of CullViews, the view masks of the items and the octree items of every view
+        std::vector<uint32_t> viewMasks;
+        std::vector<uint64_t> viewItems;
+        std::vector<MultiViewNode> viewNodes;
+    };
+
+    // The visible nodes matching the flags under the mask
+    void _DrawNodes(Core::GraphicsCommandList& commandList, const VisibleList& visibleList, uint16_t flagMask, uint16_t flags);
+
+    SceneNode* _CreateNode(SceneNode* parent);
+    SceneNodeData& _GetNodeData(PoolHandle handle);
+
+    // Over the world AABBs of the static nodes with meshes
+    void _BuildBVH();
+    // Moves the AABBs of the nodes whose transforms the last update changed, in the BVH or,
+    // for the nodes moving often, in the loose octree
+    void _UpdateBounds();
+    // Expands the potentially visible set of the cell of the camera into the BVH once it enters another cell
+    void _UpdateVisibleSet(DirectX::FXMVECTOR position);
+    // The screen size of the node slot, raised while the node is too small to draw
+    float _GetMinScreenSize(uint32_t node) const;
+    // Moves the nodes culled as too small the last frame and this one in and out of the raised screen size
+    void _UpdateSmallNodes(uint32_t chunkCount);
+    // Splits the BVH into the subtrees of the chunks, and culls every chunk on worker threads for the large
+    // scenes. The number of chunks
+    uint32_t _CullChunks(const std::function<void(uint32_t)>& cullChunk);
+    // Called from the culling workers, every chunk by a single worker
+    void _CullChunk(const FrustumCuller& culler, const FrustumVolume& frustum, DirectX::FXMVECTOR position, uint32_t chunk, CullChunk& result) const;
+    void _CullViewsChunk(const MultiFrustumCuller& culler, std::span<const Camera* const> cameras, uint32_t chunk, CullChunk& result) const;
+    // Removes the occludees behind the visible occluders of the list
+    void _CullOccluded(const Camera& camera, VisibleList& visibleList);
+    // Removes the occludees behind the reprojected depth in the reprojected occlusion mode
+    void _CullReprojected(const Camera& camera, VisibleList& visibleList);
+    // Removes the occludees the test finds hidden, on worker threads for long lists. The number removed
+    size_t _RemoveOccluded(VisibleList& visibleList, const std::function<bool(const SceneNodeData&)>& isVisible);
+    // The hardware occlusion queries of the list, and in the coherent mode removes the nodes found hidden
+    void _UpdateQueries(VisibleList& visibleList);
+
     void _UploadTexture(Core::Texture* texture, Core::GraphicsCommandList& commandList);
 
+    bool _LoadJsonScene(const Json::Value& root);
+    bool _LoadCompiledScene(std::span<const uint8_t> data, const std::string& filepath);
+
+    // The JSON files reference nodes, materials and meshes by file name in the scene directory,
+    // the package JSON entries by entry index
+    AssetReference _Resolve(const Json::Value& reference) const;
+    AssetReference _Resolve(const CompiledScene& compiledScene, const SceneFormat::MeshReference& reference) const;
+    Json::Value _ReadJson(const AssetReference& reference);
+    // Called from the loader workers, each mesh by a single worker
+    void _LoadMesh(Mesh& mesh, const AssetReference& reference);
+
     static FbxManager* _FBXManager;
     FbxScene* _scene;
 
-    std::vector<std::shared_ptr<ISceneNode>> _rootNodes;
+    Pool<SceneNode> _nodes;
+    std::vector<SceneNodeData> _nodeData;
+
+    BVH _bvh;
+    // The cooked AABBs in the space of the nodes, by node slot, for the refits of the moved nodes
+    std::vector<BVH::Bounds> _localBounds;
+    // Node slot of every transform
+    std::vector<uint32_t> _transformNodes;
+    LooseOctree _octree;
+    // Moves of every static node since the last BVH build
+    std::vector<uint8_t> _moveCounts;
+
+    PotentiallyVisibleSet _pvs;
+    // Of the last culled camera, the set is expanded again once it changes or the dirty flag is set
+    uint32_t _pvsCell;
+    bool _isPvsDirty;
+    // By node slot
+    std::vector<uint8_t> _isPotentiallyVisible;
+    size_t _pvsHiddenCount;
+
+    // Kept across the frames for their allocations
+    std::vector<uint32_t> _cullSubtrees;
+    std::vector<CullChunk> _cullChunks;
+    SoftwareOcclusion _softwareOcclusion;
+    std::vector<uint8_t> _isOccluded;
+
+    float _minScreenSize;
+    // By node slot, SCENE_SCREEN_SIZE for the nodes without their own
+    std::vector<float> _screenSizes;
+    // By node slot, the nodes culled as too small the last frame
+    std::vector<uint8_t> _isSmall;
+    std::vector<uint32_t> _smallNodes;
 
     std::shared_ptr<Core::ResourceTable> _texturesTable;
     Core::OcclusionQuery _occlusionQuery;
+    CoherentOcclusion _coherentOcclusion;
+    OcclusionMode _occlusionMode;
+    uint32_t _frameIndex;
+    // Kept across the frames for their allocations
+    std::vector<OcclusionCandidate> _occlusionCandidates;
+    std::vector<PoolHandle> _candidateNodes;
+    std::vector<uint8_t> _isDrawn;
+    std::vector<uint32_t> _queryCandidates;
+    Core::DepthReadback _depthReadback;
+    ReprojectedOcclusion _reprojectedOcclusion;
+    // The last depth read back, with the matrix it was rendered with
+    std::vector<float> _readbackDepth;
+    DirectX::XMFLOAT4X4 _readbackViewProjection;
+    VertexFetchStatistics _vertexFetchStatistics;
+    TransformStatistics _transformStatistics;
+    TraversalStatistics _traversalStatistics;
+
+    TransformStore _transforms;
+
+    // Mapped for the whole lifetime of the scene if it was loaded from a package
+    std::shared_ptr<ScenePackage> _package;
 
     std::string _name;
+
+    // Last, so the workers are stopped and the copies completed before anything else is released
+    std::unique_ptr<SceneLoader> _loader;
 };
 
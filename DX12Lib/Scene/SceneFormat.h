@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary layout of the compiled .scenebin files, the whole node hierarchy of a scene in
+// flat arrays. Compiled by FBXParser from the JSON .scene/.node/.mat files, which stay
+// the interchange and debug format, and read by Scene::LoadScene in one linear pass.
+//
+// File layout:
+//     Header
+//     Node[Header::nodeCount]             depth first order, parents before their children
+//     LOD[Header::lodCount]               Node::firstLOD..firstLOD + lodCount - 1 of each node
+//     MeshReference[Header::meshCount]
+//     Material[Header::materialCount]
+//     strings                             zero terminated, referenced by offset
+//     VisibilityCell[cells along x * y * z]   x fastest, since version 3
+//     pvs                                 the potentially visible sets the cells reference
+//
+// Every block is DATA_ALIGNMENT aligned. Mesh files are referenced by name, relative to
+// the scene directory. Inside a scene package the references also carry the TOC index
+// of the mesh entry (see ScenePackFormat.h).
+//
+// The baked potentially visible sets are optional. The cook splits the bounds of the nodes
+// with meshes into a grid of cells and stores for every cell the nodes seen from anywhere in
+// it, a bit per node in the node order. The bitsets are run length encoded as runs of a byte
+// counting the zero bytes skipped, a byte counting the literal bytes after it, and the
+// literals, until (nodeCount + 7) / 8 bytes are written. The cells with equal sets share them.
+
+namespace SceneFormat
+{
+    constexpr uint32_t MAGIC = 0x424E4353; // "SCNB"
+    constexpr uint16_t VERSION = 3;
+    constexpr uint32_t DATA_ALIGNMENT = 16;
+
+    constexpr uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+    enum NodeFlags : uint32_t
+    {
+        NODE_FLAG_NONE = 0,
+        NODE_FLAG_OCCLUDER = 1 << 0,
+        NODE_FLAG_QUANTIZED = 1 << 1,  // The meshes use the packed layout, see Node::quantization
+        NODE_FLAG_MIN_SCREEN_SIZE = 1 << 2, // The node has its own Node::minScreenSize rather than the one of the scene
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t headerSize;
+        uint32_t nodeCount;
+        uint32_t lodCount;
+        uint32_t meshCount;
+        uint32_t materialCount;
+        uint32_t stringsSize;
+        uint32_t nameOffset;        // Scene name
+        uint64_t nodesOffset;
+        uint64_t lodsOffset;
+        uint64_t meshesOffset;
+        uint64_t materialsOffset;
+        uint64_t stringsOffset;
+        float cellOrigin[3];        // Minimum corner of the visibility grid
+        float cellSize[3];
+        uint32_t cellCounts[3];     // Visibility cells along x, y and z, 0 without the baked PVS, since version 3
+        uint32_t pvsSize;           // Bytes of the encoded sets
+        uint64_t cellsOffset;
+        uint64_t pvsOffset;
+    };
+
+    struct Node
+    {
+        uint32_t parent;            // INVALID_INDEX for the root nodes
+        uint32_t nameOffset;
+        float transform[4][4];      // Local transform, rows
+        float aabbMin[4];
+        float aabbMax[4];
+        float quantizationOffset[4];
+        float quantizationScale[4];
+        uint32_t firstLOD;
+        uint32_t lodCount;
+        uint32_t material;          // INVALID_INDEX if the node has no material
+        uint32_t flags;             // NodeFlags
+        float minScreenSize;        // Projected diameter in pixels below which the node is not drawn, since version 2
+    };
+
+    struct LOD
+    {
+        uint32_t mesh;              // Into the mesh references
+        float error;                // Simplification error of the LOD, 0 for the source mesh
+    };
+
+    struct MeshReference
+    {
+        uint32_t nameOffset;        // File name in the scene directory
+        uint32_t packageEntry;      // TOC index in the scene package, INVALID_INDEX outside of packages
+    };
+
+    struct Material
+    {
+        uint32_t diffuseOffset;     // Diffuse texture path, empty if the material has no texture
+        uint32_t reserved;
+    };
+
+    struct VisibilityCell
+    {
+        uint32_t pvsOffset;         // Into the encoded sets
+        uint32_t visibleCount;      // Nodes set in the bitset
+    };
+
+    static_assert(sizeof(Header) == 128, "SceneFormat::Header layout changed");
+    static_assert(sizeof(Node) == 156, "SceneFormat::Node layout changed");
+    static_assert(sizeof(LOD) == 8, "SceneFormat::LOD layout changed");
+    static_assert(sizeof(MeshReference) == 8, "SceneFormat::MeshReference layout changed");
+    static_assert(sizeof(Material) == 8, "SceneFormat::Material layout changed");
+    static_assert(sizeof(VisibilityCell) == 8, "SceneFormat::VisibilityCell layout changed");
+
+    inline uint64_t AlignOffset(uint64_t offset)
+    {
+        return (offset + DATA_ALIGNMENT - 1) & ~static_cast<uint64_t>(DATA_ALIGNMENT - 1);
+    }
+}
@@ -0,0 +1,399 @@
+#include "stdafx.h"
+
+#include "SceneLoader.h"
+
+#include "DXObjects/GraphicsCommandList.h"
+#include "DXObjects/Texture.h"
+#include "Scene/Scene.h"
+#include "Scene/SceneNode.h"
+
+#include <filesystem>
+
+namespace
+{
+    // Copy batches in flight on the copy queue
+    constexpr size_t BATCH_COUNT = 3;
+    // Vertex and index bytes recorded into one batch, a larger mesh gets a batch of its own
+    constexpr uint64_t BATCH_BUDGET = 16ull * 1024 * 1024;
+    constexpr size_t TEXTURES_PER_BATCH = 4;
+    constexpr unsigned int MAX_WORKER_COUNT = 4;
+}
+
+SceneLoader::SceneLoader(Scene* scene)
+    : _scene(scene)
+    , _DXDevice(Core::Device::GetDXDevice())
+    , _copyQueue(Core::Device::GetCopyQueue())
+    , _fenceValue(0)
+    , _batches(BATCH_COUNT)
+    , _nextJob(0)
+    , _isStopping(false)
+{
+    _fence.Init();
+
+    for (UploadBatch& batch : _batches)
+    {
+        batch.executor.Allocate(D3D12_COMMAND_LIST_TYPE_COPY);
+    }
+}
+
+SceneLoader::~SceneLoader()
+{
+    _isStopping = true;
+    for (std::thread& worker : _workers)
+    {
+        worker.join();
+    }
+
+    // The intermediate buffers must outlive the copies
+    _fence.SetValue(_fenceValue);
+    _fence.Wait();
+
+    _copyQueue = nullptr;
+    _DXDevice = nullptr;
+}
+
+void SceneLoader::AddNode(SceneNode* node)
+{
+    ++_progress.nodeCount;
+
+    // Nothing to stream, e.g. a node grouping its children
+    if (node->_pendingUploads == 0)
+    {
+        _MakeResident(node);
+    }
+}
+
+std::shared_ptr<const MeshBuffers> SceneLoader::RequestMesh(const AssetReference& reference, SceneNode* node)
+{
+    auto [it, isInserted] = _meshIndices.try_emplace(reference.name, _meshes.size());
+    if (isInserted)
+    {
+        MeshRequest request;
+        request.buffers = std::make_shared<MeshBuffers>();
+        request.name = reference.name;
+        request.packageEntry = reference.packageEntry;
+        _meshes.push_back(std::move(request));
+
+        _jobs.push_back({ JobType::Mesh, it->second });
+        ++_progress.uploadCount;
+    }
+
+    MeshRequest& request = _meshes[it->second];
+    request.nodes.push_back(node);
+    ++node->_pendingUploads;
+
+    return request.buffers;
+}
+
+void SceneLoader::RequestTexture(const std::string& filepath, SceneNode* node)
+{
+    auto [it, isInserted] = _textureIndices.try_emplace(filepath, _textures.size());
+    if (isInserted)
+    {
+        _textures.push_back({ filepath });
+
+        _jobs.push_back({ JobType::Texture, it->second });
+        ++_progress.uploadCount;
+    }
+
+    _textures[it->second].nodes.push_back(node);
+    ++node->_pendingUploads;
+}
+
+void SceneLoader::Start()
+{
+    _clock.Tick();
+    _progress.hierarchyMilliseconds = _clock.GetTotalMilliSeconds();
+
+    size_t meshReferenceCount = 0;
+    for (const MeshRequest& request : _meshes)
+    {
+        meshReferenceCount += request.nodes.size();
+    }
+
+    unsigned int workerCount = std::clamp(std::thread::hardware_concurrency(), 2u, MAX_WORKER_COUNT + 1) - 1;
+    workerCount = std::min(workerCount, static_cast<unsigned int>(std::max<size_t>(_jobs.size(), 1)));
+    for (unsigned int i = 0; i < workerCount; ++i)
+    {
+        _workers.emplace_back(&SceneLoader::_RunWorker, this);
+    }
+
+    Logger::Log(LogType::Info, "Streaming " + std::to_string(_progress.nodeCount) + " nodes: " + std::to_string(_meshes.size()) + " meshes shared by "
+        + std::to_string(meshReferenceCount) + " LODs, " + std::to_string(_textures.size()) + " textures, " + std::to_string(workerCount) + " workers");
+}
+
+void SceneLoader::Update()
+{
+    const UINT64 completedValue = _fence.GetFence()->GetCompletedValue();
+    for (UploadBatch& batch : _batches)
+    {
+        if (batch.isInFlight && batch.fenceValue <= completedValue)
+        {
+            _Retire(batch);
+        }
+    }
+
+    if (_progress.IsFinished() && _progress.residentMilliseconds == 0.0)
+    {
+        _clock.Tick();
+        _progress.residentMilliseconds = _clock.GetTotalMilliSeconds();
+
+        Logger::Log(LogType::Info, "Scene resident in " + std::to_string(_progress.residentMilliseconds) + " ms, first node in "
+            + std::to_string(_progress.firstResidentMilliseconds) + " ms, " + std::to_string(_progress.uploadedBytes) + " bytes uploaded");
+    }
+
+    // One batch per frame, so the uploads don't stall the frame that records them
+    for (UploadBatch& batch : _batches)
+    {
+        if (!batch.isInFlight)
+        {
+            _Submit(batch);
+            break;
+        }
+    }
+}
+
+const SceneLoadProgress& SceneLoader::GetProgress() const
+{
+    return _progress;
+}
+
+void SceneLoader::_RunWorker()
+{
+    // WIC decodes the textures through COM
+    HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    for (size_t index = _nextJob++; index < _jobs.size() && !_isStopping; index = _nextJob++)
+    {
+        const Job& job = _jobs[index];
+        if (job.type == JobType::Mesh)
+        {
+            MeshRequest& request = _meshes[job.index];
+            request.mesh = std::make_shared<Mesh>();
+            _scene->_LoadMesh(*request.mesh, { request.name, request.packageEntry });
+        }
+        else
+        {
+            TextureRequest& request = _textures[job.index];
+            request.texture = Core::Texture::LoadFromFile(request.filepath);
+        }
+
+        std::lock_guard<std::mutex> lock(_decodedMutex);
+        _decoded.push_back(job);
+    }
+
+    if (SUCCEEDED(comResult))
+    {
+        CoUninitialize();
+    }
+}
+
+void SceneLoader::_Retire(UploadBatch& batch)
+{
+    for (size_t index : batch.meshes)
+    {
+        ++_progress.residentUploadCount;
+        for (SceneNode* node : _meshes[index].nodes)
+        {
+            _CompleteNode(node);
+        }
+    }
+
+    for (size_t index : batch.textures)
+    {
+        ++_progress.residentUploadCount;
+        for (SceneNode* node : _textures[index].nodes)
+        {
+            node->_texture = _textures[index].texture;
+            _CompleteNode(node);
+        }
+    }
+
+    batch.meshes.clear();
+    batch.textures.clear();
+    batch.intermediates.clear();
+    batch.isInFlight = false;
+}
+
+void SceneLoader::_Submit(UploadBatch& batch)
+{
+    std::vector<Job> jobs;
+    {
+        std::lock_guard<std::mutex> lock(_decodedMutex);
+
+        // Oldest first, the decoded jobs of the next batches stay queued
+        uint64_t bytes = 0;
+        size_t textureCount = 0;
+        size_t count = 0;
+        for (; count < _decoded.size() && bytes < BATCH_BUDGET; ++count)
+        {
+            const Job& job = _decoded[count];
+            if (job.type == JobType::Mesh)
+            {
+                const Mesh& mesh = *_meshes[job.index].mesh;
+                bytes += mesh.GetVertexCount() * mesh.GetPositionStride() * 2 + mesh.GetIndexCount() * mesh.GetIndexStride();
+            }
+            else if (++textureCount > TEXTURES_PER_BATCH)
+            {
+                break;
+            }
+        }
+
+        jobs.assign(_decoded.begin(), _decoded.begin() + count);
+        _decoded.erase(_decoded.begin(), _decoded.begin() + count);
+    }
+
+    if (jobs.empty())
+    {
+        return;
+    }
+
+    batch.executor.Reset();
+    Core::GraphicsCommandList& commandList = *batch.executor.GetCommandList();
+
+    for (const Job& job : jobs)
+    {
+        if (job.type == JobType::Mesh)
+        {
+            _UploadMesh(_meshes[job.index], batch);
+            batch.meshes.push_back(job.index);
+        }
+        else
+        {
+            if (std::shared_ptr<Core::Texture> texture = _textures[job.index].texture)
+            {
+                _scene->_UploadTexture(texture.get(), commandList);
+            }
+            batch.textures.push_back(job.index);
+        }
+    }
+
+    commandList.Close();
+
+    ID3D12CommandList* commandLists[] = { commandList.GetDXCommandList().Get() };
+    _copyQueue->ExecuteCommandLists(1, commandLists);
+    _copyQueue->Signal(_fence.GetFence().Get(), ++_fenceValue);
+
+    batch.fenceValue = _fenceValue;
+    batch.isInFlight = true;
+}
+
+void SceneLoader::_UploadMesh(MeshRequest& request, UploadBatch& batch)
+{
+    MeshBuffers& buffers = *request.buffers;
+    buffers.mesh = std::move(request.mesh);
+
+    const Mesh& mesh = *buffers.mesh;
+    const std::string name = std::filesystem::path(request.name).stem().string();
+
+    bool isPacked = mesh.GetVertexLayout() == MeshFormat::VertexLayout::Packed;
+    size_t vertexStride = isPacked ? sizeof(MeshFormat::PackedVertex) : sizeof(VertexData);
+    const void* vertexData = isPacked ? static_cast<const void*>(mesh.GetPackedVertices().data()) : mesh.GetVertices().data();
+
+    buffers.vertexBuffer = _UploadBuffer(batch, vertexData, mesh.GetVertexCount() * vertexStride, name + "_VB");
+
+    buffers.VBO = D3D12_VERTEX_BUFFER_VIEW();
+    buffers.VBO.BufferLocation = buffers.vertexBuffer ? buffers.vertexBuffer->OffsetGPU(0) : 0;
+    buffers.VBO.SizeInBytes = static_cast<UINT>(mesh.GetVertexCount() * vertexStride);
+    buffers.VBO.StrideInBytes = static_cast<UINT>(vertexStride);
+
+    buffers.colorVBO = D3D12_VERTEX_BUFFER_VIEW();
+    if (isPacked)
+    {
+        // Uniform color is a single element read by every vertex
+        std::span<const uint32_t> colors = mesh.GetColors();
+        uint32_t uniformColor = mesh.GetUniformColor();
+        bool isUniform = colors.empty();
+
+        size_t colorBytes = (isUniform ? 1 : colors.size()) * sizeof(uint32_t);
+        buffers.colorBuffer = _UploadBuffer(batch, isUniform ? &uniformColor : colors.data(), colorBytes, name + "_ColorVB");
+
+        buffers.colorVBO.BufferLocation = buffers.colorBuffer->OffsetGPU(0);
+        buffers.colorVBO.SizeInBytes = static_cast<UINT>(colorBytes);
+        buffers.colorVBO.StrideInBytes = isUniform ? 0 : sizeof(uint32_t);
+    }
+
+    std::span<const uint8_t> positions = mesh.GetPositions();
+    buffers.positionBuffer = _UploadBuffer(batch, positions.data(), positions.size(), name + "_PositionVB");
+
+    buffers.positionVBO = D3D12_VERTEX_BUFFER_VIEW();
+    buffers.positionVBO.BufferLocation = buffers.positionBuffer ? buffers.positionBuffer->OffsetGPU(0) : 0;
+    buffers.positionVBO.SizeInBytes = static_cast<UINT>(positions.size());
+    buffers.positionVBO.StrideInBytes = mesh.GetPositionStride();
+
+    size_t indexBytes = mesh.GetIndexCount() * mesh.GetIndexStride();
+    buffers.indexBuffer = _UploadBuffer(batch, mesh.GetIndexData(), indexBytes, name + "_IB");
+
+    buffers.IBO = D3D12_INDEX_BUFFER_VIEW();
+    buffers.IBO.BufferLocation = buffers.indexBuffer ? buffers.indexBuffer->OffsetGPU(0) : 0;
+    buffers.IBO.Format = mesh.GetIndexFormat();
+    buffers.IBO.SizeInBytes = static_cast<UINT>(indexBytes);
+}
+
+std::shared_ptr<Core::Resource> SceneLoader::_UploadBuffer(UploadBatch& batch, const void* data, size_t size, const std::string& name)
+{
+    // A mesh that failed to load has no data
+    if (size == 0)
+    {
+        return nullptr;
+    }
+
+    CD3DX12_HEAP_PROPERTIES heapTypeDefault(D3D12_HEAP_TYPE_DEFAULT);
+    CD3DX12_HEAP_PROPERTIES heapTypeUpload(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+    ComPtr<ID3D12Resource> destinationResource;
+    Helper::throwIfFailed(_DXDevice->CreateCommittedResource(
+        &heapTypeDefault,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&destinationResource)));
+
+    ComPtr<ID3D12Resource> intermediateResource;
+    Helper::throwIfFailed(_DXDevice->CreateCommittedResource(
+        &heapTypeUpload,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&intermediateResource)));
+    batch.intermediates.push_back(intermediateResource);
+
+    D3D12_SUBRESOURCE_DATA subresourceData = {};
+    subresourceData.pData = data;
+    subresourceData.RowPitch = size;
+    subresourceData.SlicePitch = subresourceData.RowPitch;
+
+    UpdateSubresources(batch.executor.GetCommandList()->GetDXCommandList().Get(),
+        destinationResource.Get(), intermediateResource.Get(),
+        0, 0, 1, &subresourceData);
+
+    _progress.uploadedBytes += size;
+
+    std::shared_ptr<Core::Resource> resource = std::make_shared<Core::Resource>();
+    resource->InitFromDXResource(destinationResource);
+    resource->SetName(name);
+
+    return resource;
+}
+
+void SceneLoader::_CompleteNode(SceneNode* node)
+{
+    if (--node->_pendingUploads == 0)
+    {
+        _MakeResident(node);
+    }
+}
+
+void SceneLoader::_MakeResident(SceneNode* node)
+{
+    _scene->_GetNodeData(node->_handle).flags |= SCENE_NODE_RESIDENT;
+
+    if (_progress.residentNodeCount++ == 0)
+    {
+        _clock.Tick();
+        _progress.firstResidentMilliseconds = _clock.GetTotalMilliSeconds();
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "DXObjects/Fence.h"
+#include "Render/Executor.h"
+#include "Utility/HighResolutionClock.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+class Mesh;
+class Scene;
+class SceneNode;
+struct AssetReference;
+struct MeshBuffers;
+
+namespace Core
+{
+    class Texture;
+} // namespace Core
+
+struct SceneLoadProgress
+{
+    size_t nodeCount = 0;
+    size_t residentNodeCount = 0;
+    // Meshes and textures
+    size_t uploadCount = 0;
+    size_t residentUploadCount = 0;
+    uint64_t uploadedBytes = 0;
+
+    // Since the start of Scene::LoadScene
+    double hierarchyMilliseconds = 0.0;         // The hierarchy is built, frames can be rendered
+    double firstResidentMilliseconds = 0.0;     // The first node is drawable
+    double residentMilliseconds = 0.0;          // Everything is drawable, 0 while loading
+
+    bool IsFinished() const
+    {
+        return residentUploadCount == uploadCount;
+    }
+};
+
+// Streams the GPU data of a scene while it is rendered. The hierarchy is built first and
+// every node requests its meshes and texture. The files are read and decoded
+// on worker threads, Update records the decoded data into copy command lists that run on
+// the copy queue. A node becomes resident, i.e. drawable, once all its uploads completed
+class SceneLoader
+{
+public:
+    explicit SceneLoader(Scene* scene);
+    ~SceneLoader();
+
+    SceneLoader(const SceneLoader& copy) = delete;
+    SceneLoader& operator=(const SceneLoader& copy) = delete;
+
+    // Requests made while the hierarchy is built, before Start. A node is added after its requests
+    void AddNode(SceneNode* node);
+    // The buffers are shared by all the nodes that request the same mesh and stay empty until resident
+    std::shared_ptr<const MeshBuffers> RequestMesh(const AssetReference& reference, SceneNode* node);
+    void RequestTexture(const std::string& filepath, SceneNode* node);
+
+    // Starts the worker threads once the hierarchy is built
+    void Start();
+    // Retires the finished uploads and submits the next batch, called once per frame
+    void Update();
+
+    const SceneLoadProgress& GetProgress() const;
+
+private:
+    struct MeshRequest
+    {
+        std::shared_ptr<MeshBuffers> buffers;
+        std::string name;
+        uint32_t packageEntry;
+        std::vector<SceneNode*> nodes;
+        // Written by a worker before the request is queued as decoded
+        std::shared_ptr<Mesh> mesh;
+    };
+
+    struct TextureRequest
+    {
+        std::string filepath;
+        std::vector<SceneNode*> nodes;
+        std::shared_ptr<Core::Texture> texture;
+    };
+
+    enum class JobType
+    {
+        Mesh,
+        Texture,
+    };
+
+    struct Job
+    {
+        JobType type;
+        size_t index;
+    };
+
+    struct UploadBatch
+    {
+        Executor executor;
+        UINT64 fenceValue = 0;
+        bool isInFlight = false;
+
+        std::vector<size_t> meshes;
+        std::vector<size_t> textures;
+        // Released once the copies completed
+        std::vector<ComPtr<ID3D12Resource>> intermediates;
+    };
+
+    void _RunWorker();
+    void _Retire(UploadBatch& batch);
+    void _Submit(UploadBatch& batch);
+
+    void _UploadMesh(MeshRequest& request, UploadBatch& batch);
+    std::shared_ptr<Core::Resource> _UploadBuffer(UploadBatch& batch, const void* data, size_t size, const std::string& name);
+
+    void _CompleteNode(SceneNode* node);
+    void _MakeResident(SceneNode* node);
+
+    Scene* _scene;
+    ComPtr<ID3D12Device2> _DXDevice;
+    ID3D12CommandQueue* _copyQueue;
+
+    Core::Fence _fence;
+    UINT64 _fenceValue;
+    std::vector<UploadBatch> _batches;
+
+    std::vector<MeshRequest> _meshes;
+    std::vector<TextureRequest> _textures;
+    std::unordered_map<std::string, size_t> _meshIndices;
+    std::unordered_map<std::string, size_t> _textureIndices;
+
+    // Fixed once the workers started, taken in request order so the nodes near the root come first
+    std::vector<Job> _jobs;
+    std::atomic<size_t> _nextJob;
+    std::atomic<bool> _isStopping;
+    std::vector<std::thread> _workers;
+
+    std::mutex _decodedMutex;
+    std::vector<Job> _decoded;
+
+    HighResolutionClock _clock;
+    SceneLoadProgress _progress;
+};
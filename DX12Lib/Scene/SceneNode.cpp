@@ -5,8 +5,9 @@
 
 #include "DXObjects/Texture.h"
 #include "DXObjects/GraphicsCommandList.h"
-#include "Scene/Camera.h"
+#include "Scene/CompiledScene.h"
 #include "Scene/Scene.h"
+#include "Scene/SceneLoader.h"
 #include "Volumes/FrustumVolume.h"
 
 using namespace DirectX;
@@ -49,355 +50,266 @@ namespace
 
 SceneNode::SceneNode()
     : ISceneNode()
-    , _DXDevice(Core::Device::GetDXDevice())
-    , _mesh(nullptr)
     , _texture(nullptr)
-    , _isOccluder(false)
-    , _vertexBuffer{}
-    , _indexBuffer{}
-    , _modelMatrix(nullptr)
-    , _AABBVertexBuffer(nullptr)
-    , _AABBIndexBuffer(nullptr)
-    , _AABB{}
-    , _AABBVBO{}
-    , _AABBIBO{}
-    , _VBO{}
-    , _IBO{}
+    , _querySlot(Core::OcclusionQuery::INVALID_SLOT)
+    , _pendingUploads(0)
 {
 }
 
 SceneNode::SceneNode(Scene* scene, SceneNode* parent)
     : ISceneNode(scene, parent)
-    , _DXDevice(Core::Device::GetDXDevice())
-    , _mesh(nullptr)
     , _texture(nullptr)
-    , _isOccluder(false)
-    , _vertexBuffer{}
-    , _indexBuffer{}
-    , _modelMatrix(nullptr)
-    , _AABBVertexBuffer(nullptr)
-    , _AABBIndexBuffer(nullptr)
-    , _AABB{}
-    , _AABBVBO{}
-    , _AABBIBO{}
-    , _VBO{}
-    , _IBO{}
+    , _querySlot(Core::OcclusionQuery::INVALID_SLOT)
+    , _pendingUploads(0)
 {   }
 
 SceneNode::~SceneNode()
 {
-    _DXDevice = nullptr;
-
-    for (ComPtr<ID3D12Resource> intermediate : intermediates)
-    {
-        intermediate = nullptr;
-    }
 }
 
-void SceneNode::RunOcclusion(Core::GraphicsCommandList& commandList, const FrustumVolume& frustum) const
+void SceneNode::Draw(Core::GraphicsCommandList& commandList, uint32_t lod) const
 {
-    for (const std::shared_ptr<ISceneNode> node : _childNodes)
-    {
-        node->RunOcclusion(commandList, frustum);
-    }
+    const SceneNodeData& data = _scene->_GetNodeData(_handle);
 
-    if (!_isOccluder)
+    if (_texture)
     {
-        _scene->_occlusionQuery.Run(this, commandList, frustum);
-    }
-}
+        commandList.SetDescriptorHeaps({ _scene->_texturesTable->GetDescriptorHeap().GetDXDescriptorHeap().Get() });
 
-void SceneNode::Draw(Core::GraphicsCommandList& commandList, const Camera& camera) const
-{
-    for (const std::shared_ptr<ISceneNode> node : _childNodes)
+        commandList.SetConstant(1, true);
+        commandList.SetDescriptorTable(4, _scene->_texturesTable->GetResourceGPUHandle(_texture->GetName()));
+    }
+    else
     {
-        node->Draw(commandList, camera);
+        commandList.SetConstant(1, false);
     }
 
-    _DrawCurrentNode(commandList, camera);
-}
+    // The occluders are not tested, they are drawn unconditionally. The coherent occlusion decided on the CPU
+    const bool isPredicated = _scene->_occlusionMode == OcclusionMode::Predicated && !(data.flags & SCENE_NODE_OCCLUDER);
+    _scene->_occlusionQuery.SetPredication(isPredicated ? _querySlot : Core::OcclusionQuery::INVALID_SLOT, commandList);
 
-void SceneNode::DrawOccluders(Core::GraphicsCommandList& commandList, const Camera& camera) const
-{
-    for (const std::shared_ptr<ISceneNode> node : _childNodes)
+    const MeshBuffers& buffers = *_LODs[lod];
+
+    MeshFormat::VertexLayout vertexLayout = buffers.mesh->GetVertexLayout();
+    if (!commandList.SetVertexLayout(vertexLayout))
     {
-        node->DrawOccluders(commandList, camera);
+        return;
     }
 
-    if (_isOccluder)
+    commandList.SetSRV(3, _scene->_transforms.GetModelAddress(data.transformIndex));
+
+    size_t interleavedBytes = buffers.VBO.SizeInBytes;
+    if (vertexLayout == MeshFormat::VertexLayout::Packed)
     {
-        _DrawCurrentNode(commandList, camera);
+        interleavedBytes += buffers.colorVBO.SizeInBytes;
     }
-}
 
-void SceneNode::DrawOccludees(Core::GraphicsCommandList& commandList, const Camera& camera) const
-{
-    for (const std::shared_ptr<ISceneNode> node : _childNodes)
+    commandList.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    if (commandList.IsPositionOnly())
     {
-        node->DrawOccludees(commandList, camera);
+        commandList.SetVertexBuffer(0, buffers.positionVBO);
+        _CountVertexFetch(buffers.positionVBO.SizeInBytes, interleavedBytes);
     }
-
-    if (!_isOccluder)
+    else
     {
-        _DrawCurrentNode(commandList, camera);
+        commandList.SetVertexBuffer(0, buffers.VBO);
+        if (vertexLayout == MeshFormat::VertexLayout::Packed)
+        {
+            commandList.SetVertexBuffer(1, buffers.colorVBO);
+        }
+        _CountVertexFetch(interleavedBytes, interleavedBytes);
     }
+    commandList.SetIndexBuffer(buffers.IBO);
+
+    commandList.DrawIndexed(buffers.mesh->GetIndexCount());
 }
 
 void SceneNode::DrawAABB(Core::GraphicsCommandList& commandList) const
 {
-    for (const std::shared_ptr<ISceneNode> node : _childNodes)
-    {
-        node->DrawAABB(commandList);
-    }
-
-    if (_LODs.empty())
-    {
-        return;
-    }
+    const SceneNodeData& data = _scene->_GetNodeData(_handle);
 
     commandList.SetPredication(nullptr, 0, D3D12_PREDICATION_OP_EQUAL_ZERO);
 
     commandList.SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
 
-    commandList.SetConstants(0, 3, &_AABB.min.m128_f32, 0);
-    commandList.SetConstants(0, 3, &_AABB.max.m128_f32, 4);
+    commandList.SetConstants(0, 3, &data.aabbMin, 0);
+    commandList.SetConstants(0, 3, &data.aabbMax, 4);
 
     commandList.Draw(1);
 }
 
-void SceneNode::TestAABB(Core::GraphicsCommandList& commandList) const
+uint32_t SceneNode::SetQueryBox() const
 {
-    XMMATRIX* modelMatrixData = (XMMATRIX*)_modelMatrix->Map();
-    *modelMatrixData = GetGlobalTransform();
-    commandList.SetSRV(3, _modelMatrix->OffsetGPU(0));
+    const SceneNodeData& data = _scene->_GetNodeData(_handle);
 
-    commandList.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList.SetVertexBuffer(0, _AABBVBO);
-    commandList.SetIndexBuffer(_AABBIBO);
+    _scene->_occlusionQuery.SetBox(_querySlot, data.aabbMin, data.aabbMax);
+
+    // The unit cube is shared, every test fetches its box
+    _CountVertexFetch(2 * sizeof(XMFLOAT3), AABBVolume::VERTEX_COUNT * sizeof(VertexData));
 
-    commandList.DrawIndexed(_AABB.mesh->GetIndices().size());
+    return _querySlot;
 }
 
-const AABBVolume& SceneNode::GetAABB() const
+uint32_t SceneNode::GetQuerySlot() const
 {
-    return _AABB;
+    return _querySlot;
+}
+
+size_t SceneNode::GetTriangleCount(uint32_t lod) const
+{
+    if (!IsResident() || lod >= _LODs.size())
+    {
+        return 0;
+    }
+
+    return _LODs[lod]->mesh->GetIndexCount() / 3;
+}
+
+AABBVolume SceneNode::GetAABB() const
+{
+    const SceneNodeData& data = _scene->_GetNodeData(_handle);
+    return AABBVolume(XMLoadFloat3(&data.aabbMin), XMLoadFloat3(&data.aabbMax));
 }
 
 bool SceneNode::IsOccluder() const
 {
-    return _isOccluder;
+    return (_scene->_GetNodeData(_handle).flags & SCENE_NODE_OCCLUDER) != 0;
 }
 
-void SceneNode::LoadNode(const std::string& filepath, Core::GraphicsCommandList& commandList)
+OccluderMesh SceneNode::GetOccluderMesh() const
 {
-    Logger::Log(LogType::Info, "Parsing node " + filepath);
+    OccluderMesh occluderMesh;
+    if (!IsResident() || _LODs.empty())
+    {
+        return occluderMesh;
+    }
+
+    const Mesh& mesh = *_LODs.back()->mesh;
+    occluderMesh.positions = mesh.GetPositions();
+    occluderMesh.positionStride = mesh.GetPositionStride();
+    occluderMesh.isQuantized = mesh.GetVertexLayout() == MeshFormat::VertexLayout::Packed;
+    occluderMesh.indices = mesh.GetIndexData();
+    occluderMesh.indexStride = mesh.GetIndexStride();
+    occluderMesh.indexCount = mesh.GetIndexCount();
 
-    std::ifstream in(filepath, std::ios_base::in | std::ios_base::binary);
-    Json::Value root;
-    in >> root;
+    return occluderMesh;
+}
+
+size_t SceneNode::GetMemoryUsage() const
+{
+    return sizeof(SceneNode) + _name.capacity() + _LODs.capacity() * sizeof(_LODs[0]);
+}
+
+bool SceneNode::IsResident() const
+{
+    return _pendingUploads == 0;
+}
+
+void SceneNode::LoadNode(const AssetReference& reference)
+{
+    Logger::Log(LogType::Info, "Parsing node " + reference.name);
+
+    Json::Value root = _scene->_ReadJson(reference);
 
     _name = root["Name"].asCString();
 
-    _transform = XMMatrixSet(
+    _CreateTransform(XMMatrixSet(
         root["Transform"]["r0"]["x"].asFloat(), root["Transform"]["r0"]["y"].asFloat(), root["Transform"]["r0"]["z"].asFloat(), root["Transform"]["r0"]["w"].asFloat(),
         root["Transform"]["r1"]["x"].asFloat(), root["Transform"]["r1"]["y"].asFloat(), root["Transform"]["r1"]["z"].asFloat(), root["Transform"]["r1"]["w"].asFloat(),
         root["Transform"]["r2"]["x"].asFloat(), root["Transform"]["r2"]["y"].asFloat(), root["Transform"]["r2"]["z"].asFloat(), root["Transform"]["r2"]["w"].asFloat(),
         root["Transform"]["r3"]["x"].asFloat(), root["Transform"]["r3"]["y"].asFloat(), root["Transform"]["r3"]["z"].asFloat(), root["Transform"]["r3"]["w"].asFloat()
-    );
+    ));
 
-    {
-        DirectX::XMVECTOR min = XMVectorSet(root["AABB"]["Min"]["x"].asFloat(), root["AABB"]["Min"]["y"].asFloat(), root["AABB"]["Min"]["z"].asFloat(), root["AABB"]["Min"]["w"].asFloat());
-        DirectX::XMVECTOR max = XMVectorSet(root["AABB"]["Max"]["x"].asFloat(), root["AABB"]["Max"]["y"].asFloat(), root["AABB"]["Max"]["z"].asFloat(), root["AABB"]["Max"]["w"].asFloat());
-        
-        _AABB = AABBVolume(min, max);
-
-        ComPtr<ID3D12Resource> vertexBuffer;
-        _UploadData(commandList, &vertexBuffer, _AABB.mesh->GetVertices().size(), sizeof(VertexData), _AABB.mesh->GetVertices().data());
-        _AABBVertexBuffer = std::make_shared<Core::Resource>();
-        _AABBVertexBuffer->InitFromDXResource(vertexBuffer);
-        _AABBVertexBuffer->SetName(_name + "_AABB_VB");
-
-        _AABBVBO = D3D12_VERTEX_BUFFER_VIEW();
-        _AABBVBO.BufferLocation = _AABBVertexBuffer->OffsetGPU(0);
-        _AABBVBO.SizeInBytes = static_cast<UINT>(_AABB.mesh->GetVertices().size() * sizeof(_AABB.mesh->GetVertices()[0]));
-        _AABBVBO.StrideInBytes = sizeof(VertexData);
-
-        ComPtr<ID3D12Resource> indexBuffer;
-        _UploadData(commandList, &indexBuffer, _AABB.mesh->GetIndices().size(), sizeof(UINT), _AABB.mesh->GetIndices().data());
-        _AABBIndexBuffer = std::make_shared<Core::Resource>();
-        _AABBIndexBuffer->InitFromDXResource(indexBuffer);
-        _AABBIndexBuffer->SetName(_name + "_AABB_IB");
-
-        _AABBIBO = D3D12_INDEX_BUFFER_VIEW();
-        _AABBIBO.BufferLocation = _AABBIndexBuffer->OffsetGPU(0);
-        _AABBIBO.Format = DXGI_FORMAT_R32_UINT;
-        _AABBIBO.SizeInBytes = static_cast<UINT>(_AABB.mesh->GetIndices().size() * sizeof(_AABB.mesh->GetIndices()[0]));
-    }
+    XMFLOAT3 aabbMin(root["AABB"]["Min"]["x"].asFloat(), root["AABB"]["Min"]["y"].asFloat(), root["AABB"]["Min"]["z"].asFloat());
+    XMFLOAT3 aabbMax(root["AABB"]["Max"]["x"].asFloat(), root["AABB"]["Max"]["y"].asFloat(), root["AABB"]["Max"]["z"].asFloat());
 
     auto LODs = root["LODs"];
     if (!LODs.isNull())
     {
         for (int i = 0; i < LODs.size(); ++i)
         {
-            _LODs.push_back(std::make_shared<Mesh>());
-            _LODs.back()->LoadMesh(_scene->_name + '\\' + LODs[i].asCString());
+            _LODs.push_back(_scene->_loader->RequestMesh(_scene->_Resolve(LODs[i]), this));
         }
     }
 
     if (!root["Material"].isNull())
     {
-        std::ifstream inMat(_scene->_name + '\\' + root["Material"].asCString(), std::ios_base::in | std::ios_base::binary);
-        Json::Value mat;
-        inMat >> mat;
-        if (_texture = std::move(Core::Texture::LoadFromFile(mat["Diffuse"].asCString())))
-        {
-            _scene->_UploadTexture(_texture.get(), commandList);
-        }
+        Json::Value mat = _scene->_ReadJson(_scene->_Resolve(root["Material"]));
+        _scene->_loader->RequestTexture(mat["Diffuse"].asString(), this);
     }
 
-    _isOccluder = root["IsOccluder"].asBool();
+    _SetNodeData(aabbMin, aabbMax, root["IsOccluder"].asBool(), root.get("MinScreenSize", Scene::SCENE_SCREEN_SIZE).asFloat());
 
-    auto children = root["Nodes"];
-    for (int i = 0; i < children.size(); ++i)
+    if (!root["Quantization"].isNull())
     {
-        std::shared_ptr<SceneNode> child = std::make_shared<SceneNode>(_scene, this);
-        child->LoadNode(_scene->_name + '\\' + children[i].asCString(), commandList);
-        _childNodes.push_back(child);
+        Json::Value quantization = root["Quantization"];
+        _scene->_transforms.SetQuantization(_scene->_GetNodeData(_handle).transformIndex,
+            XMFLOAT4(quantization["Offset"]["x"].asFloat(), quantization["Offset"]["y"].asFloat(), quantization["Offset"]["z"].asFloat(), 0.0f),
+            XMFLOAT4(quantization["Scale"]["x"].asFloat(), quantization["Scale"]["y"].asFloat(), quantization["Scale"]["z"].asFloat(), 0.0f));
     }
 
+    auto children = root["Nodes"];
+    for (int i = 0; i < children.size(); ++i)
     {
-        Core::EResourceType SRVType = Core::EResourceType::Dynamic | Core::EResourceType::Buffer;
-
-        Core::ResourceDescription desc;
-        desc.SetResourceType(SRVType);
-        desc.SetSize({ sizeof(XMMATRIX), 1 });
-        desc.SetStride(1);
-        desc.SetFormat(DXGI_FORMAT::DXGI_FORMAT_UNKNOWN);
-
-        _modelMatrix = std::make_shared<Core::Resource>(desc);
-        _modelMatrix->CreateCommitedResource(D3D12_RESOURCE_STATE_GENERIC_READ);
-        _modelMatrix->SetName(_name + "_ModelMatrix");
+        _scene->_CreateNode(this)->LoadNode(_scene->_Resolve(children[i]));
     }
 
-
     if (!_LODs.empty())
     {
-        for (int i = 0; i < _LODs.size(); ++i)
-        {
-            ComPtr<ID3D12Resource> vertexBuffer;
-            _UploadData(commandList, &vertexBuffer, _LODs[i]->GetVertices().size(), sizeof(VertexData), _LODs[i]->GetVertices().data());
-            _vertexBuffer.push_back(std::make_shared<Core::Resource>());
-            _vertexBuffer[i]->InitFromDXResource(vertexBuffer);
-            _vertexBuffer[i]->SetName(_name + "_VB");
-
-            _VBO.emplace_back(D3D12_VERTEX_BUFFER_VIEW());
-            _VBO[i].BufferLocation = _vertexBuffer[i]->OffsetGPU(0);
-            _VBO[i].SizeInBytes = static_cast<UINT>(_LODs[i]->GetVertices().size() * sizeof(_LODs[i]->GetVertices()[0]));
-            _VBO[i].StrideInBytes = sizeof(VertexData);
-        }
-
-        for (int i = 0; i < _LODs.size(); ++i)
-        {
-            ComPtr<ID3D12Resource> indexBuffer;
-            _UploadData(commandList, &indexBuffer, _LODs[i]->GetIndices().size(), sizeof(UINT), _LODs[i]->GetIndices().data());
-            _indexBuffer.push_back(std::make_shared<Core::Resource>());
-            _indexBuffer[i]->InitFromDXResource(indexBuffer);
-            _indexBuffer[i]->SetName(_name + "_IB");
-
-            _IBO.emplace_back(D3D12_INDEX_BUFFER_VIEW());
-            _IBO[i].BufferLocation = _indexBuffer[i]->OffsetGPU(0);
-            _IBO[i].Format = DXGI_FORMAT_R32_UINT;
-            _IBO[i].SizeInBytes = static_cast<UINT>(_LODs[i]->GetIndices().size() * sizeof(_LODs[i]->GetIndices()[0]));
-        }
+        _querySlot = _scene->_occlusionQuery.AllocateSlot();
     }
+    _scene->_loader->AddNode(this);
 }
 
-void SceneNode::_UploadData(Core::GraphicsCommandList& commandList,
-    ID3D12Resource** destinationResource,
-    size_t numElements,
-    size_t elementSize,
-    const void* bufferData,
-    D3D12_RESOURCE_FLAGS flags)
+void SceneNode::LoadNode(const CompiledScene& compiledScene, const SceneFormat::Node& desc)
 {
-    size_t bufferSize = numElements * elementSize;
-
-    CD3DX12_HEAP_PROPERTIES heapTypeDefault(D3D12_HEAP_TYPE_DEFAULT);
-    CD3DX12_RESOURCE_DESC bufferWithFlags = CD3DX12_RESOURCE_DESC::Buffer(bufferSize, flags);
-
-    Helper::throwIfFailed(_DXDevice->CreateCommittedResource(
-        &heapTypeDefault,
-        D3D12_HEAP_FLAG_NONE,
-        &bufferWithFlags,
-        D3D12_RESOURCE_STATE_COPY_DEST,
-        nullptr,
-        IID_PPV_ARGS(destinationResource)));
+    _name = compiledScene.GetString(desc.nameOffset);
 
-    CD3DX12_HEAP_PROPERTIES heapTypeUpload(D3D12_HEAP_TYPE_UPLOAD);
-    CD3DX12_RESOURCE_DESC buffer = CD3DX12_RESOURCE_DESC::Buffer(bufferSize, flags);
+    _CreateTransform(XMMATRIX(&desc.transform[0][0]));
 
-    ComPtr<ID3D12Resource> intermediateResource;
-
-    if (bufferData)
+    for (const SceneFormat::LOD& lod : compiledScene.GetLODs(desc))
     {
-        Helper::throwIfFailed(_DXDevice->CreateCommittedResource(
-            &heapTypeUpload,
-            D3D12_HEAP_FLAG_NONE,
-            &buffer,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&intermediateResource)));
-        intermediates.push_back(intermediateResource);
-
-        D3D12_SUBRESOURCE_DATA subresourceData = {};
-        subresourceData.pData = bufferData;
-        subresourceData.RowPitch = bufferSize;
-        subresourceData.SlicePitch = subresourceData.RowPitch;
-
-        UpdateSubresources(commandList.GetDXCommandList().Get(),
-            *destinationResource, intermediateResource.Get(),
-            0, 0, 1, &subresourceData);
+        _LODs.push_back(_scene->_loader->RequestMesh(_scene->_Resolve(compiledScene, compiledScene.GetMesh(lod.mesh)), this));
     }
-}
 
-void SceneNode::_DrawCurrentNode(Core::GraphicsCommandList& commandList, const Camera& camera) const
-{
-    if (_LODs.empty())
+    if (desc.material != SceneFormat::INVALID_INDEX)
     {
-        return;
+        _scene->_loader->RequestTexture(compiledScene.GetString(compiledScene.GetMaterial(desc.material).diffuseOffset), this);
     }
 
-    if (!Intersect(camera.GetViewFrustum(), _AABB))
+    _SetNodeData(XMFLOAT3(desc.aabbMin), XMFLOAT3(desc.aabbMax), (desc.flags & SceneFormat::NODE_FLAG_OCCLUDER) != 0,
+        (desc.flags & SceneFormat::NODE_FLAG_MIN_SCREEN_SIZE) ? desc.minScreenSize : Scene::SCENE_SCREEN_SIZE);
+
+    if (desc.flags & SceneFormat::NODE_FLAG_QUANTIZED)
     {
-        return;
+        _scene->_transforms.SetQuantization(_scene->_GetNodeData(_handle).transformIndex,
+            XMFLOAT4(desc.quantizationOffset[0], desc.quantizationOffset[1], desc.quantizationOffset[2], 0.0f),
+            XMFLOAT4(desc.quantizationScale[0], desc.quantizationScale[1], desc.quantizationScale[2], 0.0f));
     }
 
-    if (_texture)
+    if (!_LODs.empty())
     {
-        commandList.SetDescriptorHeaps({ _scene->_texturesTable->GetDescriptorHeap().GetDXDescriptorHeap().Get() });
-
-        commandList.SetConstant(1, true);
-        commandList.SetDescriptorTable(4, _scene->_texturesTable->GetResourceGPUHandle(_texture->GetName()));
+        _querySlot = _scene->_occlusionQuery.AllocateSlot();
     }
-    else
+    _scene->_loader->AddNode(this);
+}
+
+void SceneNode::_SetNodeData(const XMFLOAT3& aabbMin, const XMFLOAT3& aabbMax, bool isOccluder, float minScreenSize)
+{
+    _scene->_screenSizes[_handle.GetIndex()] = minScreenSize;
+
+    // Written before the children are created, which can grow the node data array
+    SceneNodeData& data = _scene->_GetNodeData(_handle);
+    data.aabbMin = aabbMin;
+    data.aabbMax = aabbMax;
+    data.lodCount = static_cast<uint16_t>(_LODs.size());
+    if (isOccluder)
     {
-        commandList.SetConstant(1, false);
+        data.flags |= SCENE_NODE_OCCLUDER;
     }
+}
 
-    _scene->_occlusionQuery.SetPredication(this, commandList);
-
-    DirectX::XMVECTOR center = _AABB.min + ((_AABB.max - _AABB.min) * 0.5f);
-    float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(camera.Position() - center));
-
-    int lod = distance / 200.0f;
-    int lodIndex = (lod >= _LODs.size()) ? (_LODs.size() - 1) : lod;
-
-    XMMATRIX* modelMatrixData = (XMMATRIX*)_modelMatrix->Map();
-    *modelMatrixData = GetGlobalTransform();
-    commandList.SetSRV(3, _modelMatrix->OffsetGPU(0));
-
-    commandList.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList.SetVertexBuffer(0, _VBO[lodIndex]);
-    commandList.SetIndexBuffer(_IBO[lodIndex]);
-
-    commandList.DrawIndexed(_LODs[lodIndex]->GetIndices().size());
+void SceneNode::_CountVertexFetch(size_t fetchedBytes, size_t interleavedBytes) const
+{
+    _scene->_vertexFetchStatistics.fetchedBytes += fetchedBytes;
+    _scene->_vertexFetchStatistics.interleavedBytes += interleavedBytes;
 }
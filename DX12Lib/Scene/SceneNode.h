@@ -3,11 +3,31 @@
 #include "DXObjects/Texture.h"
 #include "Scene/Mesh.h"
 #include "Scene/ISceneNode.h"
+#include "Scene/SoftwareOcclusion.h"
 #include "Scene/Volumes/AABBVolume.h"
 
 #include <fbxsdk.h>
 
 class Scene;
+class SceneLoader;
+
+// GPU buffers of a mesh file or package entry, shared by all the nodes that reference the file
+struct MeshBuffers
+{
+    std::shared_ptr<Mesh> mesh;
+
+    std::shared_ptr<Core::Resource> vertexBuffer;
+    std::shared_ptr<Core::Resource> indexBuffer;
+    // Color stream of the packed layout, a single element with zero stride if the color is uniform
+    std::shared_ptr<Core::Resource> colorBuffer;
+    // Position only stream for the depth only passes
+    std::shared_ptr<Core::Resource> positionBuffer;
+
+    D3D12_VERTEX_BUFFER_VIEW VBO;
+    D3D12_VERTEX_BUFFER_VIEW colorVBO;
+    D3D12_VERTEX_BUFFER_VIEW positionVBO;
+    D3D12_INDEX_BUFFER_VIEW IBO;
+};
 
 class SceneNode : public ISceneNode
 {
@@ -16,50 +36,45 @@ public:
     SceneNode(Scene* scene, SceneNode* parent = nullptr);
     ~SceneNode();
 
-    void RunOcclusion(Core::GraphicsCommandList& commandList, const FrustumVolume& frustum) const override;
-    void Draw(Core::GraphicsCommandList& commandList, const Camera& camera) const override;
-    void DrawOccluders(Core::GraphicsCommandList& commandList, const Camera& camera) const override;
-    void DrawOccludees(Core::GraphicsCommandList& commandList, const Camera& camera) const override;
+    void Draw(Core::GraphicsCommandList& commandList, uint32_t lod) const override;
     void DrawAABB(Core::GraphicsCommandList& commandList) const override;
-    void TestAABB(Core::GraphicsCommandList& commandList) const override;
 
-    const AABBVolume& GetAABB() const override;
+    AABBVolume GetAABB() const override;
     bool IsOccluder() const override;
 
-    void LoadNode(const std::string& filepath, Core::GraphicsCommandList& commandList) override;
+    void LoadNode(const AssetReference& reference) override;
+    void LoadNode(const CompiledScene& compiledScene, const SceneFormat::Node& desc) override;
+
+    // All the uploads requested by the node completed, it can be drawn and tested
+    bool IsResident() const;
+    // The coarsest LOD for the software occlusion, empty while the node is not resident
+    OccluderMesh GetOccluderMesh() const;
+    // Writes the proxy box of the node for the occlusion queries, its query slot
+    uint32_t SetQueryBox() const;
+    uint32_t GetQuerySlot() const;
+    // Of the LOD once resident, 0 before
+    size_t GetTriangleCount(uint32_t lod) const;
+
+    // Bytes of the node object and its own heap data, without the shared meshes and textures
+    size_t GetMemoryUsage() const;
 
 protected:
-    void _UploadData(Core::GraphicsCommandList& commandList,
-                     ID3D12Resource** destinationResource,
-                     size_t numElements,
-                     size_t elementSize,
-                     const void* bufferData,
-                     D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
-    void _DrawCurrentNode(Core::GraphicsCommandList& commandList, const Camera& camera) const;
+    // The traversal data, once the LODs are requested. The screen size is Scene::SCENE_SCREEN_SIZE
+    // unless the node has its own
+    void _SetNodeData(const DirectX::XMFLOAT3& aabbMin, const DirectX::XMFLOAT3& aabbMax, bool isOccluder, float minScreenSize);
+    void _CountVertexFetch(size_t fetchedBytes, size_t interleavedBytes) const;
 
 private:
-    ComPtr<ID3D12Device2> _DXDevice;
+    friend SceneLoader;
 
-    std::shared_ptr<Mesh> _mesh;
-    std::vector<std::shared_ptr<Mesh>> _LODs;
-    AABBVolume _AABB;
-    bool _isOccluder;
+    std::vector<std::shared_ptr<const MeshBuffers>> _LODs;
 
     std::shared_ptr<Core::Texture> _texture;
 
-    std::shared_ptr<Core::Resource> _modelMatrix;
-    std::vector<std::shared_ptr<Core::Resource>> _vertexBuffer;
-    std::vector<std::shared_ptr<Core::Resource>> _indexBuffer;
-
-    std::vector<D3D12_VERTEX_BUFFER_VIEW> _VBO;
-    std::vector<D3D12_INDEX_BUFFER_VIEW>_IBO;
-
-    std::shared_ptr<Core::Resource> _AABBVertexBuffer;
-    std::shared_ptr<Core::Resource> _AABBIndexBuffer;
+    // Query, predication result and proxy box of the node in the occlusion queries of the scene
+    uint32_t _querySlot;
 
-    D3D12_VERTEX_BUFFER_VIEW _AABBVBO;
-    D3D12_INDEX_BUFFER_VIEW _AABBIBO;
-    
-    std::vector<ComPtr<ID3D12Resource>> intermediates;
+    // Uploads of the meshes and texture still streamed by the scene loader
+    uint32_t _pendingUploads;
 };
 
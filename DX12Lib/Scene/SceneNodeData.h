@@ -0,0 +1,22 @@
+#pragma once
+
+enum SceneNodeFlags : uint16_t
+{
+    SCENE_NODE_NONE = 0,
+    SCENE_NODE_ALIVE = 1 << 0,          // The pool slot holds a node
+    SCENE_NODE_OCCLUDER = 1 << 1,
+    SCENE_NODE_RESIDENT = 1 << 2,       // All the uploads of the node completed
+    SCENE_NODE_DYNAMIC = 1 << 3,        // Moves often, culled through the loose octree rather than the BVH
+};
+
+// The part of a node every pass reads, indexed by the pool slot of the node. Two nodes per cache line
+struct alignas(32) SceneNodeData
+{
+    DirectX::XMFLOAT3 aabbMin;
+    uint32_t transformIndex;
+    DirectX::XMFLOAT3 aabbMax;
+    uint16_t flags;                     // SceneNodeFlags
+    uint16_t lodCount;
+};
+
+static_assert(sizeof(SceneNodeData) == 32, "SceneNodeData must stay half a cache line");
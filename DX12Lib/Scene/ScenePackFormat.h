@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary layout of the .scenepak files, a whole cooked scene in one file. Written by
+// FBXParser and mapped once by Scene::LoadScene.
+//
+// File layout:
+//     Header
+//     Entry[Header::entryCount]   the table of contents
+//     entry names                 zero terminated, for logs and the mesh registry
+//     entry data                  DATA_ALIGNMENT aligned
+//
+// Entry 0 is the scene JSON. The JSON entries reference each other by TOC index instead
+// of file names: "Nodes" of the scene and of the nodes, "LODs" and "Material" of the nodes.
+// The package may also hold a CompiledScene entry, the same hierarchy in the flat binary
+// form, which readers prefer over the JSON.
+// Uncompressed entries are used straight from the mapping, so the mesh entries keep the
+// alignment MeshFormat needs. Identical entries are stored once.
+
+namespace ScenePackFormat
+{
+    constexpr uint32_t MAGIC = 0x4B415053; // "SPAK"
+    constexpr uint16_t VERSION = 1;
+    constexpr uint32_t DATA_ALIGNMENT = 16;
+
+    enum class EntryType : uint32_t
+    {
+        Scene = 0,
+        Node = 1,
+        Material = 2,
+        Mesh = 3,
+        CompiledScene = 4,  // SceneFormat.h hierarchy of the scene, the mesh references carry the TOC indices
+    };
+
+    enum class Compression : uint32_t
+    {
+        None = 0,
+        LZ = 1,             // Utility/LZ.h block
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t headerSize;
+        uint32_t entryCount;
+        uint32_t namesSize;
+        uint64_t tocOffset;
+        uint64_t namesOffset;
+    };
+
+    struct Entry
+    {
+        uint64_t offset;
+        uint64_t size;              // Stored size
+        uint64_t uncompressedSize;
+        uint64_t hash;              // ComputeHash of the uncompressed data
+        EntryType type;
+        Compression compression;
+        uint32_t nameOffset;        // Into the names block
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(Header) == 32, "ScenePackFormat::Header layout changed");
+    static_assert(sizeof(Entry) == 48, "ScenePackFormat::Entry layout changed");
+
+    // FNV-1a
+    inline uint64_t ComputeHash(const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    inline uint64_t AlignOffset(uint64_t offset)
+    {
+        return (offset + DATA_ALIGNMENT - 1) & ~static_cast<uint64_t>(DATA_ALIGNMENT - 1);
+    }
+}
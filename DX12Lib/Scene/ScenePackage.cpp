@@ -0,0 +1,149 @@
+#include "stdafx.h"
+
+#include "ScenePackage.h"
+
+#include "Utility/LZ.h"
+#include "Utility/MappedFile.h"
+
+ScenePackage::ScenePackage()
+    : _file(nullptr)
+{
+}
+
+ScenePackage::~ScenePackage()
+{   }
+
+bool ScenePackage::Open(const std::string& filepath)
+{
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->Open(filepath))
+    {
+        return false;
+    }
+
+    const uint8_t* data = file->GetData();
+    const size_t size = file->GetSize();
+
+    const ScenePackFormat::Header* header = reinterpret_cast<const ScenePackFormat::Header*>(data);
+    if (ASSERT(size >= sizeof(ScenePackFormat::Header) && header->magic == ScenePackFormat::MAGIC, "Not a scene package: " + filepath)
+        || ASSERT(header->version <= ScenePackFormat::VERSION, "Unsupported scene package version " + std::to_string(header->version) + " in " + filepath))
+    {
+        return false;
+    }
+
+    if (ASSERT(header->tocOffset + static_cast<uint64_t>(header->entryCount) * sizeof(ScenePackFormat::Entry) <= size, "Corrupted table of contents in " + filepath)
+        || ASSERT(header->namesOffset + header->namesSize <= size, "Corrupted entry names in " + filepath))
+    {
+        return false;
+    }
+
+    std::span<const ScenePackFormat::Entry> entries(reinterpret_cast<const ScenePackFormat::Entry*>(data + header->tocOffset), header->entryCount);
+    for (const ScenePackFormat::Entry& entry : entries)
+    {
+        if (ASSERT(entry.offset + entry.size <= size, "Entry is out of bounds in " + filepath)
+            || ASSERT(entry.nameOffset < header->namesSize, "Entry name is out of bounds in " + filepath))
+        {
+            return false;
+        }
+    }
+
+    if (ASSERT(!entries.empty() && entries[0].type == ScenePackFormat::EntryType::Scene, "Scene package without a scene: " + filepath))
+    {
+        return false;
+    }
+
+    _file = std::move(file);
+    _filepath = filepath;
+    _entries = entries;
+    _names = std::span<const char>(reinterpret_cast<const char*>(data + header->namesOffset), header->namesSize);
+    _decompressed.clear();
+    _decompressed.resize(entries.size());
+
+    return true;
+}
+
+uint32_t ScenePackage::GetEntryCount() const
+{
+    return static_cast<uint32_t>(_entries.size());
+}
+
+ScenePackFormat::EntryType ScenePackage::GetEntryType(uint32_t index) const
+{
+    return _entries[index].type;
+}
+
+std::string ScenePackage::GetEntryName(uint32_t index) const
+{
+    if (!_IsValidIndex(index))
+    {
+        return {};
+    }
+
+    // The names block may not end with a terminator if the file is corrupted
+    std::span<const char> name = _names.subspan(_entries[index].nameOffset);
+    return std::string(name.data(), std::find(name.begin(), name.end(), '\0') - name.begin());
+}
+
+std::span<const uint8_t> ScenePackage::GetEntryData(uint32_t index)
+{
+    if (ASSERT(_IsValidIndex(index), "Invalid entry " + std::to_string(index) + " in " + _filepath))
+    {
+        return {};
+    }
+
+    const ScenePackFormat::Entry& entry = _entries[index];
+    std::span<const uint8_t> stored(_file->GetData() + entry.offset, entry.size);
+
+    if (entry.compression == ScenePackFormat::Compression::None)
+    {
+        return stored;
+    }
+
+    std::vector<uint8_t>& data = _decompressed[index];
+    if (data.empty() && entry.uncompressedSize > 0)
+    {
+        if (ASSERT(entry.compression == ScenePackFormat::Compression::LZ, "Unknown compression of " + GetEntryName(index) + " in " + _filepath))
+        {
+            return {};
+        }
+
+        data.resize(entry.uncompressedSize);
+        bool isValid = LZ::Decompress(stored.data(), stored.size(), data.data(), data.size())
+            && ScenePackFormat::ComputeHash(data.data(), data.size()) == entry.hash;
+        if (ASSERT(isValid, "Corrupted entry " + GetEntryName(index) + " in " + _filepath))
+        {
+            data.clear();
+            return {};
+        }
+    }
+
+    return data;
+}
+
+Json::Value ScenePackage::ParseJson(uint32_t index)
+{
+    std::span<const uint8_t> data = GetEntryData(index);
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+
+    std::string errors;
+    const char* begin = reinterpret_cast<const char*>(data.data());
+    if (ASSERT(reader->parse(begin, begin + data.size(), &root, &errors), "Failed to parse " + GetEntryName(index) + " in " + _filepath + ": " + errors))
+    {
+        return {};
+    }
+
+    return root;
+}
+
+std::shared_ptr<const void> ScenePackage::GetOwner() const
+{
+    return _file;
+}
+
+bool ScenePackage::_IsValidIndex(uint32_t index) const
+{
+    return index < _entries.size();
+}
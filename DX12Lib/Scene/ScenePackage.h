@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Scene/ScenePackFormat.h"
+
+class MappedFile;
+
+// Read-only view of a mapped .scenepak file (see ScenePackFormat.h)
+class ScenePackage
+{
+public:
+    ScenePackage();
+    ~ScenePackage();
+
+    ScenePackage(const ScenePackage& copy) = delete;
+    ScenePackage& operator=(const ScenePackage& copy) = delete;
+
+    bool Open(const std::string& filepath);
+
+    uint32_t GetEntryCount() const;
+    // The index must be less than GetEntryCount
+    ScenePackFormat::EntryType GetEntryType(uint32_t index) const;
+    std::string GetEntryName(uint32_t index) const;
+
+    // Uncompressed entries point into the mapping, compressed ones are decompressed on the first access.
+    // Empty if the index is invalid or the entry is corrupted
+    std::span<const uint8_t> GetEntryData(uint32_t index);
+    Json::Value ParseJson(uint32_t index);
+
+    // Keeps the mapping alive for the spans returned by GetEntryData
+    std::shared_ptr<const void> GetOwner() const;
+
+private:
+    bool _IsValidIndex(uint32_t index) const;
+
+    std::shared_ptr<MappedFile> _file;
+    std::string _filepath;
+
+    std::span<const ScenePackFormat::Entry> _entries;
+    std::span<const char> _names;
+    // One slot per entry, filled once, so different entries can be read from different threads
+    std::vector<std::vector<uint8_t>> _decompressed;
+};
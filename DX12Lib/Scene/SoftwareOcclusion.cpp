@@ -0,0 +1,487 @@
+#include "stdafx.h"
+
+#include "SoftwareOcclusion.h"
+
+#include <cfloat>
+#include <cmath>
+#include <execution>
+#include <immintrin.h>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+    // Occluders and triangles below which the work stays on the calling thread
+    constexpr size_t PARALLEL_OCCLUDER_COUNT = 16;
+    constexpr size_t PARALLEL_TRIANGLE_COUNT = 1024;
+
+    // Reach of the rasterizer past the screen edges in NDC, the triangles reaching further are
+    // clipped so the edge functions keep their precision
+    constexpr float GUARD_BAND = 2.0f;
+    constexpr uint32_t CLIP_PLANE_COUNT = 5;
+    // The quantized positions are read as UNORM16 like the input layout of the depth passes
+    constexpr float UNORM16_SCALE = 1.0f / 65535.0f;
+    // Every clip plane adds a vertex at most
+    constexpr uint32_t MAX_CLIPPED_VERTEX_COUNT = 3 + CLIP_PLANE_COUNT;
+
+    // The triangles keep the positive side: the near plane, then the guard band
+    const XMVECTORF32 CLIP_PLANES[CLIP_PLANE_COUNT] =
+    {
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+        { -1.0f, 0.0f, 0.0f, GUARD_BAND },
+        { 1.0f, 0.0f, 0.0f, GUARD_BAND },
+        { 0.0f, -1.0f, 0.0f, GUARD_BAND },
+        { 0.0f, 1.0f, 0.0f, GUARD_BAND },
+    };
+
+    // Bit i for the planes the vertex is behind
+    uint32_t GetOutCode(FXMVECTOR position)
+    {
+        uint32_t outCode = 0;
+        for (uint32_t p = 0; p < CLIP_PLANE_COUNT; ++p)
+        {
+            if (XMVectorGetX(XMVector4Dot(position, CLIP_PLANES[p])) < 0.0f)
+            {
+                outCode |= 1u << p;
+            }
+        }
+
+        return outCode;
+    }
+
+    uint32_t ClipPolygon(const XMVECTOR* input, uint32_t inputCount, FXMVECTOR plane, XMVECTOR* output)
+    {
+        uint32_t outputCount = 0;
+        for (uint32_t i = 0; i < inputCount; ++i)
+        {
+            const XMVECTOR current = input[i];
+            const XMVECTOR next = input[(i + 1) % inputCount];
+            const float currentDistance = XMVectorGetX(XMVector4Dot(current, plane));
+            const float nextDistance = XMVectorGetX(XMVector4Dot(next, plane));
+
+            if (currentDistance >= 0.0f)
+            {
+                output[outputCount++] = current;
+            }
+            if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+            {
+                output[outputCount++] = XMVectorLerp(current, next, currentDistance / (currentDistance - nextDistance));
+            }
+        }
+
+        return outputCount;
+    }
+
+    uint32_t GetIndex(const OccluderMesh& mesh, size_t i)
+    {
+        return mesh.indexStride == sizeof(uint16_t)
+            ? static_cast<const uint16_t*>(mesh.indices)[i]
+            : static_cast<const uint32_t*>(mesh.indices)[i];
+    }
+}
+
+SoftwareOcclusion::SoftwareOcclusion()
+    : _width(0)
+    , _height(0)
+    , _tilesPerRow(0)
+    , _viewProjection(XMMatrixIdentity())
+{
+}
+
+SoftwareOcclusion::~SoftwareOcclusion()
+{
+}
+
+void SoftwareOcclusion::Create(uint32_t width, uint32_t height)
+{
+    _width = (std::max(width, 1u) + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+    _height = (std::max(height, 1u) + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+    _tilesPerRow = _width / TILE_SIZE;
+
+    _depth.assign(static_cast<size_t>(_width) * _height, 1.0f);
+    _tileDepth.assign(static_cast<size_t>(_tilesPerRow) * (_height / TILE_SIZE), 1.0f);
+    _bandTriangles.resize(_height / TILE_SIZE);
+}
+
+void SoftwareOcclusion::Begin(const XMMATRIX& viewProjection)
+{
+    _viewProjection = viewProjection;
+
+    std::fill(_depth.begin(), _depth.end(), 1.0f);
+    std::fill(_tileDepth.begin(), _tileDepth.end(), 1.0f);
+    _occluders.clear();
+    _triangles.clear();
+}
+
+void SoftwareOcclusion::AddOccluder(const OccluderMesh& mesh, const XMMATRIX& transform)
+{
+    if (mesh.positionStride == 0 || mesh.indexCount < 3)
+    {
+        return;
+    }
+
+    _occluders.push_back({ mesh, transform });
+}
+
+void SoftwareOcclusion::Rasterize()
+{
+    if (_depth.empty())
+    {
+        return;
+    }
+
+    _occluderTriangles.resize(_occluders.size());
+    if (_occluders.size() >= PARALLEL_OCCLUDER_COUNT)
+    {
+        std::vector<uint32_t> occluders(_occluders.size());
+        std::iota(occluders.begin(), occluders.end(), 0);
+
+        std::for_each(std::execution::par, occluders.begin(), occluders.end(), [this](uint32_t occluder)
+        {
+            _SetupOccluder(_occluders[occluder], _occluderTriangles[occluder]);
+        });
+    }
+    else
+    {
+        for (uint32_t occluder = 0; occluder < _occluders.size(); ++occluder)
+        {
+            _SetupOccluder(_occluders[occluder], _occluderTriangles[occluder]);
+        }
+    }
+
+    _triangles.clear();
+    for (const std::vector<Triangle>& triangles : _occluderTriangles)
+    {
+        _triangles.insert(_triangles.end(), triangles.begin(), triangles.end());
+    }
+
+    // Every triangle to the bands of the pixel rows whose centres its bounds reach
+    for (std::vector<uint32_t>& triangles : _bandTriangles)
+    {
+        triangles.clear();
+    }
+
+    for (uint32_t i = 0; i < _triangles.size(); ++i)
+    {
+        const Triangle& triangle = _triangles[i];
+        const float minY = std::min({ triangle.y[0], triangle.y[1], triangle.y[2] });
+        const float maxY = std::max({ triangle.y[0], triangle.y[1], triangle.y[2] });
+
+        const int32_t firstRow = std::max(static_cast<int32_t>(std::ceil(minY - 0.5f)), 0);
+        const int32_t lastRow = std::min(static_cast<int32_t>(std::floor(maxY - 0.5f)), static_cast<int32_t>(_height) - 1);
+        for (int32_t band = firstRow / static_cast<int32_t>(TILE_SIZE); band <= lastRow / static_cast<int32_t>(TILE_SIZE) && firstRow <= lastRow; ++band)
+        {
+            _bandTriangles[band].push_back(i);
+        }
+    }
+
+    std::vector<uint32_t> bands(_bandTriangles.size());
+    std::iota(bands.begin(), bands.end(), 0);
+
+    if (_triangles.size() >= PARALLEL_TRIANGLE_COUNT)
+    {
+        std::for_each(std::execution::par, bands.begin(), bands.end(), [this](uint32_t band)
+        {
+            _RasterizeBand(band);
+        });
+    }
+    else
+    {
+        for (uint32_t band : bands)
+        {
+            _RasterizeBand(band);
+        }
+    }
+}
+
+bool SoftwareOcclusion::IsVisible(const XMFLOAT3& aabbMin, const XMFLOAT3& aabbMax) const
+{
+    if (_depth.empty())
+    {
+        return true;
+    }
+
+    float minX = FLT_MAX;
+    float minY = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float maxY = -FLT_MAX;
+    float minZ = FLT_MAX;
+
+    for (uint32_t corner = 0; corner < 8; ++corner)
+    {
+        const XMVECTOR position = XMVectorSet((corner & 1) ? aabbMax.x : aabbMin.x, (corner & 2) ? aabbMax.y : aabbMin.y, (corner & 4) ? aabbMax.z : aabbMin.z, 1.0f);
+
+        XMFLOAT4 clipPosition;
+        XMStoreFloat4(&clipPosition, XMVector4Transform(position, _viewProjection));
+
+        // The box reaches in front of the near plane, its projection is unbounded
+        if (clipPosition.z < 0.0f || clipPosition.w <= 0.0f)
+        {
+            return true;
+        }
+
+        const float x = clipPosition.x / clipPosition.w;
+        const float y = clipPosition.y / clipPosition.w;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, clipPosition.z / clipPosition.w);
+    }
+
+    // Every pixel the projected box touches
+    const int32_t firstColumn = std::max(static_cast<int32_t>(std::floor((minX * 0.5f + 0.5f) * _width)), 0);
+    const int32_t lastColumn = std::min(static_cast<int32_t>(std::floor((maxX * 0.5f + 0.5f) * _width)), static_cast<int32_t>(_width) - 1);
+    const int32_t firstRow = std::max(static_cast<int32_t>(std::floor((0.5f - maxY * 0.5f) * _height)), 0);
+    const int32_t lastRow = std::min(static_cast<int32_t>(std::floor((0.5f - minY * 0.5f) * _height)), static_cast<int32_t>(_height) - 1);
+
+    if (firstColumn > lastColumn || firstRow > lastRow)
+    {
+        // Off the screen by rounding only, the frustum culling kept it
+        return true;
+    }
+
+    for (int32_t tileY = firstRow / TILE_SIZE; tileY <= lastRow / static_cast<int32_t>(TILE_SIZE); ++tileY)
+    {
+        for (int32_t tileX = firstColumn / TILE_SIZE; tileX <= lastColumn / static_cast<int32_t>(TILE_SIZE); ++tileX)
+        {
+            // All the pixels of the tile are in front of the box
+            if (_tileDepth[tileY * _tilesPerRow + tileX] < minZ)
+            {
+                continue;
+            }
+
+            const int32_t rowEnd = std::min(lastRow, (tileY + 1) * static_cast<int32_t>(TILE_SIZE) - 1);
+            const int32_t columnEnd = std::min(lastColumn, (tileX + 1) * static_cast<int32_t>(TILE_SIZE) - 1);
+            for (int32_t row = std::max(firstRow, tileY * static_cast<int32_t>(TILE_SIZE)); row <= rowEnd; ++row)
+            {
+                for (int32_t column = std::max(firstColumn, tileX * static_cast<int32_t>(TILE_SIZE)); column <= columnEnd; ++column)
+                {
+                    if (_depth[row * _width + column] >= minZ)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+uint32_t SoftwareOcclusion::GetWidth() const
+{
+    return _width;
+}
+
+uint32_t SoftwareOcclusion::GetHeight() const
+{
+    return _height;
+}
+
+std::span<const float> SoftwareOcclusion::GetDepth() const
+{
+    return _depth;
+}
+
+size_t SoftwareOcclusion::GetTriangleCount() const
+{
+    return _triangles.size();
+}
+
+void SoftwareOcclusion::_SetupOccluder(const Occluder& occluder, std::vector<Triangle>& triangles) const
+{
+    triangles.clear();
+
+    const OccluderMesh& mesh = occluder.mesh;
+    const XMMATRIX transform = XMMatrixMultiply(occluder.transform, _viewProjection);
+    const size_t vertexCount = mesh.positions.size() / mesh.positionStride;
+
+    // Every vertex once, the triangles index the clip space positions
+    std::vector<XMFLOAT4> clipPositions(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const uint8_t* position = mesh.positions.data() + i * mesh.positionStride;
+
+        XMVECTOR objectPosition;
+        if (mesh.isQuantized)
+        {
+            const uint16_t* quantized = reinterpret_cast<const uint16_t*>(position);
+            objectPosition = XMVectorSet(quantized[0] * UNORM16_SCALE, quantized[1] * UNORM16_SCALE, quantized[2] * UNORM16_SCALE, 1.0f);
+        }
+        else
+        {
+            objectPosition = XMVectorSetW(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(position)), 1.0f);
+        }
+
+        XMStoreFloat4(&clipPositions[i], XMVector4Transform(objectPosition, transform));
+    }
+
+    // The front faces only, as the depth passes draw them
+    auto emit = [this, &triangles](const XMVECTOR* vertices, uint32_t vertexCount)
+    {
+        XMFLOAT3 screen[MAX_CLIPPED_VERTEX_COUNT];
+        for (uint32_t i = 0; i < vertexCount; ++i)
+        {
+            XMFLOAT4 clipPosition;
+            XMStoreFloat4(&clipPosition, vertices[i]);
+
+            screen[i].x = (clipPosition.x / clipPosition.w * 0.5f + 0.5f) * _width;
+            screen[i].y = (0.5f - clipPosition.y / clipPosition.w * 0.5f) * _height;
+            screen[i].z = clipPosition.z / clipPosition.w;
+        }
+
+        for (uint32_t i = 1; i + 1 < vertexCount; ++i)
+        {
+            const XMFLOAT3& a = screen[0];
+            const XMFLOAT3& b = screen[i];
+            const XMFLOAT3& c = screen[i + 1];
+
+            // Clockwise on the screen, which runs y down
+            const float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+            if (area > 0.0f)
+            {
+                triangles.push_back({ { a.x, b.x, c.x }, { a.y, b.y, c.y }, { a.z, b.z, c.z } });
+            }
+        }
+    };
+
+    for (size_t i = 0; i + 2 < mesh.indexCount; i += 3)
+    {
+        const uint32_t indices[3] = { GetIndex(mesh, i), GetIndex(mesh, i + 1), GetIndex(mesh, i + 2) };
+        if (indices[0] >= vertexCount || indices[1] >= vertexCount || indices[2] >= vertexCount)
+        {
+            continue;
+        }
+
+        XMVECTOR vertices[MAX_CLIPPED_VERTEX_COUNT];
+        uint32_t outCodes[3];
+        for (uint32_t v = 0; v < 3; ++v)
+        {
+            vertices[v] = XMLoadFloat4(&clipPositions[indices[v]]);
+            outCodes[v] = GetOutCode(vertices[v]);
+        }
+
+        // Behind a single plane with all its vertices
+        if (outCodes[0] & outCodes[1] & outCodes[2])
+        {
+            continue;
+        }
+
+        if ((outCodes[0] | outCodes[1] | outCodes[2]) == 0)
+        {
+            emit(vertices, 3);
+            continue;
+        }
+
+        XMVECTOR clipped[MAX_CLIPPED_VERTEX_COUNT];
+        uint32_t vertexCount = 3;
+        for (uint32_t p = 0; p < CLIP_PLANE_COUNT && vertexCount >= 3; ++p)
+        {
+            if ((outCodes[0] | outCodes[1] | outCodes[2]) & (1u << p))
+            {
+                vertexCount = ClipPolygon(vertices, vertexCount, CLIP_PLANES[p], clipped);
+                std::copy(clipped, clipped + vertexCount, vertices);
+            }
+        }
+
+        if (vertexCount >= 3)
+        {
+            emit(vertices, vertexCount);
+        }
+    }
+}
+
+void SoftwareOcclusion::_RasterizeBand(uint32_t band)
+{
+    const int32_t bandFirstRow = static_cast<int32_t>(band * TILE_SIZE);
+    const int32_t bandLastRow = bandFirstRow + static_cast<int32_t>(TILE_SIZE) - 1;
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+    for (uint32_t index : _bandTriangles[band])
+    {
+        const Triangle& triangle = _triangles[index];
+
+        const int32_t firstColumn = std::max(static_cast<int32_t>(std::ceil(std::min({ triangle.x[0], triangle.x[1], triangle.x[2] }) - 0.5f)), 0);
+        const int32_t lastColumn = std::min(static_cast<int32_t>(std::floor(std::max({ triangle.x[0], triangle.x[1], triangle.x[2] }) - 0.5f)), static_cast<int32_t>(_width) - 1);
+        const int32_t firstRow = std::max(static_cast<int32_t>(std::ceil(std::min({ triangle.y[0], triangle.y[1], triangle.y[2] }) - 0.5f)), bandFirstRow);
+        const int32_t lastRow = std::min(static_cast<int32_t>(std::floor(std::max({ triangle.y[0], triangle.y[1], triangle.y[2] }) - 0.5f)), bandLastRow);
+        if (firstColumn > lastColumn || firstRow > lastRow)
+        {
+            continue;
+        }
+
+        // Edge i runs from vertex i to the next one, the pixels on the right of all three are inside
+        float stepX[3];
+        float stepY[3];
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            const uint32_t next = (i + 1) % 3;
+            stepX[i] = triangle.y[i] - triangle.y[next];
+            stepY[i] = triangle.x[next] - triangle.x[i];
+        }
+
+        const float area = stepY[0] * (triangle.y[2] - triangle.y[0]) + stepX[0] * (triangle.x[2] - triangle.x[0]);
+        const float depthStepX = ((triangle.z[1] - triangle.z[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.z[2] - triangle.z[0]) * (triangle.y[1] - triangle.y[0])) / area;
+        const float depthStepY = ((triangle.x[1] - triangle.x[0]) * (triangle.z[2] - triangle.z[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.z[1] - triangle.z[0])) / area;
+
+        // The width is whole tiles, so the groups of 4 pixels never cross the row end
+        const int32_t alignedFirstColumn = firstColumn & ~3;
+        const float x = alignedFirstColumn + 0.5f;
+
+        const __m128 edgeStepX[3] = { _mm_set1_ps(4.0f * stepX[0]), _mm_set1_ps(4.0f * stepX[1]), _mm_set1_ps(4.0f * stepX[2]) };
+        const __m128 depthStep = _mm_set1_ps(4.0f * depthStepX);
+
+        for (int32_t row = firstRow; row <= lastRow; ++row)
+        {
+            const float y = row + 0.5f;
+
+            __m128 edges[3];
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                const float edge = stepY[i] * (y - triangle.y[i]) + stepX[i] * (x - triangle.x[i]);
+                edges[i] = _mm_add_ps(_mm_set1_ps(edge), _mm_mul_ps(_mm_set1_ps(stepX[i]), laneOffsets));
+            }
+
+            const float rowDepth = triangle.z[0] + depthStepX * (x - triangle.x[0]) + depthStepY * (y - triangle.y[0]);
+            __m128 depth = _mm_add_ps(_mm_set1_ps(rowDepth), _mm_mul_ps(_mm_set1_ps(depthStepX), laneOffsets));
+
+            float* depthRow = &_depth[static_cast<size_t>(row) * _width];
+            for (int32_t column = alignedFirstColumn; column <= lastColumn; column += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(edges[0], zero), _mm_and_ps(_mm_cmpge_ps(edges[1], zero), _mm_cmpge_ps(edges[2], zero)));
+
+                const __m128 current = _mm_loadu_ps(depthRow + column);
+                const __m128 isNearer = _mm_and_ps(inside, _mm_cmplt_ps(depth, current));
+                if (_mm_movemask_ps(isNearer) != 0)
+                {
+                    _mm_storeu_ps(depthRow + column, _mm_or_ps(_mm_and_ps(isNearer, depth), _mm_andnot_ps(isNearer, current)));
+                }
+
+                for (uint32_t i = 0; i < 3; ++i)
+                {
+                    edges[i] = _mm_add_ps(edges[i], edgeStepX[i]);
+                }
+                depth = _mm_add_ps(depth, depthStep);
+            }
+        }
+    }
+
+    // The farthest depth of the tiles of the band
+    for (uint32_t tileX = 0; tileX < _tilesPerRow; ++tileX)
+    {
+        __m128 farthest = zero;
+        for (int32_t row = bandFirstRow; row <= bandLastRow; ++row)
+        {
+            const float* pixels = &_depth[static_cast<size_t>(row) * _width + tileX * TILE_SIZE];
+            farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(pixels), _mm_loadu_ps(pixels + 4)));
+        }
+
+        farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+        farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+        _tileDepth[band * _tilesPerRow + tileX] = _mm_cvtss_f32(farthest);
+    }
+}
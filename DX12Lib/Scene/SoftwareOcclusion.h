@@ -0,0 +1,84 @@
+#pragma once
+
+// Triangles of an occluder as the CPU keeps them, the position stream of the depth passes
+struct OccluderMesh
+{
+    std::span<const uint8_t> positions;     // float3, or UNORM16 x4 if isQuantized
+    uint32_t positionStride = 0;
+    bool isQuantized = false;
+    const void* indices = nullptr;
+    uint32_t indexStride = sizeof(uint32_t);
+    size_t indexCount = 0;
+};
+
+// Low resolution depth buffer the occluders are rasterized into on the CPU, so the occludee bounds are
+// tested before any command is recorded. Every tile of TILE_SIZE x TILE_SIZE pixels keeps the farthest
+// depth of its pixels, most tests end on the tiles. A row of tiles is a band, the bands are rasterized
+// on worker threads with SSE coverage masks of 4 pixels. Depth is z / w, 0 at the near plane.
+// No D3D12 objects, the frame is the positions, the indices and the matrices
+class SoftwareOcclusion
+{
+public:
+    static constexpr uint32_t TILE_SIZE = 8;
+
+    SoftwareOcclusion();
+    ~SoftwareOcclusion();
+
+    SoftwareOcclusion(const SoftwareOcclusion& copy) = delete;
+    SoftwareOcclusion& operator=(const SoftwareOcclusion& copy) = delete;
+
+    // Rounded up to whole tiles
+    void Create(uint32_t width, uint32_t height);
+
+    // Clears the depth and the occluders, the following occluders and tests use the matrix
+    void Begin(const DirectX::XMMATRIX& viewProjection);
+    // The mesh must stay alive until Rasterize, the transform takes its positions to world space,
+    // the quantized ones as UNORM values
+    void AddOccluder(const OccluderMesh& mesh, const DirectX::XMMATRIX& transform);
+    // The front faces of the occluders added since Begin
+    void Rasterize();
+
+    // False if the box is behind the rasterized occluders on all its pixels
+    bool IsVisible(const DirectX::XMFLOAT3& aabbMin, const DirectX::XMFLOAT3& aabbMax) const;
+
+    uint32_t GetWidth() const;
+    uint32_t GetHeight() const;
+    std::span<const float> GetDepth() const;
+    // Front facing triangles of the last Rasterize, after the clipping
+    size_t GetTriangleCount() const;
+
+private:
+    struct Occluder
+    {
+        OccluderMesh mesh;
+        DirectX::XMMATRIX transform;
+    };
+
+    // In pixels, the edges run clockwise on the screen
+    struct Triangle
+    {
+        float x[3];
+        float y[3];
+        float z[3];
+    };
+
+    // Called from the workers, every occluder and every band by a single worker
+    void _SetupOccluder(const Occluder& occluder, std::vector<Triangle>& triangles) const;
+    void _RasterizeBand(uint32_t band);
+
+    uint32_t _width;
+    uint32_t _height;
+    uint32_t _tilesPerRow;
+
+    DirectX::XMMATRIX _viewProjection;
+
+    std::vector<float> _depth;
+    // Farthest depth of every tile
+    std::vector<float> _tileDepth;
+
+    std::vector<Occluder> _occluders;
+    std::vector<std::vector<Triangle>> _occluderTriangles;
+    std::vector<Triangle> _triangles;
+    // Triangles overlapping every band
+    std::vector<std::vector<uint32_t>> _bandTriangles;
+};
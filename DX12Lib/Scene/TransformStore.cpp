@@ -0,0 +1,258 @@
+#include "stdafx.h"
+
+#include "TransformStore.h"
+
+#include <execution>
+
+using namespace DirectX;
+
+namespace
+{
+    // Nodes per task of a level, smaller levels are updated on the calling thread
+    constexpr size_t PARALLEL_CHUNK_SIZE = 2048;
+
+    // The upload heap is write combined, the constants are never read back
+    void StreamMatrix(XMMATRIX* destination, const XMMATRIX& matrix)
+    {
+        float* data = reinterpret_cast<float*>(destination);
+        _mm_stream_ps(data + 0, matrix.r[0]);
+        _mm_stream_ps(data + 4, matrix.r[1]);
+        _mm_stream_ps(data + 8, matrix.r[2]);
+        _mm_stream_ps(data + 12, matrix.r[3]);
+    }
+}
+
+TransformStore::TransformStore()
+    : _hasDirty(false)
+    , _modelBuffer(nullptr)
+    , _models(nullptr)
+{
+}
+
+TransformStore::~TransformStore()
+{
+    _models = nullptr;
+    _modelBuffer = nullptr;
+}
+
+uint32_t TransformStore::Add(uint32_t parent, const XMMATRIX& localTransform)
+{
+    ASSERT(parent == INVALID_INDEX || parent < _parents.size(), "The parent transform must be added before its children");
+
+    uint32_t index = static_cast<uint32_t>(_parents.size());
+
+    _localTransforms.push_back(localTransform);
+    _globalTransforms.push_back(XMMatrixIdentity());
+    _parents.push_back(parent);
+    _isDirty.push_back(1);
+    _quantizationOffsets.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+    _quantizationScales.push_back(XMFLOAT4(1.0f, 1.0f, 1.0f, 0.0f));
+
+    _hasDirty = true;
+
+    return index;
+}
+
+void TransformStore::SetQuantization(uint32_t index, const XMFLOAT4& offset, const XMFLOAT4& scale)
+{
+    _quantizationOffsets[index] = offset;
+    _quantizationScales[index] = scale;
+
+    if (_models)
+    {
+        _models[index].QuantizationOffset = offset;
+        _models[index].QuantizationScale = scale;
+    }
+}
+
+std::vector<uint32_t> TransformStore::Build()
+{
+    const size_t count = _parents.size();
+
+    // The parents precede their children, so a single pass finds every level
+    std::vector<uint32_t> levels(count);
+    uint32_t levelCount = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        levels[i] = _parents[i] == INVALID_INDEX ? 0 : levels[_parents[i]] + 1;
+        levelCount = std::max(levelCount, levels[i] + 1);
+    }
+
+    // Counting sort, stable, so the siblings stay next to each other
+    _levels.assign(levelCount + 1, 0);
+    for (uint32_t level : levels)
+    {
+        ++_levels[level + 1];
+    }
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        _levels[level + 1] += _levels[level];
+    }
+
+    std::vector<uint32_t> remap(count);
+    std::vector<size_t> next(_levels.begin(), _levels.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        remap[i] = static_cast<uint32_t>(next[levels[i]]++);
+    }
+
+    std::vector<XMMATRIX> localTransforms(count);
+    std::vector<uint32_t> parents(count);
+    std::vector<XMFLOAT4> quantizationOffsets(count);
+    std::vector<XMFLOAT4> quantizationScales(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        localTransforms[remap[i]] = _localTransforms[i];
+        parents[remap[i]] = _parents[i] == INVALID_INDEX ? INVALID_INDEX : remap[_parents[i]];
+        quantizationOffsets[remap[i]] = _quantizationOffsets[i];
+        quantizationScales[remap[i]] = _quantizationScales[i];
+    }
+
+    _localTransforms = std::move(localTransforms);
+    _parents = std::move(parents);
+    _quantizationOffsets = std::move(quantizationOffsets);
+    _quantizationScales = std::move(quantizationScales);
+    _globalTransforms.assign(count, XMMatrixIdentity());
+    _isDirty.assign(count, 1);
+    _hasDirty = true;
+
+    if (count > 0)
+    {
+        Core::EResourceType SRVType = Core::EResourceType::Dynamic | Core::EResourceType::Buffer;
+
+        Core::ResourceDescription desc;
+        desc.SetResourceType(SRVType);
+        desc.SetSize({ static_cast<uint32_t>(sizeof(ModelDesc) * count), 1 });
+        desc.SetStride(1);
+        desc.SetFormat(DXGI_FORMAT::DXGI_FORMAT_UNKNOWN);
+
+        _modelBuffer = std::make_shared<Core::Resource>(desc);
+        _modelBuffer->CreateCommitedResource(D3D12_RESOURCE_STATE_GENERIC_READ);
+        _modelBuffer->SetName("ModelConstants");
+
+        // Mapped for the lifetime of the store
+        _models = static_cast<ModelDesc*>(_modelBuffer->Map());
+        for (size_t i = 0; i < count; ++i)
+        {
+            _models[i].QuantizationOffset = _quantizationOffsets[i];
+            _models[i].QuantizationScale = _quantizationScales[i];
+        }
+    }
+
+    return remap;
+}
+
+size_t TransformStore::Update()
+{
+    _updated.clear();
+
+    if (!_hasDirty || !_models)
+    {
+        return 0;
+    }
+
+    // The levels run one after another, the nodes of a level only read the previous ones
+    for (size_t level = 0; level + 1 < _levels.size(); ++level)
+    {
+        const size_t begin = _levels[level];
+        const size_t end = _levels[level + 1];
+
+        if (end - begin < 2 * PARALLEL_CHUNK_SIZE)
+        {
+            _UpdateRange(begin, end, _updated);
+            continue;
+        }
+
+        // Every chunk lists its updates apart, appended in order once the level is done
+        std::vector<size_t> chunks;
+        for (size_t chunk = begin; chunk < end; chunk += PARALLEL_CHUNK_SIZE)
+        {
+            chunks.push_back(chunk);
+        }
+
+        std::vector<std::vector<uint32_t>> chunkUpdated(chunks.size());
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), [this, begin, end, &chunkUpdated](size_t chunk)
+        {
+            _UpdateRange(chunk, std::min(chunk + PARALLEL_CHUNK_SIZE, end), chunkUpdated[(chunk - begin) / PARALLEL_CHUNK_SIZE]);
+        });
+
+        for (const std::vector<uint32_t>& updated : chunkUpdated)
+        {
+            _updated.insert(_updated.end(), updated.begin(), updated.end());
+        }
+    }
+
+    // The streaming stores must land before the command lists reading them are submitted
+    _mm_sfence();
+
+    std::fill(_isDirty.begin(), _isDirty.end(), 0);
+    _hasDirty = false;
+
+    return _updated.size();
+}
+
+const std::vector<uint32_t>& TransformStore::GetUpdated() const
+{
+    return _updated;
+}
+
+XMMATRIX TransformStore::GetLocalTransform(uint32_t index) const
+{
+    return _localTransforms[index];
+}
+
+void TransformStore::SetLocalTransform(uint32_t index, const XMMATRIX& localTransform)
+{
+    _localTransforms[index] = localTransform;
+    _isDirty[index] = 1;
+    _hasDirty = true;
+}
+
+XMMATRIX TransformStore::GetGlobalTransform(uint32_t index) const
+{
+    return _globalTransforms[index];
+}
+
+XMMATRIX TransformStore::GetPositionTransform(uint32_t index) const
+{
+    const XMFLOAT4& offset = _quantizationOffsets[index];
+    const XMFLOAT4& scale = _quantizationScales[index];
+
+    return XMMatrixScaling(scale.x, scale.y, scale.z) * XMMatrixTranslation(offset.x, offset.y, offset.z) * _globalTransforms[index];
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS TransformStore::GetModelAddress(uint32_t index) const
+{
+    return _modelBuffer->OffsetGPU(index * sizeof(ModelDesc));
+}
+
+size_t TransformStore::GetCount() const
+{
+    return _parents.size();
+}
+
+void TransformStore::_UpdateRange(size_t begin, size_t end, std::vector<uint32_t>& updated)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const uint32_t parent = _parents[i];
+        if (parent != INVALID_INDEX)
+        {
+            // The dirty parents pass their flag down
+            _isDirty[i] |= _isDirty[parent];
+        }
+
+        if (!_isDirty[i])
+        {
+            continue;
+        }
+
+        const XMMATRIX globalTransform = parent == INVALID_INDEX
+            ? _localTransforms[i]
+            : XMMatrixMultiply(_localTransforms[i], _globalTransforms[parent]);
+
+        _globalTransforms[i] = globalTransform;
+        StreamMatrix(&_models[i].Model, globalTransform);
+        updated.push_back(static_cast<uint32_t>(i));
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "DXObjects/Resource.h"
+
+// Per node constants of the vertex shaders, ModelSRV_CB
+struct ModelDesc
+{
+    DirectX::XMMATRIX Model;
+    DirectX::XMFLOAT4 QuantizationOffset;
+    DirectX::XMFLOAT4 QuantizationScale;
+};
+
+// Transforms of all the nodes of a scene in flat arrays, the nodes only keep their index.
+// The nodes are added parents first while the hierarchy is built, then sorted by hierarchy
+// level once, so Update is a linear sweep over the levels in which every parent is already
+// updated. The levels are split across threads, and the global transforms go straight into
+// the model constants buffer the draws bind
+class TransformStore
+{
+public:
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+    TransformStore();
+    ~TransformStore();
+
+    TransformStore(const TransformStore& copy) = delete;
+    TransformStore& operator=(const TransformStore& copy) = delete;
+
+    // The parent must be added before its children, INVALID_INDEX for the root nodes
+    uint32_t Add(uint32_t parent, const DirectX::XMMATRIX& localTransform);
+    void SetQuantization(uint32_t index, const DirectX::XMFLOAT4& offset, const DirectX::XMFLOAT4& scale);
+
+    // Orders the nodes by hierarchy level and creates the model constants buffer. Returns
+    // the new index of every node by its index from Add
+    std::vector<uint32_t> Build();
+
+    // Global transforms of the nodes moved since the last call and of their subtrees.
+    // Returns the number of recomputed transforms
+    size_t Update();
+    // The transforms recomputed by the last Update, by level
+    const std::vector<uint32_t>& GetUpdated() const;
+
+    DirectX::XMMATRIX GetLocalTransform(uint32_t index) const;
+    void SetLocalTransform(uint32_t index, const DirectX::XMMATRIX& localTransform);
+    DirectX::XMMATRIX GetGlobalTransform(uint32_t index) const;
+    // From the stored positions to world space, the dequantization of the vertex shaders first
+    DirectX::XMMATRIX GetPositionTransform(uint32_t index) const;
+
+    // ModelDesc of the node for the root SRV of the draws
+    D3D12_GPU_VIRTUAL_ADDRESS GetModelAddress(uint32_t index) const;
+
+    size_t GetCount() const;
+
+private:
+    void _UpdateRange(size_t begin, size_t end, std::vector<uint32_t>& updated);
+
+    std::vector<DirectX::XMMATRIX> _localTransforms;
+    std::vector<DirectX::XMMATRIX> _globalTransforms;
+    std::vector<uint32_t> _parents;
+    // Bytes rather than bits, so the threads splitting a level never write the same memory location
+    std::vector<uint8_t> _isDirty;
+    bool _hasDirty;
+
+    std::vector<DirectX::XMFLOAT4> _quantizationOffsets;
+    std::vector<DirectX::XMFLOAT4> _quantizationScales;
+
+    // Index of the first node of every level, the last element is the node count
+    std::vector<size_t> _levels;
+
+    std::vector<uint32_t> _updated;
+
+    std::shared_ptr<Core::Resource> _modelBuffer;
+    ModelDesc* _models;
+};
@@ -37,14 +37,11 @@ namespace
     };
 }
 
-AABBVolume::AABBVolume(DirectX::XMVECTOR min, DirectX::XMVECTOR max)
+std::shared_ptr<Mesh> AABBVolume::CreateMesh() const
 {
-    this->min = min;
-    this->max = max;
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
 
     {
-        mesh = std::make_shared<Mesh>();
-
         std::vector<VertexData> vertices(8);
         vertices[0].Position = { DirectX::XMVectorGetX(max), DirectX::XMVectorGetY(max), DirectX::XMVectorGetZ(min) };
         vertices[1].Position = { DirectX::XMVectorGetX(max), DirectX::XMVectorGetY(min), DirectX::XMVectorGetZ(min) };
@@ -67,4 +64,6 @@ AABBVolume::AABBVolume(DirectX::XMVECTOR min, DirectX::XMVECTOR max)
         mesh->SetVertices(vertices);
         mesh->SetIndices(BOX_INDICES);
     }
+
+    return mesh;
 }
@@ -7,12 +7,16 @@ class Mesh;
 class AABBVolume : public IVolume
 {
 public:
+    static constexpr UINT VERTEX_COUNT = 8;
+    static constexpr UINT INDEX_COUNT = 36;
+
     AABBVolume() = default;
-    AABBVolume(DirectX::XMVECTOR min, DirectX::XMVECTOR max);
+    AABBVolume(DirectX::XMVECTOR min, DirectX::XMVECTOR max) : min(min), max(max) {}
     ~AABBVolume() = default;
 
+    // Box mesh of the volume, built on demand for the occlusion proxies
+    std::shared_ptr<Mesh> CreateMesh() const;
+
     DirectX::XMVECTOR min;
     DirectX::XMVECTOR max;
-
-    std::shared_ptr<Mesh> mesh;
 };
@@ -0,0 +1,984 @@
+#include "stdafx.h"
+
+#include "FrustumCuller.h"
+
+#include "Scene/Volumes/FrustumVolume.h"
+
+#include <bit>
+#include <cmath>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#include <cpuid.h>
+
+// GCC and Clang only compile the wider intrinsics into the functions targeting them
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    // Every kernel call covers 16 boxes, 1, 4, 2 or 1 iterations of the scalar, SSE, AVX2 and AVX-512 loops
+    constexpr uint32_t BATCH_SIZE = 16;
+    static_assert(CullBoxes::PADDING >= BATCH_SIZE, "The kernels read a whole batch past the last box");
+
+    // Visible boxes of the batch at index in the low 16 bits, the inside boxes into insideBits and
+    // the boxes inside the frustum but too small into smallBits
+    using CullFunction = uint32_t (*)(const FrustumCuller::Planes& planes, uint32_t planeMask, const CullBoxes& boxes, size_t index, uint32_t& insideBits, uint32_t& smallBits);
+
+    // The projected diameter radius * pixelScale / distance below the minimum size, compared squared
+    bool IsSmallScalar(const FrustumCuller::Planes& planes, float centerX, float centerY, float centerZ, float radius, float minSize)
+    {
+        const float x = centerX - planes.positionX;
+        const float y = centerY - planes.positionY;
+        const float z = centerZ - planes.positionZ;
+
+        float distanceSquared = x * x;
+        distanceSquared = distanceSquared + y * y;
+        distanceSquared = distanceSquared + z * z;
+
+        const float size = radius * radius * planes.pixelScaleSquared;
+        const float limit = minSize * minSize * distanceSquared;
+
+        return size < limit;
+    }
+
+    uint32_t CullScalar(const FrustumCuller::Planes& planes, uint32_t planeMask, const CullBoxes& boxes, size_t index, uint32_t& insideBits, uint32_t& smallBits)
+    {
+        uint32_t visibleBits = 0;
+        insideBits = 0;
+        smallBits = 0;
+
+        for (uint32_t lane = 0; lane < BATCH_SIZE; ++lane)
+        {
+            const size_t i = index + lane;
+
+            float distances[6];
+            bool isSphereOutside = false;
+            for (uint32_t p = 0; p < 6; ++p)
+            {
+                if (!(planeMask & (1u << p)))
+                {
+                    continue;
+                }
+
+                float distance = planes.normalX[p] * boxes.centerX[i];
+                distance = distance + planes.normalY[p] * boxes.centerY[i];
+                distance = distance + planes.normalZ[p] * boxes.centerZ[i];
+                distance = distance + planes.distance[p];
+
+                distances[p] = distance;
+                isSphereOutside |= distance + boxes.radius[i] < 0.0f;
+            }
+
+            if (isSphereOutside)
+            {
+                continue;
+            }
+
+            bool isVisible = true;
+            bool isInside = true;
+            for (uint32_t p = 0; p < 6; ++p)
+            {
+                if (!(planeMask & (1u << p)))
+                {
+                    continue;
+                }
+
+                float projectedExtent = planes.absNormalX[p] * boxes.extentX[i];
+                projectedExtent = projectedExtent + planes.absNormalY[p] * boxes.extentY[i];
+                projectedExtent = projectedExtent + planes.absNormalZ[p] * boxes.extentZ[i];
+
+                isVisible &= distances[p] + projectedExtent > 0.0f;
+                isInside &= distances[p] - projectedExtent >= 0.0f;
+            }
+
+            if (isVisible && planes.pixelScaleSquared > 0.0f
+                && IsSmallScalar(planes, boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i], boxes.radius[i], boxes.minSize[i]))
+            {
+                smallBits |= 1u << lane;
+                isVisible = false;
+            }
+
+            visibleBits |= static_cast<uint32_t>(isVisible) << lane;
+            insideBits |= static_cast<uint32_t>(isInside) << lane;
+        }
+
+        return visibleBits;
+    }
+
+    __m128 IsSmallSSE(const FrustumCuller::Planes& planes, const CullBoxes& boxes, size_t i)
+    {
+        const __m128 x = _mm_sub_ps(_mm_loadu_ps(&boxes.centerX[i]), _mm_set1_ps(planes.positionX));
+        const __m128 y = _mm_sub_ps(_mm_loadu_ps(&boxes.centerY[i]), _mm_set1_ps(planes.positionY));
+        const __m128 z = _mm_sub_ps(_mm_loadu_ps(&boxes.centerZ[i]), _mm_set1_ps(planes.positionZ));
+
+        __m128 distanceSquared = _mm_mul_ps(x, x);
+        distanceSquared = _mm_add_ps(distanceSquared, _mm_mul_ps(y, y));
+        distanceSquared = _mm_add_ps(distanceSquared, _mm_mul_ps(z, z));
+
+        const __m128 radius = _mm_loadu_ps(&boxes.radius[i]);
+        const __m128 minSize = _mm_loadu_ps(&boxes.minSize[i]);
+        const __m128 size = _mm_mul_ps(_mm_mul_ps(radius, radius), _mm_set1_ps(planes.pixelScaleSquared));
+        const __m128 limit = _mm_mul_ps(_mm_mul_ps(minSize, minSize), distanceSquared);
+
+        return _mm_cmplt_ps(size, limit);
+    }
+
+    uint32_t CullSSE(const FrustumCuller::Planes& planes, uint32_t planeMask, const CullBoxes& boxes, size_t index, uint32_t& insideBits, uint32_t& smallBits)
+    {
+        uint32_t visibleBits = 0;
+        insideBits = 0;
+        smallBits = 0;
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 allSet = _mm_cmpeq_ps(zero, zero);
+
+        for (uint32_t lane = 0; lane < BATCH_SIZE; lane += 4)
+        {
+            const size_t i = index + lane;
+
+            __m128 distances[6];
+            __m128 sphereOutside = zero;
+            for (uint32_t p = 0; p < 6; ++p)
+            {
+                if (!(planeMask & (1u << p)))
+                {
+                    continue;
+                }
+
+                __m128 distance = _mm_mul_ps(_mm_set1_ps(planes.normalX[p]), _mm_loadu_ps(&boxes.centerX[i]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.normalY[p]), _mm_loadu_ps(&boxes.centerY[i])));
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.normalZ[p]), _mm_loadu_ps(&boxes.centerZ[i])));
+                distance = _mm_add_ps(distance, _mm_set1_ps(planes.distance[p]));
+
+                distances[p] = distance;
+                sphereOutside = _mm_or_ps(sphereOutside, _mm_cmplt_ps(_mm_add_ps(distance, _mm_loadu_ps(&boxes.radius[i])), zero));
+            }
+
+            const uint32_t outsideBits = static_cast<uint32_t>(_mm_movemask_ps(sphereOutside));
+            if (outsideBits == 0xF)
+            {
+                continue;
+            }
+
+            __m128 visible = allSet;
+            __m128 inside = allSet;
+            for (uint32_t p = 0; p < 6; ++p)
+            {
+                if (!(planeMask & (1u << p)))
+                {
+                    continue;
+                }
+
+                __m128 projectedExtent = _mm_mul_ps(_mm_set1_ps(planes.absNormalX[p]), _mm_loadu_ps(&boxes.extentX[i]));
+                projectedExtent = _mm_add_ps(projectedExtent, _mm_mul_ps(_mm_set1_ps(planes.absNormalY[p]), _mm_loadu_ps(&boxes.extentY[i])));
+                projectedExtent = _mm_add_ps(projectedExtent, _mm_mul_ps(_mm_set1_ps(planes.absNormalZ[p]), _mm_loadu_ps(&boxes.extentZ[i])));
+
+                visible = _mm_and_ps(visible, _mm_cmpgt_ps(_mm_add_ps(distances[p], projectedExtent), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_sub_ps(distances[p], projectedExtent), zero));
+            }
+
+            if (planes.pixelScaleSquared > 0.0f)
+            {
+                const __m128 small = _mm_and_ps(visible, IsSmallSSE(planes, boxes, i));
+                smallBits |= (static_cast<uint32_t>(_mm_movemask_ps(small)) & ~outsideBits) << lane;
+                visible = _mm_andnot_ps(small, visible);
+            }
+
+            visibleBits |= (static_cast<uint32_t>(_mm_movemask_ps(visible)) & ~outsideBits) << lane;
+            insideBits |= (static_cast<uint32_t>(_mm_movemask_ps(inside)) & ~outsideBits) << lane;
+        }
+
+        return visibleBits;
+    }
+
+    TARGET_AVX2 __m256 IsSmallAVX2(const FrustumCuller::Planes& planes, const CullBoxes& boxes, size_t i)
+    {
+        const __m256 x = _mm256_sub_ps(_mm256_loadu_ps(&boxes.centerX[i]), _mm256_set1_ps(planes.positionX));
+        const __m256 y = _mm256_sub_ps(_mm256_loadu_ps(&boxes.centerY[i]), _mm256_set1_ps(planes.positionY));
+        const __m256 z = _mm256_sub_ps(_mm256_loadu_ps(&boxes.centerZ[i]), _mm256_set1_ps(planes.positionZ));
+
+        __m256 distanceSquared = _mm256_mul_ps(x, x);
+        distanceSquared = _mm256_add_ps(distanceSquared, _mm256_mul_ps(y, y));
+        distanceSquared = _mm256_add_ps(distanceSquared, _mm256_mul_ps(z, z));
+
+        const __m256 radius = _mm256_loadu_ps(&boxes.radius[i]);
+        const __m256 minSize = _mm256_loadu_ps(&boxes.minSize[i]);
+        const __m256 size = _mm256_mul_ps(_mm256_mul_ps(radius, radius), _mm256_set1_ps(planes.pixelScaleSquared));
+        const __m256 limit = _mm256_mul_ps(_mm256_mul_ps(minSize, minSize), distanceSquared);
+
+        return _mm256_cmp_ps(size, limit, _CMP_LT_OQ);
+    }
+
+    TARGET_AVX2 uint32_t CullAVX2(const FrustumCuller::Planes& planes, uint32_t planeMask, const CullBoxes& boxes, size_t index, uint32_t& insideBits, uint32_t& smallBits)
+    {
+        uint32_t visibleBits = 0;
+        insideBits = 0;
+        smallBits = 0;
+
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 allSet = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+        for (uint32_t lane = 0; lane < BATCH_SIZE; lane += 8)
+        {
+            const size_t i = index + lane;
+
+            __m256 distances[6];
+            __m256 sphereOutside = zero;
+            for (uint32_t p = 0; p < 6; ++p)
+            {
+                if (!(planeMask & (1u << p)))
+                {
+                    continue;
+                }
+
+                __m256 distance = _mm256_mul_ps(_mm256_set1_ps(planes.normalX[p]), _mm256_loadu_ps(&boxes.centerX[i]));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.normalY[p]), _mm256_loadu_ps(&boxes.centerY[i])));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.normalZ[p]), _mm256_loadu_ps(&boxes.centerZ[i])));
+                distance = _mm256_add_ps(distance, _mm256_set1_ps(planes.distance[p]));
+
+                distances[p] = distance;
+                sphereOutside = _mm256_or_ps(sphereOutside, _mm256_cmp_ps(_mm256_add_ps(distance, _mm256_loadu_ps(&boxes.radius[i])), zero, _CMP_LT_OQ));
+            }
+
+            const uint32_t outsideBits = static_cast<uint32_t>(_mm256_movemask_ps(sphereOutside));
+            if (outsideBits == 0xFF)
+            {
+                continue;
+            }
+
+            __m256 visible = allSet;
+            __m256 inside = allSet;
+            for (uint32_t p = 0; p < 6; ++p)
+            {
+                if (!(planeMask & (1u << p)))
+                {
+                    continue;
+                }
+
+                __m256 projectedExtent = _mm256_mul_ps(_mm256_set1_ps(planes.absNormalX[p]), _mm256_loadu_ps(&boxes.extentX[i]));
+                projectedExtent = _mm256_add_ps(projectedExtent, _mm256_mul_ps(_mm256_set1_ps(planes.absNormalY[p]), _mm256_loadu_ps(&boxes.extentY[i])));
+                projectedExtent = _mm256_add_ps(projectedExtent, _mm256_mul_ps(_mm256_set1_ps(planes.absNormalZ[p]), _mm256_loadu_ps(&boxes.extentZ[i])));
+
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(distances[p], projectedExtent), zero, _CMP_GT_OQ));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_sub_ps(distances[p], projectedExtent), zero, _CMP_GE_OQ));
+            }
+
+            if (planes.pixelScaleSquared > 0.0f)
+            {
+                const __m256 small = _mm256_and_ps(visible, IsSmallAVX2(planes, boxes, i));
+                smallBits |= (static_cast<uint32_t>(_mm256_movemask_ps(small)) & ~outsideBits) << lane;
+                visible = _mm256_andnot_ps(small, visible);
+            }
+
+            visibleBits |= (static_cast<uint32_t>(_mm256_movemask_ps(visible)) & ~outsideBits) << lane;
+            insideBits |= (static_cast<uint32_t>(_mm256_movemask_ps(inside)) & ~outsideBits) << lane;
+        }
+
+        return visibleBits;
+    }
+
+    TARGET_AVX512 __mmask16 IsSmallAVX512(const FrustumCuller::Planes& planes, const CullBoxes& boxes, size_t i)
+    {
+        const __m512 x = _mm512_sub_ps(_mm512_loadu_ps(&boxes.centerX[i]), _mm512_set1_ps(planes.positionX));
+        const __m512 y = _mm512_sub_ps(_mm512_loadu_ps(&boxes.centerY[i]), _mm512_set1_ps(planes.positionY));
+        const __m512 z = _mm512_sub_ps(_mm512_loadu_ps(&boxes.centerZ[i]), _mm512_set1_ps(planes.positionZ));
+
+        __m512 distanceSquared = _mm512_mul_ps(x, x);
+        distanceSquared = _mm512_add_ps(distanceSquared, _mm512_mul_ps(y, y));
+        distanceSquared = _mm512_add_ps(distanceSquared, _mm512_mul_ps(z, z));
+
+        const __m512 radius = _mm512_loadu_ps(&boxes.radius[i]);
+        const __m512 minSize = _mm512_loadu_ps(&boxes.minSize[i]);
+        const __m512 size = _mm512_mul_ps(_mm512_mul_ps(radius, radius), _mm512_set1_ps(planes.pixelScaleSquared));
+        const __m512 limit = _mm512_mul_ps(_mm512_mul_ps(minSize, minSize), distanceSquared);
+
+        return _mm512_cmp_ps_mask(size, limit, _CMP_LT_OQ);
+    }
+
+    TARGET_AVX512 uint32_t CullAVX512(const FrustumCuller::Planes& planes, uint32_t planeMask, const CullBoxes& boxes, size_t index, uint32_t& insideBits, uint32_t& smallBits)
+    {
+        const __m512 zero = _mm512_setzero_ps();
+        smallBits = 0;
+
+        __m512 distances[6];
+        __mmask16 sphereOutside = 0;
+        for (uint32_t p = 0; p < 6; ++p)
+        {
+            if (!(planeMask & (1u << p)))
+            {
+                continue;
+            }
+
+            __m512 distance = _mm512_mul_ps(_mm512_set1_ps(planes.normalX[p]), _mm512_loadu_ps(&boxes.centerX[index]));
+            distance = _mm512_add_ps(distance, _mm512_mul_ps(_mm512_set1_ps(planes.normalY[p]), _mm512_loadu_ps(&boxes.centerY[index])));
+            distance = _mm512_add_ps(distance, _mm512_mul_ps(_mm512_set1_ps(planes.normalZ[p]), _mm512_loadu_ps(&boxes.centerZ[index])));
+            distance = _mm512_add_ps(distance, _mm512_set1_ps(planes.distance[p]));
+
+            distances[p] = distance;
+            sphereOutside |= _mm512_cmp_ps_mask(_mm512_add_ps(distance, _mm512_loadu_ps(&boxes.radius[index])), zero, _CMP_LT_OQ);
+        }
+
+        if (sphereOutside == 0xFFFF)
+        {
+            insideBits = 0;
+            return 0;
+        }
+
+        __mmask16 visible = 0xFFFF;
+        __mmask16 inside = 0xFFFF;
+        for (uint32_t p = 0; p < 6; ++p)
+        {
+            if (!(planeMask & (1u << p)))
+            {
+                continue;
+            }
+
+            __m512 projectedExtent = _mm512_mul_ps(_mm512_set1_ps(planes.absNormalX[p]), _mm512_loadu_ps(&boxes.extentX[index]));
+            projectedExtent = _mm512_add_ps(projectedExtent, _mm512_mul_ps(_mm512_set1_ps(planes.absNormalY[p]), _mm512_loadu_ps(&boxes.extentY[index])));
+            projectedExtent = _mm512_add_ps(projectedExtent, _mm512_mul_ps(_mm512_set1_ps(planes.absNormalZ[p]), _mm512_loadu_ps(&boxes.extentZ[index])));
+
+            visible &= _mm512_cmp_ps_mask(_mm512_add_ps(distances[p], projectedExtent), zero, _CMP_GT_OQ);
+            inside &= _mm512_cmp_ps_mask(_mm512_sub_ps(distances[p], projectedExtent), zero, _CMP_GE_OQ);
+        }
+
+        if (planes.pixelScaleSquared > 0.0f)
+        {
+            const __mmask16 small = visible & ~sphereOutside & IsSmallAVX512(planes, boxes, index);
+            smallBits = static_cast<uint32_t>(small);
+            visible &= ~small;
+        }
+
+        insideBits = static_cast<uint32_t>(inside & ~sphereOutside);
+        return static_cast<uint32_t>(visible & ~sphereOutside);
+    }
+
+    CullFunction GetCullFunction(FrustumCuller::Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case FrustumCuller::Kernel::SSE:
+            return CullSSE;
+        case FrustumCuller::Kernel::AVX2:
+            return CullAVX2;
+        case FrustumCuller::Kernel::AVX512:
+            return CullAVX512;
+        default:
+            return CullScalar;
+        }
+    }
+
+    // The visible boxes of the batch at index for view v in visibleBits[v], for the views of the mask
+    using MultiCullFunction = void (*)(const FrustumCuller::Planes* views, const uint8_t* planeMasks, uint32_t viewMask, const CullBoxes& boxes, size_t index, uint32_t* visibleBits);
+
+    // The sphere is not tested, it only rejects boxes the box test rejects too
+    void CullViewsScalar(const FrustumCuller::Planes* views, const uint8_t* planeMasks, uint32_t viewMask, const CullBoxes& boxes, size_t index, uint32_t* visibleBits)
+    {
+        for (uint32_t lane = 0; lane < BATCH_SIZE; ++lane)
+        {
+            const size_t i = index + lane;
+
+            for (uint32_t remainingViews = viewMask; remainingViews != 0; remainingViews &= remainingViews - 1)
+            {
+                const uint32_t v = std::countr_zero(remainingViews);
+                const FrustumCuller::Planes& planes = views[v];
+
+                bool isVisible = true;
+                for (uint32_t p = 0; p < 6; ++p)
+                {
+                    if (!(planeMasks[v] & (1u << p)))
+                    {
+                        continue;
+                    }
+
+                    float distance = planes.normalX[p] * boxes.centerX[i];
+                    distance = distance + planes.normalY[p] * boxes.centerY[i];
+                    distance = distance + planes.normalZ[p] * boxes.centerZ[i];
+                    distance = distance + planes.distance[p];
+
+                    float projectedExtent = planes.absNormalX[p] * boxes.extentX[i];
+                    projectedExtent = projectedExtent + planes.absNormalY[p] * boxes.extentY[i];
+                    projectedExtent = projectedExtent + planes.absNormalZ[p] * boxes.extentZ[i];
+
+                    isVisible &= distance + projectedExtent > 0.0f;
+                }
+
+                visibleBits[v] |= static_cast<uint32_t>(isVisible) << lane;
+            }
+        }
+    }
+
+    void CullViewsSSE(const FrustumCuller::Planes* views, const uint8_t* planeMasks, uint32_t viewMask, const CullBoxes& boxes, size_t index, uint32_t* visibleBits)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 allSet = _mm_cmpeq_ps(zero, zero);
+
+        for (uint32_t lane = 0; lane < BATCH_SIZE; lane += 4)
+        {
+            const size_t i = index + lane;
+
+            // Loaded once for all the views
+            const __m128 centerX = _mm_loadu_ps(&boxes.centerX[i]);
+            const __m128 centerY = _mm_loadu_ps(&boxes.centerY[i]);
+            const __m128 centerZ = _mm_loadu_ps(&boxes.centerZ[i]);
+            const __m128 extentX = _mm_loadu_ps(&boxes.extentX[i]);
+            const __m128 extentY = _mm_loadu_ps(&boxes.extentY[i]);
+            const __m128 extentZ = _mm_loadu_ps(&boxes.extentZ[i]);
+
+            for (uint32_t remainingViews = viewMask; remainingViews != 0; remainingViews &= remainingViews - 1)
+            {
+                const uint32_t v = std::countr_zero(remainingViews);
+                const FrustumCuller::Planes& planes = views[v];
+
+                __m128 visible = allSet;
+                for (uint32_t p = 0; p < 6; ++p)
+                {
+                    if (!(planeMasks[v] & (1u << p)))
+                    {
+                        continue;
+                    }
+
+                    __m128 distance = _mm_mul_ps(_mm_set1_ps(planes.normalX[p]), centerX);
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.normalY[p]), centerY));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.normalZ[p]), centerZ));
+                    distance = _mm_add_ps(distance, _mm_set1_ps(planes.distance[p]));
+
+                    __m128 projectedExtent = _mm_mul_ps(_mm_set1_ps(planes.absNormalX[p]), extentX);
+                    projectedExtent = _mm_add_ps(projectedExtent, _mm_mul_ps(_mm_set1_ps(planes.absNormalY[p]), extentY));
+                    projectedExtent = _mm_add_ps(projectedExtent, _mm_mul_ps(_mm_set1_ps(planes.absNormalZ[p]), extentZ));
+
+                    visible = _mm_and_ps(visible, _mm_cmpgt_ps(_mm_add_ps(distance, projectedExtent), zero));
+                }
+
+                visibleBits[v] |= static_cast<uint32_t>(_mm_movemask_ps(visible)) << lane;
+            }
+        }
+    }
+
+    TARGET_AVX2 void CullViewsAVX2(const FrustumCuller::Planes* views, const uint8_t* planeMasks, uint32_t viewMask, const CullBoxes& boxes, size_t index, uint32_t* visibleBits)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 allSet = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+        for (uint32_t lane = 0; lane < BATCH_SIZE; lane += 8)
+        {
+            const size_t i = index + lane;
+
+            const __m256 centerX = _mm256_loadu_ps(&boxes.centerX[i]);
+            const __m256 centerY = _mm256_loadu_ps(&boxes.centerY[i]);
+            const __m256 centerZ = _mm256_loadu_ps(&boxes.centerZ[i]);
+            const __m256 extentX = _mm256_loadu_ps(&boxes.extentX[i]);
+            const __m256 extentY = _mm256_loadu_ps(&boxes.extentY[i]);
+            const __m256 extentZ = _mm256_loadu_ps(&boxes.extentZ[i]);
+
+            for (uint32_t remainingViews = viewMask; remainingViews != 0; remainingViews &= remainingViews - 1)
+            {
+                const uint32_t v = std::countr_zero(remainingViews);
+                const FrustumCuller::Planes& planes = views[v];
+
+                __m256 visible = allSet;
+                for (uint32_t p = 0; p < 6; ++p)
+                {
+                    if (!(planeMasks[v] & (1u << p)))
+                    {
+                        continue;
+                    }
+
+                    __m256 distance = _mm256_mul_ps(_mm256_set1_ps(planes.normalX[p]), centerX);
+                    distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.normalY[p]), centerY));
+                    distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.normalZ[p]), centerZ));
+                    distance = _mm256_add_ps(distance, _mm256_set1_ps(planes.distance[p]));
+
+                    __m256 projectedExtent = _mm256_mul_ps(_mm256_set1_ps(planes.absNormalX[p]), extentX);
+                    projectedExtent = _mm256_add_ps(projectedExtent, _mm256_mul_ps(_mm256_set1_ps(planes.absNormalY[p]), extentY));
+                    projectedExtent = _mm256_add_ps(projectedExtent, _mm256_mul_ps(_mm256_set1_ps(planes.absNormalZ[p]), extentZ));
+
+                    visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(distance, projectedExtent), zero, _CMP_GT_OQ));
+                }
+
+                visibleBits[v] |= static_cast<uint32_t>(_mm256_movemask_ps(visible)) << lane;
+            }
+        }
+    }
+
+    TARGET_AVX512 void CullViewsAVX512(const FrustumCuller::Planes* views, const uint8_t* planeMasks, uint32_t viewMask, const CullBoxes& boxes, size_t index, uint32_t* visibleBits)
+    {
+        const __m512 zero = _mm512_setzero_ps();
+
+        const __m512 centerX = _mm512_loadu_ps(&boxes.centerX[index]);
+        const __m512 centerY = _mm512_loadu_ps(&boxes.centerY[index]);
+        const __m512 centerZ = _mm512_loadu_ps(&boxes.centerZ[index]);
+        const __m512 extentX = _mm512_loadu_ps(&boxes.extentX[index]);
+        const __m512 extentY = _mm512_loadu_ps(&boxes.extentY[index]);
+        const __m512 extentZ = _mm512_loadu_ps(&boxes.extentZ[index]);
+
+        for (uint32_t remainingViews = viewMask; remainingViews != 0; remainingViews &= remainingViews - 1)
+        {
+            const uint32_t v = std::countr_zero(remainingViews);
+            const FrustumCuller::Planes& planes = views[v];
+
+            __mmask16 visible = 0xFFFF;
+            for (uint32_t p = 0; p < 6; ++p)
+            {
+                if (!(planeMasks[v] & (1u << p)))
+                {
+                    continue;
+                }
+
+                __m512 distance = _mm512_mul_ps(_mm512_set1_ps(planes.normalX[p]), centerX);
+                distance = _mm512_add_ps(distance, _mm512_mul_ps(_mm512_set1_ps(planes.normalY[p]), centerY));
+                distance = _mm512_add_ps(distance, _mm512_mul_ps(_mm512_set1_ps(planes.normalZ[p]), centerZ));
+                distance = _mm512_add_ps(distance, _mm512_set1_ps(planes.distance[p]));
+
+                __m512 projectedExtent = _mm512_mul_ps(_mm512_set1_ps(planes.absNormalX[p]), extentX);
+                projectedExtent = _mm512_add_ps(projectedExtent, _mm512_mul_ps(_mm512_set1_ps(planes.absNormalY[p]), extentY));
+                projectedExtent = _mm512_add_ps(projectedExtent, _mm512_mul_ps(_mm512_set1_ps(planes.absNormalZ[p]), extentZ));
+
+                visible &= _mm512_cmp_ps_mask(_mm512_add_ps(distance, projectedExtent), zero, _CMP_GT_OQ);
+            }
+
+            visibleBits[v] |= static_cast<uint32_t>(visible);
+        }
+    }
+
+    MultiCullFunction GetMultiCullFunction(FrustumCuller::Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case FrustumCuller::Kernel::SSE:
+            return CullViewsSSE;
+        case FrustumCuller::Kernel::AVX2:
+            return CullViewsAVX2;
+        case FrustumCuller::Kernel::AVX512:
+            return CullViewsAVX512;
+        default:
+            return CullViewsScalar;
+        }
+    }
+
+    // EAX, EBX, ECX and EDX of the leaf, subleaf 0
+    void CpuId(int info[4], int leaf)
+    {
+#if defined(_MSC_VER)
+        __cpuidex(info, leaf, 0);
+#else
+        __cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+#endif
+    }
+
+    // XCR0, the register states the OS saves on a context switch
+    uint64_t GetEnabledState()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t low;
+        uint32_t high;
+        __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+        return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+    }
+
+    FrustumCuller::Planes GetPlanes(const FrustumVolume& frustum)
+    {
+        FrustumCuller::Planes planes;
+        for (uint32_t p = 0; p < 6; ++p)
+        {
+            XMFLOAT4 plane;
+            XMStoreFloat4(&plane, frustum.planes[p]);
+
+            planes.normalX[p] = plane.x;
+            planes.normalY[p] = plane.y;
+            planes.normalZ[p] = plane.z;
+            planes.distance[p] = plane.w;
+            planes.absNormalX[p] = std::abs(plane.x);
+            planes.absNormalY[p] = std::abs(plane.y);
+            planes.absNormalZ[p] = std::abs(plane.z);
+        }
+
+        planes.positionX = 0.0f;
+        planes.positionY = 0.0f;
+        planes.positionZ = 0.0f;
+        planes.pixelScaleSquared = 0.0f;
+
+        return planes;
+    }
+
+    // The box test of the scalar kernel, the sphere only rejects boxes the box test rejects too
+    FrustumIntersection ClassifyBox(const FrustumCuller::Planes& planes, const XMFLOAT3& center, const XMFLOAT3& extent, uint32_t& planeMask, uint8_t& lastPlane, size_t& planeTestCount)
+    {
+        if (planeMask == 0)
+        {
+            return FrustumIntersection::Inside;
+        }
+
+        uint32_t remainingMask = planeMask;
+        uint32_t p = (planeMask >> lastPlane) & 1 ? lastPlane : std::countr_zero(planeMask);
+        while (remainingMask != 0)
+        {
+            remainingMask &= ~(1u << p);
+            ++planeTestCount;
+
+            float distance = planes.normalX[p] * center.x;
+            distance = distance + planes.normalY[p] * center.y;
+            distance = distance + planes.normalZ[p] * center.z;
+            distance = distance + planes.distance[p];
+
+            float projectedExtent = planes.absNormalX[p] * extent.x;
+            projectedExtent = projectedExtent + planes.absNormalY[p] * extent.y;
+            projectedExtent = projectedExtent + planes.absNormalZ[p] * extent.z;
+
+            if (!(distance + projectedExtent > 0.0f))
+            {
+                lastPlane = static_cast<uint8_t>(p);
+                return FrustumIntersection::Outside;
+            }
+            if (distance - projectedExtent >= 0.0f)
+            {
+                planeMask &= ~(1u << p);
+            }
+
+            p = std::countr_zero(remainingMask);
+        }
+
+        return planeMask == 0 ? FrustumIntersection::Inside : FrustumIntersection::Intersecting;
+    }
+}
+
+void CullBoxes::Resize(size_t newCount)
+{
+    count = newCount;
+
+    // The padding boxes are points at the origin, their bits are masked out
+    for (std::vector<float>* component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius, &minSize })
+    {
+        component->resize(newCount + PADDING, 0.0f);
+    }
+}
+
+void CullBoxes::Set(size_t index, const XMFLOAT3& min, const XMFLOAT3& max)
+{
+    centerX[index] = 0.5f * (min.x + max.x);
+    centerY[index] = 0.5f * (min.y + max.y);
+    centerZ[index] = 0.5f * (min.z + max.z);
+    extentX[index] = 0.5f * (max.x - min.x);
+    extentY[index] = 0.5f * (max.y - min.y);
+    extentZ[index] = 0.5f * (max.z - min.z);
+
+    // Slightly larger, so the rounding never lets the sphere reject a box the box test keeps
+    radius[index] = 1.0001f * std::sqrt(extentX[index] * extentX[index] + extentY[index] * extentY[index] + extentZ[index] * extentZ[index]);
+}
+
+FrustumCuller::FrustumCuller(const FrustumVolume& frustum)
+    : _planes(GetPlanes(frustum))
+    , _kernel(GetSupportedKernel())
+{
+}
+
+FrustumCuller::~FrustumCuller()
+{
+}
+
+FrustumCuller::Kernel FrustumCuller::GetSupportedKernel()
+{
+    static const Kernel supportedKernel = []()
+    {
+        int info[4];
+
+        // AVX needs the OS to save the YMM state, AVX-512 the ZMM and opmask state too
+        CpuId(info, 1);
+        const bool hasOSXSave = (info[2] & (1 << 27)) != 0;
+        const bool hasAVX = (info[2] & (1 << 28)) != 0;
+        if (!hasOSXSave || !hasAVX)
+        {
+            return Kernel::SSE;
+        }
+
+        const uint64_t enabledState = GetEnabledState();
+
+        CpuId(info, 7);
+        const bool hasAVX2 = (info[1] & (1 << 5)) != 0;
+        const bool hasAVX512 = (info[1] & (1 << 16)) != 0;
+
+        if (hasAVX512 && (enabledState & 0xE6) == 0xE6)
+        {
+            return Kernel::AVX512;
+        }
+        if (hasAVX2 && (enabledState & 0x6) == 0x6)
+        {
+            return Kernel::AVX2;
+        }
+        return Kernel::SSE;
+    }();
+
+    return supportedKernel;
+}
+
+void FrustumCuller::SetKernel(Kernel kernel)
+{
+    LOG_WARNING(kernel <= GetSupportedKernel(), "The CPU does not support the culling kernel");
+
+    _kernel = std::min(kernel, GetSupportedKernel());
+}
+
+FrustumCuller::Kernel FrustumCuller::GetKernel() const
+{
+    return _kernel;
+}
+
+void FrustumCuller::SetScreenSize(FXMVECTOR position, float pixelScale)
+{
+    XMFLOAT3 cameraPosition;
+    XMStoreFloat3(&cameraPosition, position);
+
+    _planes.positionX = cameraPosition.x;
+    _planes.positionY = cameraPosition.y;
+    _planes.positionZ = cameraPosition.z;
+    _planes.pixelScaleSquared = pixelScale * pixelScale;
+}
+
+bool FrustumCuller::IsScreenSizeCulled() const
+{
+    return _planes.pixelScaleSquared > 0.0f;
+}
+
+bool FrustumCuller::IsTooSmall(const XMFLOAT3& center, float radius, float minSize) const
+{
+    return IsScreenSizeCulled() && IsSmallScalar(_planes, center.x, center.y, center.z, radius, minSize);
+}
+
+void FrustumCuller::Cull(const CullBoxes& boxes, size_t first, size_t count, uint32_t planeMask, uint64_t* visibleMask, uint64_t* insideMask, uint64_t* smallMask) const
+{
+    if (ASSERT(first + count <= boxes.count, "Culling past the last box"))
+    {
+        return;
+    }
+
+    const CullFunction cull = GetCullFunction(_kernel);
+
+    for (size_t i = 0; i < count; i += BATCH_SIZE)
+    {
+        uint32_t insideBits;
+        uint32_t smallBits;
+        uint32_t visibleBits = cull(_planes, planeMask, boxes, first + i, insideBits, smallBits);
+
+        // The boxes past the range are in the batch too
+        if (count - i < BATCH_SIZE)
+        {
+            const uint32_t rangeBits = (1u << (count - i)) - 1;
+            visibleBits &= rangeBits;
+            insideBits &= rangeBits;
+            smallBits &= rangeBits;
+        }
+
+        // A batch never straddles two words
+        const size_t word = i / 64;
+        const uint32_t shift = i % 64;
+        if (shift == 0)
+        {
+            visibleMask[word] = 0;
+            if (insideMask)
+            {
+                insideMask[word] = 0;
+            }
+            if (smallMask)
+            {
+                smallMask[word] = 0;
+            }
+        }
+
+        visibleMask[word] |= static_cast<uint64_t>(visibleBits) << shift;
+        if (insideMask)
+        {
+            insideMask[word] |= static_cast<uint64_t>(insideBits) << shift;
+        }
+        if (smallMask)
+        {
+            smallMask[word] |= static_cast<uint64_t>(smallBits) << shift;
+        }
+    }
+}
+
+void FrustumCuller::Cull(const CullBoxes& boxes, size_t first, size_t count, std::vector<uint32_t>& visible, uint32_t planeMask) const
+{
+    for (size_t i = 0; i < count; i += 64)
+    {
+        uint64_t visibleMask = 0;
+        Cull(boxes, first + i, std::min<size_t>(64, count - i), planeMask, &visibleMask);
+
+        for (; visibleMask != 0; visibleMask &= visibleMask - 1)
+        {
+            visible.push_back(static_cast<uint32_t>(first + i + std::countr_zero(visibleMask)));
+        }
+    }
+}
+
+FrustumIntersection FrustumCuller::Classify(const XMFLOAT3& center, const XMFLOAT3& extent, uint32_t& planeMask, uint8_t& lastPlane, size_t& planeTestCount) const
+{
+    return ClassifyBox(_planes, center, extent, planeMask, lastPlane, planeTestCount);
+}
+
+MultiFrustumCuller::MultiFrustumCuller(std::span<const FrustumVolume* const> frusta)
+    : _viewPlanes{}
+    , _viewCount(0)
+    , _kernel(FrustumCuller::GetSupportedKernel())
+{
+    LOG_WARNING(frusta.size() <= MAX_VIEW_COUNT, "Too many views culled together, the last ones are skipped");
+
+    for (const FrustumVolume* frustum : frusta.first(std::min<size_t>(frusta.size(), MAX_VIEW_COUNT)))
+    {
+        const uint32_t v = _viewCount++;
+        _views[v] = GetPlanes(*frustum);
+
+        for (uint32_t p = 0; p < 6; ++p)
+        {
+            _viewPlanes.normalX[p][v] = _views[v].normalX[p];
+            _viewPlanes.normalY[p][v] = _views[v].normalY[p];
+            _viewPlanes.normalZ[p][v] = _views[v].normalZ[p];
+            _viewPlanes.distance[p][v] = _views[v].distance[p];
+            _viewPlanes.absNormalX[p][v] = _views[v].absNormalX[p];
+            _viewPlanes.absNormalY[p][v] = _views[v].absNormalY[p];
+            _viewPlanes.absNormalZ[p][v] = _views[v].absNormalZ[p];
+        }
+    }
+}
+
+MultiFrustumCuller::~MultiFrustumCuller()
+{
+}
+
+void MultiFrustumCuller::SetKernel(FrustumCuller::Kernel kernel)
+{
+    LOG_WARNING(kernel <= FrustumCuller::GetSupportedKernel(), "The CPU does not support the culling kernel");
+
+    _kernel = std::min(kernel, FrustumCuller::GetSupportedKernel());
+}
+
+FrustumCuller::Kernel MultiFrustumCuller::GetKernel() const
+{
+    return _kernel;
+}
+
+uint32_t MultiFrustumCuller::GetViewCount() const
+{
+    return _viewCount;
+}
+
+uint32_t MultiFrustumCuller::GetAllViews() const
+{
+    return (1u << _viewCount) - 1;
+}
+
+void MultiFrustumCuller::Cull(const CullBoxes& boxes, size_t first, size_t count, uint32_t viewMask, const uint8_t* planeMasks, uint32_t* viewMasks) const
+{
+    if (ASSERT(first + count <= boxes.count, "Culling past the last box"))
+    {
+        return;
+    }
+
+    const MultiCullFunction cull = GetMultiCullFunction(_kernel);
+    viewMask &= GetAllViews();
+
+    for (size_t i = 0; i < count; i += BATCH_SIZE)
+    {
+        uint32_t visibleBits[MAX_VIEW_COUNT] = {};
+        cull(_views, planeMasks, viewMask, boxes, first + i, visibleBits);
+
+        // The boxes past the range are in the batch too
+        const size_t batchCount = std::min<size_t>(BATCH_SIZE, count - i);
+        const uint32_t rangeBits = (1u << batchCount) - 1;
+
+        std::fill(viewMasks + i, viewMasks + i + batchCount, 0u);
+        for (uint32_t remainingViews = viewMask; remainingViews != 0; remainingViews &= remainingViews - 1)
+        {
+            const uint32_t v = std::countr_zero(remainingViews);
+            for (uint32_t bits = visibleBits[v] & rangeBits; bits != 0; bits &= bits - 1)
+            {
+                viewMasks[i + std::countr_zero(bits)] |= 1u << v;
+            }
+        }
+    }
+}
+
+uint32_t MultiFrustumCuller::Classify(const XMFLOAT3& center, const XMFLOAT3& extent, uint32_t viewMask, uint8_t* planeMasks, size_t& planeTestCount) const
+{
+    const __m128 zero = _mm_setzero_ps();
+
+    // Loaded once for all the views
+    const __m128 centerX = _mm_set1_ps(center.x);
+    const __m128 centerY = _mm_set1_ps(center.y);
+    const __m128 centerZ = _mm_set1_ps(center.z);
+    const __m128 extentX = _mm_set1_ps(extent.x);
+    const __m128 extentY = _mm_set1_ps(extent.y);
+    const __m128 extentZ = _mm_set1_ps(extent.z);
+
+    uint32_t visibleViews = 0;
+    for (uint32_t first = 0; first < _viewCount; first += 4)
+    {
+        const uint32_t groupMask = (viewMask >> first) & 0xF;
+        if (groupMask == 0)
+        {
+            continue;
+        }
+
+        // The plane masks of 4 views, one per lane
+        const __m128i laneMasks = _mm_setr_epi32(planeMasks[first], planeMasks[first + 1], planeMasks[first + 2], planeMasks[first + 3]);
+
+        __m128 visible = _mm_castsi128_ps(_mm_cmpeq_epi32(laneMasks, laneMasks));
+        __m128i insidePlanes = _mm_setzero_si128();
+        for (uint32_t p = 0; p < 6; ++p)
+        {
+            const __m128i plane = _mm_set1_epi32(1 << p);
+            const __m128 isTested = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(laneMasks, plane), plane));
+
+            const uint32_t testedViews = static_cast<uint32_t>(_mm_movemask_ps(isTested)) & groupMask;
+            if (testedViews == 0)
+            {
+                continue;
+            }
+            planeTestCount += std::popcount(testedViews);
+
+            __m128 distance = _mm_mul_ps(_mm_loadu_ps(&_viewPlanes.normalX[p][first]), centerX);
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_loadu_ps(&_viewPlanes.normalY[p][first]), centerY));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_loadu_ps(&_viewPlanes.normalZ[p][first]), centerZ));
+            distance = _mm_add_ps(distance, _mm_loadu_ps(&_viewPlanes.distance[p][first]));
+
+            __m128 projectedExtent = _mm_mul_ps(_mm_loadu_ps(&_viewPlanes.absNormalX[p][first]), extentX);
+            projectedExtent = _mm_add_ps(projectedExtent, _mm_mul_ps(_mm_loadu_ps(&_viewPlanes.absNormalY[p][first]), extentY));
+            projectedExtent = _mm_add_ps(projectedExtent, _mm_mul_ps(_mm_loadu_ps(&_viewPlanes.absNormalZ[p][first]), extentZ));
+
+            // The planes not in the mask of a view neither reject nor contain the box
+            const __m128 isOutside = _mm_andnot_ps(_mm_cmpgt_ps(_mm_add_ps(distance, projectedExtent), zero), isTested);
+            const __m128 isInside = _mm_and_ps(_mm_cmpge_ps(_mm_sub_ps(distance, projectedExtent), zero), isTested);
+
+            visible = _mm_andnot_ps(isOutside, visible);
+            insidePlanes = _mm_or_si128(insidePlanes, _mm_and_si128(_mm_castps_si128(isInside), plane));
+
+            // Outside of all the views of the group
+            if ((static_cast<uint32_t>(_mm_movemask_ps(visible)) & groupMask) == 0)
+            {
+                break;
+            }
+        }
+
+        alignas(16) uint32_t remainingMasks[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(remainingMasks), _mm_andnot_si128(insidePlanes, laneMasks));
+
+        for (uint32_t lanes = static_cast<uint32_t>(_mm_movemask_ps(visible)) & groupMask; lanes != 0; lanes &= lanes - 1)
+        {
+            const uint32_t lane = std::countr_zero(lanes);
+            planeMasks[first + lane] = static_cast<uint8_t>(remainingMasks[lane]);
+            visibleViews |= 1u << (first + lane);
+        }
+    }
+
+    return visibleViews;
+}
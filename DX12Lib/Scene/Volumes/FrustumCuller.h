@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Scene/Volumes/FrustumVolume.h"
+
+// Boxes as centre and half extent with an array per component, so the culling kernels load one
+// component of 4, 8 or 16 boxes at once. The arrays are padded for the widest kernel to read past
+// the last box
+struct CullBoxes
+{
+    static constexpr size_t PADDING = 16;
+
+    void Resize(size_t newCount);
+    void Set(size_t index, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max);
+
+    size_t count = 0;
+
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+    std::vector<float> radius;         // Of the bounding sphere, for the early reject
+    std::vector<float> minSize;        // Projected diameter in pixels below which the box is too small to draw, 0 by default
+};
+
+// Frustum planes prepared for testing boxes by centre and extent. A box is visible while it
+// reaches in front of every plane, and inside while it is in front of every plane entirely.
+// The batches run the widest kernel the CPU supports, and every kernel matches the scalar one
+// bit for bit: the same operations in the same order, without fused multiply-adds. The plane
+// masks are the ones of FrustumVolume, the planes a parent box is inside of are skipped. With a
+// screen size set, the batches also cull the boxes whose bounding spheres project smaller than
+// their minimum size, from the distance to the camera so the result does not change as it turns
+class FrustumCuller
+{
+public:
+    enum class Kernel
+    {
+        Scalar,
+        SSE,
+        AVX2,
+        AVX512,
+    };
+
+    explicit FrustumCuller(const FrustumVolume& frustum);
+    ~FrustumCuller();
+
+    static Kernel GetSupportedKernel();
+    // For comparing the kernels, the supported one by default
+    void SetKernel(Kernel kernel);
+    Kernel GetKernel() const;
+
+    // The projected diameter in pixels of a unit sphere at unit distance, the vertical projection
+    // scale times the viewport height. 0 turns the screen size culling off, as by default
+    void SetScreenSize(DirectX::FXMVECTOR position, float pixelScale);
+    bool IsScreenSizeCulled() const;
+    // The test of the batches for a single box, as set by CullBoxes::Set
+    bool IsTooSmall(const DirectX::XMFLOAT3& center, float radius, float minSize) const;
+
+    // Bit i of the masks for the box first + i, the words past the range are not written. The boxes
+    // inside the frustum but too small are not visible, they are set in the small mask
+    void Cull(const CullBoxes& boxes, size_t first, size_t count, uint32_t planeMask, uint64_t* visibleMask, uint64_t* insideMask = nullptr, uint64_t* smallMask = nullptr) const;
+    // Appends the indices of the visible boxes
+    void Cull(const CullBoxes& boxes, size_t first, size_t count, std::vector<uint32_t>& visible, uint32_t planeMask = FrustumVolume::ALL_PLANES) const;
+
+    // A single box for the hierarchical culling, as Classify of FrustumVolume
+    FrustumIntersection Classify(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extent, uint32_t& planeMask, uint8_t& lastPlane, size_t& planeTestCount) const;
+
+    // Plane components splatted by plane, the absolute normals project the extents
+    struct Planes
+    {
+        float normalX[6];
+        float normalY[6];
+        float normalZ[6];
+        float distance[6];
+        float absNormalX[6];
+        float absNormalY[6];
+        float absNormalZ[6];
+
+        // For the screen size, squared as the distance is
+        float positionX;
+        float positionY;
+        float positionZ;
+        float pixelScaleSquared;
+    };
+
+private:
+    Planes _planes;
+    Kernel _kernel;
+};
+
+// The frusta of several views tested in a single pass over the boxes. Every batch of boxes is loaded
+// once and tested against the planes of all the views, the views a parent box is inside of test no
+// planes. Every view matches FrustumCuller bit for bit, without the screen size
+class MultiFrustumCuller
+{
+public:
+    static constexpr uint32_t MAX_VIEW_COUNT = 8;
+
+    // The planes of every view, up to MAX_VIEW_COUNT
+    explicit MultiFrustumCuller(std::span<const FrustumVolume* const> frusta);
+    ~MultiFrustumCuller();
+
+    void SetKernel(FrustumCuller::Kernel kernel);
+    FrustumCuller::Kernel GetKernel() const;
+
+    uint32_t GetViewCount() const;
+    // Bit v for view v
+    uint32_t GetAllViews() const;
+
+    // Bit v of viewMasks[i] if the box first + i is in view v, for the views of the mask. The planes
+    // of view v are the ones of planeMasks[v]
+    void Cull(const CullBoxes& boxes, size_t first, size_t count, uint32_t viewMask, const uint8_t* planeMasks, uint32_t* viewMasks) const;
+
+    // A single box for the hierarchical culling against the views of the mask, as Classify of
+    // FrustumCuller for every view, 4 views per SSE compare. Returns the views the box is not outside of
+    uint32_t Classify(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extent, uint32_t viewMask, uint8_t* planeMasks, size_t& planeTestCount) const;
+
+private:
+    // The planes by plane and view, the views past the count are zero
+    struct ViewPlanes
+    {
+        float normalX[6][MAX_VIEW_COUNT];
+        float normalY[6][MAX_VIEW_COUNT];
+        float normalZ[6][MAX_VIEW_COUNT];
+        float distance[6][MAX_VIEW_COUNT];
+        float absNormalX[6][MAX_VIEW_COUNT];
+        float absNormalY[6][MAX_VIEW_COUNT];
+        float absNormalZ[6][MAX_VIEW_COUNT];
+    };
+
+    FrustumCuller::Planes _views[MAX_VIEW_COUNT];
+    ViewPlanes _viewPlanes;
+    uint32_t _viewCount;
+    FrustumCuller::Kernel _kernel;
+};
@@ -4,86 +4,75 @@
 
 #include "Scene/Volumes/AABBVolume.h"
 
-using namespace DirectX;
-
-namespace
-{
-    bool IntersectWithPlane(const XMVECTOR& plane, const AABBVolume& aabb)
-    {
-        bool result = true;
+#include <bit>
 
-        XMVECTOR aabbCenter = (aabb.max + aabb.min) * 0.5f;
-        XMVECTOR aabbHalfSize = (aabb.max - aabb.min) * 0.5f;
-
-        float rg = abs(XMVectorGetX(plane) * XMVectorGetX(aabbHalfSize))
-                 + abs(XMVectorGetY(plane) * XMVectorGetY(aabbHalfSize))
-                 + abs(XMVectorGetZ(plane) * XMVectorGetZ(aabbHalfSize));
-
-        if (XMVectorGetX(XMPlaneDotCoord(plane, aabbCenter)) <= -rg)
-        {
-            result = false;
-        }
-
-        return result;
-    }
-}
+using namespace DirectX;
 
 void FrustumVolume::BuildFromProjMatrix(const DirectX::XMMATRIX projectionMatrix)
 {
+    // The elements through a store, m128_f32 is MSVC only
+    XMFLOAT4X4 matrix;
+    XMStoreFloat4x4(&matrix, projectionMatrix);
+
     // Calculate left plane of frustum.
-    planes[0] = XMVectorSet(projectionMatrix.r[0].m128_f32[3] + projectionMatrix.r[0].m128_f32[0],
-                            projectionMatrix.r[1].m128_f32[3] + projectionMatrix.r[1].m128_f32[0],
-                            projectionMatrix.r[2].m128_f32[3] + projectionMatrix.r[2].m128_f32[0],
-                            projectionMatrix.r[3].m128_f32[3] + projectionMatrix.r[3].m128_f32[0]);
+    planes[0] = XMVectorSet(matrix.m[0][3] + matrix.m[0][0],
+                            matrix.m[1][3] + matrix.m[1][0],
+                            matrix.m[2][3] + matrix.m[2][0],
+                            matrix.m[3][3] + matrix.m[3][0]);
     planes[0] = XMPlaneNormalize(planes[0]);
     leftPlane = &planes[0];
 
     // Calculate right plane of frustum.
-    planes[1] = XMVectorSet(projectionMatrix.r[0].m128_f32[3] - projectionMatrix.r[0].m128_f32[0],
-                            projectionMatrix.r[1].m128_f32[3] - projectionMatrix.r[1].m128_f32[0],
-                            projectionMatrix.r[2].m128_f32[3] - projectionMatrix.r[2].m128_f32[0],
-                            projectionMatrix.r[3].m128_f32[3] - projectionMatrix.r[3].m128_f32[0]);
+    planes[1] = XMVectorSet(matrix.m[0][3] - matrix.m[0][0],
+                            matrix.m[1][3] - matrix.m[1][0],
+                            matrix.m[2][3] - matrix.m[2][0],
+                            matrix.m[3][3] - matrix.m[3][0]);
     planes[1] = XMPlaneNormalize(planes[1]);
     rightPlane = &planes[1];
 
     // Calculate bottom plane of frustum.
-    planes[2] = XMVectorSet(projectionMatrix.r[0].m128_f32[3] + projectionMatrix.r[0].m128_f32[1],
-                            projectionMatrix.r[1].m128_f32[3] + projectionMatrix.r[1].m128_f32[1],
-                            projectionMatrix.r[2].m128_f32[3] + projectionMatrix.r[2].m128_f32[1],
-                            projectionMatrix.r[3].m128_f32[3] + projectionMatrix.r[3].m128_f32[1]);
+    planes[2] = XMVectorSet(matrix.m[0][3] + matrix.m[0][1],
+                            matrix.m[1][3] + matrix.m[1][1],
+                            matrix.m[2][3] + matrix.m[2][1],
+                            matrix.m[3][3] + matrix.m[3][1]);
     planes[2] = XMPlaneNormalize(planes[2]);
     bottomPlane = &planes[2];
 
     // Calculate top plane of frustum.
-    planes[3] = XMVectorSet(projectionMatrix.r[0].m128_f32[3] - projectionMatrix.r[0].m128_f32[1],
-                            projectionMatrix.r[1].m128_f32[3] - projectionMatrix.r[1].m128_f32[1],
-                            projectionMatrix.r[2].m128_f32[3] - projectionMatrix.r[2].m128_f32[1],
-                            projectionMatrix.r[3].m128_f32[3] - projectionMatrix.r[3].m128_f32[1]);
+    planes[3] = XMVectorSet(matrix.m[0][3] - matrix.m[0][1],
+                            matrix.m[1][3] - matrix.m[1][1],
+                            matrix.m[2][3] - matrix.m[2][1],
+                            matrix.m[3][3] - matrix.m[3][1]);
     planes[3] = XMPlaneNormalize(planes[3]);
     topPlane = &planes[3];
 
     // Calculate near plane of frustum.
-    planes[4] = XMVectorSet(projectionMatrix.r[0].m128_f32[3] + projectionMatrix.r[0].m128_f32[2],
-                            projectionMatrix.r[1].m128_f32[3] + projectionMatrix.r[1].m128_f32[2],
-                            projectionMatrix.r[2].m128_f32[3] + projectionMatrix.r[2].m128_f32[2],
-                            projectionMatrix.r[3].m128_f32[3] + projectionMatrix.r[3].m128_f32[2]);
+    planes[4] = XMVectorSet(matrix.m[0][3] + matrix.m[0][2],
+                            matrix.m[1][3] + matrix.m[1][2],
+                            matrix.m[2][3] + matrix.m[2][2],
+                            matrix.m[3][3] + matrix.m[3][2]);
     planes[4] = XMPlaneNormalize(planes[4]);
     nearPlane = &planes[4];
 
     // Calculate far plane of frustum.
-    planes[5] = XMVectorSet(projectionMatrix.r[0].m128_f32[3] - projectionMatrix.r[0].m128_f32[2],
-                            projectionMatrix.r[1].m128_f32[3] - projectionMatrix.r[1].m128_f32[2],
-                            projectionMatrix.r[2].m128_f32[3] - projectionMatrix.r[2].m128_f32[2],
-                            projectionMatrix.r[3].m128_f32[3] - projectionMatrix.r[3].m128_f32[2]);
+    planes[5] = XMVectorSet(matrix.m[0][3] - matrix.m[0][2],
+                            matrix.m[1][3] - matrix.m[1][2],
+                            matrix.m[2][3] - matrix.m[2][2],
+                            matrix.m[3][3] - matrix.m[3][2]);
     planes[5] = XMPlaneNormalize(planes[5]);
     farPlane = &planes[5];
 }
 
 bool Intersect(const FrustumVolume& frustum, const AABBVolume& aabb)
 {
+    // The centre and half size once for all the planes, FrustumCuller tests many boxes at a time
+    const XMVECTOR aabbCenter = (aabb.max + aabb.min) * 0.5f;
+    const XMVECTOR aabbHalfSize = (aabb.max - aabb.min) * 0.5f;
+
     for (const XMVECTOR& plane : frustum.planes)
     {
-        if (!IntersectWithPlane(plane, aabb))
+        const XMVECTOR rg = XMVector3Dot(XMVectorAbs(plane), aabbHalfSize);
+        if (XMVector4LessOrEqual(XMPlaneDotCoord(plane, aabbCenter), -rg))
         {
             return false;
         }
@@ -91,3 +80,39 @@ bool Intersect(const FrustumVolume& frustum, const AABBVolume& aabb)
 
     return true;
 }
+
+FrustumIntersection Classify(const FrustumVolume& frustum, const AABBVolume& aabb, uint32_t& planeMask, uint8_t& lastPlane, size_t& planeTestCount)
+{
+    if (planeMask == 0)
+    {
+        return FrustumIntersection::Inside;
+    }
+
+    const XMVECTOR aabbCenter = (aabb.max + aabb.min) * 0.5f;
+    const XMVECTOR aabbHalfSize = (aabb.max - aabb.min) * 0.5f;
+
+    // The rejecting plane of the last time first, then the others of the mask
+    uint32_t remainingMask = planeMask;
+    uint32_t plane = (planeMask >> lastPlane) & 1 ? lastPlane : std::countr_zero(planeMask);
+    while (remainingMask != 0)
+    {
+        remainingMask &= ~(1u << plane);
+        ++planeTestCount;
+
+        const XMVECTOR distance = XMPlaneDotCoord(frustum.planes[plane], aabbCenter);
+        const XMVECTOR rg = XMVector3Dot(XMVectorAbs(frustum.planes[plane]), aabbHalfSize);
+        if (XMVector4LessOrEqual(distance, -rg))
+        {
+            lastPlane = static_cast<uint8_t>(plane);
+            return FrustumIntersection::Outside;
+        }
+        if (XMVector4GreaterOrEqual(distance, rg))
+        {
+            planeMask &= ~(1u << plane);
+        }
+
+        plane = std::countr_zero(remainingMask);
+    }
+
+    return planeMask == 0 ? FrustumIntersection::Inside : FrustumIntersection::Intersecting;
+}
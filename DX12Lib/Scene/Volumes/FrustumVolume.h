@@ -4,12 +4,33 @@
 
 class AABBVolume;
 
+enum class FrustumIntersection
+{
+    Outside,
+    Intersecting,
+    Inside,
+};
+
+// Bounds and planes tested by a culling traversal
+struct FrustumTestCount
+{
+    size_t boundsCount = 0;
+    size_t planeCount = 0;
+};
+
 class FrustumVolume : public IVolume
 {
 public:
+    // Bit i of the plane masks stands for planes[i]
+    static constexpr uint32_t ALL_PLANES = 0x3F;
+
     void BuildFromProjMatrix(const DirectX::XMMATRIX projectionMatrix);
 
     friend bool Intersect(const FrustumVolume& frustum, const AABBVolume& aabb);
+    // For the hierarchies: only the planes of planeMask are tested, lastPlane first, the plane that
+    // rejected the box the last time. The planes the box is entirely in front of are cleared from
+    // the mask for the children of the box, an empty mask is inside. Adds the planes tested
+    friend FrustumIntersection Classify(const FrustumVolume& frustum, const AABBVolume& aabb, uint32_t& planeMask, uint8_t& lastPlane, size_t& planeTestCount);
 
     DirectX::XMVECTOR* leftPlane;
     DirectX::XMVECTOR* rightPlane;
@@ -0,0 +1,37 @@
+// Every texel of the depth readback keeps the farthest depth of the block of depth buffer
+// pixels it covers, the pixels it covers partially included, so nothing is nearer on the CPU
+// than it was on the screen.
+
+struct TargetDesc
+{
+    uint2 Size;
+};
+
+struct PixelShaderInput
+{
+    float4 Position : SV_Position;
+};
+
+ConstantBuffer<TargetDesc> Target : register(b0);
+Texture2D<float> Depth : register(t0);
+
+float main(PixelShaderInput IN) : SV_Target
+{
+    uint2 depthSize;
+    Depth.GetDimensions(depthSize.x, depthSize.y);
+
+    uint2 texel = uint2(IN.Position.xy);
+    uint2 first = texel * depthSize / Target.Size;
+    uint2 last = min(((texel + 1) * depthSize + Target.Size - 1) / Target.Size, depthSize);
+
+    float depth = 0.0f;
+    for (uint y = first.y; y < last.y; ++y)
+    {
+        for (uint x = first.x; x < last.x; ++x)
+        {
+            depth = max(depth, Depth.Load(int3(x, y, 0)));
+        }
+    }
+
+    return depth;
+}
@@ -0,0 +1,34 @@
+// Fullscreen triangle of the depth downsample, the depth readback target is covered by the
+// vertices generated from their ids without any vertex buffer.
+
+#define DepthDownsample_RootSig \
+	"RootFlags " \
+	"( " \
+		"DENY_GEOMETRY_SHADER_ROOT_ACCESS | " \
+		"DENY_HULL_SHADER_ROOT_ACCESS | " \
+		"DENY_DOMAIN_SHADER_ROOT_ACCESS " \
+	"), " \
+    "RootConstants(num32BitConstants=2, b0, visibility=SHADER_VISIBILITY_PIXEL), " \
+    "DescriptorTable(SRV(t0), visibility=SHADER_VISIBILITY_PIXEL)"
+
+struct VertexInput
+{
+    uint vertex : SV_VertexID;
+};
+
+struct VertexShaderOutput
+{
+    float4 Position : SV_Position;
+};
+
+[RootSignature(DepthDownsample_RootSig)]
+VertexShaderOutput main(VertexInput IN)
+{
+    VertexShaderOutput OUT;
+
+    // (-1, 1), (3, 1), (-1, -3), clockwise on the screen
+    float2 uv = float2((IN.vertex << 1) & 2, IN.vertex & 2);
+    OUT.Position = float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+
+    return OUT;
+}
@@ -0,0 +1,69 @@
+
+// The Vertex Shader (VS) stage is responsible for transforming the vertex data 
+// from object-space into clip-space, performing (skeletal) animation or computing 
+// per-vertex lighting.
+//
+// Depth only variant for the depth prepass: reads the position stream of the mesh,
+// either float3 or the UNORM16 quantized positions of the packed layout. The float
+// meshes have a zero quantization offset and a unit scale.
+
+#define Sprite_RootSig \
+	"RootFlags " \
+	"( " \
+		"ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT | " \
+		"DENY_GEOMETRY_SHADER_ROOT_ACCESS | " \
+		"DENY_HULL_SHADER_ROOT_ACCESS | " \
+		"DENY_DOMAIN_SHADER_ROOT_ACCESS " \
+	"), " \
+    "RootConstants(num32BitConstants=16, b0, visibility=SHADER_VISIBILITY_ALL), " \
+    "RootConstants(num32BitConstants=1, b1, visibility=SHADER_VISIBILITY_ALL), " \
+    "CBV(b2, visibility=SHADER_VISIBILITY_ALL), " \
+	"SRV(t0, visibility=SHADER_VISIBILITY_ALL), " \
+    "DescriptorTable(SRV(t1),visibility=SHADER_VISIBILITY_PIXEL)," \
+    "StaticSampler(s0," \
+        "addressU = TEXTURE_ADDRESS_MIRROR," \
+        "addressV = TEXTURE_ADDRESS_MIRROR," \
+        "addressW = TEXTURE_ADDRESS_MIRROR," \
+        "filter = FILTER_MIN_MAG_MIP_LINEAR)," \
+
+struct ConstantsDesc
+{
+    row_major float4x4 ViewProj;
+};
+
+struct ModelDesc
+{
+    row_major matrix Model;
+    // Dequantization of the packed vertex positions
+    float4 QuantizationOffset;
+    float4 QuantizationScale;
+};
+
+ConstantBuffer<ConstantsDesc> Constants : register(b0);
+StructuredBuffer<ModelDesc> ModelSRV_CB : register(t0);
+
+struct VertexPosition
+{
+    float3 Position : POSITION;
+    
+    uint sv_instance : SV_InstanceID;
+};
+
+struct VertexShaderOutput
+{
+    float4 Position : SV_Position;
+};
+
+[RootSignature(Sprite_RootSig)]
+VertexShaderOutput main(VertexPosition IN)
+{
+    VertexShaderOutput OUT;
+
+    ModelDesc model = ModelSRV_CB[IN.sv_instance];
+    float3 position = model.QuantizationOffset.xyz + IN.Position * model.QuantizationScale.xyz;
+
+    float4 worldPosition = mul(float4(position, 1.0f), model.Model);
+    OUT.Position = mul(worldPosition, Constants.ViewProj);
+
+    return OUT;
+}
@@ -30,39 +30,35 @@ struct ConstantsDesc
 struct ModelDesc
 {
     row_major matrix Model;
+    // Dequantization of the packed vertex positions
+    float4 QuantizationOffset;
+    float4 QuantizationScale;
 };
 
 ConstantBuffer<ConstantsDesc> Constants : register(b0);
 StructuredBuffer<ModelDesc> ModelSRV_CB : register(t0);
 
-struct VertexPosColor
+// The occlusion pass only writes depth, so the AABB vertices carry positions only. The proxies
+// are instances of the unit cube, scaled to the world space box of every node
+struct VertexPosition
 {
     float3 Position : POSITION;
-    float3 Normal : NORMAL;
-    float4 Color : COLOR;
-    float2 Texture : TEXCOORD;
-    
-    uint sv_instance : SV_InstanceID;
+    float3 BoxMin : BOX_MIN;
+    float3 BoxMax : BOX_MAX;
 };
 
 struct VertexShaderOutput
 {
     float4 Position : SV_Position;
-    float3 Normal : NORMAL;
-    float4 Color : COLOR;
-    float2 Texture : TEXCOORD;
 };
 
 [RootSignature(Sprite_RootSig)]
-VertexShaderOutput main(VertexPosColor IN)
+VertexShaderOutput main(VertexPosition IN)
 {
     VertexShaderOutput OUT;
 
-    float4 worldPosition = float4(IN.Position, 1.0f);
+    float4 worldPosition = float4(lerp(IN.BoxMin, IN.BoxMax, IN.Position), 1.0f);
     OUT.Position = mul(worldPosition, Constants.ViewProj);
-    OUT.Normal = mul(float4(IN.Normal, 0.0f), ModelSRV_CB[IN.sv_instance].Model).xyz;
-    OUT.Color = IN.Color;
-    OUT.Texture = IN.Texture;
 
     return OUT;
 }
@@ -0,0 +1,91 @@
+
+// The Vertex Shader (VS) stage is responsible for transforming the vertex data 
+// from object-space into clip-space, performing (skeletal) animation or computing 
+// per-vertex lighting.
+//
+// Variant for the meshes stored in the packed vertex layout: the positions are
+// quantized to 16 bits inside the node quantization box, the normals are
+// octahedral encoded and the UVs are half floats. The color comes from the second
+// vertex stream, which has a zero stride if the mesh color is uniform.
+
+#define Sprite_RootSig \
+	"RootFlags " \
+	"( " \
+		"ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT | " \
+		"DENY_GEOMETRY_SHADER_ROOT_ACCESS | " \
+		"DENY_HULL_SHADER_ROOT_ACCESS | " \
+		"DENY_DOMAIN_SHADER_ROOT_ACCESS " \
+	"), " \
+    "RootConstants(num32BitConstants=16, b0, visibility=SHADER_VISIBILITY_ALL), " \
+    "RootConstants(num32BitConstants=1, b1, visibility=SHADER_VISIBILITY_ALL), " \
+    "CBV(b2, visibility=SHADER_VISIBILITY_ALL), " \
+	"SRV(t0, visibility=SHADER_VISIBILITY_ALL), " \
+    "DescriptorTable(SRV(t1),visibility=SHADER_VISIBILITY_PIXEL)," \
+    "StaticSampler(s0," \
+        "addressU = TEXTURE_ADDRESS_MIRROR," \
+        "addressV = TEXTURE_ADDRESS_MIRROR," \
+        "addressW = TEXTURE_ADDRESS_MIRROR," \
+        "filter = FILTER_MIN_MAG_MIP_LINEAR)," \
+
+struct ConstantsDesc
+{
+    row_major float4x4 ViewProj;
+};
+
+struct ModelDesc
+{
+    row_major matrix Model;
+    // Dequantization of the packed vertex positions
+    float4 QuantizationOffset;
+    float4 QuantizationScale;
+};
+
+ConstantBuffer<ConstantsDesc> Constants : register(b0);
+StructuredBuffer<ModelDesc> ModelSRV_CB : register(t0);
+
+struct PackedVertex
+{
+    float4 Position : POSITION;
+    float2 Normal : NORMAL;
+    float2 Texture : TEXCOORD;
+    float4 Color : COLOR;
+    
+    uint sv_instance : SV_InstanceID;
+};
+
+struct VertexShaderOutput
+{
+    float4 Position : SV_Position;
+    float3 Normal : NORMAL;
+    float4 Color : COLOR;
+    float2 Texture : TEXCOORD;
+};
+
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    if (normal.z < 0.0f)
+    {
+        float2 signs = float2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+        normal.xy = (1.0f - abs(encoded.yx)) * signs;
+    }
+
+    return normalize(normal);
+}
+
+[RootSignature(Sprite_RootSig)]
+VertexShaderOutput main(PackedVertex IN)
+{
+    VertexShaderOutput OUT;
+
+    ModelDesc model = ModelSRV_CB[IN.sv_instance];
+    float3 position = model.QuantizationOffset.xyz + IN.Position.xyz * model.QuantizationScale.xyz;
+
+    float4 worldPosition = mul(float4(position, 1.0f), model.Model);
+    OUT.Position = mul(worldPosition, Constants.ViewProj);
+    OUT.Normal = mul(float4(DecodeOctahedral(IN.Normal), 0.0f), model.Model).xyz;
+    OUT.Color = IN.Color;
+    OUT.Texture = IN.Texture;
+
+    return OUT;
+}
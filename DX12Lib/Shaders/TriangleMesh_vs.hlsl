@@ -30,6 +30,9 @@ struct ConstantsDesc
 struct ModelDesc
 {
     row_major matrix Model;
+    // Dequantization of the packed vertex positions
+    float4 QuantizationOffset;
+    float4 QuantizationScale;
 };
 
 ConstantBuffer<ConstantsDesc> Constants : register(b0);
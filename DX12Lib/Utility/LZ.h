@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Byte oriented LZ77 block compression, used by the scene packages (see Scene/ScenePackFormat.h).
+// Header only, so the FBXParser cook shares the same code.
+//
+// A block is a list of sequences:
+//     token           literal count in the high 4 bits, match length - MIN_MATCH in the low 4 bits,
+//                     15 means the count continues in the following bytes (255 means continue)
+//     literals
+//     match offset    2 bytes, little endian, distance back from the current output position
+// The last sequence has literals only.
+
+namespace LZ
+{
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t MAX_OFFSET = 65535;
+    constexpr uint32_t HASH_BITS = 16;
+    // Matches stop before the end of the block, so the last sequence always has literals
+    constexpr size_t LAST_LITERALS = 5;
+
+    namespace Detail
+    {
+        constexpr uint32_t NO_POSITION = 0xFFFFFFFF;
+
+        inline void WriteLength(std::vector<uint8_t>& out, size_t length)
+        {
+            while (length >= 255)
+            {
+                out.push_back(255);
+                length -= 255;
+            }
+            out.push_back(static_cast<uint8_t>(length));
+        }
+
+        inline bool ReadLength(const uint8_t*& src, const uint8_t* end, size_t& length)
+        {
+            uint8_t value = 255;
+            while (value == 255)
+            {
+                if (src == end)
+                {
+                    return false;
+                }
+                value = *src++;
+                length += value;
+            }
+            return true;
+        }
+
+        inline void WriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+        {
+            size_t matchCode = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+
+            uint8_t token = static_cast<uint8_t>((literalCount < 15 ? literalCount : 15) << 4);
+            if (matchLength > 0)
+            {
+                token |= static_cast<uint8_t>(matchCode < 15 ? matchCode : 15);
+            }
+            out.push_back(token);
+
+            if (literalCount >= 15)
+            {
+                WriteLength(out, literalCount - 15);
+            }
+            out.insert(out.end(), literals, literals + literalCount);
+
+            if (matchLength > 0)
+            {
+                out.push_back(static_cast<uint8_t>(offset & 0xFF));
+                out.push_back(static_cast<uint8_t>(offset >> 8));
+                if (matchCode >= 15)
+                {
+                    WriteLength(out, matchCode - 15);
+                }
+            }
+        }
+    }
+
+    // Greedy compression with a single entry hash table of the 4 byte sequences
+    inline std::vector<uint8_t> Compress(const uint8_t* data, size_t size)
+    {
+        std::vector<uint8_t> out;
+        out.reserve(size / 2 + 16);
+
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS, Detail::NO_POSITION);
+
+        const size_t matchLimit = size > LAST_LITERALS ? size - LAST_LITERALS : 0;
+        size_t anchor = 0;
+        size_t position = 0;
+
+        while (position + MIN_MATCH <= matchLimit)
+        {
+            uint32_t sequence;
+            std::memcpy(&sequence, data + position, sizeof(sequence));
+            uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+
+            uint32_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(position);
+
+            if (candidate == Detail::NO_POSITION || position - candidate > MAX_OFFSET
+                || std::memcmp(data + candidate, data + position, MIN_MATCH) != 0)
+            {
+                ++position;
+                continue;
+            }
+
+            size_t matchLength = MIN_MATCH;
+            while (position + matchLength < matchLimit && data[candidate + matchLength] == data[position + matchLength])
+            {
+                ++matchLength;
+            }
+
+            Detail::WriteSequence(out, data + anchor, position - anchor, position - candidate, matchLength);
+
+            position += matchLength;
+            anchor = position;
+        }
+
+        Detail::WriteSequence(out, data + anchor, size - anchor, 0, 0);
+
+        return out;
+    }
+
+    // Returns false if the block is corrupted or doesn't decompress to exactly dstSize bytes
+    inline bool Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+    {
+        const uint8_t* srcEnd = src + srcSize;
+        size_t written = 0;
+
+        while (src < srcEnd)
+        {
+            uint8_t token = *src++;
+
+            size_t literalCount = token >> 4;
+            if (literalCount == 15 && !Detail::ReadLength(src, srcEnd, literalCount))
+            {
+                return false;
+            }
+            if (literalCount > static_cast<size_t>(srcEnd - src) || literalCount > dstSize - written)
+            {
+                return false;
+            }
+            std::memcpy(dst + written, src, literalCount);
+            src += literalCount;
+            written += literalCount;
+
+            // The last sequence has no match
+            if (src == srcEnd)
+            {
+                break;
+            }
+
+            if (srcEnd - src < 2)
+            {
+                return false;
+            }
+            size_t offset = src[0] | (static_cast<size_t>(src[1]) << 8);
+            src += 2;
+
+            size_t matchLength = token & 0x0F;
+            if (matchLength == 15 && !Detail::ReadLength(src, srcEnd, matchLength))
+            {
+                return false;
+            }
+            matchLength += MIN_MATCH;
+
+            if (offset == 0 || offset > written || matchLength > dstSize - written)
+            {
+                return false;
+            }
+
+            // Byte by byte, the match may overlap the bytes it produces
+            const uint8_t* match = dst + written - offset;
+            for (size_t i = 0; i < matchLength; ++i)
+            {
+                dst[written + i] = match[i];
+            }
+            written += matchLength;
+        }
+
+        return written == dstSize;
+    }
+}
@@ -89,7 +89,9 @@ void Logger::Log(LogType type, const std::string& message)
     std::chrono::time_point<std::chrono::system_clock> time = std::chrono::zoned_time(std::chrono::current_zone(), std::chrono::system_clock::now()).get_sys_time();
 
     std::string output = std::format("{0:%T}", time) + " | " + logType(type) + ": " + message + '\n';
-    Instance()._logFile << output;
+    Logger& logger = Instance();
+    std::lock_guard<std::mutex> lock(logger._logMutex);
+    logger._logFile << output;
 }
 
 void Logger::SetLogLevel(LogType logLevel)
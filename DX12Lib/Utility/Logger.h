@@ -43,6 +43,8 @@ private:
     ~Logger();
 
     std::fstream _logFile;
+    // The scene loader logs from its worker threads
+    std::mutex _logMutex;
 
     static LogType _logLevel;
 };
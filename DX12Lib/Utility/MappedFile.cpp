@@ -0,0 +1,91 @@
+#include "stdafx.h"
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile()
+    : _file(INVALID_HANDLE_VALUE)
+    , _mapping(nullptr)
+    , _data(nullptr)
+    , _size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& filepath)
+{
+    Close();
+
+    _file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (ASSERT(_file != INVALID_HANDLE_VALUE, "Failed to open file: " + filepath))
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize = {};
+    GetFileSizeEx(_file, &fileSize);
+    _size = static_cast<size_t>(fileSize.QuadPart);
+
+    // Mapping of an empty file is not allowed
+    if (_size == 0)
+    {
+        return true;
+    }
+
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (ASSERT(_mapping != nullptr, "Failed to create file mapping: " + filepath))
+    {
+        Close();
+        return false;
+    }
+
+    _data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (ASSERT(_data != nullptr, "Failed to map file: " + filepath))
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data)
+    {
+        UnmapViewOfFile(_data);
+        _data = nullptr;
+    }
+
+    if (_mapping)
+    {
+        CloseHandle(_mapping);
+        _mapping = nullptr;
+    }
+
+    if (_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(_file);
+        _file = INVALID_HANDLE_VALUE;
+    }
+
+    _size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+    return _file != INVALID_HANDLE_VALUE;
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+    return _data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return _size;
+}
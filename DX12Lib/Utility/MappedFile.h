@@ -0,0 +1,27 @@
+#pragma once
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile& copy) = delete;
+    MappedFile& operator=(const MappedFile& copy) = delete;
+
+    bool Open(const std::string& filepath);
+    void Close();
+
+    bool IsOpen() const;
+
+    const uint8_t* GetData() const;
+    size_t GetSize() const;
+
+private:
+    HANDLE _file;
+    HANDLE _mapping;
+
+    const uint8_t* _data;
+    size_t _size;
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// 32 bit handle into a Pool: slot index in the low 24 bits, generation of the slot in the
+// high 8 bits. A handle to a destroyed object stops resolving once its slot is reused
+struct PoolHandle
+{
+    static constexpr uint32_t INDEX_BITS = 24;
+    static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static constexpr uint32_t INVALID = 0xFFFFFFFF;
+
+    uint32_t value = INVALID;
+
+    uint32_t GetIndex() const { return value & INDEX_MASK; }
+    uint32_t GetGeneration() const { return value >> INDEX_BITS; }
+    bool IsValid() const { return value != INVALID; }
+
+    bool operator==(const PoolHandle& other) const { return value == other.value; }
+    bool operator!=(const PoolHandle& other) const { return value != other.value; }
+};
+
+// Fixed size blocks of objects addressed by PoolHandle. The objects never move, so plain
+// pointers stay valid until the object is destroyed, and the slots of destroyed objects are
+// reused. Header only as a template
+template<typename T, uint32_t BLOCK_SIZE = 1024>
+class Pool
+{
+public:
+    Pool() = default;
+    ~Pool()
+    {
+        Clear();
+    }
+
+    Pool(const Pool& copy) = delete;
+    Pool& operator=(const Pool& copy) = delete;
+
+    template<typename... Args>
+    PoolHandle Create(Args&&... args)
+    {
+        uint32_t index;
+        if (!_freeSlots.empty())
+        {
+            index = _freeSlots.back();
+            _freeSlots.pop_back();
+        }
+        else
+        {
+            index = static_cast<uint32_t>(_generations.size());
+            if (index % BLOCK_SIZE == 0)
+            {
+                _blocks.push_back(std::make_unique<Block>());
+            }
+            _generations.push_back(0);
+            _isAlive.push_back(false);
+        }
+
+        new (_GetSlot(index)) T(std::forward<Args>(args)...);
+        _isAlive[index] = true;
+        ++_count;
+
+        return { (static_cast<uint32_t>(_generations[index]) << PoolHandle::INDEX_BITS) | index };
+    }
+
+    void Destroy(PoolHandle handle)
+    {
+        if (T* object = Get(handle))
+        {
+            uint32_t index = handle.GetIndex();
+
+            object->~T();
+            _isAlive[index] = false;
+            ++_generations[index];
+            _freeSlots.push_back(index);
+            --_count;
+        }
+    }
+
+    void Clear()
+    {
+        for (uint32_t index = 0; index < _generations.size(); ++index)
+        {
+            if (_isAlive[index])
+            {
+                _GetSlot(index)->~T();
+            }
+        }
+
+        _blocks.clear();
+        _generations.clear();
+        _isAlive.clear();
+        _freeSlots.clear();
+        _count = 0;
+    }
+
+    // nullptr if the handle is stale
+    T* Get(PoolHandle handle) const
+    {
+        uint32_t index = handle.GetIndex();
+        if (!handle.IsValid() || index >= _generations.size() || !_isAlive[index] || _generations[index] != handle.GetGeneration())
+        {
+            return nullptr;
+        }
+
+        return _GetSlot(index);
+    }
+
+    // For sweeps over the slots, nullptr for the free ones
+    T* GetAt(uint32_t index) const
+    {
+        return _isAlive[index] ? _GetSlot(index) : nullptr;
+    }
+
+    // Handle of the object in a live slot, without touching the object
+    PoolHandle GetHandleAt(uint32_t index) const
+    {
+        return { (static_cast<uint32_t>(_generations[index]) << PoolHandle::INDEX_BITS) | index };
+    }
+
+    // Slots ever used, the bound of the slot indices
+    uint32_t GetSlotCount() const
+    {
+        return static_cast<uint32_t>(_generations.size());
+    }
+
+    uint32_t GetCount() const
+    {
+        return _count;
+    }
+
+private:
+    struct Block
+    {
+        alignas(T) unsigned char data[sizeof(T) * BLOCK_SIZE];
+    };
+
+    T* _GetSlot(uint32_t index) const
+    {
+        return std::launder(reinterpret_cast<T*>(_blocks[index / BLOCK_SIZE]->data) + index % BLOCK_SIZE);
+    }
+
+    std::vector<std::unique_ptr<Block>> _blocks;
+    std::vector<uint8_t> _generations;
+    std::vector<bool> _isAlive;
+    std::vector<uint32_t> _freeSlots;
+    uint32_t _count = 0;
+};
@@ -40,7 +40,9 @@ using namespace Microsoft::WRL;
 #include <chrono>
 #include <memory>
 #include <vector>
+#include <span>
 #include <map>
+#include <mutex>
 
 #include "Utility/KeyCodes.h"
 #include "Utility/Defines.h"
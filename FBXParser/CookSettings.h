@@ -0,0 +1,45 @@
+#pragma once
+
+// Options of the asset cook, parsed from the FBXParser command line
+struct CookSettings
+{
+    // Merge face corners with identical position/normal/color/UV
+    bool weldVertices = true;
+    // Attributes closer than epsilon are welded together, 0 means exact match only
+    float weldEpsilon = 0.0f;
+
+    // Reorder triangles for the post-transform vertex cache and vertices for fetch locality
+    bool optimizeVertexCache = true;
+    // Number of entries of the simulated post-transform cache
+    uint32_t vertexCacheSize = 16;
+
+    // Triangle count of every generated LOD relative to LOD0, used for nodes that were
+    // imported from a single FBX file. Empty disables the generation
+    std::vector<float> lodRatios = { 0.5f, 0.25f, 0.125f };
+    // Geometric error limit of a generated LOD relative to the mesh bounding box diagonal
+    float lodMaxError = 0.02f;
+
+    // Store the vertices in the packed layout (16-bit positions, octahedral normals, half UVs, RGBA8 colors)
+    // when it is precise enough for the mesh
+    bool packVertices = true;
+    // Largest position quantization error allowed for the packed layout, in the units of the vertex positions
+    float packPositionTolerance = 0.01f;
+
+    // Store a position only copy of the vertices for the depth prepass and the occlusion passes
+    bool writePositionStream = true;
+
+    // Also compile the scene hierarchy into the binary .scenebin file the runtime loads without JSON parsing
+    bool writeCompiledScene = true;
+
+    // Bake the potentially visible sets of a grid of camera cells into the compiled scene, for static scenes
+    bool bakeVisibility = false;
+    // Side of the cells in world units, 0 splits the longest side of the scene into VisibilityBaker::DEFAULT_CELL_COUNT
+    float visibilityCellSize = 0.0f;
+    // Random samples of every cell and of every node bounds, next to their corners
+    uint32_t visibilitySampleCount = 16;
+
+    // Also pack the cooked scene into one .scenepak file
+    bool writePackage = false;
+    // LZ compress the package entries that get smaller, compressed meshes can't be used straight from the mapping
+    bool compressPackage = false;
+};
@@ -2,6 +2,15 @@
 
 #include "FBXParser.h"
 
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "SceneCompiler.h"
+#include "ScenePackage.h"
+
+#include <format>
+#include <iostream>
+#include <sstream>
+
 using namespace DirectX;
 
 namespace
@@ -9,6 +18,44 @@ namespace
     constexpr char SCENE_EXT[] = ".scene";
     constexpr char MESH_EXT[] = ".mesh";
     constexpr char MATERIAL_EXT[] = ".mat";
+    constexpr char COMPILED_SCENE_EXT[] = ".scenebin";
+    constexpr char PACKAGE_EXT[] = ".scenepak";
+
+    constexpr char CONVERT_OPTION[] = "--convert";
+    constexpr char OPTIMIZE_OPTION[] = "--optimize";
+    constexpr char COMPILE_OPTION[] = "--compile";
+    constexpr char PACK_OPTION[] = "--pack";
+    constexpr char NO_WELD_OPTION[] = "--no-weld";
+    constexpr char WELD_EPSILON_OPTION[] = "--weld-epsilon";
+    constexpr char NO_CACHE_OPTIMIZATION_OPTION[] = "--no-cache-optimization";
+    constexpr char CACHE_SIZE_OPTION[] = "--cache-size";
+    constexpr char NO_LOD_GENERATION_OPTION[] = "--no-lod-generation";
+    constexpr char LOD_RATIOS_OPTION[] = "--lod-ratios";
+    constexpr char LOD_MAX_ERROR_OPTION[] = "--lod-max-error";
+    constexpr char NO_PACKED_VERTICES_OPTION[] = "--no-packed-vertices";
+    constexpr char PACK_TOLERANCE_OPTION[] = "--pack-tolerance";
+    constexpr char NO_POSITION_STREAM_OPTION[] = "--no-position-stream";
+    constexpr char NO_COMPILED_SCENE_OPTION[] = "--no-compiled-scene";
+    constexpr char PACKAGE_OPTION[] = "--package";
+    constexpr char COMPRESS_PACKAGE_OPTION[] = "--compress-package";
+    constexpr char BAKE_VISIBILITY_OPTION[] = "--bake-visibility";
+    constexpr char VISIBILITY_CELL_SIZE_OPTION[] = "--visibility-cell-size";
+    constexpr char VISIBILITY_SAMPLES_OPTION[] = "--visibility-samples";
+
+    // Parses the comma separated list of numbers, e.g. "0.5,0.25,0.1"
+    std::vector<float> ParseFloatList(const std::string& list)
+    {
+        std::vector<float> values;
+
+        std::stringstream stream(list);
+        std::string value;
+        while (std::getline(stream, value, ','))
+        {
+            values.push_back(std::stof(value));
+        }
+
+        return values;
+    }
 }
 
 FBXParser::FBXParser()
@@ -37,10 +84,38 @@ int FBXParser::Run(int argc, char* argv[])
         return 1;
     }
 
-    std::vector<std::string> filepath;
+    std::vector<std::string> args;
     for (int i = 1; i < argc; ++i)
     {
-        filepath.push_back(argv[i]);
+        args.push_back(argv[i]);
+    }
+
+    if (args[0] == CONVERT_OPTION)
+    {
+        return Convert(std::vector<std::string>(args.begin() + 1, args.end()));
+    }
+
+    bool isOptimize = args[0] == OPTIMIZE_OPTION;
+    bool isCompile = args[0] == COMPILE_OPTION;
+    bool isPack = args[0] == PACK_OPTION;
+
+    std::vector<std::string> filepath;
+    if (!ParseOptions(std::vector<std::string>(args.begin() + (isOptimize || isCompile || isPack ? 1 : 0), args.end()), filepath) || filepath.empty())
+    {
+        return 2;
+    }
+
+    if (isOptimize)
+    {
+        return Optimize(filepath);
+    }
+    if (isCompile)
+    {
+        return Compile(filepath);
+    }
+    if (isPack)
+    {
+        return Pack(filepath);
     }
 
     int parseResult = Parse(filepath);
@@ -49,9 +124,89 @@ int FBXParser::Run(int argc, char* argv[])
         return parseResult;
     }
 
-    Save();
+    return Save();
+}
+
+bool FBXParser::ParseOptions(const std::vector<std::string>& args, std::vector<std::string>& outFilepath)
+{
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (args[i] == NO_WELD_OPTION)
+        {
+            _settings.weldVertices = false;
+        }
+        else if (args[i] == WELD_EPSILON_OPTION && i + 1 < args.size())
+        {
+            _settings.weldEpsilon = std::stof(args[++i]);
+        }
+        else if (args[i] == NO_CACHE_OPTIMIZATION_OPTION)
+        {
+            _settings.optimizeVertexCache = false;
+        }
+        else if (args[i] == CACHE_SIZE_OPTION && i + 1 < args.size())
+        {
+            _settings.vertexCacheSize = static_cast<uint32_t>(std::stoul(args[++i]));
+        }
+        else if (args[i] == NO_LOD_GENERATION_OPTION)
+        {
+            _settings.lodRatios.clear();
+        }
+        else if (args[i] == LOD_RATIOS_OPTION && i + 1 < args.size())
+        {
+            _settings.lodRatios = ParseFloatList(args[++i]);
+        }
+        else if (args[i] == LOD_MAX_ERROR_OPTION && i + 1 < args.size())
+        {
+            _settings.lodMaxError = std::stof(args[++i]);
+        }
+        else if (args[i] == NO_PACKED_VERTICES_OPTION)
+        {
+            _settings.packVertices = false;
+        }
+        else if (args[i] == PACK_TOLERANCE_OPTION && i + 1 < args.size())
+        {
+            _settings.packPositionTolerance = std::stof(args[++i]);
+        }
+        else if (args[i] == NO_POSITION_STREAM_OPTION)
+        {
+            _settings.writePositionStream = false;
+        }
+        else if (args[i] == NO_COMPILED_SCENE_OPTION)
+        {
+            _settings.writeCompiledScene = false;
+        }
+        else if (args[i] == PACKAGE_OPTION)
+        {
+            _settings.writePackage = true;
+        }
+        else if (args[i] == COMPRESS_PACKAGE_OPTION)
+        {
+            _settings.compressPackage = true;
+        }
+        else if (args[i] == BAKE_VISIBILITY_OPTION)
+        {
+            _settings.bakeVisibility = true;
+        }
+        else if (args[i] == VISIBILITY_CELL_SIZE_OPTION && i + 1 < args.size())
+        {
+            _settings.visibilityCellSize = std::stof(args[++i]);
+        }
+        else if (args[i] == VISIBILITY_SAMPLES_OPTION && i + 1 < args.size())
+        {
+            _settings.visibilitySampleCount = static_cast<uint32_t>(std::stoul(args[++i]));
+        }
+        else if (args[i].starts_with("--"))
+        {
+            std::cout << "Unknown option " << args[i] << std::endl;
+            return false;
+        }
+        else
+        {
+            outFilepath.push_back(args[i]);
+        }
+    }
 
-    return parseResult;
+    return true;
 }
 
 int FBXParser::Parse(const std::vector<std::string>& filepath)
@@ -126,7 +281,7 @@ bool FBXParser::ImportFbxScene(const std::vector<std::string>& filepath)
 
 bool FBXParser::ParseFbxScene()
 {
-    return _scene.Parse(_fbxLODScenes);
+    return _scene.Parse(_fbxLODScenes, _settings);
 }
 
 int FBXParser::Save()
@@ -135,5 +290,137 @@ int FBXParser::Save()
     std::filesystem::create_directory(_scene.GetName());
     _scene.Save(outDirectory);
 
+    if (_settings.writeCompiledScene)
+    {
+        int compileResult = Compile({ outDirectory + _scene.GetName() + SCENE_EXT });
+        if (compileResult != 0)
+        {
+            return compileResult;
+        }
+    }
+
+    if (_settings.writePackage)
+    {
+        return Pack({ outDirectory + _scene.GetName() + SCENE_EXT });
+    }
+
     return 0;
 }
+
+int FBXParser::Compile(const std::vector<std::string>& scenes)
+{
+    int result = 0;
+
+    for (const std::string& scene : scenes)
+    {
+        std::filesystem::path compiledPath(scene);
+        compiledPath.replace_extension(COMPILED_SCENE_EXT);
+
+        if (!SceneCompiler::Save(scene, compiledPath.string(), _settings))
+        {
+            std::cout << "Failed to compile " << scene << std::endl;
+            result = 5;
+        }
+    }
+
+    return result;
+}
+
+int FBXParser::Pack(const std::vector<std::string>& scenes)
+{
+    int result = 0;
+
+    for (const std::string& scene : scenes)
+    {
+        // The package goes next to the scene directory
+        std::filesystem::path scenePath(scene);
+        std::filesystem::path packagePath = scenePath.parent_path().parent_path() / (scenePath.stem().string() + PACKAGE_EXT);
+
+        if (!ScenePackage::Write(scene, packagePath.string(), _settings))
+        {
+            std::cout << "Failed to pack " << scene << std::endl;
+            result = 5;
+        }
+    }
+
+    return result;
+}
+
+int FBXParser::Convert(const std::vector<std::string>& directories)
+{
+    int result = 0;
+
+    for (const std::string& directory : directories)
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(directory))
+        {
+            if (entry.path().extension() != MESH_EXT || MeshFile::IsBinary(entry.path().string()))
+            {
+                continue;
+            }
+
+            LOD lod;
+            if (!MeshFile::Load(entry.path().string(), lod) || !MeshFile::Save(entry.path().string(), lod))
+            {
+                std::cout << "Failed to convert " << entry.path().string() << std::endl;
+                result = 5;
+                continue;
+            }
+
+            std::cout << "Converted " << entry.path().string() << std::endl;
+        }
+    }
+
+    return result;
+}
+
+int FBXParser::Optimize(const std::vector<std::string>& directories)
+{
+    int result = 0;
+
+    for (const std::string& directory : directories)
+    {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(directory))
+        {
+            if (entry.path().extension() != MESH_EXT)
+            {
+                continue;
+            }
+
+            LOD lod;
+            MeshFile::VertexPacking packing;
+            if (!MeshFile::Load(entry.path().string(), lod, &packing))
+            {
+                std::cout << "Failed to load " << entry.path().string() << std::endl;
+                result = 5;
+                continue;
+            }
+
+            size_t vertexCount = lod.vertices.size();
+            if (_settings.weldVertices)
+            {
+                MeshOptimizer::WeldVertices(lod, _settings.weldEpsilon);
+            }
+            if (_settings.optimizeVertexCache)
+            {
+                MeshOptimizer::Optimize(lod, _settings.vertexCacheSize);
+            }
+
+            // Packed meshes keep the quantization of their node, the position stream follows the settings
+            packing.hasPositionStream = _settings.writePositionStream;
+            if (!MeshFile::Save(entry.path().string(), lod, packing))
+            {
+                std::cout << "Failed to save " << entry.path().string() << std::endl;
+                result = 5;
+                continue;
+            }
+
+            std::cout << std::format("Optimized {}: vertices {} -> {}, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+                entry.path().string(), vertexCount, lod.vertices.size(),
+                lod.cacheStats.acmrBefore, lod.cacheStats.acmrAfter,
+                lod.cacheStats.atvrBefore, lod.cacheStats.atvrAfter) << std::endl;
+        }
+    }
+
+    return result;
+}
@@ -17,7 +17,20 @@ private:
 
     int Save();
 
+    // Rewrites legacy text .mesh files of already cooked scenes in the binary format
+    int Convert(const std::vector<std::string>& directories);
+    // Runs the cook mesh passes (welding, vertex cache and fetch reordering) on the .mesh files
+    // of already cooked scenes, the directories are searched recursively
+    int Optimize(const std::vector<std::string>& directories);
+    // Compiles the cooked .scene files into .scenebin files next to them
+    int Compile(const std::vector<std::string>& scenes);
+    // Packs the cooked .scene files with everything they reference into .scenepak files
+    int Pack(const std::vector<std::string>& scenes);
+
+    bool ParseOptions(const std::vector<std::string>& args, std::vector<std::string>& outFilepath);
+
     Scene _scene;
+    CookSettings _settings;
 
     std::vector<FbxScene*> _fbxLODScenes;
     FbxManager* _fbxManager;
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../DX12Lib/Scene/MeshFormat.h"
+
+struct LOD
+{
+    std::vector<DirectX::XMVECTOR> vertices = {};
+    std::vector<DirectX::XMVECTOR> normals = {};
+    std::vector<DirectX::XMVECTOR> colors = {};
+    std::vector<DirectX::XMFLOAT2> UVs = {};
+    std::vector<UINT64> indices = {};
+
+    MeshFormat::CacheStats cacheStats = {};
+    // Largest distance of a collapsed vertex from the LOD0 surface (RMS over the triangles merged
+    // into it), in the units of the vertex positions
+    float geometricError = 0.0f;
+};
@@ -0,0 +1,616 @@
+#include "pch.h"
+
+#include "MeshFile.h"
+
+#include "../DX12Lib/Scene/MeshFormat.h"
+#include "../DX12Lib/Scene/ScenePackFormat.h"
+
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+    void WritePadding(std::ostream& out, uint64_t offset)
+    {
+        static const char zeros[MeshFormat::DATA_ALIGNMENT] = {};
+
+        uint64_t current = static_cast<uint64_t>(out.tellp());
+        if (offset > current)
+        {
+            out.write(zeros, offset - current);
+        }
+    }
+
+    uint16_t QuantizeUnorm16(float value)
+    {
+        return static_cast<uint16_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+
+    int16_t QuantizeSnorm16(float value)
+    {
+        return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    float SignNotZero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    // Octahedral normal encoding (Cigolle et al. 2014): the unit sphere is projected onto
+    // an octahedron, and its lower half is folded over the upper half into the [-1, 1] square
+    XMFLOAT2 EncodeOctahedral(FXMVECTOR normal)
+    {
+        XMFLOAT3 n;
+        XMStoreFloat3(&n, normal);
+
+        float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (length == 0.0f)
+        {
+            return XMFLOAT2(0.0f, 0.0f);
+        }
+
+        XMFLOAT2 result(n.x / length, n.y / length);
+        if (n.z < 0.0f)
+        {
+            result = XMFLOAT2((1.0f - std::abs(result.y)) * SignNotZero(result.x), (1.0f - std::abs(result.x)) * SignNotZero(result.y));
+        }
+
+        return result;
+    }
+
+    XMVECTOR DecodeOctahedral(float x, float y)
+    {
+        XMFLOAT3 n(x, y, 1.0f - std::abs(x) - std::abs(y));
+        if (n.z < 0.0f)
+        {
+            n.x = (1.0f - std::abs(y)) * SignNotZero(x);
+            n.y = (1.0f - std::abs(x)) * SignNotZero(y);
+        }
+
+        return XMVector3Normalize(XMLoadFloat3(&n));
+    }
+
+    // RGBA8 in the memory order of DXGI_FORMAT_R8G8B8A8_UNORM, the alpha is always opaque
+    uint32_t PackColor(FXMVECTOR color)
+    {
+        XMFLOAT4 c;
+        XMStoreFloat4(&c, color);
+
+        uint32_t r = QuantizeUnorm16(c.x) >> 8;
+        uint32_t g = QuantizeUnorm16(c.y) >> 8;
+        uint32_t b = QuantizeUnorm16(c.z) >> 8;
+        uint32_t a = 0xFF;
+
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    XMVECTOR UnpackColor(uint32_t color)
+    {
+        return XMVectorSet((color & 0xFF) / 255.0f, ((color >> 8) & 0xFF) / 255.0f, ((color >> 16) & 0xFF) / 255.0f, (color >> 24) / 255.0f);
+    }
+
+    MeshFormat::PackedVertex PackVertex(const LOD& lod, size_t vertex, const MeshFormat::Quantization& quantization)
+    {
+        XMFLOAT3 position;
+        XMStoreFloat3(&position, lod.vertices[vertex]);
+        XMFLOAT2 normal = EncodeOctahedral(lod.normals[vertex]);
+
+        MeshFormat::PackedVertex packed = {};
+        packed.position[0] = QuantizeUnorm16(quantization.scale[0] > 0.0f ? (position.x - quantization.offset[0]) / quantization.scale[0] : 0.0f);
+        packed.position[1] = QuantizeUnorm16(quantization.scale[1] > 0.0f ? (position.y - quantization.offset[1]) / quantization.scale[1] : 0.0f);
+        packed.position[2] = QuantizeUnorm16(quantization.scale[2] > 0.0f ? (position.z - quantization.offset[2]) / quantization.scale[2] : 0.0f);
+        packed.normal[0] = QuantizeSnorm16(normal.x);
+        packed.normal[1] = QuantizeSnorm16(normal.y);
+        packed.uv[0] = XMConvertFloatToHalf(lod.UVs[vertex].x);
+        packed.uv[1] = XMConvertFloatToHalf(lod.UVs[vertex].y);
+
+        return packed;
+    }
+
+    void UnpackVertex(const MeshFormat::PackedVertex& packed, const MeshFormat::Quantization& quantization, LOD& lod)
+    {
+        lod.vertices.push_back(XMVectorSet(
+            quantization.offset[0] + packed.position[0] / 65535.0f * quantization.scale[0],
+            quantization.offset[1] + packed.position[1] / 65535.0f * quantization.scale[1],
+            quantization.offset[2] + packed.position[2] / 65535.0f * quantization.scale[2],
+            0.0f));
+        lod.normals.push_back(DecodeOctahedral(std::max(packed.normal[0] / 32767.0f, -1.0f), std::max(packed.normal[1] / 32767.0f, -1.0f)));
+        lod.UVs.push_back(XMFLOAT2(XMConvertHalfToFloat(packed.uv[0]), XMConvertHalfToFloat(packed.uv[1])));
+    }
+
+    bool LoadBinary(const std::vector<char>& data, LOD& lod, MeshFile::VertexPacking& packing)
+    {
+        if (data.size() < MeshFormat::MIN_HEADER_SIZE)
+        {
+            return false;
+        }
+
+        const MeshFormat::Header* header = reinterpret_cast<const MeshFormat::Header*>(data.data());
+        if (header->magic != MeshFormat::MAGIC || header->version > MeshFormat::VERSION)
+        {
+            return false;
+        }
+
+        if (header->headerSize >= offsetof(MeshFormat::Header, quantization))
+        {
+            lod.cacheStats = header->cacheStats;
+        }
+
+        if (header->headerSize >= sizeof(MeshFormat::Header))
+        {
+            packing.quantization = header->quantization;
+        }
+
+        const MeshFormat::StreamDesc* streams = reinterpret_cast<const MeshFormat::StreamDesc*>(data.data() + header->headerSize);
+        const uint32_t* colors = nullptr;
+        for (uint32_t i = 0; i < header->streamCount; ++i)
+        {
+            const MeshFormat::StreamDesc& stream = streams[i];
+            if (stream.offset + stream.size > data.size())
+            {
+                return false;
+            }
+
+            if (stream.type == MeshFormat::StreamType::Interleaved)
+            {
+                const MeshFormat::Vertex* vertices = reinterpret_cast<const MeshFormat::Vertex*>(data.data() + stream.offset);
+                for (uint32_t v = 0; v < header->vertexCount; ++v)
+                {
+                    const MeshFormat::Vertex& vertex = vertices[v];
+                    lod.vertices.push_back(XMVectorSet(vertex.position[0], vertex.position[1], vertex.position[2], 0.0f));
+                    lod.normals.push_back(XMVectorSet(vertex.normal[0], vertex.normal[1], vertex.normal[2], 0.0f));
+                    lod.colors.push_back(XMVectorSet(vertex.color[0], vertex.color[1], vertex.color[2], vertex.color[3]));
+                    lod.UVs.push_back(XMFLOAT2(vertex.uv[0], vertex.uv[1]));
+                }
+            }
+            else if (stream.type == MeshFormat::StreamType::Packed)
+            {
+                packing.isPacked = true;
+
+                const MeshFormat::PackedVertex* vertices = reinterpret_cast<const MeshFormat::PackedVertex*>(data.data() + stream.offset);
+                for (uint32_t v = 0; v < header->vertexCount; ++v)
+                {
+                    UnpackVertex(vertices[v], packing.quantization, lod);
+                }
+            }
+            else if (stream.type == MeshFormat::StreamType::Color)
+            {
+                colors = reinterpret_cast<const uint32_t*>(data.data() + stream.offset);
+            }
+            else if (stream.type == MeshFormat::StreamType::Position)
+            {
+                // Derived from the full vertices, only the presence of the stream is kept
+                packing.hasPositionStream = true;
+            }
+        }
+
+        if (packing.isPacked)
+        {
+            for (uint32_t v = 0; v < header->vertexCount; ++v)
+            {
+                lod.colors.push_back(UnpackColor(colors ? colors[v] : header->uniformColor));
+            }
+        }
+
+        if (header->indexOffset + static_cast<uint64_t>(header->indexCount) * header->indexStride > data.size())
+        {
+            return false;
+        }
+
+        const uint8_t* indices = reinterpret_cast<const uint8_t*>(data.data() + header->indexOffset);
+        for (uint32_t i = 0; i < header->indexCount; ++i)
+        {
+            lod.indices.push_back(header->indexStride == sizeof(uint16_t)
+                ? reinterpret_cast<const uint16_t*>(indices)[i]
+                : reinterpret_cast<const uint32_t*>(indices)[i]);
+        }
+
+        return true;
+    }
+
+    bool LoadText(const std::string& path, LOD& lod)
+    {
+        std::ifstream in(path, std::ios_base::in);
+        if (!in.is_open())
+        {
+            return false;
+        }
+
+        std::vector<XMVECTOR> points;
+        std::vector<XMVECTOR> normals;
+        std::vector<XMVECTOR> colors;
+        std::vector<XMFLOAT2> UVs;
+        std::vector<UINT64> faces;
+
+        bool isShared = true;
+        std::string input;
+        while (in >> input)
+        {
+            if (input == "v")
+            {
+                float x, y, z, w;
+                in >> x >> y >> z >> w;
+                points.push_back(XMVectorSet(x, y, z, w));
+            }
+            else if (input == "vn")
+            {
+                float x, y, z, w;
+                in >> x >> y >> z >> w;
+                normals.push_back(XMVectorSet(x, y, z, w));
+            }
+            else if (input == "vc")
+            {
+                float r, g, b, a;
+                in >> r >> g >> b >> a;
+                colors.push_back(XMVectorSet(r, g, b, a));
+            }
+            else if (input == "vt")
+            {
+                float u, v, w;
+                in >> u >> v >> w;
+                UVs.push_back(XMFLOAT2(u, v));
+            }
+            else if (input == "f")
+            {
+                char sym;
+                UINT64 v, vn, vt;
+                for (int i = 0; i < 3; ++i)
+                {
+                    in >> v >> sym >> vn >> sym >> vt;
+                    faces.push_back(v);
+                    faces.push_back(vn);
+                    faces.push_back(vt);
+                    isShared &= (v == vn && v == vt);
+                }
+            }
+            else
+            {
+                std::string line;
+                std::getline(in, line);
+            }
+        }
+
+        if (isShared && points.size() == normals.size() && points.size() == colors.size() && points.size() == UVs.size())
+        {
+            // Every face corner references the same index in all attribute arrays
+            lod.vertices = std::move(points);
+            lod.normals = std::move(normals);
+            lod.colors = std::move(colors);
+            lod.UVs = std::move(UVs);
+            for (size_t i = 0; i < faces.size(); i += 3)
+            {
+                lod.indices.push_back(faces[i]);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < faces.size(); i += 3)
+            {
+                lod.vertices.push_back(points[faces[i]]);
+                lod.normals.push_back(normals[faces[i + 1]]);
+                lod.colors.push_back(colors[faces[i]]);
+                lod.UVs.push_back(UVs[faces[i + 2]]);
+                lod.indices.push_back(lod.indices.size());
+            }
+        }
+
+        return true;
+    }
+}
+
+namespace MeshFile
+{
+    std::string Serialize(const LOD& lod, const VertexPacking& packing)
+    {
+        std::ostringstream out(std::ios_base::out | std::ios_base::binary);
+
+        const size_t vertexCount = lod.vertices.size();
+
+        std::vector<MeshFormat::Vertex> vertices;
+        std::vector<MeshFormat::PackedVertex> packedVertices;
+        std::vector<uint32_t> colors;
+        std::vector<MeshFormat::PackedPosition> packedPositions;
+        std::vector<XMFLOAT3> positions;
+        uint32_t uniformColor = 0;
+
+        if (packing.isPacked)
+        {
+            packedVertices.resize(vertexCount);
+            for (size_t i = 0; i < vertexCount; ++i)
+            {
+                packedVertices[i] = PackVertex(lod, i, packing.quantization);
+            }
+
+            if (IsUniformColor(lod))
+            {
+                uniformColor = vertexCount > 0 ? PackColor(lod.colors[0]) : 0;
+            }
+            else
+            {
+                colors.resize(vertexCount);
+                for (size_t i = 0; i < vertexCount; ++i)
+                {
+                    colors[i] = PackColor(lod.colors[i]);
+                }
+            }
+
+            if (packing.hasPositionStream)
+            {
+                packedPositions.resize(vertexCount);
+                for (size_t i = 0; i < vertexCount; ++i)
+                {
+                    std::memcpy(packedPositions[i].position, packedVertices[i].position, sizeof(packedPositions[i].position));
+                }
+            }
+        }
+        else
+        {
+            vertices.resize(vertexCount);
+            for (size_t i = 0; i < vertexCount; ++i)
+            {
+                XMFLOAT4 color;
+                XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(vertices[i].position), lod.vertices[i]);
+                XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(vertices[i].normal), lod.normals[i]);
+                XMStoreFloat4(&color, lod.colors[i]);
+                vertices[i].color[0] = color.x;
+                vertices[i].color[1] = color.y;
+                vertices[i].color[2] = color.z;
+                vertices[i].color[3] = 1.0f;
+                vertices[i].uv[0] = lod.UVs[i].x;
+                vertices[i].uv[1] = lod.UVs[i].y;
+            }
+
+            if (packing.hasPositionStream)
+            {
+                positions.resize(vertexCount);
+                for (size_t i = 0; i < vertexCount; ++i)
+                {
+                    XMStoreFloat3(&positions[i], lod.vertices[i]);
+                }
+            }
+        }
+
+        // 16-bit indices are enough to address up to 65536 vertices
+        bool isShortIndex = vertexCount <= std::numeric_limits<uint16_t>::max() + 1;
+        std::vector<uint16_t> shortIndices;
+        std::vector<uint32_t> indices;
+        if (isShortIndex)
+        {
+            shortIndices.assign(lod.indices.begin(), lod.indices.end());
+        }
+        else
+        {
+            indices.assign(lod.indices.begin(), lod.indices.end());
+        }
+
+        std::vector<std::pair<MeshFormat::StreamDesc, const void*>> streams;
+        auto addStream = [&streams](MeshFormat::StreamType type, uint32_t stride, size_t count, const void* data)
+            {
+                MeshFormat::StreamDesc stream = {};
+                stream.type = type;
+                stream.stride = stride;
+                stream.size = static_cast<uint64_t>(count) * stride;
+                streams.emplace_back(stream, data);
+            };
+
+        if (packing.isPacked)
+        {
+            addStream(MeshFormat::StreamType::Packed, sizeof(MeshFormat::PackedVertex), packedVertices.size(), packedVertices.data());
+            if (!colors.empty())
+            {
+                addStream(MeshFormat::StreamType::Color, sizeof(uint32_t), colors.size(), colors.data());
+            }
+            if (packing.hasPositionStream)
+            {
+                addStream(MeshFormat::StreamType::Position, sizeof(MeshFormat::PackedPosition), packedPositions.size(), packedPositions.data());
+            }
+        }
+        else
+        {
+            addStream(MeshFormat::StreamType::Interleaved, sizeof(MeshFormat::Vertex), vertices.size(), vertices.data());
+            if (packing.hasPositionStream)
+            {
+                addStream(MeshFormat::StreamType::Position, sizeof(XMFLOAT3), positions.size(), positions.data());
+            }
+        }
+
+        MeshFormat::Header header = {};
+        header.magic = MeshFormat::MAGIC;
+        header.version = MeshFormat::VERSION;
+        header.headerSize = sizeof(MeshFormat::Header);
+        header.vertexCount = static_cast<uint32_t>(vertexCount);
+        header.indexCount = static_cast<uint32_t>(lod.indices.size());
+        header.indexStride = isShortIndex ? sizeof(uint16_t) : sizeof(uint32_t);
+        header.streamCount = static_cast<uint32_t>(streams.size());
+        header.cacheStats = lod.cacheStats;
+        header.quantization = packing.quantization;
+        header.uniformColor = uniformColor;
+
+        uint64_t offset = header.headerSize + header.streamCount * sizeof(MeshFormat::StreamDesc);
+        for (auto& [stream, data] : streams)
+        {
+            stream.offset = MeshFormat::AlignOffset(offset);
+            offset = stream.offset + stream.size;
+        }
+        header.indexOffset = MeshFormat::AlignOffset(offset);
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& [stream, data] : streams)
+        {
+            out.write(reinterpret_cast<const char*>(&stream), sizeof(stream));
+        }
+
+        for (const auto& [stream, data] : streams)
+        {
+            WritePadding(out, stream.offset);
+            out.write(reinterpret_cast<const char*>(data), stream.size);
+        }
+
+        WritePadding(out, header.indexOffset);
+        if (isShortIndex)
+        {
+            out.write(reinterpret_cast<const char*>(shortIndices.data()), shortIndices.size() * sizeof(uint16_t));
+        }
+        else
+        {
+            out.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+        }
+
+        return out.str();
+    }
+
+    bool Save(const std::string& path, const LOD& lod, const VertexPacking& packing)
+    {
+        std::ofstream out(path, std::fstream::out | std::ios_base::binary);
+        if (!out.is_open())
+        {
+            return false;
+        }
+
+        std::string data = Serialize(lod, packing);
+        out.write(data.data(), data.size());
+
+        return out.good();
+    }
+
+    bool Load(const std::string& path, LOD& lod, VertexPacking* outPacking)
+    {
+        lod = {};
+
+        VertexPacking packing;
+        if (outPacking)
+        {
+            *outPacking = {};
+        }
+
+        if (IsBinary(path))
+        {
+            std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+            std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+            bool result = LoadBinary(data, lod, packing);
+            if (outPacking)
+            {
+                *outPacking = packing;
+            }
+
+            return result;
+        }
+
+        return LoadText(path, lod);
+    }
+
+    bool IsBinary(const std::string& path)
+    {
+        std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+
+        uint32_t magic = 0;
+        in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+
+        return in.good() && magic == MeshFormat::MAGIC;
+    }
+
+    MeshFormat::Quantization ComputeQuantization(const std::vector<LOD>& lods)
+    {
+        XMVECTOR min = XMVectorReplicate(std::numeric_limits<float>::max());
+        XMVECTOR max = XMVectorReplicate(-std::numeric_limits<float>::max());
+        for (const LOD& lod : lods)
+        {
+            for (const XMVECTOR& vertex : lod.vertices)
+            {
+                min = XMVectorMin(min, vertex);
+                max = XMVectorMax(max, vertex);
+            }
+        }
+
+        MeshFormat::Quantization quantization = {};
+        if (XMVector3Greater(min, max))
+        {
+            return quantization;
+        }
+
+        XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(quantization.offset), min);
+        XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(quantization.scale), XMVectorSubtract(max, min));
+
+        return quantization;
+    }
+
+    bool IsUniformColor(const LOD& lod)
+    {
+        if (lod.colors.empty())
+        {
+            return true;
+        }
+
+        uint32_t color = PackColor(lod.colors[0]);
+        return std::all_of(lod.colors.begin(), lod.colors.end(), [color](const XMVECTOR& other)
+            {
+                return PackColor(other) == color;
+            });
+    }
+
+    uint64_t ComputeHash(std::string_view data)
+    {
+        return ScenePackFormat::ComputeHash(data.data(), data.size());
+    }
+
+    SharedMeshes::SharedMeshes(const std::string& path)
+        : _path(path)
+        , _files{}
+        , _sharedCount(0)
+        , _sharedBytes(0)
+    {   }
+
+    std::string SharedMeshes::Save(const std::string& filename, const LOD& lod, const VertexPacking& packing)
+    {
+        std::string data = Serialize(lod, packing);
+        uint64_t hash = ComputeHash(data);
+
+        // Compare the contents on a hash match, so a hash collision can't merge different meshes
+        auto [begin, end] = _files.equal_range(hash);
+        for (auto it = begin; it != end; ++it)
+        {
+            std::ifstream in(_path + it->second, std::ios_base::in | std::ios_base::binary);
+            std::string written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            if (written == data)
+            {
+                ++_sharedCount;
+                _sharedBytes += data.size();
+                return it->second;
+            }
+        }
+
+        std::ofstream out(_path + filename, std::fstream::out | std::ios_base::binary);
+        out.write(data.data(), data.size());
+        if (!out.good())
+        {
+            return {};
+        }
+
+        _files.emplace(hash, filename);
+        return filename;
+    }
+
+    size_t SharedMeshes::GetFileCount() const
+    {
+        return _files.size();
+    }
+
+    size_t SharedMeshes::GetSharedCount() const
+    {
+        return _sharedCount;
+    }
+
+    uint64_t SharedMeshes::GetSharedBytes() const
+    {
+        return _sharedBytes;
+    }
+}
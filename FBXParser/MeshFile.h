@@ -0,0 +1,61 @@
+#pragma once
+
+#include "LOD.h"
+
+#include <string_view>
+#include <unordered_map>
+
+namespace MeshFile
+{
+    // Vertex layout of a written mesh, chosen by the cook per node
+    struct VertexPacking
+    {
+        bool isPacked = false;
+        MeshFormat::Quantization quantization = {};
+        // Write a Position stream next to the full vertices
+        bool hasPositionStream = false;
+    };
+
+    // Contents of the binary .mesh file of the LOD (see DX12Lib/Scene/MeshFormat.h)
+    std::string Serialize(const LOD& lod, const VertexPacking& packing = {});
+
+    // Writes the LOD as a binary .mesh file
+    bool Save(const std::string& path, const LOD& lod, const VertexPacking& packing = {});
+
+    // Reads both the binary and the legacy text .mesh files.
+    // Packed vertices are dequantized, outPacking receives the layout of the file
+    bool Load(const std::string& path, LOD& lod, VertexPacking* outPacking = nullptr);
+
+    bool IsBinary(const std::string& path);
+
+    // Quantization box that maps the positions of all the LODs to 16 bits
+    MeshFormat::Quantization ComputeQuantization(const std::vector<LOD>& lods);
+
+    // Packing converts the colors to RGBA8, the vertex color stream is dropped if all colors are equal
+    bool IsUniformColor(const LOD& lod);
+
+    uint64_t ComputeHash(std::string_view data);
+
+    // Mesh files of one cooked scene. Meshes with byte identical contents are written once,
+    // so the nodes with the same geometry reference one file
+    class SharedMeshes
+    {
+    public:
+        explicit SharedMeshes(const std::string& path);
+
+        // Writes the LOD as path + filename unless an identical mesh was already written.
+        // Returns the name of the file the node has to reference, empty if the write failed
+        std::string Save(const std::string& filename, const LOD& lod, const VertexPacking& packing = {});
+
+        size_t GetFileCount() const;
+        // Meshes that reused an already written file, and the bytes they didn't write
+        size_t GetSharedCount() const;
+        uint64_t GetSharedBytes() const;
+
+    private:
+        std::string _path;
+        std::unordered_multimap<uint64_t, std::string> _files;
+        size_t _sharedCount;
+        uint64_t _sharedBytes;
+    };
+}
@@ -0,0 +1,346 @@
+#include "pch.h"
+
+#include "MeshOptimizer.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr size_t WELD_KEY_SIZE = 12;
+
+    using WeldKey = std::array<int64_t, WELD_KEY_SIZE>;
+
+    struct WeldKeyHash
+    {
+        size_t operator()(const WeldKey& key) const
+        {
+            // FNV-1a over the key components
+            uint64_t hash = 14695981039346656037ull;
+            for (int64_t value : key)
+            {
+                hash ^= static_cast<uint64_t>(value);
+                hash *= 1099511628211ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    int64_t QuantizeComponent(float value, float epsilon)
+    {
+        if (epsilon > 0.0f)
+        {
+            return static_cast<int64_t>(std::floor(value / epsilon + 0.5f));
+        }
+
+        // Exact match: compare bit patterns, but treat -0 and +0 as the same value
+        if (value == 0.0f)
+        {
+            value = 0.0f;
+        }
+
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    WeldKey MakeWeldKey(const LOD& lod, size_t vertex, float epsilon)
+    {
+        XMFLOAT3 position;
+        XMFLOAT3 normal;
+        XMFLOAT4 color;
+        XMStoreFloat3(&position, lod.vertices[vertex]);
+        XMStoreFloat3(&normal, lod.normals[vertex]);
+        XMStoreFloat4(&color, lod.colors[vertex]);
+        const XMFLOAT2& uv = lod.UVs[vertex];
+
+        return {
+            QuantizeComponent(position.x, epsilon), QuantizeComponent(position.y, epsilon), QuantizeComponent(position.z, epsilon),
+            QuantizeComponent(normal.x, epsilon), QuantizeComponent(normal.y, epsilon), QuantizeComponent(normal.z, epsilon),
+            QuantizeComponent(color.x, epsilon), QuantizeComponent(color.y, epsilon), QuantizeComponent(color.z, epsilon), QuantizeComponent(color.w, epsilon),
+            QuantizeComponent(uv.x, epsilon), QuantizeComponent(uv.y, epsilon)
+        };
+    }
+
+    constexpr UINT64 INVALID_INDEX = std::numeric_limits<UINT64>::max();
+
+    // Triangles adjacent to every vertex, stored as ranges of one flat array
+    struct TriangleAdjacency
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+    };
+
+    TriangleAdjacency BuildAdjacency(const std::vector<UINT64>& indices, size_t vertexCount)
+    {
+        TriangleAdjacency adjacency;
+        adjacency.offsets.assign(vertexCount + 1, 0);
+        adjacency.triangles.resize(indices.size());
+
+        for (UINT64 index : indices)
+        {
+            ++adjacency.offsets[index + 1];
+        }
+        for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            adjacency.offsets[vertex + 1] += adjacency.offsets[vertex];
+        }
+
+        std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        return adjacency;
+    }
+
+    // Tipsify: picks the next fanning vertex among the vertices of the last emitted fan,
+    // preferring the ones that will still be in the cache after their remaining triangles
+    // are emitted
+    int64_t GetNextVertex(const std::vector<UINT64>& candidates, const std::vector<uint32_t>& liveTriangles,
+        const std::vector<uint32_t>& cacheTime, uint32_t timestamp, uint32_t cacheSize)
+    {
+        int64_t bestVertex = -1;
+        int64_t bestPriority = -1;
+
+        for (UINT64 vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+            {
+                continue;
+            }
+
+            int64_t priority = 0;
+            if (timestamp - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+            {
+                priority = timestamp - cacheTime[vertex];
+            }
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                bestVertex = static_cast<int64_t>(vertex);
+            }
+        }
+
+        return bestVertex;
+    }
+}
+
+namespace MeshOptimizer
+{
+    void WeldVertices(LOD& lod, float epsilon)
+    {
+        if (lod.vertices.empty())
+        {
+            return;
+        }
+
+        std::unordered_map<WeldKey, UINT64, WeldKeyHash> uniqueVertices;
+        uniqueVertices.reserve(lod.vertices.size());
+
+        std::vector<UINT64> remap(lod.vertices.size());
+
+        LOD welded;
+        welded.cacheStats = lod.cacheStats;
+        welded.geometricError = lod.geometricError;
+        welded.vertices.reserve(lod.vertices.size());
+        welded.normals.reserve(lod.normals.size());
+        welded.colors.reserve(lod.colors.size());
+        welded.UVs.reserve(lod.UVs.size());
+
+        for (size_t vertex = 0; vertex < lod.vertices.size(); ++vertex)
+        {
+            auto [it, isInserted] = uniqueVertices.try_emplace(MakeWeldKey(lod, vertex, epsilon), welded.vertices.size());
+            if (isInserted)
+            {
+                welded.vertices.push_back(lod.vertices[vertex]);
+                welded.normals.push_back(lod.normals[vertex]);
+                welded.colors.push_back(lod.colors[vertex]);
+                welded.UVs.push_back(lod.UVs[vertex]);
+            }
+            remap[vertex] = it->second;
+        }
+
+        welded.indices.reserve(lod.indices.size());
+        for (UINT64 index : lod.indices)
+        {
+            welded.indices.push_back(remap[index]);
+        }
+
+        lod = std::move(welded);
+    }
+
+    VertexCacheStats AnalyzeVertexCache(const std::vector<UINT64>& indices, size_t vertexCount, uint32_t cacheSize)
+    {
+        VertexCacheStats stats = {};
+        if (indices.empty() || vertexCount == 0)
+        {
+            return stats;
+        }
+
+        // A vertex is in the FIFO cache if less than cacheSize vertices were transformed after it
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<bool> isReferenced(vertexCount, false);
+        uint32_t timestamp = cacheSize + 1;
+        size_t transformedCount = 0;
+        size_t referencedCount = 0;
+
+        for (UINT64 index : indices)
+        {
+            if (timestamp - cacheTime[index] > cacheSize)
+            {
+                cacheTime[index] = timestamp++;
+                ++transformedCount;
+            }
+
+            if (!isReferenced[index])
+            {
+                isReferenced[index] = true;
+                ++referencedCount;
+            }
+        }
+
+        stats.acmr = static_cast<float>(transformedCount) / static_cast<float>(indices.size() / 3);
+        stats.atvr = static_cast<float>(transformedCount) / static_cast<float>(referencedCount);
+
+        return stats;
+    }
+
+    void OptimizeVertexCache(std::vector<UINT64>& indices, size_t vertexCount, uint32_t cacheSize)
+    {
+        if (indices.empty() || vertexCount == 0)
+        {
+            return;
+        }
+
+        const size_t triangleCount = indices.size() / 3;
+        TriangleAdjacency adjacency = BuildAdjacency(indices, vertexCount);
+
+        std::vector<uint32_t> liveTriangles(vertexCount);
+        for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            liveTriangles[vertex] = adjacency.offsets[vertex + 1] - adjacency.offsets[vertex];
+        }
+
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<bool> isEmitted(triangleCount, false);
+        std::vector<UINT64> deadEnd;
+        std::vector<UINT64> candidates;
+        uint32_t timestamp = cacheSize + 1;
+        size_t cursor = 0;
+
+        std::vector<UINT64> result;
+        result.reserve(indices.size());
+
+        int64_t fanningVertex = 0;
+        while (fanningVertex >= 0)
+        {
+            candidates.clear();
+
+            for (uint32_t i = adjacency.offsets[fanningVertex]; i < adjacency.offsets[fanningVertex + 1]; ++i)
+            {
+                uint32_t triangle = adjacency.triangles[i];
+                if (isEmitted[triangle])
+                {
+                    continue;
+                }
+
+                for (size_t corner = 0; corner < 3; ++corner)
+                {
+                    UINT64 vertex = indices[triangle * 3 + corner];
+
+                    result.push_back(vertex);
+                    deadEnd.push_back(vertex);
+                    candidates.push_back(vertex);
+                    --liveTriangles[vertex];
+
+                    if (timestamp - cacheTime[vertex] > cacheSize)
+                    {
+                        cacheTime[vertex] = timestamp++;
+                    }
+                }
+
+                isEmitted[triangle] = true;
+            }
+
+            fanningVertex = GetNextVertex(candidates, liveTriangles, cacheTime, timestamp, cacheSize);
+            if (fanningVertex >= 0)
+            {
+                continue;
+            }
+
+            // Dead end: go back to the recently used vertices that still have triangles
+            while (!deadEnd.empty() && fanningVertex < 0)
+            {
+                UINT64 vertex = deadEnd.back();
+                deadEnd.pop_back();
+
+                if (liveTriangles[vertex] > 0)
+                {
+                    fanningVertex = static_cast<int64_t>(vertex);
+                }
+            }
+
+            // Otherwise continue with the next vertex in the input order
+            while (fanningVertex < 0 && cursor < vertexCount)
+            {
+                if (liveTriangles[cursor] > 0)
+                {
+                    fanningVertex = static_cast<int64_t>(cursor);
+                }
+                ++cursor;
+            }
+        }
+
+        indices = std::move(result);
+    }
+
+    void OptimizeVertexFetch(LOD& lod)
+    {
+        std::vector<UINT64> remap(lod.vertices.size(), INVALID_INDEX);
+
+        LOD reordered;
+        reordered.cacheStats = lod.cacheStats;
+        reordered.geometricError = lod.geometricError;
+        reordered.indices.reserve(lod.indices.size());
+
+        for (UINT64 index : lod.indices)
+        {
+            if (remap[index] == INVALID_INDEX)
+            {
+                remap[index] = reordered.vertices.size();
+
+                reordered.vertices.push_back(lod.vertices[index]);
+                reordered.normals.push_back(lod.normals[index]);
+                reordered.colors.push_back(lod.colors[index]);
+                reordered.UVs.push_back(lod.UVs[index]);
+            }
+
+            reordered.indices.push_back(remap[index]);
+        }
+
+        lod = std::move(reordered);
+    }
+
+    void Optimize(LOD& lod, uint32_t cacheSize)
+    {
+        VertexCacheStats before = AnalyzeVertexCache(lod.indices, lod.vertices.size(), cacheSize);
+
+        OptimizeVertexCache(lod.indices, lod.vertices.size(), cacheSize);
+        OptimizeVertexFetch(lod);
+
+        VertexCacheStats after = AnalyzeVertexCache(lod.indices, lod.vertices.size(), cacheSize);
+
+        lod.cacheStats.acmrBefore = before.acmr;
+        lod.cacheStats.atvrBefore = before.atvr;
+        lod.cacheStats.acmrAfter = after.acmr;
+        lod.cacheStats.atvrAfter = after.atvr;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Node.h"
+
+namespace MeshOptimizer
+{
+    // Merges vertices with identical attributes and rebuilds the index buffer.
+    // Attributes are compared on a grid of epsilon size, or bitwise if epsilon is 0.
+    void WeldVertices(LOD& lod, float epsilon = 0.0f);
+
+    struct VertexCacheStats
+    {
+        float acmr; // Average cache miss ratio, transformed vertices per triangle
+        float atvr; // Average transform to vertex ratio, transformed vertices per referenced vertex
+    };
+
+    // Simulates a FIFO post-transform cache of cacheSize entries over the index buffer
+    VertexCacheStats AnalyzeVertexCache(const std::vector<UINT64>& indices, size_t vertexCount, uint32_t cacheSize);
+
+    // Reorders the triangles for the post-transform vertex cache (Tipsify, Sander et al. 2007)
+    void OptimizeVertexCache(std::vector<UINT64>& indices, size_t vertexCount, uint32_t cacheSize);
+
+    // Renumbers the vertices in the order of their first use by the index buffer.
+    // Vertices that are not referenced by any triangle are dropped.
+    void OptimizeVertexFetch(LOD& lod);
+
+    // Runs the vertex cache and the vertex fetch passes and records the cache statistics
+    // before and after them in lod.cacheStats
+    void Optimize(LOD& lod, uint32_t cacheSize);
+}
@@ -0,0 +1,485 @@
+#include "pch.h"
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <tuple>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t INVALID_VERTEX = std::numeric_limits<uint32_t>::max();
+
+    // Collapses that turn a triangle by more than ~75 degrees are rejected
+    constexpr double MAX_NORMAL_DEVIATION = 0.25;
+
+    struct Vector3
+    {
+        double x, y, z;
+
+        Vector3 operator-(const Vector3& other) const { return { x - other.x, y - other.y, z - other.z }; }
+    };
+
+    Vector3 Cross(const Vector3& a, const Vector3& b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    double Dot(const Vector3& a, const Vector3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    // Symmetric 4x4 matrix of the plane equations, sum of squared distances to the planes
+    // weighted by the triangle areas
+    struct Quadric
+    {
+        double a2, ab, ac, ad;
+        double b2, bc, bd;
+        double c2, cd;
+        double d2;
+        // Sum of the plane weights
+        double weight;
+
+        void AddPlane(const Vector3& normal, double d, double weight)
+        {
+            a2 += weight * normal.x * normal.x;
+            ab += weight * normal.x * normal.y;
+            ac += weight * normal.x * normal.z;
+            ad += weight * normal.x * d;
+            b2 += weight * normal.y * normal.y;
+            bc += weight * normal.y * normal.z;
+            bd += weight * normal.y * d;
+            c2 += weight * normal.z * normal.z;
+            cd += weight * normal.z * d;
+            d2 += weight * d * d;
+            this->weight += weight;
+        }
+
+        void Add(const Quadric& other)
+        {
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+            b2 += other.b2; bc += other.bc; bd += other.bd;
+            c2 += other.c2; cd += other.cd;
+            d2 += other.d2;
+            weight += other.weight;
+        }
+
+        double Evaluate(const Vector3& p) const
+        {
+            double error = a2 * p.x * p.x + 2.0 * ab * p.x * p.y + 2.0 * ac * p.x * p.z + 2.0 * ad * p.x
+                + b2 * p.y * p.y + 2.0 * bc * p.y * p.z + 2.0 * bd * p.y
+                + c2 * p.z * p.z + 2.0 * cd * p.z
+                + d2;
+
+            return std::max(error, 0.0);
+        }
+
+        // Weighted mean of the squared distances, independent of the mesh scale unlike Evaluate
+        double EvaluateDistance2(const Vector3& p) const
+        {
+            return weight > 0.0 ? Evaluate(p) / weight : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        // Squared distance, as EvaluateDistance2 returns it
+        double cost;
+        uint32_t source;
+        uint32_t target;
+        uint32_t version;
+
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const LOD& source)
+            : _source(source)
+        {
+            const size_t vertexCount = source.vertices.size();
+
+            _positions.resize(vertexCount);
+            for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+            {
+                XMFLOAT3 position;
+                XMStoreFloat3(&position, source.vertices[vertex]);
+                _positions[vertex] = { position.x, position.y, position.z };
+            }
+
+            _indices.assign(source.indices.begin(), source.indices.end());
+            _isTriangleAlive.assign(_indices.size() / 3, true);
+            _liveTriangleCount = _indices.size() / 3;
+
+            _vertexTriangles.resize(vertexCount);
+            for (size_t i = 0; i < _indices.size(); ++i)
+            {
+                _vertexTriangles[_indices[i]].push_back(static_cast<uint32_t>(i / 3));
+            }
+
+            _quadrics.assign(vertexCount, {});
+            for (size_t triangle = 0; triangle < _isTriangleAlive.size(); ++triangle)
+            {
+                const Vector3& p0 = _positions[_indices[triangle * 3 + 0]];
+                const Vector3& p1 = _positions[_indices[triangle * 3 + 1]];
+                const Vector3& p2 = _positions[_indices[triangle * 3 + 2]];
+
+                Vector3 normal = Cross(p1 - p0, p2 - p0);
+                double length = std::sqrt(Dot(normal, normal));
+                if (length == 0.0)
+                {
+                    continue;
+                }
+
+                // Weight the plane by the triangle area
+                normal = { normal.x / length, normal.y / length, normal.z / length };
+                double d = -Dot(normal, p0);
+                for (size_t corner = 0; corner < 3; ++corner)
+                {
+                    _quadrics[_indices[triangle * 3 + corner]].AddPlane(normal, d, length * 0.5);
+                }
+            }
+
+            _versions.assign(vertexCount, 0);
+            _isRemoved.assign(vertexCount, false);
+            _ClassifyVertices();
+        }
+
+        float Run(size_t targetIndexCount, float maxError, LOD& result)
+        {
+            const double maxCost = static_cast<double>(maxError) * maxError;
+            const size_t targetTriangleCount = targetIndexCount / 3;
+
+            for (uint32_t vertex = 0; vertex < _positions.size(); ++vertex)
+            {
+                _PushBestCollapse(vertex);
+            }
+
+            double error = 0.0;
+            while (_liveTriangleCount > targetTriangleCount && !_queue.empty())
+            {
+                Collapse collapse = _queue.top();
+                _queue.pop();
+
+                if (_isRemoved[collapse.source] || _versions[collapse.source] != collapse.version)
+                {
+                    continue;
+                }
+
+                if (collapse.cost > maxCost)
+                {
+                    break;
+                }
+
+                if (!_IsValidCollapse(collapse.source, collapse.target))
+                {
+                    ++_versions[collapse.source];
+                    _PushBestCollapse(collapse.source);
+                    continue;
+                }
+
+                error = std::max(error, collapse.cost);
+                _Collapse(collapse.source, collapse.target);
+            }
+
+            _BuildResult(result);
+
+            return static_cast<float>(std::sqrt(error));
+        }
+
+    private:
+        // Vertices on the borders of the index topology (open borders and attribute seams,
+        // where the welded vertices are split) and vertices that share their position with
+        // another vertex are locked in place
+        void _ClassifyVertices()
+        {
+            _isLocked.assign(_positions.size(), false);
+
+            std::vector<std::pair<uint32_t, uint32_t>> edges;
+            edges.reserve(_indices.size());
+            for (size_t triangle = 0; triangle < _isTriangleAlive.size(); ++triangle)
+            {
+                for (size_t corner = 0; corner < 3; ++corner)
+                {
+                    uint32_t a = _indices[triangle * 3 + corner];
+                    uint32_t b = _indices[triangle * 3 + (corner + 1) % 3];
+                    edges.emplace_back(std::min(a, b), std::max(a, b));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+
+            for (size_t i = 0; i < edges.size();)
+            {
+                size_t j = i;
+                while (j < edges.size() && edges[j] == edges[i])
+                {
+                    ++j;
+                }
+
+                // Manifold interior edges are shared by exactly two triangles
+                if (j - i != 2)
+                {
+                    _isLocked[edges[i].first] = true;
+                    _isLocked[edges[i].second] = true;
+                }
+                i = j;
+            }
+
+            std::vector<uint32_t> order(_positions.size());
+            for (uint32_t vertex = 0; vertex < order.size(); ++vertex)
+            {
+                order[vertex] = vertex;
+            }
+
+            auto positionLess = [this](uint32_t a, uint32_t b)
+                {
+                    const Vector3& pa = _positions[a];
+                    const Vector3& pb = _positions[b];
+                    return std::tie(pa.x, pa.y, pa.z) < std::tie(pb.x, pb.y, pb.z);
+                };
+            std::sort(order.begin(), order.end(), positionLess);
+
+            for (size_t i = 1; i < order.size(); ++i)
+            {
+                if (!positionLess(order[i - 1], order[i]))
+                {
+                    _isLocked[order[i - 1]] = true;
+                    _isLocked[order[i]] = true;
+                }
+            }
+        }
+
+        void _GetNeighbors(uint32_t vertex, std::vector<uint32_t>& outNeighbors) const
+        {
+            outNeighbors.clear();
+            for (uint32_t triangle : _vertexTriangles[vertex])
+            {
+                for (size_t corner = 0; corner < 3; ++corner)
+                {
+                    uint32_t neighbor = _indices[triangle * 3 + corner];
+                    if (neighbor != vertex && std::find(outNeighbors.begin(), outNeighbors.end(), neighbor) == outNeighbors.end())
+                    {
+                        outNeighbors.push_back(neighbor);
+                    }
+                }
+            }
+        }
+
+        bool _IsValidCollapse(uint32_t source, uint32_t target)
+        {
+            // Link condition: the only common neighbors of the edge ends are the opposite
+            // vertices of the two edge triangles, otherwise the collapse creates a non-manifold fold
+            _GetNeighbors(source, _sourceNeighbors);
+            _GetNeighbors(target, _targetNeighbors);
+
+            if (std::find(_sourceNeighbors.begin(), _sourceNeighbors.end(), target) == _sourceNeighbors.end())
+            {
+                return false;
+            }
+
+            size_t commonCount = 0;
+            size_t edgeTriangleCount = 0;
+            for (uint32_t neighbor : _sourceNeighbors)
+            {
+                if (std::find(_targetNeighbors.begin(), _targetNeighbors.end(), neighbor) != _targetNeighbors.end())
+                {
+                    ++commonCount;
+                }
+            }
+
+            const Vector3& targetPosition = _positions[target];
+            for (uint32_t triangle : _vertexTriangles[source])
+            {
+                uint32_t i0 = _indices[triangle * 3 + 0];
+                uint32_t i1 = _indices[triangle * 3 + 1];
+                uint32_t i2 = _indices[triangle * 3 + 2];
+
+                if (i0 == target || i1 == target || i2 == target)
+                {
+                    ++edgeTriangleCount;
+                    continue;
+                }
+
+                // The triangle must not flip or turn too much when the source moves to the target
+                const Vector3& p0 = _positions[i0];
+                const Vector3& p1 = _positions[i1];
+                const Vector3& p2 = _positions[i2];
+                Vector3 oldNormal = Cross(p1 - p0, p2 - p0);
+
+                const Vector3& n0 = i0 == source ? targetPosition : p0;
+                const Vector3& n1 = i1 == source ? targetPosition : p1;
+                const Vector3& n2 = i2 == source ? targetPosition : p2;
+                Vector3 newNormal = Cross(n1 - n0, n2 - n0);
+
+                double lengths = std::sqrt(Dot(oldNormal, oldNormal) * Dot(newNormal, newNormal));
+                if (Dot(oldNormal, newNormal) < MAX_NORMAL_DEVIATION * lengths)
+                {
+                    return false;
+                }
+            }
+
+            return edgeTriangleCount == 2 && commonCount == 2;
+        }
+
+        void _PushBestCollapse(uint32_t source)
+        {
+            if (_isLocked[source] || _isRemoved[source])
+            {
+                return;
+            }
+
+            std::vector<uint32_t> neighbors;
+            _GetNeighbors(source, neighbors);
+
+            Collapse best = { std::numeric_limits<double>::max(), source, INVALID_VERTEX, _versions[source] };
+            for (uint32_t target : neighbors)
+            {
+                double cost = _quadrics[source].EvaluateDistance2(_positions[target]);
+                if (cost < best.cost && _IsValidCollapse(source, target))
+                {
+                    best.cost = cost;
+                    best.target = target;
+                }
+            }
+
+            if (best.target != INVALID_VERTEX)
+            {
+                _queue.push(best);
+            }
+        }
+
+        void _Collapse(uint32_t source, uint32_t target)
+        {
+            for (uint32_t triangle : _vertexTriangles[source])
+            {
+                uint32_t* corners = &_indices[triangle * 3];
+                if (corners[0] == target || corners[1] == target || corners[2] == target)
+                {
+                    // Degenerate after the collapse
+                    _isTriangleAlive[triangle] = false;
+                    --_liveTriangleCount;
+
+                    for (size_t corner = 0; corner < 3; ++corner)
+                    {
+                        if (corners[corner] != source)
+                        {
+                            std::vector<uint32_t>& triangles = _vertexTriangles[corners[corner]];
+                            triangles.erase(std::find(triangles.begin(), triangles.end(), triangle));
+                        }
+                    }
+                    continue;
+                }
+
+                for (size_t corner = 0; corner < 3; ++corner)
+                {
+                    if (corners[corner] == source)
+                    {
+                        corners[corner] = target;
+                    }
+                }
+                _vertexTriangles[target].push_back(triangle);
+            }
+
+            _vertexTriangles[source].clear();
+            _isRemoved[source] = true;
+            _quadrics[target].Add(_quadrics[source]);
+
+            // Collapses around the target see a different one-ring now
+            std::vector<uint32_t> neighbors;
+            _GetNeighbors(target, neighbors);
+            neighbors.push_back(target);
+            for (uint32_t vertex : neighbors)
+            {
+                ++_versions[vertex];
+                _PushBestCollapse(vertex);
+            }
+        }
+
+        void _BuildResult(LOD& result) const
+        {
+            result = {};
+
+            std::vector<uint32_t> remap(_positions.size(), INVALID_VERTEX);
+            for (size_t triangle = 0; triangle < _isTriangleAlive.size(); ++triangle)
+            {
+                if (!_isTriangleAlive[triangle])
+                {
+                    continue;
+                }
+
+                for (size_t corner = 0; corner < 3; ++corner)
+                {
+                    uint32_t vertex = _indices[triangle * 3 + corner];
+                    if (remap[vertex] == INVALID_VERTEX)
+                    {
+                        remap[vertex] = static_cast<uint32_t>(result.vertices.size());
+
+                        result.vertices.push_back(_source.vertices[vertex]);
+                        result.normals.push_back(_source.normals[vertex]);
+                        result.colors.push_back(_source.colors[vertex]);
+                        result.UVs.push_back(_source.UVs[vertex]);
+                    }
+                    result.indices.push_back(remap[vertex]);
+                }
+            }
+        }
+
+        const LOD& _source;
+
+        std::vector<Vector3> _positions;
+        std::vector<uint32_t> _indices;
+        std::vector<bool> _isTriangleAlive;
+        size_t _liveTriangleCount;
+
+        std::vector<std::vector<uint32_t>> _vertexTriangles;
+        std::vector<Quadric> _quadrics;
+        std::vector<bool> _isLocked;
+        std::vector<bool> _isRemoved;
+        std::vector<uint32_t> _versions;
+
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> _queue;
+
+        // Scratch buffers of _IsValidCollapse
+        std::vector<uint32_t> _sourceNeighbors;
+        std::vector<uint32_t> _targetNeighbors;
+    };
+}
+
+namespace MeshSimplifier
+{
+    float Simplify(const LOD& source, size_t targetIndexCount, float maxError, LOD& result)
+    {
+        if (source.indices.size() <= targetIndexCount)
+        {
+            result = source;
+            return 0.0f;
+        }
+
+        Simplifier simplifier(source);
+        return simplifier.Run(targetIndexCount, maxError, result);
+    }
+
+    float GetExtent(const LOD& lod)
+    {
+        if (lod.vertices.empty())
+        {
+            return 0.0f;
+        }
+
+        XMVECTOR min = lod.vertices[0];
+        XMVECTOR max = lod.vertices[0];
+        for (const XMVECTOR& vertex : lod.vertices)
+        {
+            min = XMVectorMin(min, vertex);
+            max = XMVectorMax(max, vertex);
+        }
+
+        return XMVectorGetX(XMVector3Length(XMVectorSubtract(max, min)));
+    }
+}
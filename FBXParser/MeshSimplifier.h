@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Node.h"
+
+namespace MeshSimplifier
+{
+    // Reduces the triangle count of the LOD down to targetIndexCount indices by quadric error
+    // half-edge collapses (Garland & Heckbert 1997). The error of a collapse is the area-weighted
+    // RMS distance of the new position to the LOD0 triangles merged into the vertex, so it does not
+    // depend on the mesh scale. Collapses stop once it exceeds maxError (in the units of the
+    // vertex positions).
+    // Vertices on open borders and on attribute seams (UV, normal or color discontinuities)
+    // never move, so the seams and borders are kept intact.
+    // Returns the geometric error of the result
+    float Simplify(const LOD& source, size_t targetIndexCount, float maxError, LOD& result);
+
+    // Length of the diagonal of the bounding box of the LOD vertices
+    float GetExtent(const LOD& lod);
+}
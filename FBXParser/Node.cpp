@@ -1,10 +1,20 @@
 #include "pch.h"
 #include "Node.h"
 
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+
 using namespace DirectX;
 
 namespace
 {
+    // Largest UV coordinate that is stored as a half float in the packed vertex layout
+    constexpr float MAX_PACKED_UV = 4.0f;
+
     XMMATRIX GetNodeLocalTransform(FbxNode* fbxNode)
     {
         FbxAMatrix fbxTransform = fbxNode->EvaluateLocalTransform();
@@ -320,7 +330,7 @@ std::string Node::GetTextureName() const
     return _textureName;
 }
 
-bool Node::Parse(FbxNode* fbxNode)
+bool Node::Parse(FbxNode* fbxNode, const CookSettings& settings)
 {
     _name = fbxNode->GetName();
 
@@ -335,7 +345,7 @@ bool Node::Parse(FbxNode* fbxNode)
         _aabb.first = XMVectorSet(min.mData[0], min.mData[1], min.mData[2], min.mData[3]);
         _aabb.second = XMVectorSet(max.mData[0], max.mData[1], max.mData[2], max.mData[3]);
 
-        ParseMesh(fbxMesh, 0);
+        ParseMesh(fbxMesh, 0, settings);
 
         _textureName = GetDiffuseTextureName(fbxNode);
     }
@@ -344,14 +354,14 @@ bool Node::Parse(FbxNode* fbxNode)
     for (int childIndex = 0; childIndex < fbxNode->GetChildCount(); ++childIndex)
     {
         auto childNode = std::make_shared<Node>();
-        childNode->Parse(fbxNode->GetChild(childIndex));
+        childNode->Parse(fbxNode->GetChild(childIndex), settings);
         _children.push_back(childNode);
     }
 
     return true;
 }
 
-bool Node::Parse(std::vector<FbxNode*> fbxLODs)
+bool Node::Parse(std::vector<FbxNode*> fbxLODs, const CookSettings& settings)
 {
     if (fbxLODs.empty())
     {
@@ -381,7 +391,7 @@ bool Node::Parse(std::vector<FbxNode*> fbxLODs)
             _aabb.first = XMVectorSet(min.mData[0], min.mData[1], min.mData[2], min.mData[3]);
             _aabb.second = XMVectorSet(max.mData[0], max.mData[1], max.mData[2], max.mData[3]);
 
-            ParseMesh(fbxMesh, i);
+            ParseMesh(fbxMesh, i, settings);
 
             _textureName = GetDiffuseTextureName(fbxLODs[i]);
         }
@@ -399,14 +409,79 @@ bool Node::Parse(std::vector<FbxNode*> fbxLODs)
         }
 
         auto childNode = std::make_shared<Node>();
-        childNode->Parse(children);
+        childNode->Parse(children, settings);
         _children.push_back(childNode);
     }
 
     return true;
 }
 
-bool Node::Save(const std::string& path) const
+void Node::GenerateLODs(const CookSettings& settings)
+{
+    if (_lods.size() != 1 || _lods[0].indices.empty())
+    {
+        return;
+    }
+
+    const float maxError = settings.lodMaxError * MeshSimplifier::GetExtent(_lods[0]);
+
+    for (float ratio : settings.lodRatios)
+    {
+        size_t targetIndexCount = static_cast<size_t>(_lods[0].indices.size() * ratio) / 3 * 3;
+
+        LOD lod;
+        lod.geometricError = MeshSimplifier::Simplify(_lods[0], targetIndexCount, maxError, lod);
+
+        // The error limit was reached before the mesh got noticeably simpler, coarser levels won't do better
+        if (lod.indices.size() > _lods.back().indices.size() * 9 / 10)
+        {
+            break;
+        }
+
+        if (settings.optimizeVertexCache)
+        {
+            MeshOptimizer::Optimize(lod, settings.vertexCacheSize);
+        }
+
+        _lods.push_back(std::move(lod));
+    }
+}
+
+void Node::ChooseVertexLayout(const CookSettings& settings)
+{
+    _hasPositionStream = settings.writePositionStream;
+
+    if (!settings.packVertices || _lods.empty() || _lods[0].vertices.empty())
+    {
+        return;
+    }
+
+    MeshFormat::Quantization quantization = MeshFile::ComputeQuantization(_lods);
+
+    // Rounding to the nearest of the 65536 steps moves a position by half a step at most
+    float maxScale = std::max({ quantization.scale[0], quantization.scale[1], quantization.scale[2] });
+    if (maxScale / 65535.0f * 0.5f > settings.packPositionTolerance)
+    {
+        return;
+    }
+
+    // Half floats lose too much precision for tiled UVs
+    for (const LOD& lod : _lods)
+    {
+        for (const XMFLOAT2& uv : lod.UVs)
+        {
+            if (std::abs(uv.x) > MAX_PACKED_UV || std::abs(uv.y) > MAX_PACKED_UV)
+            {
+                return;
+            }
+        }
+    }
+
+    _isPacked = true;
+    _quantization = quantization;
+}
+
+bool Node::Save(const std::string& path, MeshFile::SharedMeshes& meshes) const
 {
     std::string rootPath = path + _name + ".node";
     std::ofstream out(rootPath, std::fstream::out | std::ios_base::binary);
@@ -418,6 +493,7 @@ bool Node::Save(const std::string& path) const
     jsonRoot["Name"] = _name.c_str();
 
     Json::Value lods(Json::arrayValue);
+    Json::Value lodErrors(Json::arrayValue);
     for (int lod = 0; lod < _lods.size(); ++lod)
     {
         if (_lods[lod].vertices.empty())
@@ -426,9 +502,9 @@ bool Node::Save(const std::string& path) const
         }
         // Save mesh data
         const std::string lodName = "LOD" + std::to_string(lod);
-        std::string meshFilepath = (_name + '_' + lodName + ".mesh").c_str();
-        SaveMesh(path + meshFilepath, lod);
+        std::string meshFilepath = SaveMesh(meshes, _name + '_' + lodName + ".mesh", lod);
         lods.append(meshFilepath.c_str());
+        lodErrors.append(_lods[lod].geometricError);
 
         // Save material data
         std::string materialFilepath = (_name + ".mat").c_str();
@@ -438,6 +514,7 @@ bool Node::Save(const std::string& path) const
     if (!lods.empty())
     {
         jsonRoot["LODs"] = lods;
+        jsonRoot["LODErrors"] = lodErrors;
     }
 
     Json::Value jsonTransform;
@@ -474,12 +551,25 @@ bool Node::Save(const std::string& path) const
     jsonAABB["Max"]["w"] = XMVectorGetW(_aabb.second);
     jsonRoot["AABB"] = jsonAABB;
 
+    // Dequantization constants of the packed vertex positions
+    if (_isPacked)
+    {
+        Json::Value jsonQuantization;
+        jsonQuantization["Offset"]["x"] = _quantization.offset[0];
+        jsonQuantization["Offset"]["y"] = _quantization.offset[1];
+        jsonQuantization["Offset"]["z"] = _quantization.offset[2];
+        jsonQuantization["Scale"]["x"] = _quantization.scale[0];
+        jsonQuantization["Scale"]["y"] = _quantization.scale[1];
+        jsonQuantization["Scale"]["z"] = _quantization.scale[2];
+        jsonRoot["Quantization"] = jsonQuantization;
+    }
+
     jsonRoot["IsOccluder"] = _isOccluder;
 
     Json::Value nodes(Json::arrayValue);
     for (const auto& node : _children)
     {
-        node->Save(path);
+        node->Save(path, meshes);
         nodes.append((node->GetName() + ".node").c_str());
     }
     jsonRoot["Nodes"] = nodes;
@@ -494,39 +584,14 @@ bool Node::SaveChildren(const std::string& path) const
     return false;
 }
 
-bool Node::SaveMesh(const std::string& path, int lod) const
+std::string Node::SaveMesh(MeshFile::SharedMeshes& meshes, const std::string& filename, int lod) const
 {
-    std::ofstream out(path, std::fstream::out);
-
-    for (const auto& vertex : _lods[lod].vertices)
-    {
-        out << "v " << XMVectorGetX(vertex) << ' ' << XMVectorGetY(vertex) << ' ' << XMVectorGetZ(vertex) << ' ' << XMVectorGetW(vertex) << '\n';
-    }
-
-    for (const auto& normal : _lods[lod].normals)
-    {
-        out << "vn " << XMVectorGetX(normal) << ' ' << XMVectorGetY(normal) << ' ' << XMVectorGetZ(normal) << ' ' << XMVectorGetW(normal) << '\n';
-    }
+    MeshFile::VertexPacking packing;
+    packing.isPacked = _isPacked;
+    packing.quantization = _quantization;
+    packing.hasPositionStream = _hasPositionStream;
 
-    for (const auto& color : _lods[lod].colors)
-    {
-        out << "vc " << XMVectorGetX(color) << ' ' << XMVectorGetY(color) << ' ' << XMVectorGetZ(color) << ' ' << 1.0f << '\n';
-    }
-
-    for (const auto& uv : _lods[lod].UVs)
-    {
-        out << "vt " << uv.x << ' ' << uv.y << " 0" << '\n';
-    }
-
-    for (int i = 0; i < _lods[lod].indices.size(); i += 3)
-    {
-        out << "f " <<
-            _lods[lod].indices[i]     << '/' << _lods[lod].indices[i]     << '/' << _lods[lod].indices[i] << ' ' <<
-            _lods[lod].indices[i + 1] << '/' << _lods[lod].indices[i + 1] << '/' << _lods[lod].indices[i + 1] << ' ' <<
-            _lods[lod].indices[i + 2] << '/' << _lods[lod].indices[i + 2] << '/' << _lods[lod].indices[i + 2] << '\n';
-    }
-
-    return true;
+    return meshes.Save(filename, _lods[lod], packing);
 }
 
 bool Node::SaveMaterial(const std::string& path) const
@@ -543,7 +608,7 @@ bool Node::SaveMaterial(const std::string& path) const
     return true;
 }
 
-bool Node::ParseMesh(FbxMesh* fbxMesh, int lod)
+bool Node::ParseMesh(FbxMesh* fbxMesh, int lod, const CookSettings& settings)
 {
     for (int polygonIndex = 0; polygonIndex < fbxMesh->GetPolygonCount(); ++polygonIndex)
     {
@@ -565,9 +630,20 @@ bool Node::ParseMesh(FbxMesh* fbxMesh, int lod)
             _lods[lod].normals.push_back(XMVector3Normalize(normal));
             _lods[lod].colors.push_back(color);
             _lods[lod].UVs.push_back(uv);
-            _lods[lod].indices.push_back(vertexAbsoluteIndex);
+            _lods[lod].indices.push_back(_lods[lod].vertices.size() - 1);
         }
     }
 
+    // Every face corner was read as a separate vertex, merge the identical ones
+    if (settings.weldVertices)
+    {
+        MeshOptimizer::WeldVertices(_lods[lod], settings.weldEpsilon);
+    }
+
+    if (settings.optimizeVertexCache)
+    {
+        MeshOptimizer::Optimize(_lods[lod], settings.vertexCacheSize);
+    }
+
     return false;
 }
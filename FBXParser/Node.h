@@ -1,13 +1,12 @@
 #pragma once
 
-struct LOD
+#include "CookSettings.h"
+#include "LOD.h"
+
+namespace MeshFile
 {
-    std::vector<DirectX::XMVECTOR> vertices = {};
-    std::vector<DirectX::XMVECTOR> normals = {};
-    std::vector<DirectX::XMVECTOR> colors = {};
-    std::vector<DirectX::XMFLOAT2> UVs = {};
-    std::vector<UINT64> indices = {};
-};
+    class SharedMeshes;
+}
 
 class Node
 {
@@ -27,16 +26,24 @@ public:
 
     std::string GetTextureName() const;
 
-    bool Parse(FbxNode* fbxNode);
-    bool Parse(std::vector<FbxNode*> fbxLODs);
+    bool Parse(FbxNode* fbxNode, const CookSettings& settings);
+    bool Parse(std::vector<FbxNode*> fbxLODs, const CookSettings& settings);
+
+    // Builds the LOD chain from LOD0 by mesh simplification, if the node was imported from a single file
+    void GenerateLODs(const CookSettings& settings);
+    // Picks the packed vertex layout for the node meshes if it keeps their precision,
+    // and whether the meshes get a position only stream
+    void ChooseVertexLayout(const CookSettings& settings);
 
-    bool Save(const std::string& path) const;
+    // Identical meshes of different nodes are written once through the shared meshes
+    bool Save(const std::string& path, MeshFile::SharedMeshes& meshes) const;
 
 private:
-    bool ParseMesh(FbxMesh* fbxMesh, int lod);
+    bool ParseMesh(FbxMesh* fbxMesh, int lod, const CookSettings& settings);
 
     bool SaveChildren(const std::string& path) const;
-    bool SaveMesh(const std::string& path, int lod) const;
+    // Returns the name of the mesh file the LOD references, empty on failure
+    std::string SaveMesh(MeshFile::SharedMeshes& meshes, const std::string& filename, int lod) const;
     bool SaveMaterial(const std::string& path) const;
 
     std::string _name;
@@ -47,6 +54,9 @@ private:
 
     std::pair<DirectX::XMVECTOR, DirectX::XMVECTOR> _aabb;
     std::vector<LOD> _lods;
+    bool _isPacked = false;
+    MeshFormat::Quantization _quantization = {};
+    bool _hasPositionStream = false;
     std::string _textureName;
     bool _isOccluder;
 };
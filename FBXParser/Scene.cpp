@@ -1,6 +1,12 @@
 #include "pch.h"
 #include "Scene.h"
 
+#include "MeshFile.h"
+
+#include <algorithm>
+#include <execution>
+#include <iostream>
+
 Scene::Scene()
     : _root{}
 {   }
@@ -18,7 +24,7 @@ std::shared_ptr<Node> Scene::GetRootNodes() const
     return _root;
 }
 
-bool Scene::Parse(const std::vector<FbxScene*>& fbxScenes)
+bool Scene::Parse(const std::vector<FbxScene*>& fbxScenes, const CookSettings& settings)
 {
     _name = fbxScenes[0]->GetName();
 
@@ -29,7 +35,25 @@ bool Scene::Parse(const std::vector<FbxScene*>& fbxScenes)
     }
     _root = std::make_shared<Node>();
 
-    return _root->Parse(fbxLODs);
+    if (!_root->Parse(fbxLODs, settings))
+    {
+        return false;
+    }
+
+    // The FBX SDK is not thread safe, so the simplification runs once all the nodes are imported
+    std::vector<std::shared_ptr<Node>> nodes = { _root };
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        nodes.insert(nodes.end(), nodes[i]->GetChildren().begin(), nodes[i]->GetChildren().end());
+    }
+
+    std::for_each(std::execution::par, nodes.begin(), nodes.end(), [&settings](const std::shared_ptr<Node>& node)
+        {
+            node->GenerateLODs(settings);
+            node->ChooseVertexLayout(settings);
+        });
+
+    return true;
 }
 
 bool Scene::Save(const std::string& path) const
@@ -43,10 +67,12 @@ bool Scene::Save(const std::string& path) const
     Json::Value jsonRoot;
     Json::Value nodes(Json::arrayValue);
 
+    MeshFile::SharedMeshes meshes(path);
+
     jsonRoot["Name"] = _name.c_str();
     for (const auto& node : _root->GetChildren())
     {
-        node->Save(path);
+        node->Save(path, meshes);
 
         nodes.append((node->GetName() + ".node").c_str());
     }
@@ -54,5 +80,8 @@ bool Scene::Save(const std::string& path) const
 
     writer->write(jsonRoot, &out);
 
+    std::cout << "Saved " << meshes.GetFileCount() << " mesh files, " << meshes.GetSharedCount() << " identical meshes shared ("
+        << meshes.GetSharedBytes() << " bytes)" << std::endl;
+
     return false;
 }
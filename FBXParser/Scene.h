@@ -11,7 +11,7 @@ public:
     std::string GetName() const;
     std::shared_ptr<Node> GetRootNodes() const;
 
-    bool Parse(const std::vector<FbxScene*>& fbxScene);
+    bool Parse(const std::vector<FbxScene*>& fbxScene, const CookSettings& settings);
 
     bool Save(const std::string& path) const;
 
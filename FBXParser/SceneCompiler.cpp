@@ -0,0 +1,335 @@
+#include "pch.h"
+
+#include "SceneCompiler.h"
+
+#include "MeshFile.h"
+#include "VisibilityBaker.h"
+
+#include "../DX12Lib/Scene/SceneFormat.h"
+
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+    class SceneBuilder
+    {
+    public:
+        explicit SceneBuilder(const std::filesystem::path& directory)
+            : _directory(directory)
+        {
+            // Offset 0 is the empty string
+            _strings.push_back('\0');
+        }
+
+        void AddScene(const std::string& filename)
+        {
+            Json::Value root = _ReadJson(filename);
+            _nameOffset = _AddString(root["Name"].asString());
+
+            for (const Json::Value& node : root["Nodes"])
+            {
+                _AddNode(node.asString(), SceneFormat::INVALID_INDEX);
+            }
+        }
+
+        std::string Serialize() const
+        {
+            SceneFormat::Header header = {};
+            header.magic = SceneFormat::MAGIC;
+            header.version = SceneFormat::VERSION;
+            header.headerSize = sizeof(SceneFormat::Header);
+            header.nodeCount = static_cast<uint32_t>(_nodes.size());
+            header.lodCount = static_cast<uint32_t>(_lods.size());
+            header.meshCount = static_cast<uint32_t>(_meshes.size());
+            header.materialCount = static_cast<uint32_t>(_materials.size());
+            header.stringsSize = static_cast<uint32_t>(_strings.size());
+            header.nameOffset = _nameOffset;
+
+            header.nodesOffset = SceneFormat::AlignOffset(sizeof(SceneFormat::Header));
+            header.lodsOffset = SceneFormat::AlignOffset(header.nodesOffset + _nodes.size() * sizeof(SceneFormat::Node));
+            header.meshesOffset = SceneFormat::AlignOffset(header.lodsOffset + _lods.size() * sizeof(SceneFormat::LOD));
+            header.materialsOffset = SceneFormat::AlignOffset(header.meshesOffset + _meshes.size() * sizeof(SceneFormat::MeshReference));
+            header.stringsOffset = SceneFormat::AlignOffset(header.materialsOffset + _materials.size() * sizeof(SceneFormat::Material));
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                header.cellOrigin[axis] = _visibility.cellOrigin[axis];
+                header.cellSize[axis] = _visibility.cellSize[axis];
+                header.cellCounts[axis] = _visibility.cellCounts[axis];
+            }
+            header.pvsSize = static_cast<uint32_t>(_visibility.pvs.size());
+            header.cellsOffset = SceneFormat::AlignOffset(header.stringsOffset + _strings.size());
+            header.pvsOffset = SceneFormat::AlignOffset(header.cellsOffset + _visibility.cells.size() * sizeof(SceneFormat::VisibilityCell));
+
+            std::string data(header.pvsOffset + _visibility.pvs.size(), '\0');
+            _Write(data, 0, &header, sizeof(header));
+            _Write(data, header.nodesOffset, _nodes.data(), _nodes.size() * sizeof(SceneFormat::Node));
+            _Write(data, header.lodsOffset, _lods.data(), _lods.size() * sizeof(SceneFormat::LOD));
+            _Write(data, header.meshesOffset, _meshes.data(), _meshes.size() * sizeof(SceneFormat::MeshReference));
+            _Write(data, header.materialsOffset, _materials.data(), _materials.size() * sizeof(SceneFormat::Material));
+            _Write(data, header.stringsOffset, _strings.data(), _strings.size());
+            _Write(data, header.cellsOffset, _visibility.cells.data(), _visibility.cells.size() * sizeof(SceneFormat::VisibilityCell));
+            _Write(data, header.pvsOffset, _visibility.pvs.data(), _visibility.pvs.size());
+
+            return data;
+        }
+
+        // From the world AABBs of the nodes and their LOD0 meshes, after AddScene
+        void BakeVisibility(float cellSize, uint32_t sampleCount)
+        {
+            // The parents precede their children
+            std::vector<XMMATRIX> globalTransforms(_nodes.size());
+            std::vector<VisibilityBaker::NodeGeometry> geometry(_nodes.size());
+            std::unordered_map<uint32_t, LOD> meshes;
+            for (size_t i = 0; i < _nodes.size(); ++i)
+            {
+                const SceneFormat::Node& node = _nodes[i];
+
+                const XMMATRIX local(&node.transform[0][0]);
+                globalTransforms[i] = node.parent != SceneFormat::INVALID_INDEX ? XMMatrixMultiply(local, globalTransforms[node.parent]) : local;
+
+                geometry[i].aabbMin = XMFLOAT3(node.aabbMin[0], node.aabbMin[1], node.aabbMin[2]);
+                geometry[i].aabbMax = XMFLOAT3(node.aabbMax[0], node.aabbMax[1], node.aabbMax[2]);
+                if (node.lodCount == 0)
+                {
+                    continue;
+                }
+
+                const uint32_t mesh = _lods[node.firstLOD].mesh;
+                auto [it, isInserted] = meshes.try_emplace(mesh);
+                const std::filesystem::path meshPath = _directory / (_strings.data() + _meshes[mesh].nameOffset);
+                if (isInserted && !MeshFile::Load(meshPath.string(), it->second))
+                {
+                    std::cout << "Failed to load " << meshPath.string() << std::endl;
+                    _isValid = false;
+                    return;
+                }
+
+                const LOD& lod = it->second;
+                for (UINT64 index : lod.indices)
+                {
+                    XMFLOAT3 vertex;
+                    XMStoreFloat3(&vertex, XMVector3TransformCoord(lod.vertices[index], globalTransforms[i]));
+                    geometry[i].triangles.push_back(vertex);
+                }
+            }
+
+            _visibility = VisibilityBaker::Bake(geometry, cellSize, sampleCount);
+        }
+
+        const VisibilityBaker::VisibilitySets& GetVisibility() const
+        {
+            return _visibility;
+        }
+
+        bool IsValid() const
+        {
+            return _isValid;
+        }
+
+    private:
+        // Depth first, so the children of a node follow it
+        void _AddNode(const std::string& filename, uint32_t parent)
+        {
+            Json::Value root = _ReadJson(filename);
+
+            uint32_t index = static_cast<uint32_t>(_nodes.size());
+            _nodes.emplace_back();
+
+            SceneFormat::Node node = {};
+            node.parent = parent;
+            node.nameOffset = _AddString(root["Name"].asString());
+
+            const char* rows[] = { "r0", "r1", "r2", "r3" };
+            const char* components[] = { "x", "y", "z", "w" };
+            for (int row = 0; row < 4; ++row)
+            {
+                for (int column = 0; column < 4; ++column)
+                {
+                    node.transform[row][column] = root["Transform"][rows[row]][components[column]].asFloat();
+                }
+            }
+
+            for (int i = 0; i < 4; ++i)
+            {
+                node.aabbMin[i] = root["AABB"]["Min"][components[i]].asFloat();
+                node.aabbMax[i] = root["AABB"]["Max"][components[i]].asFloat();
+            }
+
+            node.quantizationScale[0] = node.quantizationScale[1] = node.quantizationScale[2] = 1.0f;
+            if (root.isMember("Quantization"))
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    node.quantizationOffset[i] = root["Quantization"]["Offset"][components[i]].asFloat();
+                    node.quantizationScale[i] = root["Quantization"]["Scale"][components[i]].asFloat();
+                }
+                node.flags |= SceneFormat::NODE_FLAG_QUANTIZED;
+            }
+
+            if (root["IsOccluder"].asBool())
+            {
+                node.flags |= SceneFormat::NODE_FLAG_OCCLUDER;
+            }
+
+            if (root.isMember("MinScreenSize"))
+            {
+                node.minScreenSize = root["MinScreenSize"].asFloat();
+                node.flags |= SceneFormat::NODE_FLAG_MIN_SCREEN_SIZE;
+            }
+
+            node.firstLOD = static_cast<uint32_t>(_lods.size());
+            const Json::Value& lods = root["LODs"];
+            for (Json::ArrayIndex i = 0; i < lods.size(); ++i)
+            {
+                SceneFormat::LOD lod = {};
+                lod.mesh = _AddMesh(lods[i].asString());
+                lod.error = root["LODErrors"].get(i, 0.0f).asFloat();
+                _lods.push_back(lod);
+            }
+            node.lodCount = static_cast<uint32_t>(_lods.size()) - node.firstLOD;
+
+            node.material = root.isMember("Material") ? _AddMaterial(root["Material"].asString()) : SceneFormat::INVALID_INDEX;
+
+            _nodes[index] = node;
+
+            for (const Json::Value& child : root["Nodes"])
+            {
+                _AddNode(child.asString(), index);
+            }
+        }
+
+        uint32_t _AddMesh(const std::string& filename)
+        {
+            auto [it, isInserted] = _meshIndices.try_emplace(filename, static_cast<uint32_t>(_meshes.size()));
+            if (isInserted)
+            {
+                _meshes.push_back({ _AddString(filename), SceneFormat::INVALID_INDEX });
+            }
+            return it->second;
+        }
+
+        uint32_t _AddMaterial(const std::string& filename)
+        {
+            auto [it, isInserted] = _materialIndices.try_emplace(filename, static_cast<uint32_t>(_materials.size()));
+            if (isInserted)
+            {
+                Json::Value material = _ReadJson(filename);
+                _materials.push_back({ _AddString(material["Diffuse"].asString()), 0 });
+            }
+            return it->second;
+        }
+
+        uint32_t _AddString(const std::string& string)
+        {
+            if (string.empty())
+            {
+                return 0;
+            }
+
+            auto [it, isInserted] = _stringOffsets.try_emplace(string, static_cast<uint32_t>(_strings.size()));
+            if (isInserted)
+            {
+                _strings.insert(_strings.end(), string.begin(), string.end());
+                _strings.push_back('\0');
+            }
+            return it->second;
+        }
+
+        Json::Value _ReadJson(const std::string& filename)
+        {
+            std::ifstream in(_directory / filename, std::ios_base::in | std::ios_base::binary);
+            if (!in.is_open())
+            {
+                std::cout << "Failed to open " << (_directory / filename).string() << std::endl;
+                _isValid = false;
+                return {};
+            }
+
+            Json::Value root;
+            in >> root;
+
+            return root;
+        }
+
+        static void _Write(std::string& data, uint64_t offset, const void* source, size_t size)
+        {
+            if (size > 0)
+            {
+                std::memcpy(data.data() + offset, source, size);
+            }
+        }
+
+        std::filesystem::path _directory;
+
+        std::vector<SceneFormat::Node> _nodes;
+        std::vector<SceneFormat::LOD> _lods;
+        std::vector<SceneFormat::MeshReference> _meshes;
+        std::vector<SceneFormat::Material> _materials;
+        std::vector<char> _strings;
+        uint32_t _nameOffset = 0;
+        VisibilityBaker::VisibilitySets _visibility;
+
+        std::unordered_map<std::string, uint32_t> _meshIndices;
+        std::unordered_map<std::string, uint32_t> _materialIndices;
+        std::unordered_map<std::string, uint32_t> _stringOffsets;
+        bool _isValid = true;
+    };
+}
+
+namespace SceneCompiler
+{
+    bool Compile(const std::string& scenePath, std::string& outData, const CookSettings& settings)
+    {
+        std::filesystem::path path(scenePath);
+
+        SceneBuilder builder(path.parent_path());
+        builder.AddScene(path.filename().string());
+        if (builder.IsValid() && settings.bakeVisibility)
+        {
+            builder.BakeVisibility(settings.visibilityCellSize, settings.visibilitySampleCount);
+
+            const VisibilityBaker::VisibilitySets& visibility = builder.GetVisibility();
+            uint64_t visibleCount = 0;
+            for (const SceneFormat::VisibilityCell& cell : visibility.cells)
+            {
+                visibleCount += cell.visibleCount;
+            }
+            std::cout << "Baked the potentially visible sets of " << visibility.cells.size() << " cells of " << scenePath << ": "
+                << (visibility.cells.empty() ? 0 : visibleCount / visibility.cells.size()) << " nodes visible per cell, "
+                << visibility.pvs.size() << " bytes" << std::endl;
+        }
+        if (!builder.IsValid())
+        {
+            return false;
+        }
+
+        outData = builder.Serialize();
+
+        return true;
+    }
+
+    bool Save(const std::string& scenePath, const std::string& outputPath, const CookSettings& settings)
+    {
+        std::string data;
+        if (!Compile(scenePath, data, settings))
+        {
+            return false;
+        }
+
+        std::ofstream out(outputPath, std::fstream::out | std::ios_base::binary);
+        if (!out.is_open())
+        {
+            return false;
+        }
+        out.write(data.data(), data.size());
+
+        std::cout << "Compiled " << scenePath << " into " << outputPath << ": " << data.size() << " bytes" << std::endl;
+
+        return out.good();
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "CookSettings.h"
+
+#include <string>
+
+namespace SceneCompiler
+{
+    // Compiles a cooked .scene file and the node and material files it references into the flat
+    // binary hierarchy (see DX12Lib/Scene/SceneFormat.h). The mesh references keep the file names.
+    // The potentially visible sets are baked from the LOD0 meshes if the settings ask for them
+    bool Compile(const std::string& scenePath, std::string& outData, const CookSettings& settings = {});
+
+    // Writes the compiled scene as a .scenebin file
+    bool Save(const std::string& scenePath, const std::string& outputPath, const CookSettings& settings = {});
+}
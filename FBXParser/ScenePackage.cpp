@@ -0,0 +1,300 @@
+#include "pch.h"
+
+#include "ScenePackage.h"
+#include "SceneCompiler.h"
+
+#include "../DX12Lib/Scene/SceneFormat.h"
+#include "../DX12Lib/Scene/ScenePackFormat.h"
+#include "../DX12Lib/Utility/LZ.h"
+
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+    struct PackageEntry
+    {
+        ScenePackFormat::EntryType type;
+        std::string name;
+        std::string data;
+        uint64_t hash;
+    };
+
+    class PackageBuilder
+    {
+    public:
+        explicit PackageBuilder(const std::filesystem::path& directory)
+            : _directory(directory)
+        {
+            // Entry 0 is the scene, it is filled in last
+            _entries.emplace_back();
+        }
+
+        uint32_t AddNode(const std::string& filename)
+        {
+            auto it = _indices.find(filename);
+            if (it != _indices.end())
+            {
+                return it->second;
+            }
+
+            Json::Value root = _ReadJson(filename);
+            _ResolveNode(root);
+
+            return _AddEntry(ScenePackFormat::EntryType::Node, filename, _WriteJson(root));
+        }
+
+        void SetScene(const std::string& filename)
+        {
+            Json::Value root = _ReadJson(filename);
+            _ResolveNodes(root["Nodes"]);
+
+            std::string data = _WriteJson(root);
+            _entries[0] = { ScenePackFormat::EntryType::Scene, filename, data, ScenePackFormat::ComputeHash(data.data(), data.size()) };
+        }
+
+        // The compiled hierarchy references the meshes by file name, the packed copy gets the TOC indices
+        void AddCompiledScene(const std::string& filename, std::string data)
+        {
+            SceneFormat::Header header;
+            std::memcpy(&header, data.data(), sizeof(header));
+
+            for (uint32_t i = 0; i < header.meshCount; ++i)
+            {
+                char* mesh = data.data() + header.meshesOffset + i * sizeof(SceneFormat::MeshReference);
+
+                SceneFormat::MeshReference reference;
+                std::memcpy(&reference, mesh, sizeof(reference));
+                reference.packageEntry = _AddFile(ScenePackFormat::EntryType::Mesh, data.c_str() + header.stringsOffset + reference.nameOffset);
+                std::memcpy(mesh, &reference, sizeof(reference));
+            }
+
+            _AddEntry(ScenePackFormat::EntryType::CompiledScene, filename, std::move(data));
+        }
+
+        const std::vector<PackageEntry>& GetEntries() const
+        {
+            return _entries;
+        }
+
+        bool IsValid() const
+        {
+            return _isValid;
+        }
+
+    private:
+        uint32_t _AddFile(ScenePackFormat::EntryType type, const std::string& filename)
+        {
+            auto it = _indices.find(filename);
+            if (it != _indices.end())
+            {
+                return it->second;
+            }
+
+            std::ifstream in(_directory / filename, std::ios_base::in | std::ios_base::binary);
+            if (!in.is_open())
+            {
+                std::cout << "Failed to open " << (_directory / filename).string() << std::endl;
+                _isValid = false;
+            }
+            std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+            return _AddEntry(type, filename, std::move(data));
+        }
+
+        uint32_t _AddEntry(ScenePackFormat::EntryType type, const std::string& filename, std::string data)
+        {
+            uint64_t hash = ScenePackFormat::ComputeHash(data.data(), data.size());
+
+            // Identical files, e.g. the materials of the copies of an object, are stored once
+            auto [begin, end] = _contents.equal_range(hash);
+            for (auto it = begin; it != end; ++it)
+            {
+                const PackageEntry& entry = _entries[it->second];
+                if (entry.type == type && entry.data == data)
+                {
+                    _indices[filename] = it->second;
+                    return it->second;
+                }
+            }
+
+            uint32_t index = static_cast<uint32_t>(_entries.size());
+            _entries.push_back({ type, filename, std::move(data), hash });
+            _contents.emplace(hash, index);
+            _indices[filename] = index;
+
+            return index;
+        }
+
+        void _ResolveNodes(Json::Value& nodes)
+        {
+            for (Json::Value& node : nodes)
+            {
+                node = AddNode(node.asString());
+            }
+        }
+
+        void _ResolveNode(Json::Value& root)
+        {
+            if (root.isMember("LODs"))
+            {
+                for (Json::Value& lod : root["LODs"])
+                {
+                    lod = _AddFile(ScenePackFormat::EntryType::Mesh, lod.asString());
+                }
+            }
+
+            if (root.isMember("Material"))
+            {
+                root["Material"] = _AddFile(ScenePackFormat::EntryType::Material, root["Material"].asString());
+            }
+
+            if (root.isMember("Nodes"))
+            {
+                _ResolveNodes(root["Nodes"]);
+            }
+        }
+
+        Json::Value _ReadJson(const std::string& filename)
+        {
+            std::ifstream in(_directory / filename, std::ios_base::in | std::ios_base::binary);
+            if (!in.is_open())
+            {
+                std::cout << "Failed to open " << (_directory / filename).string() << std::endl;
+                _isValid = false;
+                return {};
+            }
+
+            Json::Value root;
+            in >> root;
+
+            return root;
+        }
+
+        static std::string _WriteJson(const Json::Value& root)
+        {
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "";
+
+            return Json::writeString(builder, root);
+        }
+
+        std::filesystem::path _directory;
+        std::vector<PackageEntry> _entries;
+        std::unordered_map<std::string, uint32_t> _indices;
+        std::unordered_multimap<uint64_t, uint32_t> _contents;
+        bool _isValid = true;
+    };
+
+    void WritePadding(std::ostream& out, uint64_t offset)
+    {
+        static const char zeros[ScenePackFormat::DATA_ALIGNMENT] = {};
+
+        uint64_t current = static_cast<uint64_t>(out.tellp());
+        if (offset > current)
+        {
+            out.write(zeros, offset - current);
+        }
+    }
+}
+
+namespace ScenePackage
+{
+    bool Write(const std::string& scenePath, const std::string& packagePath, const CookSettings& settings)
+    {
+        std::filesystem::path path(scenePath);
+
+        PackageBuilder builder(path.parent_path());
+        builder.SetScene(path.filename().string());
+
+        std::string compiledScene;
+        if (!SceneCompiler::Compile(scenePath, compiledScene, settings))
+        {
+            return false;
+        }
+        builder.AddCompiledScene(path.stem().string() + ".scenebin", std::move(compiledScene));
+
+        if (!builder.IsValid())
+        {
+            return false;
+        }
+
+        const std::vector<PackageEntry>& entries = builder.GetEntries();
+
+        // Compressed entries are kept only if they get smaller
+        std::vector<std::vector<uint8_t>> compressed(entries.size());
+        if (settings.compressPackage)
+        {
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                compressed[i] = LZ::Compress(reinterpret_cast<const uint8_t*>(entries[i].data.data()), entries[i].data.size());
+                if (compressed[i].size() >= entries[i].data.size())
+                {
+                    compressed[i].clear();
+                }
+            }
+        }
+
+        std::string names;
+        std::vector<ScenePackFormat::Entry> toc(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            toc[i].type = entries[i].type;
+            toc[i].hash = entries[i].hash;
+            toc[i].uncompressedSize = entries[i].data.size();
+            toc[i].compression = compressed[i].empty() ? ScenePackFormat::Compression::None : ScenePackFormat::Compression::LZ;
+            toc[i].size = compressed[i].empty() ? entries[i].data.size() : compressed[i].size();
+            toc[i].nameOffset = static_cast<uint32_t>(names.size());
+
+            names += entries[i].name;
+            names.push_back('\0');
+        }
+
+        ScenePackFormat::Header header = {};
+        header.magic = ScenePackFormat::MAGIC;
+        header.version = ScenePackFormat::VERSION;
+        header.headerSize = sizeof(ScenePackFormat::Header);
+        header.entryCount = static_cast<uint32_t>(toc.size());
+        header.namesSize = static_cast<uint32_t>(names.size());
+        header.tocOffset = header.headerSize;
+        header.namesOffset = header.tocOffset + toc.size() * sizeof(ScenePackFormat::Entry);
+
+        uint64_t offset = header.namesOffset + names.size();
+        for (ScenePackFormat::Entry& entry : toc)
+        {
+            entry.offset = ScenePackFormat::AlignOffset(offset);
+            offset = entry.offset + entry.size;
+        }
+
+        std::ofstream out(packagePath, std::fstream::out | std::ios_base::binary);
+        if (!out.is_open())
+        {
+            return false;
+        }
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(toc.data()), toc.size() * sizeof(ScenePackFormat::Entry));
+        out.write(names.data(), names.size());
+
+        uint64_t uncompressedSize = 0;
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            WritePadding(out, toc[i].offset);
+            if (compressed[i].empty())
+            {
+                out.write(entries[i].data.data(), entries[i].data.size());
+            }
+            else
+            {
+                out.write(reinterpret_cast<const char*>(compressed[i].data()), compressed[i].size());
+            }
+            uncompressedSize += entries[i].data.size();
+        }
+
+        std::cout << "Packed " << scenePath << " into " << packagePath << ": " << entries.size() << " entries, "
+            << uncompressedSize << " -> " << offset << " bytes" << std::endl;
+
+        return out.good();
+    }
+}
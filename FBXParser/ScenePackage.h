@@ -0,0 +1,15 @@
+#pragma once
+
+#include "CookSettings.h"
+
+#include <string>
+
+namespace ScenePackage
+{
+    // Packs a cooked scene, the .scene file and the node, material and mesh files it references,
+    // into one .scenepak file (see DX12Lib/Scene/ScenePackFormat.h).
+    // With compressPackage the entries that get smaller are LZ compressed, otherwise the meshes stay
+    // uncompressed so the runtime reads them straight from the mapping. The compiled scene entry
+    // is compiled with the settings
+    bool Write(const std::string& scenePath, const std::string& packagePath, const CookSettings& settings);
+}
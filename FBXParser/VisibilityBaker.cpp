@@ -0,0 +1,466 @@
+#include "pch.h"
+
+#include "VisibilityBaker.h"
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <execution>
+#include <map>
+#include <numeric>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t MAX_LEAF_TRIANGLES = 4;
+    // Bounds the traversal stack, the triangles are split at the median on every level
+    constexpr uint32_t MAX_DEPTH = 48;
+    // The corner samples of the node bounds are pulled that much of the extent towards the center
+    constexpr float CORNER_INSET = 0.01f;
+    // Hits closer to the ends of a segment than this fraction of its length don't block it
+    constexpr float SEGMENT_EPSILON = 1e-4f;
+    constexpr uint32_t MAX_RUN_LENGTH = 255;
+
+    float GetAxis(const XMFLOAT3& v, int axis)
+    {
+        return (&v.x)[axis];
+    }
+
+    XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+    }
+
+    XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    XMFLOAT3 Lerp(const XMFLOAT3& a, const XMFLOAT3& b, float tx, float ty, float tz)
+    {
+        return XMFLOAT3(a.x + (b.x - a.x) * tx, a.y + (b.y - a.y) * ty, a.z + (b.z - a.z) * tz);
+    }
+
+    bool HasGeometry(const VisibilityBaker::NodeGeometry& node)
+    {
+        return node.triangles.size() >= 3;
+    }
+
+    bool Overlaps(const XMFLOAT3& minA, const XMFLOAT3& maxA, const XMFLOAT3& minB, const XMFLOAT3& maxB)
+    {
+        return minA.x <= maxB.x && maxA.x >= minB.x
+            && minA.y <= maxB.y && maxA.y >= minB.y
+            && minA.z <= maxB.z && maxA.z >= minB.z;
+    }
+
+    // Fraction of the segment from origin to origin + direction at which it enters the box, 0 if it starts in it.
+    // The segment ends inside the box
+    float GetEntry(const XMFLOAT3& aabbMin, const XMFLOAT3& aabbMax, const XMFLOAT3& origin, const XMFLOAT3& direction)
+    {
+        float entry = 0.0f;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float d = GetAxis(direction, axis);
+            if (d != 0.0f)
+            {
+                const float t0 = (GetAxis(aabbMin, axis) - GetAxis(origin, axis)) / d;
+                const float t1 = (GetAxis(aabbMax, axis) - GetAxis(origin, axis)) / d;
+                entry = std::max(entry, std::min(t0, t1));
+            }
+        }
+
+        return entry;
+    }
+
+    struct Triangle
+    {
+        XMFLOAT3 v0;
+        XMFLOAT3 edge1;
+        XMFLOAT3 edge2;
+        uint32_t node;
+    };
+
+    // Möller-Trumbore, for the hits inside the segment
+    bool IsCrossed(const Triangle& triangle, const XMFLOAT3& origin, const XMFLOAT3& direction)
+    {
+        const XMFLOAT3 p = Cross(direction, triangle.edge2);
+        const float determinant = Dot(triangle.edge1, p);
+        if (determinant == 0.0f)
+        {
+            return false;
+        }
+        const float inverse = 1.0f / determinant;
+
+        const XMFLOAT3 s = Subtract(origin, triangle.v0);
+        const float u = Dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+        {
+            return false;
+        }
+
+        const XMFLOAT3 q = Cross(s, triangle.edge1);
+        const float v = Dot(direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+        {
+            return false;
+        }
+
+        const float t = Dot(triangle.edge2, q) * inverse;
+        return t > SEGMENT_EPSILON && t < 1.0f - SEGMENT_EPSILON;
+    }
+
+    // The triangles of all the nodes for the segment queries, split at the median of the longest
+    // axis into a flat array in which the children of a node are a pair placed after it
+    class TriangleTree
+    {
+    public:
+        explicit TriangleTree(const std::vector<VisibilityBaker::NodeGeometry>& nodes)
+        {
+            std::vector<Triangle> triangles;
+            std::vector<XMFLOAT3> centroids;
+            for (uint32_t i = 0; i < nodes.size(); ++i)
+            {
+                const std::vector<XMFLOAT3>& vertices = nodes[i].triangles;
+                for (size_t j = 0; j + 2 < vertices.size(); j += 3)
+                {
+                    triangles.push_back({ vertices[j], Subtract(vertices[j + 1], vertices[j]), Subtract(vertices[j + 2], vertices[j]), i });
+                    centroids.emplace_back((vertices[j].x + vertices[j + 1].x + vertices[j + 2].x) / 3.0f,
+                        (vertices[j].y + vertices[j + 1].y + vertices[j + 2].y) / 3.0f,
+                        (vertices[j].z + vertices[j + 1].z + vertices[j + 2].z) / 3.0f);
+                }
+            }
+
+            if (triangles.empty())
+            {
+                return;
+            }
+
+            std::vector<uint32_t> order(triangles.size());
+            std::iota(order.begin(), order.end(), 0);
+
+            struct BuildTask
+            {
+                uint32_t node;
+                uint32_t first;
+                uint32_t count;
+                uint32_t depth;
+            };
+
+            _nodes.emplace_back();
+            std::vector<BuildTask> tasks;
+            tasks.push_back({ 0, 0, static_cast<uint32_t>(triangles.size()), 0 });
+
+            while (!tasks.empty())
+            {
+                BuildTask task = tasks.back();
+                tasks.pop_back();
+
+                XMFLOAT3 aabbMin(FLT_MAX, FLT_MAX, FLT_MAX);
+                XMFLOAT3 aabbMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+                XMFLOAT3 centroidMin(FLT_MAX, FLT_MAX, FLT_MAX);
+                XMFLOAT3 centroidMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+                for (uint32_t i = task.first; i < task.first + task.count; ++i)
+                {
+                    const Triangle& triangle = triangles[order[i]];
+                    const XMFLOAT3 vertices[] = { triangle.v0,
+                        XMFLOAT3(triangle.v0.x + triangle.edge1.x, triangle.v0.y + triangle.edge1.y, triangle.v0.z + triangle.edge1.z),
+                        XMFLOAT3(triangle.v0.x + triangle.edge2.x, triangle.v0.y + triangle.edge2.y, triangle.v0.z + triangle.edge2.z) };
+                    for (const XMFLOAT3& vertex : vertices)
+                    {
+                        XMStoreFloat3(&aabbMin, XMVectorMin(XMLoadFloat3(&aabbMin), XMLoadFloat3(&vertex)));
+                        XMStoreFloat3(&aabbMax, XMVectorMax(XMLoadFloat3(&aabbMax), XMLoadFloat3(&vertex)));
+                    }
+                    XMStoreFloat3(&centroidMin, XMVectorMin(XMLoadFloat3(&centroidMin), XMLoadFloat3(&centroids[order[i]])));
+                    XMStoreFloat3(&centroidMax, XMVectorMax(XMLoadFloat3(&centroidMax), XMLoadFloat3(&centroids[order[i]])));
+                }
+
+                Node& node = _nodes[task.node];
+                node.aabbMin = aabbMin;
+                node.aabbMax = aabbMax;
+
+                if (task.count <= MAX_LEAF_TRIANGLES || task.depth >= MAX_DEPTH)
+                {
+                    node.offset = task.first;
+                    node.count = task.count;
+                    continue;
+                }
+
+                const XMFLOAT3 extent = Subtract(centroidMax, centroidMin);
+                const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+                const uint32_t leftCount = task.count / 2;
+                std::nth_element(order.begin() + task.first, order.begin() + task.first + leftCount, order.begin() + task.first + task.count,
+                    [&centroids, axis](uint32_t a, uint32_t b) { return GetAxis(centroids[a], axis) < GetAxis(centroids[b], axis); });
+
+                const uint32_t child = static_cast<uint32_t>(_nodes.size());
+                node.offset = child;
+                node.count = 0;
+
+                _nodes.emplace_back();
+                _nodes.emplace_back();
+
+                tasks.push_back({ child, task.first, leftCount, task.depth + 1 });
+                tasks.push_back({ child + 1, task.first + leftCount, task.count - leftCount, task.depth + 1 });
+            }
+
+            _triangles.reserve(triangles.size());
+            for (uint32_t i : order)
+            {
+                _triangles.push_back(triangles[i]);
+            }
+        }
+
+        // True if a triangle of another node than skippedNode crosses the segment from origin to origin + direction
+        bool IsBlocked(const XMFLOAT3& origin, const XMFLOAT3& direction, uint32_t skippedNode) const
+        {
+            if (_nodes.empty())
+            {
+                return false;
+            }
+
+            const XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+            uint32_t stack[MAX_DEPTH + 2];
+            uint32_t stackSize = 0;
+            stack[stackSize++] = 0;
+
+            while (stackSize > 0)
+            {
+                const Node& node = _nodes[stack[--stackSize]];
+                if (!_IsCrossed(node, origin, inverse))
+                {
+                    continue;
+                }
+
+                if (node.count == 0)
+                {
+                    stack[stackSize++] = node.offset + 1;
+                    stack[stackSize++] = node.offset;
+                    continue;
+                }
+
+                for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+                {
+                    if (_triangles[i].node != skippedNode && IsCrossed(_triangles[i], origin, direction))
+                    {
+                        return true;
+                    }
+                }
+            }
+
+            return false;
+        }
+
+    private:
+        struct Node
+        {
+            XMFLOAT3 aabbMin;
+            uint32_t offset;        // First child for inner nodes, first triangle for leaves
+            XMFLOAT3 aabbMax;
+            uint32_t count;         // Triangles of the leaf, 0 for inner nodes
+        };
+
+        // Slab test of the segment, the axes it is parallel to compare as NaN and are skipped
+        static bool _IsCrossed(const Node& node, const XMFLOAT3& origin, const XMFLOAT3& inverseDirection)
+        {
+            float entry = 0.0f;
+            float exit = 1.0f;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const float t0 = (GetAxis(node.aabbMin, axis) - GetAxis(origin, axis)) * GetAxis(inverseDirection, axis);
+                const float t1 = (GetAxis(node.aabbMax, axis) - GetAxis(origin, axis)) * GetAxis(inverseDirection, axis);
+                entry = std::max(entry, std::min(t0, t1));
+                exit = std::min(exit, std::max(t0, t1));
+            }
+
+            return entry <= exit;
+        }
+
+        std::vector<Node> _nodes;
+        // Leaf order
+        std::vector<Triangle> _triangles;
+    };
+
+    // Sets the bits of the nodes seen from the cell
+    void BakeCell(const TriangleTree& tree, const std::vector<VisibilityBaker::NodeGeometry>& nodes,
+        const XMFLOAT3& cellMin, const XMFLOAT3& cellMax, uint32_t sampleCount, uint32_t seed, std::vector<uint8_t>& bits)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        std::vector<XMFLOAT3> cellSamples;
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            cellSamples.push_back(Lerp(cellMin, cellMax, static_cast<float>(corner & 1), static_cast<float>((corner >> 1) & 1), static_cast<float>(corner >> 2)));
+        }
+        for (uint32_t i = 0; i < sampleCount; ++i)
+        {
+            cellSamples.push_back(Lerp(cellMin, cellMax, unit(random), unit(random), unit(random)));
+        }
+
+        std::vector<XMFLOAT3> nodeSamples;
+        for (uint32_t node = 0; node < nodes.size(); ++node)
+        {
+            const VisibilityBaker::NodeGeometry& geometry = nodes[node];
+            if (!HasGeometry(geometry))
+            {
+                continue;
+            }
+
+            // The camera may be anywhere in the cell, inside the node bounds too
+            if (Overlaps(cellMin, cellMax, geometry.aabbMin, geometry.aabbMax))
+            {
+                bits[node / 8] |= 1 << (node % 8);
+                continue;
+            }
+
+            nodeSamples.clear();
+            nodeSamples.push_back(Lerp(geometry.aabbMin, geometry.aabbMax, 0.5f, 0.5f, 0.5f));
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                const float tx = corner & 1 ? 1.0f - CORNER_INSET : CORNER_INSET;
+                const float ty = (corner >> 1) & 1 ? 1.0f - CORNER_INSET : CORNER_INSET;
+                const float tz = corner >> 2 ? 1.0f - CORNER_INSET : CORNER_INSET;
+                nodeSamples.push_back(Lerp(geometry.aabbMin, geometry.aabbMax, tx, ty, tz));
+            }
+            for (uint32_t i = 0; i < sampleCount; ++i)
+            {
+                nodeSamples.push_back(Lerp(geometry.aabbMin, geometry.aabbMax, unit(random), unit(random), unit(random)));
+            }
+
+            bool isVisible = false;
+            for (size_t i = 0; i < cellSamples.size() && !isVisible; ++i)
+            {
+                for (size_t j = 0; j < nodeSamples.size() && !isVisible; ++j)
+                {
+                    // Up to where the segment enters the node bounds, its own triangles or the ones of the
+                    // nodes inside the bounds can't hide it
+                    const XMFLOAT3 direction = Subtract(nodeSamples[j], cellSamples[i]);
+                    const float entry = GetEntry(geometry.aabbMin, geometry.aabbMax, cellSamples[i], direction);
+                    const XMFLOAT3 segment(direction.x * entry, direction.y * entry, direction.z * entry);
+
+                    isVisible = entry <= 0.0f || !tree.IsBlocked(cellSamples[i], segment, node);
+                }
+            }
+
+            if (isVisible)
+            {
+                bits[node / 8] |= 1 << (node % 8);
+            }
+        }
+    }
+}
+
+namespace VisibilityBaker
+{
+    VisibilitySets Bake(const std::vector<NodeGeometry>& nodes, float cellSize, uint32_t sampleCount)
+    {
+        VisibilitySets sets;
+
+        XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+        XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+        for (const NodeGeometry& node : nodes)
+        {
+            if (HasGeometry(node))
+            {
+                boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&node.aabbMin));
+                boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&node.aabbMax));
+            }
+        }
+
+        XMFLOAT3 extent;
+        XMStoreFloat3(&extent, XMVectorSubtract(boundsMax, boundsMin));
+        const float longest = std::max({ extent.x, extent.y, extent.z });
+        const float size = cellSize > 0.0f ? cellSize : longest / DEFAULT_CELL_COUNT;
+        if (!(longest >= 0.0f) || !(size > 0.0f))
+        {
+            return sets;
+        }
+
+        // Cubic cells, the grid centered on the bounds
+        XMFLOAT3 center;
+        XMStoreFloat3(&center, XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f));
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            sets.cellCounts[axis] = std::max(1u, static_cast<uint32_t>(std::ceil(GetAxis(extent, axis) / size)));
+            sets.cellSize[axis] = size;
+            sets.cellOrigin[axis] = GetAxis(center, axis) - 0.5f * size * sets.cellCounts[axis];
+        }
+
+        const uint32_t cellCount = sets.cellCounts[0] * sets.cellCounts[1] * sets.cellCounts[2];
+        std::vector<std::vector<uint8_t>> cellBits(cellCount, std::vector<uint8_t>((nodes.size() + 7) / 8, 0));
+
+        TriangleTree tree(nodes);
+
+        std::vector<uint32_t> cells(cellCount);
+        std::iota(cells.begin(), cells.end(), 0);
+        std::for_each(std::execution::par, cells.begin(), cells.end(), [&](uint32_t cell)
+        {
+            const uint32_t x = cell % sets.cellCounts[0];
+            const uint32_t y = cell / sets.cellCounts[0] % sets.cellCounts[1];
+            const uint32_t z = cell / (sets.cellCounts[0] * sets.cellCounts[1]);
+            const XMFLOAT3 cellMin(sets.cellOrigin[0] + x * size, sets.cellOrigin[1] + y * size, sets.cellOrigin[2] + z * size);
+            const XMFLOAT3 cellMax(cellMin.x + size, cellMin.y + size, cellMin.z + size);
+
+            BakeCell(tree, nodes, cellMin, cellMax, sampleCount, cell, cellBits[cell]);
+        });
+
+        // The cells seeing the same nodes share their set
+        std::map<std::vector<uint8_t>, uint32_t> offsets;
+        std::vector<uint8_t> encoded;
+        sets.cells.resize(cellCount);
+        for (uint32_t cell = 0; cell < cellCount; ++cell)
+        {
+            Encode(cellBits[cell], encoded);
+
+            auto [it, isInserted] = offsets.try_emplace(encoded, static_cast<uint32_t>(sets.pvs.size()));
+            if (isInserted)
+            {
+                sets.pvs.insert(sets.pvs.end(), encoded.begin(), encoded.end());
+            }
+
+            uint32_t visibleCount = 0;
+            for (uint8_t byte : cellBits[cell])
+            {
+                visibleCount += std::popcount(byte);
+            }
+            sets.cells[cell] = { it->second, visibleCount };
+        }
+
+        return sets;
+    }
+
+    void Encode(const std::vector<uint8_t>& bits, std::vector<uint8_t>& outData)
+    {
+        outData.clear();
+
+        size_t i = 0;
+        while (i < bits.size())
+        {
+            size_t zeroCount = 0;
+            while (i + zeroCount < bits.size() && bits[i + zeroCount] == 0 && zeroCount < MAX_RUN_LENGTH)
+            {
+                ++zeroCount;
+            }
+            i += zeroCount;
+
+            size_t literalCount = 0;
+            while (i + literalCount < bits.size() && bits[i + literalCount] != 0 && literalCount < MAX_RUN_LENGTH)
+            {
+                ++literalCount;
+            }
+
+            outData.push_back(static_cast<uint8_t>(zeroCount));
+            outData.push_back(static_cast<uint8_t>(literalCount));
+            outData.insert(outData.end(), bits.begin() + i, bits.begin() + i + literalCount);
+            i += literalCount;
+        }
+    }
+}
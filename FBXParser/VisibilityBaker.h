@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../DX12Lib/Scene/SceneFormat.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+namespace VisibilityBaker
+{
+    // A node of the compiled scene in world space, as the baker sees it
+    struct NodeGeometry
+    {
+        DirectX::XMFLOAT3 aabbMin;
+        DirectX::XMFLOAT3 aabbMax;
+        // Three vertices per triangle of LOD0, empty for the nodes without meshes
+        std::vector<DirectX::XMFLOAT3> triangles;
+    };
+
+    // The grid of the compiled scene header, the cells and their encoded sets (see SceneFormat.h)
+    struct VisibilitySets
+    {
+        float cellOrigin[3] = {};
+        float cellSize[3] = {};
+        uint32_t cellCounts[3] = {};
+        std::vector<SceneFormat::VisibilityCell> cells;
+        std::vector<uint8_t> pvs;
+    };
+
+    // Splits the bounds of the nodes with meshes into cells of about cellSize, or of a grid of
+    // DEFAULT_CELL_COUNT cells along the longest side if it is 0. A node is potentially visible from
+    // a cell if a segment from one of its samples to one of the samples of the node bounds enters
+    // them before any triangle of the other nodes. The cells are sampled at their corners and at
+    // sampleCount random points, the node bounds at their center, corners and sampleCount random
+    // points. The cells are baked on worker threads, with the same samples on every run
+    constexpr uint32_t DEFAULT_CELL_COUNT = 8;
+    VisibilitySets Bake(const std::vector<NodeGeometry>& nodes, float cellSize, uint32_t sampleCount);
+
+    // Run length encodes the bitset as the cells reference it
+    void Encode(const std::vector<uint8_t>& bits, std::vector<uint8_t>& outData);
+}
@@ -0,0 +1,100 @@
+#include "stdafx.h"
+
+#include "Scene/BVH.h"
+
+#include "RandomScene.h"
+
+#include <gtest/gtest.h>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr float SCENE_SIZE = 1000.0f;
+    constexpr float MAX_ITEM_SIZE = 30.0f;
+    constexpr uint32_t SUBTREE_COUNT = 64;
+    constexpr uint32_t VIEW_COUNT = 8;
+
+    std::vector<uint32_t> Sorted(std::vector<uint32_t> items)
+    {
+        std::sort(items.begin(), items.end());
+        return items;
+    }
+}
+
+// The subtrees of Split culled apart, as the chunks of Scene::CullView, find every item of the tree once
+TEST(BVHTest, SubtreeCullsCoverTheTree)
+{
+    std::mt19937 random(3);
+    for (size_t count : { 0, 1, 7, 100, 5000, 20000 })
+    {
+        const std::vector<BVH::Bounds> bounds = RandomScene::CreateBounds(random, count, SCENE_SIZE, MAX_ITEM_SIZE);
+
+        BVH bvh;
+        bvh.Build(RandomScene::CreateItems(bounds));
+        ASSERT_EQ(bvh.GetItemCount(), count);
+
+        std::vector<uint32_t> subtrees;
+        bvh.Split(SUBTREE_COUNT, subtrees);
+        EXPECT_EQ(subtrees.empty(), count == 0);
+
+        for (uint32_t view = 0; view < VIEW_COUNT; ++view)
+        {
+            const FrustumVolume frustum = RandomScene::CreateRandomFrustum(random, SCENE_SIZE);
+            const std::vector<uint32_t> expected = RandomScene::Cull(frustum, bounds);
+
+            std::vector<uint32_t> items;
+            bvh.Cull(frustum, items);
+            ASSERT_EQ(Sorted(items), expected) << count;
+
+            const FrustumCuller culler(frustum);
+            items.clear();
+            for (uint32_t subtree : subtrees)
+                bvh.Cull(culler, subtree, items);
+            ASSERT_EQ(Sorted(items), expected) << count;
+        }
+    }
+}
+
+// One traversal for several views finds every item once, with the views a traversal per view finds it in
+TEST(BVHTest, MultiViewCullMatchesSingleViews)
+{
+    std::mt19937 random(4);
+    const std::vector<BVH::Bounds> bounds = RandomScene::CreateBounds(random, 20000, SCENE_SIZE, MAX_ITEM_SIZE);
+
+    BVH bvh;
+    bvh.Build(RandomScene::CreateItems(bounds));
+
+    for (uint32_t viewCount = 1; viewCount <= MultiFrustumCuller::MAX_VIEW_COUNT; ++viewCount)
+    {
+        std::vector<FrustumVolume> frusta;
+        std::vector<const FrustumVolume*> views;
+        for (uint32_t view = 0; view < viewCount; ++view)
+            frusta.push_back(RandomScene::CreateRandomFrustum(random, SCENE_SIZE));
+        for (const FrustumVolume& frustum : frusta)
+            views.push_back(&frustum);
+
+        std::vector<uint32_t> expected(bounds.size(), 0);
+        for (uint32_t view = 0; view < viewCount; ++view)
+        {
+            std::vector<uint32_t> items;
+            bvh.Cull(FrustumCuller(frusta[view]), 0, items);
+            for (uint32_t item : items)
+                expected[item] |= 1u << view;
+        }
+
+        const MultiFrustumCuller culler(views);
+        std::vector<uint32_t> items;
+        std::vector<uint32_t> viewMasks;
+        bvh.Cull(culler, 0, items, viewMasks);
+        ASSERT_EQ(items.size(), viewMasks.size());
+
+        std::vector<uint32_t> masks(bounds.size(), 0);
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            ASSERT_EQ(masks[items[i]], 0u) << "Item " << items[i] << " found twice";
+            masks[items[i]] = viewMasks[i];
+        }
+        ASSERT_EQ(masks, expected) << viewCount;
+    }
+}
@@ -0,0 +1,173 @@
+#include "stdafx.h"
+
+#include "Scene/BVH.h"
+
+#include "RandomScene.h"
+
+#include <benchmark/benchmark.h>
+
+#include <execution>
+#include <numeric>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr float SCENE_SIZE = 1000.0f;
+    constexpr float MAX_ITEM_SIZE = 30.0f;
+    // As Scene::CullView splits the large scenes
+    constexpr uint32_t CULL_SUBTREE_COUNT = 64;
+
+    struct BoxScene
+    {
+        explicit BoxScene(size_t count)
+        {
+            std::mt19937 random(5);
+            bounds = RandomScene::CreateBounds(random, count, SCENE_SIZE, MAX_ITEM_SIZE);
+            bvh.Build(RandomScene::CreateItems(bounds));
+        }
+
+        std::vector<BVH::Bounds> bounds;
+        BVH bvh;
+    };
+
+    // A camera at the middle of a side of the scene looking across it
+    FrustumVolume GetMainView()
+    {
+        return RandomScene::CreateFrustum(XMVectorSet(500.0f, 500.0f, 0.0f, 1.0f), XMVectorSet(500.0f, 500.0f, 1000.0f, 1.0f), XMConvertToRadians(60.0f), SCENE_SIZE);
+    }
+    // Nested frusta of one camera reaching ever farther, as shadow cascades, or cameras side by side
+    // seeing mostly the same nodes, as split screen
+    std::vector<FrustumVolume> GetViews(uint32_t count, bool isCascades)
+    {
+        std::vector<FrustumVolume> frusta;
+        for (uint32_t view = 0; view < count; ++view)
+        {
+            const float farZ = isCascades ? SCENE_SIZE * (view + 1) / count : SCENE_SIZE;
+            const float offset = isCascades ? 0.0f : 15.0f * view;
+            const XMVECTOR eye = XMVectorSet(500.0f + offset, 500.0f, 0.0f, 1.0f);
+            const XMVECTOR target = XMVectorSet(500.0f + offset, 500.0f, 1000.0f, 1.0f);
+            frusta.push_back(RandomScene::CreateFrustum(eye, target, XMConvertToRadians(60.0f), farZ));
+        }
+        return frusta;
+    }
+}
+
+// A view culled once on the calling thread, as the scenes under 4096 nodes
+static void BM_CullView(benchmark::State& state)
+{
+    const BoxScene scene(state.range(0));
+    const FrustumCuller culler(GetMainView());
+
+    std::vector<uint32_t> items;
+    for (auto _ : state)
+    {
+        items.clear();
+        scene.bvh.Cull(culler, 0, items);
+        benchmark::DoNotOptimize(items.data());
+    }
+
+    state.counters["visible"] = double(items.size());
+}
+BENCHMARK(BM_CullView)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+// A view culled in the subtrees of Split on the worker threads, merged in order
+static void BM_CullViewChunks(benchmark::State& state)
+{
+    const BoxScene scene(state.range(0));
+    const FrustumCuller culler(GetMainView());
+
+    std::vector<uint32_t> subtrees;
+    std::vector<std::vector<uint32_t>> chunkItems;
+    std::vector<uint32_t> chunks;
+    std::vector<uint32_t> items;
+    for (auto _ : state)
+    {
+        scene.bvh.Split(CULL_SUBTREE_COUNT, subtrees);
+        chunkItems.resize(subtrees.size());
+        chunks.resize(subtrees.size());
+        std::iota(chunks.begin(), chunks.end(), 0);
+
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](uint32_t chunk)
+        {
+            chunkItems[chunk].clear();
+            scene.bvh.Cull(culler, subtrees[chunk], chunkItems[chunk]);
+        });
+
+        items.clear();
+        for (const std::vector<uint32_t>& chunk : chunkItems)
+            items.insert(items.end(), chunk.begin(), chunk.end());
+        benchmark::DoNotOptimize(items.data());
+    }
+
+    state.counters["visible"] = double(items.size());
+    state.counters["threads"] = double(std::thread::hardware_concurrency());
+}
+BENCHMARK(BM_CullViewChunks)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+// Before the visible lists: the depth prepass, the occlusion queries and the main pass culled the view apart
+static void BM_CullViewPerPass(benchmark::State& state)
+{
+    const BoxScene scene(state.range(0));
+    const FrustumVolume frustum = GetMainView();
+
+    std::vector<uint32_t> items;
+    for (auto _ : state)
+    {
+        for (uint32_t pass = 0; pass < 3; ++pass)
+        {
+            items.clear();
+            scene.bvh.Cull(frustum, items);
+            benchmark::DoNotOptimize(items.data());
+        }
+    }
+
+    state.counters["visible"] = double(items.size());
+}
+BENCHMARK(BM_CullViewPerPass)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+// Every view in a traversal of its own
+static void BM_CullViewsSeparately(benchmark::State& state)
+{
+    const BoxScene scene(100000);
+    const std::vector<FrustumVolume> frusta = GetViews(static_cast<uint32_t>(state.range(0)), state.range(1) != 0);
+
+    std::vector<uint32_t> items;
+    for (auto _ : state)
+    {
+        for (const FrustumVolume& frustum : frusta)
+        {
+            items.clear();
+            scene.bvh.Cull(FrustumCuller(frustum), 0, items);
+            benchmark::DoNotOptimize(items.data());
+        }
+    }
+}
+BENCHMARK(BM_CullViewsSeparately)->ArgsProduct({ { 1, 4, 8 }, { 1, 0 } })->ArgNames({ "views", "cascades" })->Unit(benchmark::kMicrosecond);
+
+// All the views in a single traversal, as Scene::CullViews
+static void BM_CullViewsTogether(benchmark::State& state)
+{
+    const BoxScene scene(100000);
+    const std::vector<FrustumVolume> frusta = GetViews(static_cast<uint32_t>(state.range(0)), state.range(1) != 0);
+
+    std::vector<const FrustumVolume*> views;
+    for (const FrustumVolume& frustum : frusta)
+        views.push_back(&frustum);
+
+    std::vector<uint32_t> items;
+    std::vector<uint32_t> viewMasks;
+    for (auto _ : state)
+    {
+        items.clear();
+        viewMasks.clear();
+        scene.bvh.Cull(MultiFrustumCuller(views), 0, items, viewMasks);
+        benchmark::DoNotOptimize(items.data());
+    }
+
+    state.counters["visible"] = double(items.size());
+}
+BENCHMARK(BM_CullViewsTogether)->ArgsProduct({ { 1, 4, 8 }, { 1, 0 } })->ArgNames({ "views", "cascades" })->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
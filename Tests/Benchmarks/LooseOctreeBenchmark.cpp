@@ -0,0 +1,144 @@
+#include "stdafx.h"
+
+#include "Scene/LooseOctree.h"
+
+#include "RandomScene.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr size_t OBJECT_COUNT = 10000;
+    constexpr float SCENE_SIZE = 1000.0f;
+    constexpr float MAX_OBJECT_SIZE = 20.0f;
+    constexpr float MAX_SPEED = 3.0f;
+    // The objects turn back every half period, so they stay around the scene however long the run
+    constexpr uint32_t PERIOD = 100;
+
+    // 10k objects moving every frame, as the nodes the scene moves to the octree
+    struct MovingObjects
+    {
+        MovingObjects()
+        {
+            std::mt19937 random(2);
+            std::uniform_real_distribution<float> speed(-MAX_SPEED, MAX_SPEED);
+
+            bounds = RandomScene::CreateBounds(random, OBJECT_COUNT, SCENE_SIZE, MAX_OBJECT_SIZE);
+            velocities.resize(OBJECT_COUNT);
+            for (XMFLOAT3& velocity : velocities)
+                velocity = XMFLOAT3(speed(random), speed(random), speed(random));
+
+            frustum = RandomScene::CreateFrustum(XMVectorSet(500.0f, 500.0f, 0.0f, 1.0f), XMVectorSet(500.0f, 500.0f, 1000.0f, 1.0f), XMConvertToRadians(60.0f), SCENE_SIZE);
+        }
+
+        void Step()
+        {
+            const float direction = frame++ % PERIOD < PERIOD / 2 ? 1.0f : -1.0f;
+            for (size_t i = 0; i < OBJECT_COUNT; ++i)
+            {
+                const XMFLOAT3 velocity(direction * velocities[i].x, direction * velocities[i].y, direction * velocities[i].z);
+                bounds[i].min = XMFLOAT3(bounds[i].min.x + velocity.x, bounds[i].min.y + velocity.y, bounds[i].min.z + velocity.z);
+                bounds[i].max = XMFLOAT3(bounds[i].max.x + velocity.x, bounds[i].max.y + velocity.y, bounds[i].max.z + velocity.z);
+            }
+        }
+
+        void CreateOctree(LooseOctree& octree) const
+        {
+            octree.Create({ XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(SCENE_SIZE, SCENE_SIZE, SCENE_SIZE) }, LooseOctree::MAX_DEPTH, 2.0f);
+            for (uint32_t i = 0; i < OBJECT_COUNT; ++i)
+                octree.Insert(i, bounds[i]);
+        }
+
+        std::vector<BVH::Bounds> bounds;
+        std::vector<XMFLOAT3> velocities;
+        FrustumVolume frustum;
+        uint32_t frame = 0;
+    };
+}
+
+// A frame of moves: every object to its new bounds
+static void BM_OctreeMove(benchmark::State& state)
+{
+    MovingObjects objects;
+    LooseOctree octree;
+    objects.CreateOctree(octree);
+
+    for (auto _ : state)
+    {
+        objects.Step();
+        for (uint32_t i = 0; i < OBJECT_COUNT; ++i)
+            octree.Move(i, objects.bounds[i]);
+    }
+}
+BENCHMARK(BM_OctreeMove)->Unit(benchmark::kMillisecond);
+
+// The BVH kept current by a full build every frame
+static void BM_BVHRebuild(benchmark::State& state)
+{
+    MovingObjects objects;
+    BVH bvh;
+
+    for (auto _ : state)
+    {
+        objects.Step();
+        bvh.Build(RandomScene::CreateItems(objects.bounds));
+    }
+}
+BENCHMARK(BM_BVHRebuild)->Unit(benchmark::kMillisecond);
+
+// The BVH kept current by refits, which loosen it as the objects spread
+static void BM_BVHRefit(benchmark::State& state)
+{
+    MovingObjects objects;
+    BVH bvh;
+    bvh.Build(RandomScene::CreateItems(objects.bounds));
+
+    for (auto _ : state)
+    {
+        objects.Step();
+        for (uint32_t i = 0; i < OBJECT_COUNT; ++i)
+            bvh.SetBounds(i, objects.bounds[i]);
+        bvh.Refit();
+    }
+}
+BENCHMARK(BM_BVHRefit)->Unit(benchmark::kMillisecond);
+
+static void BM_OctreeQuery(benchmark::State& state)
+{
+    MovingObjects objects;
+    LooseOctree octree;
+    objects.CreateOctree(octree);
+
+    std::vector<uint32_t> items;
+    for (auto _ : state)
+    {
+        items.clear();
+        octree.Query(objects.frustum, items);
+        benchmark::DoNotOptimize(items.data());
+    }
+
+    state.counters["visible"] = double(items.size());
+}
+BENCHMARK(BM_OctreeQuery)->Unit(benchmark::kMicrosecond);
+
+static void BM_BVHCull(benchmark::State& state)
+{
+    MovingObjects objects;
+    BVH bvh;
+    bvh.Build(RandomScene::CreateItems(objects.bounds));
+
+    std::vector<uint32_t> items;
+    for (auto _ : state)
+    {
+        items.clear();
+        bvh.Cull(objects.frustum, items);
+        benchmark::DoNotOptimize(items.data());
+    }
+
+    state.counters["visible"] = double(items.size());
+}
+BENCHMARK(BM_BVHCull)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,178 @@
+#include "stdafx.h"
+
+#include "Scene/Mesh.h"
+
+#include "../FBXParser/MeshFile.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <filesystem>
+
+namespace
+{
+    // The largest text mesh of the scenes
+    const std::string TEXT_MESH = MODELS_DIR "FruitBowl/Pear1.001.mesh";
+    const std::string FRUIT_BOWL = MODELS_DIR "FruitBowl";
+
+    std::string GetTempPath(const std::string& filename)
+    {
+        return (std::filesystem::temp_directory_path() / filename).string();
+    }
+
+    // The text mesh cooked to a binary one by the writer of FBXParser, in the given layout
+    bool CookMesh(const std::string& textPath, const std::string& binaryPath, bool isPacked = false, bool hasPositionStream = false)
+    {
+        LOD lod;
+        if (!MeshFile::Load(textPath, lod))
+            return false;
+
+        const MeshFile::VertexPacking packing = { .isPacked = isPacked, .quantization = MeshFile::ComputeQuantization({ lod }), .hasPositionStream = hasPositionStream };
+        return MeshFile::Save(binaryPath, lod, packing);
+    }
+
+    size_t GetFileSize(const std::string& path)
+    {
+        return static_cast<size_t>(std::filesystem::file_size(path));
+    }
+
+    // The buffers of the layout the mesh has, copied out as SceneLoader::_UploadMesh records them,
+    // so the mapped pages are read in the timings too
+    void CopyToUpload(const Mesh& mesh, std::vector<std::byte>& upload)
+    {
+        const bool isPacked = mesh.GetVertexLayout() == MeshFormat::VertexLayout::Packed;
+        const std::span<const std::byte> buffers[] =
+        {
+            isPacked ? std::as_bytes(mesh.GetPackedVertices()) : std::as_bytes(mesh.GetVertices()),
+            std::as_bytes(mesh.GetColors()),
+            std::as_bytes(mesh.GetPositions()),
+            std::span<const std::byte>(static_cast<const std::byte*>(mesh.GetIndexData()), mesh.GetIndexCount() * mesh.GetIndexStride())
+        };
+
+        upload.clear();
+        for (const std::span<const std::byte>& buffer : buffers)
+            upload.insert(upload.end(), buffer.begin(), buffer.end());
+    }
+
+    void LoadMeshes(benchmark::State& state, const std::string& path)
+    {
+        std::vector<std::byte> upload;
+        size_t vertexCount = 0;
+        for (auto _ : state)
+        {
+            Mesh mesh;
+            mesh.LoadMesh(path);
+            CopyToUpload(mesh, upload);
+            vertexCount = mesh.GetVertexCount();
+            benchmark::DoNotOptimize(upload.data());
+        }
+
+        state.counters["vertices"] = double(vertexCount);
+        state.counters["file bytes"] = double(GetFileSize(path));
+    }
+
+    // The meshes of the FruitBowl scene cooked in a layout, with or without the position stream
+    struct CookedScene
+    {
+        CookedScene(bool isPacked, bool hasPositionStream)
+        {
+            for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(FRUIT_BOWL))
+            {
+                if (entry.path().extension() != ".mesh")
+                    continue;
+
+                const std::string path = GetTempPath("MeshBenchmark" + std::to_string(meshes.size()) + ".mesh");
+                CookMesh(entry.path().string(), path, isPacked, hasPositionStream);
+                meshes.emplace_back().LoadMesh(path);
+                std::filesystem::remove(path);
+            }
+        }
+
+        std::vector<Mesh> meshes;
+    };
+
+    // The vertex fetch of a position-only pass: every index reads the position of its vertex
+    template<typename Position>
+    Position FetchPositions(const Mesh& mesh, const uint8_t* vertices, size_t stride)
+    {
+        Position sum = {};
+        for (size_t i = 0; i < mesh.GetIndexCount(); ++i)
+        {
+            const uint32_t index = mesh.GetIndexStride() == sizeof(uint16_t)
+                ? static_cast<const uint16_t*>(mesh.GetIndexData())[i]
+                : static_cast<const uint32_t*>(mesh.GetIndexData())[i];
+
+            Position position;
+            std::memcpy(&position, vertices + index * stride, sizeof(Position));
+            for (size_t c = 0; c < sizeof(Position) / sizeof(sum.position[0]); ++c)
+                sum.position[c] += position.position[c];
+        }
+        return sum;
+    }
+
+    struct FloatPosition
+    {
+        float position[3];
+    };
+}
+
+// The legacy text mesh parsed with the streams of _LoadTextMesh
+static void BM_LoadTextMesh(benchmark::State& state)
+{
+    LoadMeshes(state, TEXT_MESH);
+}
+BENCHMARK(BM_LoadTextMesh)->Unit(benchmark::kMillisecond);
+
+// The same mesh cooked to the binary format, with the position stream as the cook writes it by default
+static void BM_LoadBinaryMesh(benchmark::State& state)
+{
+    const std::string binaryPath = GetTempPath("MeshBenchmark.mesh");
+    CookMesh(TEXT_MESH, binaryPath, false, true);
+
+    LoadMeshes(state, binaryPath);
+
+    std::filesystem::remove(binaryPath);
+}
+BENCHMARK(BM_LoadBinaryMesh)->Unit(benchmark::kMillisecond);
+
+// A depth pass over the FruitBowl scene, fetching the positions from the full vertices the passes
+// used to bind or from the position stream
+static void BM_FetchPositions(benchmark::State& state)
+{
+    const bool isPacked = state.range(0) != 0;
+    const bool isPositionStream = state.range(1) != 0;
+    const CookedScene scene(isPacked, isPositionStream);
+
+    size_t boundBytes = 0;
+    size_t vertexCount = 0;
+    for (const Mesh& mesh : scene.meshes)
+    {
+        const size_t stride = isPositionStream ? mesh.GetPositionStride() : isPacked ? sizeof(MeshFormat::PackedVertex) : sizeof(VertexData);
+        boundBytes += mesh.GetVertexCount() * stride;
+        vertexCount += mesh.GetVertexCount();
+    }
+
+    for (auto _ : state)
+    {
+        for (const Mesh& mesh : scene.meshes)
+        {
+            if (isPacked)
+            {
+                const uint8_t* vertices = isPositionStream ? mesh.GetPositions().data() : reinterpret_cast<const uint8_t*>(mesh.GetPackedVertices().data());
+                benchmark::DoNotOptimize(FetchPositions<MeshFormat::PackedPosition>(mesh, vertices, isPositionStream ? mesh.GetPositionStride() : sizeof(MeshFormat::PackedVertex)));
+            }
+            else
+            {
+                const uint8_t* vertices = isPositionStream ? mesh.GetPositions().data() : reinterpret_cast<const uint8_t*>(mesh.GetVertices().data());
+                benchmark::DoNotOptimize(FetchPositions<FloatPosition>(mesh, vertices, isPositionStream ? mesh.GetPositionStride() : sizeof(VertexData)));
+            }
+        }
+    }
+
+    // As Scene counts the vertex buffer bytes bound by the draws
+    state.counters["bound bytes"] = double(boundBytes);
+    state.counters["bytes/vertex"] = double(boundBytes) / double(vertexCount);
+}
+BENCHMARK(BM_FetchPositions)->ArgsProduct({ { 0, 1 }, { 0, 1 } })->ArgNames({ "packed", "stream" })->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
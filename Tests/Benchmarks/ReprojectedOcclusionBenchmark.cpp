@@ -0,0 +1,92 @@
+#include "stdafx.h"
+
+#include "Scene/ReprojectedOcclusion.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    // The size the frame depth is downsampled to
+    constexpr uint32_t WIDTH = 256;
+    constexpr uint32_t HEIGHT = 144;
+    constexpr float NEAR_Z = 0.1f;
+    constexpr float FAR_Z = 1000.0f;
+    constexpr size_t TEST_COUNT = 10000;
+
+    XMMATRIX GetViewProjection(float x, float z)
+    {
+        return XMMatrixMultiply(XMMatrixTranslation(-x, 0.0f, -z), XMMatrixPerspectiveFovLH(0.8f, float(WIDTH) / HEIGHT, NEAR_Z, FAR_Z));
+    }
+
+    // A rough wall 50 to 60 units away over the left 60% of the view, the far plane right of it
+    std::vector<float> CreateDepth()
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> distance(50.0f, 60.0f);
+
+        std::vector<float> depth(static_cast<size_t>(WIDTH) * HEIGHT);
+        for (uint32_t y = 0; y < HEIGHT; ++y)
+        {
+            for (uint32_t x = 0; x < WIDTH; ++x)
+                depth[y * WIDTH + x] = 5 * x < 3 * WIDTH ? FAR_Z / (FAR_Z - NEAR_Z) * (1.0f - NEAR_Z / distance(random)) : 1.0f;
+        }
+        return depth;
+    }
+}
+
+// The camera moved a step forward and aside since the depth was rendered
+static void BM_Build(benchmark::State& state)
+{
+    const std::vector<float> depth = CreateDepth();
+    const XMMATRIX previousViewProjection = GetViewProjection(0.0f, 0.0f);
+    const XMMATRIX viewProjection = GetViewProjection(1.0f, 2.0f);
+
+    ReprojectedOcclusion occlusion;
+    for (auto _ : state)
+        occlusion.Build(depth, WIDTH, HEIGHT, previousViewProjection, viewProjection);
+
+    state.counters["holes"] = double(occlusion.GetHoleCount());
+}
+BENCHMARK(BM_Build)->Unit(benchmark::kMillisecond);
+
+static void BM_IsVisible(benchmark::State& state)
+{
+    const std::vector<float> depth = CreateDepth();
+    const XMMATRIX previousViewProjection = GetViewProjection(0.0f, 0.0f);
+    const XMMATRIX viewProjection = GetViewProjection(1.0f, 2.0f);
+
+    ReprojectedOcclusion occlusion;
+    occlusion.Build(depth, WIDTH, HEIGHT, previousViewProjection, viewProjection);
+
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> distance(20.0f, 170.0f);
+    std::uniform_real_distribution<float> halfSize(0.2f, 8.0f);
+
+    std::vector<std::pair<XMFLOAT3, XMFLOAT3>> boxes(TEST_COUNT);
+    for (auto& [aabbMin, aabbMax] : boxes)
+    {
+        const float size = halfSize(random);
+        const XMFLOAT3 center(80.0f * unit(random), 45.0f * unit(random), distance(random));
+        aabbMin = XMFLOAT3(center.x - size, center.y - size, center.z - size);
+        aabbMax = XMFLOAT3(center.x + size, center.y + size, center.z + size);
+    }
+
+    size_t visibleCount = 0;
+    for (auto _ : state)
+    {
+        visibleCount = 0;
+        for (const auto& [aabbMin, aabbMax] : boxes)
+            visibleCount += occlusion.IsVisible(aabbMin, aabbMax);
+        benchmark::DoNotOptimize(visibleCount);
+    }
+
+    state.counters["visible"] = double(visibleCount);
+}
+BENCHMARK(BM_IsVisible)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,171 @@
+#include "stdafx.h"
+
+#include "Scene/SceneNodeData.h"
+#include "Utility/Pool.h"
+
+#include "RandomScene.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr float SCENE_SIZE = 1000.0f;
+    constexpr float MAX_NODE_SIZE = 30.0f;
+    constexpr uint32_t CHILD_COUNT = 10;
+
+    // The layout of the nodes before the pool: a shared_ptr per node, the children by shared_ptr,
+    // the AABB next to the cold data. The D3D12 members are opaque bytes of their size
+    struct TreeNode
+    {
+        virtual ~TreeNode() = default;
+
+        std::string name;
+        void* scene = nullptr;
+        TreeNode* parent = nullptr;
+        std::vector<std::shared_ptr<TreeNode>> childNodes;
+        uint32_t transformIndex = 0;
+
+        void* device = nullptr;
+        std::shared_ptr<void> mesh;
+        std::vector<std::shared_ptr<const void>> LODs;
+        AABBVolume AABB;
+        bool isOccluder = false;
+        std::shared_ptr<void> texture;
+        std::shared_ptr<void> AABBVertexBuffer;
+        std::shared_ptr<void> AABBIndexBuffer;
+        uint8_t AABBVBO[16] = {};
+        uint8_t AABBIBO[16] = {};
+        uint32_t pendingUploads = 0;
+    };
+
+    std::vector<BVH::Bounds> CreateBounds(size_t count)
+    {
+        std::mt19937 random(6);
+        return RandomScene::CreateBounds(random, count, SCENE_SIZE, MAX_NODE_SIZE);
+    }
+
+    FrustumVolume GetView()
+    {
+        return RandomScene::CreateFrustum(XMVectorSet(500.0f, 500.0f, 0.0f, 1.0f), XMVectorSet(500.0f, 500.0f, 1000.0f, 1.0f), XMConvertToRadians(60.0f), SCENE_SIZE);
+    }
+
+    // Every node a child of the node CHILD_COUNT times closer to the root
+    std::shared_ptr<TreeNode> CreateTree(const std::vector<BVH::Bounds>& bounds)
+    {
+        std::vector<TreeNode*> nodes;
+        std::shared_ptr<TreeNode> root = std::make_shared<TreeNode>();
+        nodes.push_back(root.get());
+
+        for (size_t i = 0; i < bounds.size(); ++i)
+        {
+            TreeNode* parent = nodes[i / CHILD_COUNT];
+            std::shared_ptr<TreeNode> node = std::make_shared<TreeNode>();
+            node->name = "Node" + std::to_string(i);
+            node->parent = parent;
+            node->transformIndex = static_cast<uint32_t>(i);
+            node->AABB = AABBVolume(XMLoadFloat3(&bounds[i].min), XMLoadFloat3(&bounds[i].max));
+            nodes.push_back(node.get());
+            parent->childNodes.push_back(std::move(node));
+        }
+        return root;
+    }
+
+    size_t CountVisible(const TreeNode& node, const FrustumVolume& frustum)
+    {
+        size_t count = node.parent && Intersect(frustum, node.AABB) ? 1 : 0;
+        for (const std::shared_ptr<TreeNode>& child : node.childNodes)
+        {
+            // The passes held a copy while drawing the child
+            const std::shared_ptr<TreeNode> copy = child;
+            count += CountVisible(*copy, frustum);
+        }
+        return count;
+    }
+}
+
+// The passes recursing through the shared_ptr tree, every node tested against the frustum
+static void BM_TraverseTree(benchmark::State& state)
+{
+    const std::vector<BVH::Bounds> bounds = CreateBounds(state.range(0));
+    const std::shared_ptr<TreeNode> root = CreateTree(bounds);
+    const FrustumVolume frustum = GetView();
+
+    size_t visibleCount = 0;
+    for (auto _ : state)
+    {
+        visibleCount = CountVisible(*root, frustum);
+        benchmark::DoNotOptimize(visibleCount);
+    }
+
+    // The node, its control block of make_shared and its entry in the children of the parent
+    state.counters["visible"] = double(visibleCount);
+    state.counters["bytes/node"] = double(sizeof(TreeNode) + 2 * sizeof(void*) + sizeof(std::shared_ptr<TreeNode>));
+}
+BENCHMARK(BM_TraverseTree)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+// The passes sweeping the hot node data by pool slot, the cold nodes stay in the pool
+static void BM_SweepNodeData(benchmark::State& state)
+{
+    const std::vector<BVH::Bounds> bounds = CreateBounds(state.range(0));
+    const FrustumVolume frustum = GetView();
+
+    Pool<TreeNode> pool;
+    std::vector<SceneNodeData> nodeData;
+    for (size_t i = 0; i < bounds.size(); ++i)
+    {
+        const PoolHandle handle = pool.Create();
+        pool.Get(handle)->name = "Node" + std::to_string(i);
+
+        nodeData.resize(std::max<size_t>(nodeData.size(), handle.GetIndex() + 1));
+        SceneNodeData& data = nodeData[handle.GetIndex()];
+        data.aabbMin = bounds[i].min;
+        data.aabbMax = bounds[i].max;
+        data.transformIndex = static_cast<uint32_t>(i);
+        data.flags = SCENE_NODE_ALIVE | SCENE_NODE_RESIDENT;
+        data.lodCount = 1;
+    }
+
+    size_t visibleCount = 0;
+    for (auto _ : state)
+    {
+        visibleCount = 0;
+        for (const SceneNodeData& data : nodeData)
+        {
+            if ((data.flags & SCENE_NODE_RESIDENT) && Intersect(frustum, AABBVolume(XMLoadFloat3(&data.aabbMin), XMLoadFloat3(&data.aabbMax))))
+                ++visibleCount;
+        }
+        benchmark::DoNotOptimize(visibleCount);
+    }
+
+    state.counters["visible"] = double(visibleCount);
+    state.counters["hot bytes/node"] = double(sizeof(SceneNodeData));
+}
+BENCHMARK(BM_SweepNodeData)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+static void BM_CreateTree(benchmark::State& state)
+{
+    const std::vector<BVH::Bounds> bounds = CreateBounds(state.range(0));
+    for (auto _ : state)
+    {
+        std::shared_ptr<TreeNode> root = CreateTree(bounds);
+        benchmark::DoNotOptimize(root.get());
+    }
+}
+BENCHMARK(BM_CreateTree)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_CreatePool(benchmark::State& state)
+{
+    const size_t count = state.range(0);
+    for (auto _ : state)
+    {
+        Pool<TreeNode> pool;
+        for (size_t i = 0; i < count; ++i)
+            pool.Get(pool.Create())->name = "Node" + std::to_string(i);
+        benchmark::DoNotOptimize(pool.GetCount());
+    }
+}
+BENCHMARK(BM_CreatePool)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
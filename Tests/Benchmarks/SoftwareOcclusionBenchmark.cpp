@@ -0,0 +1,114 @@
+#include "stdafx.h"
+
+#include "Scene/SoftwareOcclusion.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t WIDTH = 320;
+    constexpr uint32_t HEIGHT = 180;
+    constexpr uint32_t LAYER_COUNT = 32;
+    constexpr uint32_t LAYER_TRIANGLE_COUNT = 2000;
+    constexpr uint16_t TRIANGLE_SIZE = 2000;
+    constexpr size_t TEST_COUNT = 10000;
+
+    // Small quantized front facing triangles scattered over the unit square
+    struct Layer
+    {
+        std::vector<uint16_t> positions;
+        std::vector<uint32_t> indices;
+
+        OccluderMesh GetMesh() const
+        {
+            OccluderMesh mesh;
+            mesh.positions = std::span(reinterpret_cast<const uint8_t*>(positions.data()), positions.size() * sizeof(uint16_t));
+            mesh.positionStride = 4 * sizeof(uint16_t);
+            mesh.isQuantized = true;
+            mesh.indices = indices.data();
+            mesh.indexCount = indices.size();
+            return mesh;
+        }
+    };
+
+    Layer CreateLayer()
+    {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<uint32_t> coordinate(0, UINT16_MAX - TRIANGLE_SIZE);
+
+        Layer layer;
+        for (uint32_t i = 0; i < LAYER_TRIANGLE_COUNT; ++i)
+        {
+            const uint16_t x = uint16_t(coordinate(random));
+            const uint16_t y = uint16_t(coordinate(random));
+            const uint32_t first = uint32_t(layer.positions.size() / 4);
+            layer.positions.insert(layer.positions.end(),
+            {
+                x, y, 0, 0,
+                uint16_t(x + TRIANGLE_SIZE), y, 0, 0,
+                x, uint16_t(y + TRIANGLE_SIZE), 0, 0,
+            });
+            layer.indices.insert(layer.indices.end(), { first, first + 2, first + 1 });
+        }
+        return layer;
+    }
+
+    // The layers stacked in front of the camera, 60 units wide
+    void RasterizeLayers(SoftwareOcclusion& occlusion, const Layer& layer)
+    {
+        occlusion.Begin(XMMatrixPerspectiveFovLH(XM_PIDIV4, float(WIDTH) / HEIGHT, 0.1f, 1000.0f));
+
+        const OccluderMesh mesh = layer.GetMesh();
+        for (uint32_t i = 0; i < LAYER_COUNT; ++i)
+        {
+            const XMMATRIX transform = XMMatrixMultiply(XMMatrixScaling(60.0f, 60.0f, 1.0f), XMMatrixTranslation(-30.0f, -30.0f, 20.0f + i));
+            occlusion.AddOccluder(mesh, transform);
+        }
+        occlusion.Rasterize();
+    }
+}
+
+static void BM_Rasterize(benchmark::State& state)
+{
+    const Layer layer = CreateLayer();
+    SoftwareOcclusion occlusion;
+    occlusion.Create(WIDTH, HEIGHT);
+
+    for (auto _ : state)
+        RasterizeLayers(occlusion, layer);
+
+    state.counters["triangles"] = double(occlusion.GetTriangleCount());
+}
+BENCHMARK(BM_Rasterize)->Unit(benchmark::kMillisecond);
+
+static void BM_IsVisible(benchmark::State& state)
+{
+    const Layer layer = CreateLayer();
+    SoftwareOcclusion occlusion;
+    occlusion.Create(WIDTH, HEIGHT);
+    RasterizeLayers(occlusion, layer);
+
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> coordinate(-30.0f, 30.0f);
+    std::vector<XMFLOAT3> boxMins(TEST_COUNT);
+    for (XMFLOAT3& boxMin : boxMins)
+        boxMin = XMFLOAT3(coordinate(random), coordinate(random), 30.0f);
+
+    size_t visibleCount = 0;
+    for (auto _ : state)
+    {
+        visibleCount = 0;
+        for (const XMFLOAT3& boxMin : boxMins)
+            visibleCount += occlusion.IsVisible(boxMin, XMFLOAT3(boxMin.x + 1.0f, boxMin.y + 1.0f, boxMin.z + 1.0f));
+        benchmark::DoNotOptimize(visibleCount);
+    }
+
+    state.counters["visible"] = double(visibleCount);
+}
+BENCHMARK(BM_IsVisible)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,105 @@
+#include "stdafx.h"
+
+#include "Scene/TransformStore.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t NODE_COUNT = 10000;
+    // The depth, the occlusion and the render passes each read the global transform of every node
+    constexpr uint32_t READS_PER_FRAME = 3;
+
+    enum class EMoved
+    {
+        None,
+        Leaves,
+        Roots
+    };
+
+    // Chains of the given depth under a root node each, as the deep hierarchies of skeletons
+    // and nested props
+    struct DeepHierarchy
+    {
+        explicit DeepHierarchy(uint32_t depth)
+        {
+            for (uint32_t i = 0; i < NODE_COUNT; ++i)
+            {
+                const uint32_t parent = i % depth == 0 ? TransformStore::INVALID_INDEX : i - 1;
+                const XMMATRIX localTransform = XMMatrixRotationY(0.01f) * XMMatrixTranslation(0.0f, 1.0f, 0.0f);
+                parents.push_back(parent);
+                localTransforms.push_back(localTransform);
+                if (parent == TransformStore::INVALID_INDEX)
+                    roots.push_back(i);
+                else if (i % depth == depth - 1 || i + 1 == NODE_COUNT)
+                    leaves.push_back(i);
+                store.Add(parent, localTransform);
+            }
+
+            remap = store.Build();
+            store.Update();
+        }
+
+        std::vector<uint32_t> parents;
+        std::vector<XMMATRIX> localTransforms;
+        std::vector<uint32_t> roots;
+        std::vector<uint32_t> leaves;
+        std::vector<uint32_t> remap;
+        TransformStore store;
+    };
+}
+
+// Before the cache: every read walks the parent chain, depth multiplications a node
+static void BM_WalkParentChains(benchmark::State& state)
+{
+    const DeepHierarchy hierarchy(static_cast<uint32_t>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        XMVECTOR sum = XMVectorZero();
+        for (uint32_t read = 0; read < READS_PER_FRAME; ++read)
+        {
+            for (uint32_t i = 0; i < NODE_COUNT; ++i)
+            {
+                XMMATRIX transform = hierarchy.localTransforms[i];
+                for (uint32_t parent = hierarchy.parents[i]; parent != TransformStore::INVALID_INDEX; parent = hierarchy.parents[parent])
+                    transform = transform * hierarchy.localTransforms[parent];
+                sum = XMVectorAdd(sum, transform.r[3]);
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+BENCHMARK(BM_WalkParentChains)->Arg(4)->Arg(16)->Arg(64)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+
+// The cached transforms: the moved nodes set, Update once, then the cached reads
+static void BM_UpdateTransforms(benchmark::State& state)
+{
+    DeepHierarchy hierarchy(static_cast<uint32_t>(state.range(0)));
+    const EMoved moved = static_cast<EMoved>(state.range(1));
+    const std::vector<uint32_t> noNodes;
+    const std::vector<uint32_t>& movedNodes = moved == EMoved::Roots ? hierarchy.roots : moved == EMoved::Leaves ? hierarchy.leaves : noNodes;
+
+    size_t updatedCount = 0;
+    for (auto _ : state)
+    {
+        for (uint32_t node : movedNodes)
+            hierarchy.store.SetLocalTransform(hierarchy.remap[node], hierarchy.localTransforms[node]);
+        updatedCount = hierarchy.store.Update();
+
+        XMVECTOR sum = XMVectorZero();
+        for (uint32_t read = 0; read < READS_PER_FRAME; ++read)
+        {
+            for (uint32_t i = 0; i < NODE_COUNT; ++i)
+                sum = XMVectorAdd(sum, hierarchy.store.GetGlobalTransform(i).r[3]);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.counters["recomputed"] = double(updatedCount);
+}
+BENCHMARK(BM_UpdateTransforms)->ArgsProduct({ { 4, 16, 64 }, { int(EMoved::None), int(EMoved::Leaves), int(EMoved::Roots) } })->ArgNames({ "depth", "moved" })->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,209 @@
+#include "stdafx.h"
+
+#include "Scene/CoherentOcclusion.h"
+
+#include <gtest/gtest.h>
+
+#include <numeric>
+
+namespace
+{
+    // The caller side of the coherent occlusion: the frame indices cycle, and the queries of a frame
+    // find what isVisible says and come back when its frame index is used again
+    struct Frames
+    {
+        Frames(uint32_t slotCount, uint32_t frameCount)
+            : isVisible(slotCount, 0)
+            , frameCount(frameCount)
+            , results(frameCount, std::vector<UINT64>(slotCount, 0))
+        {
+            occlusion.Create(slotCount, frameCount);
+        }
+
+        OcclusionReadback Render(const std::vector<OcclusionCandidate>& candidates)
+        {
+            const uint32_t frameIndex = frame++ % frameCount;
+            std::vector<UINT64>& frameResults = results[frameIndex];
+            const OcclusionReadback readback = occlusion.BeginFrame(frameIndex, frameResults);
+
+            std::fill(frameResults.begin(), frameResults.end(), 0);
+            occlusion.Update(candidates, isDrawn, queryCandidates, queries);
+
+            // A query counts the samples of all its boxes, the result goes to the slot of the first node
+            queriedSlots.clear();
+            for (const OcclusionBatch& query : queries)
+            {
+                std::vector<uint32_t>& slots = queriedSlots.emplace_back();
+                UINT64 sampleCount = 0;
+                for (uint32_t i = query.first; i < query.first + query.count; ++i)
+                {
+                    slots.push_back(candidates[queryCandidates[i]].slot);
+                    sampleCount += isVisible[slots.back()] ? 100 : 0;
+                }
+                frameResults[slots.front()] = sampleCount;
+            }
+
+            return readback;
+        }
+
+        CoherentOcclusion occlusion;
+        std::vector<uint8_t> isVisible;
+        uint32_t frameCount;
+        uint32_t frame = 0;
+        std::vector<std::vector<UINT64>> results;
+
+        // Of the last frame
+        std::vector<uint8_t> isDrawn;
+        std::vector<uint32_t> queryCandidates;
+        std::vector<OcclusionBatch> queries;
+        std::vector<std::vector<uint32_t>> queriedSlots;
+    };
+
+    std::vector<OcclusionCandidate> CreateCandidates(uint32_t count, uint32_t group)
+    {
+        std::vector<OcclusionCandidate> candidates;
+        for (uint32_t slot = 0; slot < count; ++slot)
+            candidates.push_back({ slot, group });
+        return candidates;
+    }
+}
+
+// The nodes start visible and are queried alone. Their results come back frameCount frames later,
+// counted with that latency
+TEST(CoherentOcclusionTest, ReadbackCountsQueriesAndLatency)
+{
+    constexpr uint32_t NODE_COUNT = 5;
+    constexpr uint32_t FRAME_COUNT = 3;
+
+    Frames frames(NODE_COUNT, FRAME_COUNT);
+    const std::vector<OcclusionCandidate> candidates = CreateCandidates(NODE_COUNT, 0);
+
+    OcclusionReadback readback = frames.Render(candidates);
+    EXPECT_EQ(readback.queryCount, 0u);
+    EXPECT_EQ(frames.isDrawn, std::vector<uint8_t>(NODE_COUNT, 1));
+    EXPECT_EQ(frames.queries.size(), NODE_COUNT);
+
+    for (uint32_t frame = 1; frame < FRAME_COUNT; ++frame)
+    {
+        readback = frames.Render(candidates);
+        EXPECT_EQ(readback.queryCount, 0u) << frame;
+        EXPECT_TRUE(frames.queries.empty()) << frame;
+    }
+
+    readback = frames.Render(candidates);
+    EXPECT_EQ(readback.queryCount, NODE_COUNT);
+    EXPECT_EQ(readback.latencyFrames, NODE_COUNT * FRAME_COUNT);
+
+    // All invisible now, in one batched query
+    EXPECT_EQ(frames.isDrawn, std::vector<uint8_t>(NODE_COUNT, 0));
+    EXPECT_EQ(frames.queriedSlots, std::vector<std::vector<uint32_t>>({ { 0, 1, 2, 3, 4 } }));
+}
+
+// A batch of invisible nodes whose query finds some of them visible: they are queried alone next and
+// stay undrawn until those results say which ones are visible, the others are batched again
+TEST(CoherentOcclusionTest, VisibleBatchIsQueriedAlone)
+{
+    constexpr uint32_t NODE_COUNT = CoherentOcclusion::MAX_BATCH_SIZE;
+    constexpr uint32_t FRAME_COUNT = 2;
+    constexpr uint32_t VISIBLE_SLOT = 3;
+
+    Frames frames(NODE_COUNT, FRAME_COUNT);
+    const std::vector<OcclusionCandidate> candidates = CreateCandidates(NODE_COUNT, 0);
+
+    std::vector<uint32_t> allSlots(NODE_COUNT);
+    std::iota(allSlots.begin(), allSlots.end(), 0);
+
+    for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+        frames.Render(candidates);
+
+    // The first results come back and batch the nodes, as one of them comes into view
+    frames.isVisible[VISIBLE_SLOT] = 1;
+    frames.Render(candidates);
+    ASSERT_EQ(frames.queriedSlots, std::vector<std::vector<uint32_t>>({ allSlots }));
+
+    for (uint32_t frame = 1; frame < FRAME_COUNT; ++frame)
+    {
+        frames.Render(candidates);
+        EXPECT_TRUE(frames.queries.empty());
+    }
+
+    // The batch result is back, a query per node
+    EXPECT_EQ(frames.Render(candidates).queryCount, 1u);
+    EXPECT_EQ(frames.isDrawn, std::vector<uint8_t>(NODE_COUNT, 0));
+    ASSERT_EQ(frames.queries.size(), NODE_COUNT);
+    for (uint32_t slot = 0; slot < NODE_COUNT; ++slot)
+        EXPECT_EQ(frames.queriedSlots[slot], std::vector<uint32_t>({ slot }));
+
+    for (uint32_t frame = 1; frame < FRAME_COUNT; ++frame)
+        frames.Render(candidates);
+
+    // Only the visible node is drawn, the others are batched again without it
+    EXPECT_EQ(frames.Render(candidates).queryCount, NODE_COUNT);
+    for (uint32_t slot = 0; slot < NODE_COUNT; ++slot)
+        EXPECT_EQ(frames.isDrawn[slot], slot == VISIBLE_SLOT) << slot;
+
+    allSlots.erase(allSlots.begin() + VISIBLE_SLOT);
+    EXPECT_EQ(frames.queriedSlots, std::vector<std::vector<uint32_t>>({ allSlots }));
+}
+
+// The visible nodes are drawn every frame and queried again every VISIBLE_QUERY_INTERVAL frames, plus
+// the offset of their slot
+TEST(CoherentOcclusionTest, VisibleNodesAreRequeriedAfterInterval)
+{
+    constexpr uint32_t NODE_COUNT = 4;
+    constexpr uint32_t FRAME_COUNT = 3;
+    constexpr uint32_t RENDERED_FRAMES = 60;
+
+    Frames frames(NODE_COUNT, FRAME_COUNT);
+    std::fill(frames.isVisible.begin(), frames.isVisible.end(), 1);
+    const std::vector<OcclusionCandidate> candidates = CreateCandidates(NODE_COUNT, 0);
+
+    std::vector<std::vector<uint32_t>> queryFrames(NODE_COUNT);
+    for (uint32_t frame = 0; frame < RENDERED_FRAMES; ++frame)
+    {
+        frames.Render(candidates);
+        EXPECT_EQ(frames.isDrawn, std::vector<uint8_t>(NODE_COUNT, 1)) << frame;
+
+        for (const std::vector<uint32_t>& slots : frames.queriedSlots)
+        {
+            ASSERT_EQ(slots.size(), 1u);
+            queryFrames[slots[0]].push_back(frame);
+        }
+    }
+
+    for (uint32_t slot = 0; slot < NODE_COUNT; ++slot)
+    {
+        ASSERT_GT(queryFrames[slot].size(), 2u);
+        EXPECT_EQ(queryFrames[slot][0], 0u);
+        for (size_t i = 1; i < queryFrames[slot].size(); ++i)
+            EXPECT_EQ(queryFrames[slot][i] - queryFrames[slot][i - 1], CoherentOcclusion::VISIBLE_QUERY_INTERVAL + slot) << slot;
+    }
+}
+
+// An invisible node that leaves the frustum and enters it again is drawn and queried alone at once,
+// whatever its last result said
+TEST(CoherentOcclusionTest, EnteringNodeIsDrawnAndQueried)
+{
+    constexpr uint32_t NODE_COUNT = 3;
+    constexpr uint32_t FRAME_COUNT = 2;
+    constexpr uint32_t ENTERING_SLOT = 1;
+
+    Frames frames(NODE_COUNT, FRAME_COUNT);
+    const std::vector<OcclusionCandidate> candidates = CreateCandidates(NODE_COUNT, 0);
+    std::vector<OcclusionCandidate> others = candidates;
+    others.erase(others.begin() + ENTERING_SLOT);
+
+    for (uint32_t frame = 0; frame <= FRAME_COUNT; ++frame)
+        frames.Render(candidates);
+    ASSERT_EQ(frames.isDrawn, std::vector<uint8_t>(NODE_COUNT, 0));
+
+    // Out of the frustum until its batch result came back
+    for (uint32_t frame = 0; frame < 2 * FRAME_COUNT; ++frame)
+        frames.Render(others);
+
+    frames.Render(candidates);
+    for (uint32_t slot = 0; slot < NODE_COUNT; ++slot)
+        EXPECT_EQ(frames.isDrawn[slot], slot == ENTERING_SLOT) << slot;
+    ASSERT_FALSE(frames.queriedSlots.empty());
+    EXPECT_EQ(frames.queriedSlots[0], std::vector<uint32_t>({ ENTERING_SLOT }));
+}
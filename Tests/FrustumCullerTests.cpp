@@ -0,0 +1,416 @@
+#include "stdafx.h"
+
+#include "Scene/Volumes/FrustumCuller.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr size_t BOX_COUNT = 5000;
+    constexpr float SCENE_SIZE = 1000.0f;
+    constexpr float SCREEN_SCALE = 1080.0f;
+
+    const FrustumCuller::Kernel KERNELS[] =
+    {
+        FrustumCuller::Kernel::SSE,
+        FrustumCuller::Kernel::AVX2,
+        FrustumCuller::Kernel::AVX512,
+    };
+
+    const char* GetKernelName(FrustumCuller::Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case FrustumCuller::Kernel::SSE:
+            return "SSE";
+        case FrustumCuller::Kernel::AVX2:
+            return "AVX2";
+        case FrustumCuller::Kernel::AVX512:
+            return "AVX-512";
+        default:
+            return "Scalar";
+        }
+    }
+
+    struct View
+    {
+        FrustumVolume frustum;
+        XMVECTOR position;
+    };
+
+    // A camera inside the scene looking at a random point, so the boxes are outside, straddling
+    // and inside the frustum
+    View RandomView(std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> coordinate(0.0f, SCENE_SIZE);
+        std::uniform_real_distribution<float> fov(XMConvertToRadians(30.0f), XMConvertToRadians(100.0f));
+
+        const XMVECTOR eye = XMVectorSet(coordinate(random), coordinate(random), coordinate(random), 1.0f);
+        const XMVECTOR target = XMVectorSet(coordinate(random), coordinate(random), coordinate(random), 1.0f);
+
+        const XMMATRIX view = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        const XMMATRIX projection = XMMatrixPerspectiveFovLH(fov(random), 16.0f / 9.0f, 0.1f, 0.6f * SCENE_SIZE);
+
+        View result;
+        result.frustum.BuildFromProjMatrix(XMMatrixMultiply(view, projection));
+        result.position = eye;
+        return result;
+    }
+
+    // Boxes from points to a tenth of the scene, a third of them with a minimum screen size
+    CullBoxes RandomBoxes(std::mt19937& random, size_t count)
+    {
+        std::uniform_real_distribution<float> coordinate(0.0f, SCENE_SIZE);
+        std::uniform_real_distribution<float> size(0.0f, 0.1f * SCENE_SIZE);
+        std::uniform_real_distribution<float> minSize(0.0f, 50.0f);
+
+        CullBoxes boxes;
+        boxes.Resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const XMFLOAT3 min(coordinate(random), coordinate(random), coordinate(random));
+            const XMFLOAT3 max(min.x + size(random), min.y + size(random), min.z + size(random));
+            boxes.Set(i, min, max);
+            boxes.minSize[i] = i % 3 == 0 ? minSize(random) : 0.0f;
+        }
+        return boxes;
+    }
+
+    uint32_t RandomPlaneMask(std::mt19937& random)
+    {
+        return std::uniform_int_distribution<uint32_t>(0, FrustumVolume::ALL_PLANES)(random);
+    }
+
+    bool IsSet(const std::vector<uint64_t>& mask, size_t bit)
+    {
+        return (mask[bit / 64] >> (bit % 64) & 1) != 0;
+    }
+
+    struct Masks
+    {
+        std::vector<uint64_t> visible;
+        std::vector<uint64_t> inside;
+        std::vector<uint64_t> small;
+    };
+
+    Masks Cull(const FrustumCuller& culler, const CullBoxes& boxes, size_t first, size_t count, uint32_t planeMask)
+    {
+        // One word past the range, which must stay untouched
+        const size_t wordCount = (count + 63) / 64;
+        Masks masks = { std::vector<uint64_t>(wordCount + 1, ~0ull), std::vector<uint64_t>(wordCount + 1, ~0ull), std::vector<uint64_t>(wordCount + 1, ~0ull) };
+        culler.Cull(boxes, first, count, planeMask, masks.visible.data(), masks.inside.data(), masks.small.data());
+
+        EXPECT_EQ(masks.visible.back(), ~0ull);
+        EXPECT_EQ(masks.inside.back(), ~0ull);
+        EXPECT_EQ(masks.small.back(), ~0ull);
+        return masks;
+    }
+
+    class FrustumCullerTest : public testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            if (FrustumCuller::GetSupportedKernel() == FrustumCuller::Kernel::Scalar)
+            {
+                GTEST_SKIP() << "No SIMD kernel supported";
+            }
+        }
+
+        std::mt19937 _random{ 7 };
+    };
+}
+
+// Every SIMD kernel must give the masks of the scalar kernel bit for bit: the ranges start and end
+// off the batches, the planes masks skip random planes and the screen size is on and off
+TEST_F(FrustumCullerTest, BatchKernelsMatchScalar)
+{
+    const CullBoxes boxes = RandomBoxes(_random, BOX_COUNT);
+
+    for (int frustum = 0; frustum < 40; ++frustum)
+    {
+        const View view = RandomView(_random);
+        FrustumCuller culler(view.frustum);
+        if (frustum % 2 == 1)
+        {
+            culler.SetScreenSize(view.position, SCREEN_SCALE);
+        }
+
+        const size_t first = std::uniform_int_distribution<size_t>(0, 100)(_random);
+        const size_t count = std::uniform_int_distribution<size_t>(1, BOX_COUNT - first)(_random);
+        const uint32_t planeMask = frustum % 4 < 2 ? FrustumVolume::ALL_PLANES : RandomPlaneMask(_random);
+
+        culler.SetKernel(FrustumCuller::Kernel::Scalar);
+        const Masks reference = Cull(culler, boxes, first, count, planeMask);
+
+        for (FrustumCuller::Kernel kernel : KERNELS)
+        {
+            if (kernel > FrustumCuller::GetSupportedKernel())
+            {
+                continue;
+            }
+
+            culler.SetKernel(kernel);
+            const Masks masks = Cull(culler, boxes, first, count, planeMask);
+
+            SCOPED_TRACE(GetKernelName(kernel));
+            EXPECT_EQ(masks.visible, reference.visible);
+            EXPECT_EQ(masks.inside, reference.inside);
+            EXPECT_EQ(masks.small, reference.small);
+        }
+    }
+}
+
+// Boxes touching the planes and spheres exactly at their screen size, on an integer grid so the
+// distances are exact: the kernels must break the ties the way the scalar kernel does
+TEST_F(FrustumCullerTest, BatchKernelsMatchScalarOnTies)
+{
+    // The cube from 0 to 100, the planes face inwards
+    FrustumVolume frustum;
+    frustum.planes[0] = XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+    frustum.planes[1] = XMVectorSet(-1.0f, 0.0f, 0.0f, 100.0f);
+    frustum.planes[2] = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+    frustum.planes[3] = XMVectorSet(0.0f, -1.0f, 0.0f, 100.0f);
+    frustum.planes[4] = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+    frustum.planes[5] = XMVectorSet(0.0f, 0.0f, -1.0f, 100.0f);
+
+    CullBoxes boxes;
+    std::vector<XMFLOAT3> centers;
+    std::vector<float> extents;
+    for (float x = -10.0f; x <= 110.0f; x += 10.0f)
+    {
+        for (float y = -10.0f; y <= 110.0f; y += 10.0f)
+        {
+            for (float z = -10.0f; z <= 110.0f; z += 10.0f)
+            {
+                for (float extent : { 0.0f, 5.0f, 10.0f })
+                {
+                    centers.emplace_back(x, y, z);
+                    extents.push_back(extent);
+                }
+            }
+        }
+    }
+
+    boxes.Resize(centers.size());
+    size_t tieCount = 0;
+    for (size_t i = 0; i < centers.size(); ++i)
+    {
+        const XMFLOAT3& center = centers[i];
+        boxes.Set(i, XMFLOAT3(center.x - extents[i], center.y - extents[i], center.z - extents[i]), XMFLOAT3(center.x + extents[i], center.y + extents[i], center.z + extents[i]));
+
+        // From the camera at the origin with a unit pixel scale, a sphere as large as its
+        // distance is exactly at the minimum size of 1
+        const float distance = std::sqrt(center.x * center.x + center.y * center.y + center.z * center.z);
+        if (distance == std::floor(distance))
+        {
+            boxes.radius[i] = distance;
+            ++tieCount;
+        }
+        boxes.minSize[i] = 1.0f;
+    }
+    ASSERT_GT(tieCount, 0u);
+
+    FrustumCuller culler(frustum);
+    culler.SetScreenSize(XMVectorZero(), 1.0f);
+
+    culler.SetKernel(FrustumCuller::Kernel::Scalar);
+    const Masks reference = Cull(culler, boxes, 0, boxes.count, FrustumVolume::ALL_PLANES);
+
+    for (FrustumCuller::Kernel kernel : KERNELS)
+    {
+        if (kernel > FrustumCuller::GetSupportedKernel())
+        {
+            continue;
+        }
+
+        culler.SetKernel(kernel);
+        const Masks masks = Cull(culler, boxes, 0, boxes.count, FrustumVolume::ALL_PLANES);
+
+        SCOPED_TRACE(GetKernelName(kernel));
+        EXPECT_EQ(masks.visible, reference.visible);
+        EXPECT_EQ(masks.inside, reference.inside);
+        EXPECT_EQ(masks.small, reference.small);
+    }
+}
+
+// The scalar batches classify every box as the hierarchical test does, and keep the small boxes
+// apart from the visible ones
+TEST_F(FrustumCullerTest, ScalarBatchMatchesClassify)
+{
+    const CullBoxes boxes = RandomBoxes(_random, BOX_COUNT);
+
+    size_t partialCount = 0;
+    size_t insideCount = 0;
+    size_t smallCount = 0;
+    for (int frustum = 0; frustum < 20; ++frustum)
+    {
+        const View view = RandomView(_random);
+        FrustumCuller culler(view.frustum);
+        culler.SetScreenSize(view.position, SCREEN_SCALE);
+        culler.SetKernel(FrustumCuller::Kernel::Scalar);
+
+        const Masks masks = Cull(culler, boxes, 0, BOX_COUNT, FrustumVolume::ALL_PLANES);
+
+        for (size_t i = 0; i < BOX_COUNT; ++i)
+        {
+            const XMFLOAT3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+            const XMFLOAT3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+
+            uint32_t planeMask = FrustumVolume::ALL_PLANES;
+            uint8_t lastPlane = 0;
+            size_t planeTestCount = 0;
+            const FrustumIntersection intersection = culler.Classify(center, extent, planeMask, lastPlane, planeTestCount);
+            const bool isTooSmall = culler.IsTooSmall(center, boxes.radius[i], boxes.minSize[i]);
+
+            const bool isInFrustum = intersection != FrustumIntersection::Outside;
+            ASSERT_EQ(IsSet(masks.visible, i), isInFrustum && !isTooSmall) << "box " << i;
+            ASSERT_EQ(IsSet(masks.small, i), isInFrustum && isTooSmall) << "box " << i;
+            ASSERT_EQ(IsSet(masks.inside, i), intersection == FrustumIntersection::Inside) << "box " << i;
+
+            partialCount += intersection == FrustumIntersection::Intersecting;
+            insideCount += intersection == FrustumIntersection::Inside;
+            smallCount += isInFrustum && isTooSmall;
+        }
+    }
+
+    // The scene covers every case
+    EXPECT_GT(partialCount, 0u);
+    EXPECT_GT(insideCount, 0u);
+    EXPECT_GT(smallCount, 0u);
+}
+
+TEST_F(FrustumCullerTest, IndexCullMatchesMasks)
+{
+    const CullBoxes boxes = RandomBoxes(_random, BOX_COUNT);
+    const View view = RandomView(_random);
+    FrustumCuller culler(view.frustum);
+
+    const size_t first = 37;
+    const size_t count = BOX_COUNT - 100;
+    const Masks masks = Cull(culler, boxes, first, count, FrustumVolume::ALL_PLANES);
+
+    std::vector<uint32_t> visible;
+    culler.Cull(boxes, first, count, visible);
+
+    std::vector<uint32_t> expected;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (IsSet(masks.visible, i))
+        {
+            expected.push_back(static_cast<uint32_t>(first + i));
+        }
+    }
+    EXPECT_EQ(visible, expected);
+}
+
+// The multi-view kernels match the scalar one, and every view matches its single view culler
+TEST_F(FrustumCullerTest, MultiViewKernelsMatchScalar)
+{
+    const CullBoxes boxes = RandomBoxes(_random, BOX_COUNT);
+
+    for (uint32_t viewCount = 1; viewCount <= MultiFrustumCuller::MAX_VIEW_COUNT; ++viewCount)
+    {
+        std::vector<View> views;
+        std::vector<const FrustumVolume*> frusta;
+        for (uint32_t v = 0; v < viewCount; ++v)
+        {
+            views.push_back(RandomView(_random));
+        }
+        for (const View& view : views)
+        {
+            frusta.push_back(&view.frustum);
+        }
+
+        MultiFrustumCuller culler(frusta);
+        const uint32_t viewMask = viewCount > 2 ? culler.GetAllViews() & ~2u : culler.GetAllViews();
+
+        uint8_t planeMasks[MultiFrustumCuller::MAX_VIEW_COUNT];
+        for (uint8_t& planeMask : planeMasks)
+        {
+            planeMask = static_cast<uint8_t>(viewCount % 2 == 0 ? FrustumVolume::ALL_PLANES : RandomPlaneMask(_random));
+        }
+
+        const size_t first = 11;
+        const size_t count = BOX_COUNT - 29;
+
+        culler.SetKernel(FrustumCuller::Kernel::Scalar);
+        std::vector<uint32_t> reference(count);
+        culler.Cull(boxes, first, count, viewMask, planeMasks, reference.data());
+
+        for (FrustumCuller::Kernel kernel : KERNELS)
+        {
+            if (kernel > FrustumCuller::GetSupportedKernel())
+            {
+                continue;
+            }
+
+            culler.SetKernel(kernel);
+            std::vector<uint32_t> viewMasks(count);
+            culler.Cull(boxes, first, count, viewMask, planeMasks, viewMasks.data());
+
+            SCOPED_TRACE(std::string(GetKernelName(kernel)) + ", " + std::to_string(viewCount) + " views");
+            EXPECT_EQ(viewMasks, reference);
+        }
+
+        for (uint32_t v = 0; v < viewCount; ++v)
+        {
+            FrustumCuller single(views[v].frustum);
+            single.SetKernel(FrustumCuller::Kernel::Scalar);
+            const Masks masks = Cull(single, boxes, first, count, planeMasks[v]);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const bool isExpected = (viewMask >> v & 1) != 0 && IsSet(masks.visible, i);
+                ASSERT_EQ((reference[i] >> v & 1) != 0, isExpected) << "view " << v << ", box " << first + i;
+            }
+        }
+    }
+}
+
+// The hierarchical test of several views gives the views and plane masks of the single view test
+TEST_F(FrustumCullerTest, MultiViewClassifyMatchesSingleView)
+{
+    const CullBoxes boxes = RandomBoxes(_random, BOX_COUNT);
+
+    std::vector<View> views;
+    std::vector<const FrustumVolume*> frusta;
+    for (uint32_t v = 0; v < MultiFrustumCuller::MAX_VIEW_COUNT; ++v)
+    {
+        views.push_back(RandomView(_random));
+    }
+    for (const View& view : views)
+    {
+        frusta.push_back(&view.frustum);
+    }
+    const MultiFrustumCuller culler(frusta);
+
+    for (size_t i = 0; i < BOX_COUNT; ++i)
+    {
+        const XMFLOAT3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+        const XMFLOAT3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+
+        uint8_t planeMasks[MultiFrustumCuller::MAX_VIEW_COUNT];
+        std::fill(std::begin(planeMasks), std::end(planeMasks), static_cast<uint8_t>(FrustumVolume::ALL_PLANES));
+        size_t planeTestCount = 0;
+        const uint32_t visibleViews = culler.Classify(center, extent, culler.GetAllViews(), planeMasks, planeTestCount);
+
+        for (uint32_t v = 0; v < MultiFrustumCuller::MAX_VIEW_COUNT; ++v)
+        {
+            uint32_t planeMask = FrustumVolume::ALL_PLANES;
+            uint8_t lastPlane = 0;
+            size_t singleTestCount = 0;
+            const FrustumIntersection intersection = FrustumCuller(views[v].frustum).Classify(center, extent, planeMask, lastPlane, singleTestCount);
+
+            ASSERT_EQ((visibleViews >> v & 1) != 0, intersection != FrustumIntersection::Outside) << "view " << v << ", box " << i;
+            if (intersection != FrustumIntersection::Outside)
+            {
+                ASSERT_EQ(planeMasks[v], planeMask) << "view " << v << ", box " << i;
+            }
+        }
+    }
+}
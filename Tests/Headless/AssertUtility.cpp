@@ -0,0 +1,39 @@
+#include "stdafx.h"
+
+#include <iostream>
+
+// The headless builds print the messages instead of writing log.txt through Logger
+namespace AssertUtility
+{
+    bool AssertFunction(bool statement, const std::string& message)
+    {
+        if (!statement)
+        {
+            std::cerr << "Error: " << message << std::endl;
+        }
+        return !statement;
+    }
+
+    bool LogWarningFunction(bool statement, const std::string& message)
+    {
+        if (!statement)
+        {
+            std::cerr << "Warning: " << message << std::endl;
+        }
+        return !statement;
+    }
+
+    bool LogInfoFunction(bool statement, const std::string& message)
+    {
+        return !statement;
+    }
+}
+
+// The info messages, as the load times of every mesh, would drown the test and benchmark output
+void Logger::Log(LogType type, const std::string& message)
+{
+    if (type != LogType::Info)
+    {
+        std::cerr << message << std::endl;
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Stand-in of DXObjects/Resource.h for the headless builds: the buffers the scene code maps
+// live in memory, and their GPU addresses are only offsets from 0
+
+#if defined(_WIN32)
+#include <d3d12.h>
+#else
+using D3D12_GPU_VIRTUAL_ADDRESS = UINT64;
+
+enum D3D12_RESOURCE_STATES
+{
+    D3D12_RESOURCE_STATE_COMMON = 0,
+    D3D12_RESOURCE_STATE_COPY_DEST = 0x400,
+    D3D12_RESOURCE_STATE_GENERIC_READ = 0xAC3
+};
+#endif
+
+namespace Core
+{
+    enum class EResourceType : int
+    {
+        None = 1 << 0,
+        Dynamic = 1 << 1,
+        ReadBack = 1 << 2,
+        Unordered = 1 << 3,
+        Buffer = 1 << 4
+    };
+
+    // As BINARY_OPERATION_TO_ENUM, Utility/Helpers.h needs Windows
+    inline EResourceType operator|(const EResourceType x, const EResourceType y)
+    {
+        return (EResourceType)((int)x | (int)y);
+    }
+
+    class ResourceDescription
+    {
+    public:
+        void SetSize(const DirectX::XMUINT2& size) { _size = size; }
+        DirectX::XMUINT2 GetSize() const { return _size; }
+
+        void SetFormat(DXGI_FORMAT) {}
+        void SetResourceType(EResourceType) {}
+        void SetStride(UINT64) {}
+
+    private:
+        DirectX::XMUINT2 _size = { 0, 0 };
+    };
+
+    class Resource
+    {
+    public:
+        Resource(ResourceDescription resourceDesc) : _resourceDesc(resourceDesc) {}
+
+        void SetName(const std::string& name) { _name = name; }
+        std::string GetName() const { return _name; }
+
+        D3D12_GPU_VIRTUAL_ADDRESS OffsetGPU(unsigned int offset) const { return offset; }
+        void* Map() { return _data.data(); }
+
+        void CreateCommitedResource(D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COPY_DEST)
+        {
+            // In matrices, so aligned for the streaming stores
+            _data.resize((_resourceDesc.GetSize().x + sizeof(DirectX::XMMATRIX) - 1) / sizeof(DirectX::XMMATRIX));
+        }
+
+    private:
+        std::string _name;
+        ResourceDescription _resourceDesc;
+        std::vector<DirectX::XMMATRIX> _data;
+    };
+} // namespace Core
@@ -0,0 +1,9 @@
+#pragma once
+
+// Stand-in of FBXParser/pch.h for the headless builds: the cook code that needs neither the FBX SDK,
+// JSON nor D3D12, as the mesh file writer the tests read back
+
+#include "stdafx.h"
+
+#include <filesystem>
+#include <utility>
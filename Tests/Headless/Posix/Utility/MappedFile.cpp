@@ -0,0 +1,86 @@
+#include "stdafx.h"
+
+#include "Utility/MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile()
+    : _file(-1)
+    , _data(nullptr)
+    , _size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& filepath)
+{
+    Close();
+
+    _file = open(filepath.c_str(), O_RDONLY);
+    if (ASSERT(_file != -1, "Failed to open file: " + filepath))
+    {
+        return false;
+    }
+
+    struct stat fileStat = {};
+    fstat(_file, &fileStat);
+    _size = static_cast<size_t>(fileStat.st_size);
+
+    // Mapping of an empty file is not allowed
+    if (_size == 0)
+    {
+        return true;
+    }
+
+    void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _file, 0);
+    if (ASSERT(data != MAP_FAILED, "Failed to map file: " + filepath))
+    {
+        Close();
+        return false;
+    }
+    _data = static_cast<const uint8_t*>(data);
+
+    // As FILE_FLAG_SEQUENTIAL_SCAN
+    madvise(data, _size, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data)
+    {
+        munmap(const_cast<uint8_t*>(_data), _size);
+        _data = nullptr;
+    }
+
+    if (_file != -1)
+    {
+        close(_file);
+        _file = -1;
+    }
+
+    _size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+    return _file != -1;
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+    return _data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return _size;
+}
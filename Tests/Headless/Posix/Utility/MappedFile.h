@@ -0,0 +1,27 @@
+#pragma once
+
+// Stand-in of Utility/MappedFile.h for the headless builds off Windows: the same mapping
+// through mmap
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile& copy) = delete;
+    MappedFile& operator=(const MappedFile& copy) = delete;
+
+    bool Open(const std::string& filepath);
+    void Close();
+
+    bool IsOpen() const;
+
+    const uint8_t* GetData() const;
+    size_t GetSize() const;
+
+private:
+    int _file;
+
+    const uint8_t* _data;
+    size_t _size;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+// Precompiled header of the headless builds: the scene code that needs neither Windows nor
+// D3D12, compiled on its own for the tests and the benchmarks
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#if defined(min)
+#undef min
+#endif
+
+#if defined(max)
+#undef max
+#endif
+
+#include <dxgiformat.h>
+#else
+using UINT = unsigned int;
+using UINT64 = unsigned long long;
+
+// The formats the scene code names
+enum DXGI_FORMAT
+{
+    DXGI_FORMAT_UNKNOWN = 0,
+    DXGI_FORMAT_R32_UINT = 42,
+    DXGI_FORMAT_R16_UINT = 57
+};
+#endif
+
+#include <DirectXMath.h>        // SIMD-friendly C++ types and functions
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <span>
+#include <map>
+#include <mutex>
+
+#include "Utility/Defines.h"
+#include "Utility/Logger.h"
@@ -0,0 +1,98 @@
+#include "stdafx.h"
+
+#include "Scene/LooseOctree.h"
+
+#include "RandomScene.h"
+
+#include <gtest/gtest.h>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr size_t OBJECT_COUNT = 10000;
+    constexpr float SCENE_SIZE = 1000.0f;
+    constexpr float MAX_OBJECT_SIZE = 20.0f;
+    constexpr float MAX_SPEED = 3.0f;
+    constexpr uint32_t FRAME_COUNT = 50;
+
+    std::vector<uint32_t> Sorted(std::vector<uint32_t> items)
+    {
+        std::sort(items.begin(), items.end());
+        return items;
+    }
+
+    void Move(BVH::Bounds& bounds, const XMFLOAT3& velocity)
+    {
+        bounds.min = XMFLOAT3(bounds.min.x + velocity.x, bounds.min.y + velocity.y, bounds.min.z + velocity.z);
+        bounds.max = XMFLOAT3(bounds.max.x + velocity.x, bounds.max.y + velocity.y, bounds.max.z + velocity.z);
+    }
+
+    bool Overlaps(const BVH::Bounds& a, const BVH::Bounds& b)
+    {
+        return a.min.x <= b.max.x && a.max.x >= b.min.x
+            && a.min.y <= b.max.y && a.max.y >= b.min.y
+            && a.min.z <= b.max.z && a.max.z >= b.min.z;
+    }
+}
+
+// Objects moving every frame, some of them out of the root cube, queried against brute force
+TEST(LooseOctreeTest, QueriesMatchBruteForce)
+{
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> speed(-MAX_SPEED, MAX_SPEED);
+    std::uniform_real_distribution<float> coordinate(0.0f, SCENE_SIZE);
+
+    std::vector<BVH::Bounds> bounds = RandomScene::CreateBounds(random, OBJECT_COUNT, SCENE_SIZE, MAX_OBJECT_SIZE);
+    std::vector<XMFLOAT3> velocities(OBJECT_COUNT);
+    for (XMFLOAT3& velocity : velocities)
+        velocity = XMFLOAT3(speed(random), speed(random), speed(random));
+
+    LooseOctree octree;
+    octree.Create({ XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(SCENE_SIZE, SCENE_SIZE, SCENE_SIZE) }, LooseOctree::MAX_DEPTH, 2.0f);
+    for (uint32_t i = 0; i < OBJECT_COUNT; ++i)
+        octree.Insert(i, bounds[i]);
+
+    // Every tenth object leaves, the brute force skips them
+    for (uint32_t i = 0; i < OBJECT_COUNT; i += 10)
+        octree.Remove(i);
+    EXPECT_EQ(octree.GetCount(), OBJECT_COUNT - OBJECT_COUNT / 10);
+    EXPECT_FALSE(octree.Contains(0));
+    EXPECT_TRUE(octree.Contains(1));
+
+    for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        for (uint32_t i = 0; i < OBJECT_COUNT; ++i)
+        {
+            Move(bounds[i], velocities[i]);
+            if (octree.Contains(i))
+                octree.Move(i, bounds[i]);
+        }
+
+        const FrustumVolume frustum = RandomScene::CreateRandomFrustum(random, SCENE_SIZE);
+        std::vector<uint32_t> expected;
+        for (uint32_t item : RandomScene::Cull(frustum, bounds))
+        {
+            if (octree.Contains(item))
+                expected.push_back(item);
+        }
+
+        std::vector<uint32_t> items;
+        octree.Query(frustum, items);
+        ASSERT_EQ(Sorted(items), expected) << frame;
+
+        BVH::Bounds box;
+        box.min = XMFLOAT3(coordinate(random), coordinate(random), coordinate(random));
+        box.max = XMFLOAT3(box.min.x + 200.0f, box.min.y + 200.0f, box.min.z + 200.0f);
+        expected.clear();
+        for (uint32_t i = 0; i < OBJECT_COUNT; ++i)
+        {
+            if (octree.Contains(i) && Overlaps(box, bounds[i]))
+                expected.push_back(i);
+        }
+
+        items.clear();
+        octree.Query(box, items);
+        ASSERT_EQ(Sorted(items), expected) << frame;
+    }
+}
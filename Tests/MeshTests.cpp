@@ -0,0 +1,151 @@
+#include "stdafx.h"
+
+#include "Scene/Mesh.h"
+
+#include "../FBXParser/MeshFile.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+
+namespace
+{
+    const std::string TEXT_MESH = MODELS_DIR "Book/Sphere_002_Sphere_003.mesh";
+
+    std::string GetTempPath(const std::string& filename)
+    {
+        return (std::filesystem::temp_directory_path() / filename).string();
+    }
+
+    // The text mesh cooked to a binary one by the writer of FBXParser, in the given layout
+    bool CookMesh(const std::string& textPath, const std::string& binaryPath, bool isPacked = false, bool hasPositionStream = false)
+    {
+        LOD lod;
+        if (!MeshFile::Load(textPath, lod))
+            return false;
+
+        const MeshFile::VertexPacking packing = { .isPacked = isPacked, .quantization = MeshFile::ComputeQuantization({ lod }), .hasPositionStream = hasPositionStream };
+        return MeshFile::Save(binaryPath, lod, packing);
+    }
+
+    std::vector<uint32_t> GetIndices(const Mesh& mesh)
+    {
+        std::vector<uint32_t> indices;
+        for (size_t i = 0; i < mesh.GetIndexCount(); ++i)
+        {
+            indices.push_back(mesh.GetIndexStride() == sizeof(uint16_t)
+                ? static_cast<const uint16_t*>(mesh.GetIndexData())[i]
+                : static_cast<const uint32_t*>(mesh.GetIndexData())[i]);
+        }
+        return indices;
+    }
+
+    std::vector<uint8_t> ReadFile(const std::string& path)
+    {
+        std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+        return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    bool ParseMesh(const std::vector<uint8_t>& data)
+    {
+        Mesh mesh;
+        return mesh.LoadMesh("Corrupted", data, nullptr);
+    }
+}
+
+// A text mesh of Models/ cooked to the binary format loads back mapped, with the same vertices and indices
+TEST(MeshTest, BinaryMatchesText)
+{
+    Mesh textMesh;
+    textMesh.LoadMesh(TEXT_MESH);
+    ASSERT_GT(textMesh.GetVertexCount(), 0u);
+    EXPECT_FALSE(textMesh.IsMapped());
+
+    const std::string binaryPath = GetTempPath("MeshTest.mesh");
+    ASSERT_TRUE(CookMesh(TEXT_MESH, binaryPath));
+
+    Mesh binaryMesh;
+    binaryMesh.LoadMesh(binaryPath);
+    EXPECT_TRUE(binaryMesh.IsMapped());
+    EXPECT_EQ(binaryMesh.GetVertexLayout(), MeshFormat::VertexLayout::Float);
+    EXPECT_EQ(binaryMesh.GetIndexFormat(), DXGI_FORMAT_R16_UINT);
+
+    ASSERT_EQ(binaryMesh.GetVertexCount(), textMesh.GetVertexCount());
+    EXPECT_EQ(std::memcmp(binaryMesh.GetVertices().data(), textMesh.GetVertices().data(), textMesh.GetVertices().size_bytes()), 0);
+    EXPECT_EQ(GetIndices(binaryMesh), GetIndices(textMesh));
+
+    std::filesystem::remove(binaryPath);
+}
+
+// The depth passes see the same positions whether the cook wrote the position stream or the mesh
+// extracted it from the full vertices, in both layouts
+TEST(MeshTest, PositionStreamMatchesVertices)
+{
+    Mesh textMesh;
+    textMesh.LoadMesh(TEXT_MESH);
+    const std::string binaryPath = GetTempPath("MeshTest.mesh");
+
+    for (bool isPacked : { false, true })
+    {
+        std::vector<uint8_t> positions[2];
+        for (bool hasPositionStream : { false, true })
+        {
+            ASSERT_TRUE(CookMesh(TEXT_MESH, binaryPath, isPacked, hasPositionStream));
+
+            Mesh mesh;
+            mesh.LoadMesh(binaryPath);
+            ASSERT_EQ(mesh.GetVertexLayout(), isPacked ? MeshFormat::VertexLayout::Packed : MeshFormat::VertexLayout::Float);
+            ASSERT_EQ(mesh.GetPositions().size(), mesh.GetVertexCount() * mesh.GetPositionStride());
+            EXPECT_EQ(mesh.GetPositionStride(), isPacked ? sizeof(MeshFormat::PackedPosition) : sizeof(DirectX::XMFLOAT3));
+
+            positions[hasPositionStream].assign(mesh.GetPositions().begin(), mesh.GetPositions().end());
+        }
+        EXPECT_EQ(positions[true], positions[false]) << isPacked;
+
+        if (!isPacked)
+        {
+            for (size_t i = 0; i < textMesh.GetVertexCount(); ++i)
+                ASSERT_EQ(std::memcmp(positions[true].data() + i * sizeof(DirectX::XMFLOAT3), &textMesh.GetVertices()[i].Position, sizeof(DirectX::XMFLOAT3)), 0) << i;
+        }
+    }
+
+    std::filesystem::remove(binaryPath);
+}
+
+// Headers whose counts don't fit the file are rejected, also where the products of the counts would wrap
+TEST(MeshTest, CorruptedMeshesAreRejected)
+{
+    const std::string binaryPath = GetTempPath("MeshTest.mesh");
+    ASSERT_TRUE(CookMesh(TEXT_MESH, binaryPath, false, true));
+    const std::vector<uint8_t> data = ReadFile(binaryPath);
+    std::filesystem::remove(binaryPath);
+
+    ASSERT_TRUE(ParseMesh(data));
+
+    auto corrupt = [&data](auto change)
+    {
+        std::vector<uint8_t> corrupted = data;
+        change(*reinterpret_cast<MeshFormat::Header*>(corrupted.data()), reinterpret_cast<MeshFormat::StreamDesc*>(corrupted.data() + sizeof(MeshFormat::Header)));
+        return corrupted;
+    };
+
+    // More vertices than the streams hold
+    EXPECT_FALSE(ParseMesh(corrupt([](MeshFormat::Header& header, MeshFormat::StreamDesc*) { ++header.vertexCount; })));
+    // A stream cut short, the rest of the file would pass for it
+    EXPECT_FALSE(ParseMesh(corrupt([](MeshFormat::Header&, MeshFormat::StreamDesc* streams) { streams[1].size -= streams[1].stride; })));
+    // The file truncated in the middle of the indices
+    std::vector<uint8_t> truncated(data.begin(), data.end() - 2);
+    EXPECT_FALSE(ParseMesh(truncated));
+
+    // indexCount * indexStride wraps to 2 bytes in 32 bits
+    EXPECT_FALSE(ParseMesh(corrupt([](MeshFormat::Header& header, MeshFormat::StreamDesc*)
+    {
+        header.indexOffset = 0;
+        header.indexCount = 0x80000001;
+    })));
+    // streamCount * sizeof(StreamDesc) wraps in 32 bits
+    EXPECT_FALSE(ParseMesh(corrupt([](MeshFormat::Header& header, MeshFormat::StreamDesc*) { header.streamCount = 0xAAAAAAAB; })));
+    // offset + size wraps in 64 bits
+    EXPECT_FALSE(ParseMesh(corrupt([](MeshFormat::Header&, MeshFormat::StreamDesc* streams) { streams[0].offset = ~0ull - 15; })));
+}
@@ -0,0 +1,99 @@
+#include "stdafx.h"
+
+#include "Utility/Pool.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    // Counts the live objects, so the tests see every constructor matched by a destructor
+    struct Counted
+    {
+        Counted(uint32_t value, int& liveCount)
+            : value(value)
+            , liveCount(liveCount)
+        {
+            ++liveCount;
+        }
+
+        ~Counted()
+        {
+            --liveCount;
+        }
+
+        uint32_t value;
+        int& liveCount;
+    };
+}
+
+TEST(PoolTest, StaleHandlesStopResolving)
+{
+    int liveCount = 0;
+    Pool<Counted, 4> pool;
+
+    std::vector<PoolHandle> handles;
+    for (uint32_t i = 0; i < 10; ++i)
+        handles.push_back(pool.Create(i, liveCount));
+    EXPECT_EQ(liveCount, 10);
+    EXPECT_EQ(pool.GetCount(), 10u);
+
+    pool.Destroy(handles[3]);
+    EXPECT_EQ(liveCount, 9);
+    EXPECT_EQ(pool.Get(handles[3]), nullptr);
+    EXPECT_EQ(pool.GetAt(3), nullptr);
+
+    // Destroying twice does nothing
+    pool.Destroy(handles[3]);
+    EXPECT_EQ(liveCount, 9);
+
+    // The slot is reused by a new generation, the old handle still does not resolve
+    const PoolHandle reused = pool.Create(100u, liveCount);
+    EXPECT_EQ(reused.GetIndex(), 3u);
+    EXPECT_EQ(reused.GetGeneration(), 1u);
+    EXPECT_NE(reused, handles[3]);
+    EXPECT_EQ(pool.Get(handles[3]), nullptr);
+    ASSERT_NE(pool.Get(reused), nullptr);
+    EXPECT_EQ(pool.Get(reused)->value, 100u);
+    EXPECT_EQ(pool.GetHandleAt(3), reused);
+
+    EXPECT_EQ(pool.Get(PoolHandle()), nullptr);
+    EXPECT_EQ(pool.GetSlotCount(), 10u);
+
+    pool.Clear();
+    EXPECT_EQ(liveCount, 0);
+    EXPECT_EQ(pool.GetCount(), 0u);
+    EXPECT_EQ(pool.Get(reused), nullptr);
+}
+
+TEST(PoolTest, ObjectsNeverMove)
+{
+    int liveCount = 0;
+    {
+        Pool<Counted, 16> pool;
+
+        std::vector<PoolHandle> handles;
+        std::vector<const Counted*> objects;
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            handles.push_back(pool.Create(i, liveCount));
+            objects.push_back(pool.Get(handles.back()));
+
+            // Destroy some as the pool grows, their slots are taken by the next objects
+            if (i % 7 == 0)
+            {
+                pool.Destroy(handles.front());
+                handles.erase(handles.begin());
+                objects.erase(objects.begin());
+            }
+        }
+
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            ASSERT_EQ(pool.Get(handles[i]), objects[i]);
+            EXPECT_EQ(pool.Get(handles[i])->value, objects[i]->value);
+        }
+        EXPECT_EQ(pool.GetCount(), handles.size());
+        EXPECT_EQ(liveCount, static_cast<int>(handles.size()));
+    }
+    EXPECT_EQ(liveCount, 0);
+}
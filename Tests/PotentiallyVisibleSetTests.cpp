@@ -0,0 +1,205 @@
+#include "stdafx.h"
+
+#include "Scene/CompiledScene.h"
+#include "Scene/PotentiallyVisibleSet.h"
+
+#include "../FBXParser/VisibilityBaker.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <numeric>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t SAMPLE_COUNT = 4;
+
+    // A compiled scene without nodes that carries only the sets, laid out as SceneCompiler writes them
+    std::vector<uint8_t> WriteScene(const VisibilityBaker::VisibilitySets& sets)
+    {
+        SceneFormat::Header header = {};
+        header.magic = SceneFormat::MAGIC;
+        header.version = SceneFormat::VERSION;
+        header.headerSize = sizeof(SceneFormat::Header);
+        header.stringsSize = 1;
+        header.nodesOffset = header.lodsOffset = header.meshesOffset = header.materialsOffset = header.stringsOffset = sizeof(SceneFormat::Header);
+        std::copy(std::begin(sets.cellOrigin), std::end(sets.cellOrigin), header.cellOrigin);
+        std::copy(std::begin(sets.cellSize), std::end(sets.cellSize), header.cellSize);
+        std::copy(std::begin(sets.cellCounts), std::end(sets.cellCounts), header.cellCounts);
+        header.pvsSize = static_cast<uint32_t>(sets.pvs.size());
+        header.cellsOffset = SceneFormat::AlignOffset(header.stringsOffset + header.stringsSize);
+        header.pvsOffset = SceneFormat::AlignOffset(header.cellsOffset + sets.cells.size() * sizeof(SceneFormat::VisibilityCell));
+
+        std::vector<uint8_t> data(header.pvsOffset + sets.pvs.size(), 0);
+        std::memcpy(data.data(), &header, sizeof(header));
+        std::memcpy(data.data() + header.cellsOffset, sets.cells.data(), sets.cells.size() * sizeof(SceneFormat::VisibilityCell));
+        std::memcpy(data.data() + header.pvsOffset, sets.pvs.data(), sets.pvs.size());
+        return data;
+    }
+
+    // The sets of the scene for nodeCount nodes in pool slots of the same index
+    void CreateSets(PotentiallyVisibleSet& pvs, const std::vector<uint8_t>& data, uint32_t nodeCount)
+    {
+        CompiledScene compiledScene;
+        ASSERT_TRUE(compiledScene.Parse(data, "PotentiallyVisibleSetTest"));
+
+        std::vector<uint32_t> nodeSlots(nodeCount);
+        std::iota(nodeSlots.begin(), nodeSlots.end(), 0);
+        pvs.Create(compiledScene, nodeSlots);
+    }
+
+    std::vector<uint8_t> Expand(const PotentiallyVisibleSet& pvs, uint32_t cell, uint32_t nodeCount)
+    {
+        std::vector<uint8_t> isVisible(nodeCount, 1);
+        pvs.Expand(cell, isVisible);
+        return isVisible;
+    }
+
+    bool IsSet(const std::vector<uint8_t>& bits, uint32_t node)
+    {
+        return bits[node / 8] >> (node % 8) & 1;
+    }
+
+    // The axis aligned box as twelve triangles
+    VisibilityBaker::NodeGeometry CreateBox(const XMFLOAT3& aabbMin, const XMFLOAT3& aabbMax)
+    {
+        VisibilityBaker::NodeGeometry node = { aabbMin, aabbMax, {} };
+        auto corner = [&](int i) { return XMFLOAT3(i & 1 ? aabbMax.x : aabbMin.x, i & 2 ? aabbMax.y : aabbMin.y, i & 4 ? aabbMax.z : aabbMin.z); };
+        const int faces[6][4] = { { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+        for (const auto& face : faces)
+        {
+            for (int i : { face[0], face[1], face[2], face[0], face[2], face[3] })
+                node.triangles.push_back(corner(i));
+        }
+        return node;
+    }
+}
+
+// Sets with runs of zero and literal bytes longer than a run byte counts decode to what was encoded,
+// one cell per set
+TEST(PotentiallyVisibleSetTest, EncodeRoundTrips)
+{
+    constexpr uint32_t SET_SIZE = 1200;
+    constexpr uint32_t NODE_COUNT = SET_SIZE * 8;
+
+    std::mt19937 random(3);
+    std::uniform_int_distribution<uint32_t> byte(0, 255);
+    std::vector<std::vector<uint8_t>> bitsets(4, std::vector<uint8_t>(SET_SIZE, 0));
+    // Empty, 600 zero bytes then 600 literals, all literals, random with zeros between
+    std::generate(bitsets[1].begin() + 600, bitsets[1].end(), [&] { return static_cast<uint8_t>(byte(random) | 1); });
+    std::fill(bitsets[2].begin(), bitsets[2].end(), uint8_t(0xFF));
+    std::generate(bitsets[3].begin(), bitsets[3].end(), [&] { return static_cast<uint8_t>(byte(random) < 128 ? 0 : byte(random)); });
+
+    VisibilityBaker::VisibilitySets sets;
+    std::fill(std::begin(sets.cellSize), std::end(sets.cellSize), 1.0f);
+    sets.cellCounts[0] = static_cast<uint32_t>(bitsets.size());
+    sets.cellCounts[1] = sets.cellCounts[2] = 1;
+
+    std::vector<uint8_t> encoded;
+    for (const std::vector<uint8_t>& bits : bitsets)
+    {
+        VisibilityBaker::Encode(bits, encoded);
+        sets.cells.push_back({ static_cast<uint32_t>(sets.pvs.size()), 0 });
+        sets.pvs.insert(sets.pvs.end(), encoded.begin(), encoded.end());
+    }
+    // Four runs of 255 and one of 180 zero bytes, two bytes each
+    VisibilityBaker::Encode(bitsets[0], encoded);
+    EXPECT_EQ(encoded.size(), 10u);
+
+    PotentiallyVisibleSet pvs;
+    CreateSets(pvs, WriteScene(sets), NODE_COUNT);
+    ASSERT_FALSE(pvs.IsEmpty());
+    ASSERT_EQ(pvs.GetCellCount(), bitsets.size());
+
+    for (uint32_t cell = 0; cell < bitsets.size(); ++cell)
+    {
+        EXPECT_EQ(pvs.GetCell(XMVectorSet(cell + 0.5f, 0.5f, 0.5f, 0.0f)), cell);
+
+        const std::vector<uint8_t> isVisible = Expand(pvs, cell, NODE_COUNT);
+        for (uint32_t node = 0; node < NODE_COUNT; ++node)
+        {
+            ASSERT_EQ(isVisible[node], IsSet(bitsets[cell], node)) << "Cell " << cell << ", node " << node;
+        }
+    }
+}
+
+// A set that runs out of the data, past the set size or never ends leaves the whole PVS empty
+TEST(PotentiallyVisibleSetTest, CorruptedSetsAreRejected)
+{
+    constexpr uint32_t NODE_COUNT = 64;
+
+    std::vector<uint8_t> bits(NODE_COUNT / 8, 0);
+    bits[2] = 0x0F;
+    bits[3] = 0xF0;
+
+    VisibilityBaker::VisibilitySets sets;
+    std::fill(std::begin(sets.cellSize), std::end(sets.cellSize), 1.0f);
+    std::fill(std::begin(sets.cellCounts), std::end(sets.cellCounts), 1u);
+    sets.cells.push_back({ 0, 8 });
+    VisibilityBaker::Encode(bits, sets.pvs);
+
+    PotentiallyVisibleSet pvs;
+    CreateSets(pvs, WriteScene(sets), NODE_COUNT);
+    ASSERT_FALSE(pvs.IsEmpty());
+
+    auto isRejected = [&sets](auto corrupt)
+    {
+        VisibilityBaker::VisibilitySets corrupted = sets;
+        corrupt(corrupted.pvs);
+
+        PotentiallyVisibleSet pvs;
+        CreateSets(pvs, WriteScene(corrupted), NODE_COUNT);
+        return pvs.IsEmpty() && pvs.GetCell(XMVectorSet(0.5f, 0.5f, 0.5f, 0.0f)) == PotentiallyVisibleSet::INVALID_CELL;
+    };
+
+    // The last run cut off
+    EXPECT_TRUE(isRejected([](std::vector<uint8_t>& data) { data.pop_back(); }));
+    // More zero bytes than the set holds
+    EXPECT_TRUE(isRejected([](std::vector<uint8_t>& data) { data[0] = NODE_COUNT / 8 + 1; }));
+    // A run of neither zeros nor literals, which would never reach the set size
+    EXPECT_TRUE(isRejected([](std::vector<uint8_t>& data) { data = { 0, 0 }; }));
+    // No runs at all
+    EXPECT_TRUE(isRejected([](std::vector<uint8_t>& data) { data.clear(); }));
+}
+
+// A wall across the whole scene between two boxes: the cells on either side see the wall and the box
+// on their side, not the one behind the wall. A node without triangles is never potentially visible
+TEST(PotentiallyVisibleSetTest, WallHidesNodeBehindIt)
+{
+    enum : uint32_t { LEFT_BOX, WALL, RIGHT_BOX, EMPTY, NODE_COUNT };
+
+    std::vector<VisibilityBaker::NodeGeometry> nodes(NODE_COUNT);
+    nodes[LEFT_BOX] = CreateBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+    nodes[WALL] = CreateBox(XMFLOAT3(4.9f, -20.0f, -20.0f), XMFLOAT3(5.1f, 21.0f, 21.0f));
+    nodes[RIGHT_BOX] = CreateBox(XMFLOAT3(9.0f, 0.0f, 0.0f), XMFLOAT3(10.0f, 1.0f, 1.0f));
+    nodes[EMPTY] = { XMFLOAT3(2.0f, 0.0f, 0.0f), XMFLOAT3(3.0f, 1.0f, 1.0f), {} };
+
+    const VisibilityBaker::VisibilitySets sets = VisibilityBaker::Bake(nodes, 2.5f, SAMPLE_COUNT);
+    ASSERT_EQ(sets.cells.size(), size_t(sets.cellCounts[0]) * sets.cellCounts[1] * sets.cellCounts[2]);
+
+    PotentiallyVisibleSet pvs;
+    CreateSets(pvs, WriteScene(sets), NODE_COUNT);
+    ASSERT_FALSE(pvs.IsEmpty());
+
+    // The cells next to the wall, which overlaps them. Neither overlaps a box, both see theirs through the samples
+    const uint32_t leftCell = pvs.GetCell(XMVectorSet(3.0f, 0.5f, 0.5f, 0.0f));
+    const uint32_t rightCell = pvs.GetCell(XMVectorSet(6.0f, 0.5f, 0.5f, 0.0f));
+    ASSERT_NE(leftCell, PotentiallyVisibleSet::INVALID_CELL);
+    ASSERT_NE(rightCell, PotentiallyVisibleSet::INVALID_CELL);
+
+    EXPECT_EQ(Expand(pvs, leftCell, NODE_COUNT), std::vector<uint8_t>({ 1, 1, 0, 0 }));
+    EXPECT_EQ(Expand(pvs, rightCell, NODE_COUNT), std::vector<uint8_t>({ 0, 1, 1, 0 }));
+    EXPECT_EQ(sets.cells[leftCell].visibleCount, 2u);
+
+    // The same grid with the wall reduced to a triangle out of the way, the box behind it is seen
+    nodes[WALL].triangles = { XMFLOAT3(5.0f, 30.0f, 30.0f), XMFLOAT3(5.0f, 31.0f, 30.0f), XMFLOAT3(5.0f, 30.0f, 31.0f) };
+    const VisibilityBaker::VisibilitySets openSets = VisibilityBaker::Bake(nodes, 2.5f, SAMPLE_COUNT);
+    ASSERT_EQ(openSets.cells.size(), sets.cells.size());
+
+    PotentiallyVisibleSet openPvs;
+    CreateSets(openPvs, WriteScene(openSets), NODE_COUNT);
+    EXPECT_EQ(Expand(openPvs, leftCell, NODE_COUNT)[RIGHT_BOX], 1);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Scene/BVH.h"
+#include "Scene/Volumes/AABBVolume.h"
+
+#include <random>
+
+// Random boxes and views over a cube of a scene, shared by the tests and the benchmarks
+namespace RandomScene
+{
+    // Min corners uniform over the scene, edges up to maxSize
+    inline std::vector<BVH::Bounds> CreateBounds(std::mt19937& random, size_t count, float sceneSize, float maxSize)
+    {
+        std::uniform_real_distribution<float> coordinate(0.0f, sceneSize);
+        std::uniform_real_distribution<float> size(0.1f, maxSize);
+
+        std::vector<BVH::Bounds> bounds(count);
+        for (BVH::Bounds& box : bounds)
+        {
+            box.min = DirectX::XMFLOAT3(coordinate(random), coordinate(random), coordinate(random));
+            box.max = DirectX::XMFLOAT3(box.min.x + size(random), box.min.y + size(random), box.min.z + size(random));
+        }
+        return bounds;
+    }
+
+    inline std::vector<BVH::Item> CreateItems(std::span<const BVH::Bounds> bounds)
+    {
+        std::vector<BVH::Item> items(bounds.size());
+        for (size_t i = 0; i < bounds.size(); ++i)
+        {
+            items[i].bounds = bounds[i];
+            items[i].index = static_cast<uint32_t>(i);
+        }
+        return items;
+    }
+
+    // The view frustum in world space of a camera at eye looking at target
+    inline FrustumVolume CreateFrustum(DirectX::FXMVECTOR eye, DirectX::FXMVECTOR target, float fovY, float farZ)
+    {
+        const DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(eye, target, DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        const DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(fovY, 16.0f / 9.0f, 0.1f, farZ);
+
+        FrustumVolume frustum;
+        frustum.BuildFromProjMatrix(DirectX::XMMatrixMultiply(view, projection));
+        return frustum;
+    }
+
+    // A camera inside the scene looking at a random point, seeing about half of the scene across
+    inline FrustumVolume CreateRandomFrustum(std::mt19937& random, float sceneSize)
+    {
+        std::uniform_real_distribution<float> coordinate(0.0f, sceneSize);
+
+        const DirectX::XMVECTOR eye = DirectX::XMVectorSet(coordinate(random), coordinate(random), coordinate(random), 1.0f);
+        const DirectX::XMVECTOR target = DirectX::XMVectorSet(coordinate(random), coordinate(random), coordinate(random), 1.0f);
+        return CreateFrustum(eye, target, DirectX::XMConvertToRadians(60.0f), 0.5f * sceneSize);
+    }
+
+    // The indices of the bounds intersecting the frustum, tested one by one
+    inline std::vector<uint32_t> Cull(const FrustumVolume& frustum, std::span<const BVH::Bounds> bounds)
+    {
+        std::vector<uint32_t> items;
+        for (size_t i = 0; i < bounds.size(); ++i)
+        {
+            if (Intersect(frustum, AABBVolume(DirectX::XMLoadFloat3(&bounds[i].min), DirectX::XMLoadFloat3(&bounds[i].max))))
+                items.push_back(static_cast<uint32_t>(i));
+        }
+        return items;
+    }
+}
@@ -0,0 +1,267 @@
+#include "stdafx.h"
+
+#include "Scene/ReprojectedOcclusion.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    // Odd on both axes, so every level but the last is padded
+    constexpr uint32_t WIDTH = 257;
+    constexpr uint32_t HEIGHT = 143;
+    constexpr float NEAR_Z = 0.1f;
+    constexpr float FAR_Z = 1000.0f;
+    constexpr float WALL_Z = 50.0f;
+    constexpr size_t BOX_COUNT = 20000;
+
+    // Depth of a point in view space, z / w of the projection
+    float GetProjectedDepth(float viewZ)
+    {
+        return FAR_Z / (FAR_Z - NEAR_Z) * (1.0f - NEAR_Z / viewZ);
+    }
+
+    XMMATRIX GetProjection()
+    {
+        return XMMatrixPerspectiveFovLH(0.8f, float(WIDTH) / HEIGHT, NEAR_Z, FAR_Z);
+    }
+
+    // The camera at the position looking down +z
+    XMMATRIX GetViewProjection(float x, float y, float z)
+    {
+        return XMMatrixMultiply(XMMatrixTranslation(-x, -y, -z), GetProjection());
+    }
+
+    // A rough wall behind WALL_Z over the columns left of skyColumn, the far plane right of it
+    std::vector<float> CreateDepth(uint32_t skyColumn)
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> offset(0.0f, 10.0f);
+
+        std::vector<float> depth(static_cast<size_t>(WIDTH) * HEIGHT);
+        for (uint32_t y = 0; y < HEIGHT; ++y)
+        {
+            for (uint32_t x = 0; x < WIDTH; ++x)
+                depth[y * WIDTH + x] = x < skyColumn ? GetProjectedDepth(WALL_Z + offset(random)) : 1.0f;
+        }
+        return depth;
+    }
+
+    bool IsBoxVisible(const ReprojectedOcclusion& occlusion, const XMFLOAT3& center, float halfSize)
+    {
+        return occlusion.IsVisible(
+            XMFLOAT3(center.x - halfSize, center.y - halfSize, center.z - halfSize),
+            XMFLOAT3(center.x + halfSize, center.y + halfSize, center.z + halfSize));
+    }
+
+    // The same test on every texel of level 0, without the hierarchy and the SSE
+    bool IsBoxVisibleOnTexels(const ReprojectedOcclusion& occlusion, const XMMATRIX& viewProjection, const XMFLOAT3& aabbMin, const XMFLOAT3& aabbMax)
+    {
+        float minX = FLT_MAX;
+        float minY = FLT_MAX;
+        float minZ = FLT_MAX;
+        float maxX = -FLT_MAX;
+        float maxY = -FLT_MAX;
+        for (uint32_t corner = 0; corner < 8; ++corner)
+        {
+            const XMVECTOR position = XMVectorSet(
+                corner & 1 ? aabbMax.x : aabbMin.x,
+                corner & 2 ? aabbMax.y : aabbMin.y,
+                corner & 4 ? aabbMax.z : aabbMin.z,
+                1.0f);
+
+            XMFLOAT4 clipPosition;
+            XMStoreFloat4(&clipPosition, XMVector4Transform(position, viewProjection));
+            if (clipPosition.w <= 0.0f || clipPosition.z < 0.0f)
+                return true;
+
+            minX = std::min(minX, clipPosition.x / clipPosition.w);
+            maxX = std::max(maxX, clipPosition.x / clipPosition.w);
+            minY = std::min(minY, clipPosition.y / clipPosition.w);
+            maxY = std::max(maxY, clipPosition.y / clipPosition.w);
+            minZ = std::min(minZ, clipPosition.z / clipPosition.w);
+        }
+
+        const int32_t width = static_cast<int32_t>(occlusion.GetWidth());
+        const int32_t height = static_cast<int32_t>(occlusion.GetHeight());
+        const int32_t left = std::max(static_cast<int32_t>(std::floor((minX * 0.5f + 0.5f) * width)), 0);
+        const int32_t top = std::max(static_cast<int32_t>(std::floor((0.5f - maxY * 0.5f) * height)), 0);
+        const int32_t right = std::min(static_cast<int32_t>(std::floor((maxX * 0.5f + 0.5f) * width)), width - 1);
+        const int32_t bottom = std::min(static_cast<int32_t>(std::floor((0.5f - minY * 0.5f) * height)), height - 1);
+
+        for (int32_t y = top; y <= bottom; ++y)
+        {
+            for (int32_t x = left; x <= right; ++x)
+            {
+                if (occlusion.GetMaxDepth(0, x, y) >= minZ)
+                    return true;
+            }
+        }
+        return left > right || top > bottom;
+    }
+
+    void ExpectMatchesTexels(const ReprojectedOcclusion& occlusion, const XMMATRIX& viewProjection, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> depth(20.0f, 170.0f);
+        std::uniform_real_distribution<float> halfSize(0.2f, 8.0f);
+
+        size_t occludedCount = 0;
+        for (size_t i = 0; i < BOX_COUNT; ++i)
+        {
+            const float size = halfSize(random);
+            const XMFLOAT3 center(80.0f * unit(random), 45.0f * unit(random), depth(random));
+            const XMFLOAT3 aabbMin(center.x - size, center.y - size, center.z - size);
+            const XMFLOAT3 aabbMax(center.x + size, center.y + size, center.z + size);
+
+            const bool isVisible = occlusion.IsVisible(aabbMin, aabbMax);
+            ASSERT_EQ(isVisible, IsBoxVisibleOnTexels(occlusion, viewProjection, aabbMin, aabbMax)) << i;
+            occludedCount += !isVisible;
+        }
+
+        // Some are occluded, the holes keep the rest visible after moving
+        EXPECT_GT(occludedCount, 0u);
+    }
+}
+
+TEST(ReprojectedOcclusionTest, StaticViewKeepsTheDepth)
+{
+    const std::vector<float> depth = CreateDepth(WIDTH * 3 / 5);
+    const XMMATRIX viewProjection = GetViewProjection(0.0f, 0.0f, 0.0f);
+
+    ReprojectedOcclusion occlusion;
+    occlusion.Build(depth, WIDTH, HEIGHT, viewProjection, viewProjection);
+
+    EXPECT_EQ(occlusion.GetHoleCount(), 0u);
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+            ASSERT_NEAR(occlusion.GetMaxDepth(0, x, y), depth[y * WIDTH + x], 1e-5f) << x << ", " << y;
+    }
+}
+
+TEST(ReprojectedOcclusionTest, OddLevelsArePadded)
+{
+    // The last column alone is at the far plane
+    const std::vector<float> depth = CreateDepth(WIDTH - 1);
+    const XMMATRIX viewProjection = GetViewProjection(0.0f, 0.0f, 0.0f);
+
+    ReprojectedOcclusion occlusion;
+    occlusion.Build(depth, WIDTH, HEIGHT, viewProjection, viewProjection);
+
+    const uint32_t levelCount = occlusion.GetLevelCount();
+    ASSERT_GT(levelCount, 1u);
+    EXPECT_EQ(occlusion.GetLevelWidth(levelCount - 1), 1u);
+    EXPECT_EQ(occlusion.GetLevelHeight(levelCount - 1), 1u);
+
+    // Every texel is the min and max of its 2x2 children, the missing ones repeat the last row
+    // and column
+    for (uint32_t level = 1; level < levelCount; ++level)
+    {
+        const uint32_t childWidth = occlusion.GetLevelWidth(level - 1);
+        const uint32_t childHeight = occlusion.GetLevelHeight(level - 1);
+        ASSERT_EQ(occlusion.GetLevelWidth(level), (childWidth + 1) / 2);
+        ASSERT_EQ(occlusion.GetLevelHeight(level), (childHeight + 1) / 2);
+
+        for (uint32_t y = 0; y < occlusion.GetLevelHeight(level); ++y)
+        {
+            for (uint32_t x = 0; x < occlusion.GetLevelWidth(level); ++x)
+            {
+                float minDepth = FLT_MAX;
+                float maxDepth = -FLT_MAX;
+                for (uint32_t child = 0; child < 4; ++child)
+                {
+                    const uint32_t childX = std::min(2 * x + (child & 1), childWidth - 1);
+                    const uint32_t childY = std::min(2 * y + (child >> 1), childHeight - 1);
+                    minDepth = std::min(minDepth, occlusion.GetMinDepth(level - 1, childX, childY));
+                    maxDepth = std::max(maxDepth, occlusion.GetMaxDepth(level - 1, childX, childY));
+                }
+
+                ASSERT_EQ(occlusion.GetMinDepth(level, x, y), minDepth) << level << ": " << x << ", " << y;
+                ASSERT_EQ(occlusion.GetMaxDepth(level, x, y), maxDepth) << level << ": " << x << ", " << y;
+            }
+        }
+    }
+
+    EXPECT_EQ(occlusion.GetMaxDepth(levelCount - 1, 0, 0), 1.0f);
+
+    // Behind the wall, and behind it but reaching into the last column
+    const float rightEdge = 100.0f * std::tan(0.4f) * WIDTH / HEIGHT;
+    EXPECT_FALSE(IsBoxVisible(occlusion, XMFLOAT3(0.0f, 0.0f, 100.0f), 1.0f));
+    EXPECT_TRUE(IsBoxVisible(occlusion, XMFLOAT3(rightEdge, 0.0f, 100.0f), 1.0f));
+
+    std::mt19937 random(2);
+    ExpectMatchesTexels(occlusion, viewProjection, random);
+}
+
+TEST(ReprojectedOcclusionTest, DisocclusionsAreHoles)
+{
+    const std::vector<float> depth = CreateDepth(WIDTH);
+    const XMMATRIX previousViewProjection = GetViewProjection(0.0f, 0.0f, 0.0f);
+
+    // Stepping back shrinks the wall, the border it covered before is disoccluded
+    const XMMATRIX viewProjection = GetViewProjection(0.0f, 0.0f, -10.0f);
+    ReprojectedOcclusion occlusion;
+    occlusion.Build(depth, WIDTH, HEIGHT, previousViewProjection, viewProjection);
+    ASSERT_GT(occlusion.GetHoleCount(), 0u);
+
+    // The wall has no sky, so the holes are the texels at the far plane
+    size_t farCount = 0;
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+            farCount += occlusion.GetMaxDepth(0, x, y) == 1.0f;
+    }
+    EXPECT_EQ(farCount, occlusion.GetHoleCount());
+
+    // Far behind the wall, in its middle and on the disoccluded border
+    const float viewZ = 500.0f;
+    const float border = 0.95f * viewZ * std::tan(0.4f) * WIDTH / HEIGHT;
+    EXPECT_FALSE(IsBoxVisible(occlusion, XMFLOAT3(0.0f, 0.0f, viewZ - 10.0f), 1.0f));
+    EXPECT_TRUE(IsBoxVisible(occlusion, XMFLOAT3(-border, 0.0f, viewZ - 10.0f), 1.0f));
+    EXPECT_TRUE(IsBoxVisible(occlusion, XMFLOAT3(border, 0.0f, viewZ - 10.0f), 1.0f));
+
+    std::mt19937 random(3);
+    ExpectMatchesTexels(occlusion, viewProjection, random);
+
+    // Stepping forward and aside spreads the texels apart and uncovers the other side
+    const XMMATRIX movedViewProjection = GetViewProjection(3.0f, 0.0f, 5.0f);
+    occlusion.Build(depth, WIDTH, HEIGHT, previousViewProjection, movedViewProjection);
+    ASSERT_GT(occlusion.GetHoleCount(), 0u);
+    ExpectMatchesTexels(occlusion, movedViewProjection, random);
+}
+
+TEST(ReprojectedOcclusionTest, BoxesAtTheNearPlaneAreVisible)
+{
+    const std::vector<float> depth = CreateDepth(WIDTH);
+    const XMMATRIX viewProjection = GetViewProjection(0.0f, 0.0f, 0.0f);
+
+    ReprojectedOcclusion occlusion;
+    occlusion.Build(depth, WIDTH, HEIGHT, viewProjection, viewProjection);
+    ASSERT_FALSE(IsBoxVisible(occlusion, XMFLOAT3(0.0f, 0.0f, 100.0f), 1.0f));
+
+    // Through the camera, between the camera and the near plane and wholly behind the camera
+    EXPECT_TRUE(IsBoxVisible(occlusion, XMFLOAT3(0.0f, 0.0f, 0.0f), 1.0f));
+    EXPECT_TRUE(occlusion.IsVisible(XMFLOAT3(-0.01f, -0.01f, 0.02f), XMFLOAT3(0.01f, 0.01f, 0.05f)));
+    EXPECT_TRUE(IsBoxVisible(occlusion, XMFLOAT3(0.0f, 0.0f, -100.0f), 1.0f));
+    // Far behind the wall but reaching across the near plane
+    EXPECT_TRUE(occlusion.IsVisible(XMFLOAT3(-1.0f, -1.0f, 0.05f), XMFLOAT3(1.0f, 1.0f, 200.0f)));
+}
+
+TEST(ReprojectedOcclusionTest, EverythingIsVisibleAfterClear)
+{
+    const std::vector<float> depth = CreateDepth(WIDTH);
+    const XMMATRIX viewProjection = GetViewProjection(0.0f, 0.0f, 0.0f);
+
+    ReprojectedOcclusion occlusion;
+    EXPECT_TRUE(IsBoxVisible(occlusion, XMFLOAT3(0.0f, 0.0f, 100.0f), 1.0f));
+
+    occlusion.Build(depth, WIDTH, HEIGHT, viewProjection, viewProjection);
+    ASSERT_FALSE(IsBoxVisible(occlusion, XMFLOAT3(0.0f, 0.0f, 100.0f), 1.0f));
+
+    occlusion.Clear();
+    EXPECT_TRUE(IsBoxVisible(occlusion, XMFLOAT3(0.0f, 0.0f, 100.0f), 1.0f));
+}
@@ -0,0 +1,135 @@
+#include "stdafx.h"
+
+#include "Scene/SoftwareOcclusion.h"
+
+#include <gtest/gtest.h>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t WIDTH = 320;
+    constexpr uint32_t HEIGHT = 180;
+    constexpr float NEAR_Z = 0.1f;
+    constexpr float FAR_Z = 1000.0f;
+    constexpr float WALL_Z = 10.0f;
+
+    // A square wall facing the camera, clockwise on the screen with the first indices
+    const XMFLOAT3 WALL_POSITIONS[] =
+    {
+        { -3.0f, -3.0f, 0.0f },
+        { -3.0f, 3.0f, 0.0f },
+        { 3.0f, 3.0f, 0.0f },
+        { 3.0f, -3.0f, 0.0f },
+    };
+    const uint32_t FRONT_INDICES[] = { 0, 1, 2, 0, 2, 3 };
+    const uint32_t BACK_INDICES[] = { 0, 2, 1, 0, 3, 2 };
+
+    OccluderMesh WallMesh(const uint32_t (&indices)[6])
+    {
+        OccluderMesh mesh;
+        mesh.positions = std::span(reinterpret_cast<const uint8_t*>(WALL_POSITIONS), sizeof(WALL_POSITIONS));
+        mesh.positionStride = sizeof(XMFLOAT3);
+        mesh.indices = indices;
+        mesh.indexCount = std::size(indices);
+        return mesh;
+    }
+
+    // Depth of a point in view space, z / w of the projection
+    float GetProjectedDepth(float viewZ)
+    {
+        return FAR_Z / (FAR_Z - NEAR_Z) * (1.0f - NEAR_Z / viewZ);
+    }
+}
+
+// The camera sits at the origin looking down +z
+class SoftwareOcclusionTest : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        _occlusion.Create(WIDTH, HEIGHT);
+    }
+
+    void RasterizeWall(const uint32_t (&indices)[6], const XMMATRIX& transform)
+    {
+        const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, float(WIDTH) / HEIGHT, NEAR_Z, FAR_Z);
+        _occlusion.Begin(projection);
+        _occlusion.AddOccluder(WallMesh(indices), transform);
+        _occlusion.Rasterize();
+    }
+
+    bool IsBoxVisible(float x, float y, float z, float halfSize) const
+    {
+        return _occlusion.IsVisible(
+            XMFLOAT3(x - halfSize, y - halfSize, z - halfSize),
+            XMFLOAT3(x + halfSize, y + halfSize, z + halfSize));
+    }
+
+    SoftwareOcclusion _occlusion;
+};
+
+TEST_F(SoftwareOcclusionTest, WallHidesBoxesBehindIt)
+{
+    RasterizeWall(FRONT_INDICES, XMMatrixTranslation(0.0f, 0.0f, WALL_Z));
+    EXPECT_EQ(_occlusion.GetTriangleCount(), 2u);
+
+    EXPECT_FALSE(IsBoxVisible(0.0f, 0.0f, 20.0f, 1.0f));
+    EXPECT_FALSE(IsBoxVisible(1.0f, 1.0f, 100.0f, 0.5f));
+
+    // Partly beside the wall, in front of it and through the near plane
+    EXPECT_TRUE(IsBoxVisible(6.5f, 0.0f, 20.0f, 1.0f));
+    EXPECT_TRUE(IsBoxVisible(0.0f, 0.0f, 5.0f, 1.0f));
+    EXPECT_TRUE(IsBoxVisible(0.0f, 0.0f, 0.0f, 1.0f));
+    // Touching the wall from behind
+    EXPECT_TRUE(IsBoxVisible(0.0f, 0.0f, WALL_Z + 0.5f, 1.0f));
+}
+
+TEST_F(SoftwareOcclusionTest, BackFacesHideNothing)
+{
+    RasterizeWall(BACK_INDICES, XMMatrixTranslation(0.0f, 0.0f, WALL_Z));
+    EXPECT_EQ(_occlusion.GetTriangleCount(), 0u);
+
+    EXPECT_TRUE(IsBoxVisible(0.0f, 0.0f, 20.0f, 1.0f));
+    EXPECT_TRUE(IsBoxVisible(1.0f, 1.0f, 100.0f, 0.5f));
+}
+
+TEST_F(SoftwareOcclusionTest, DepthMatchesProjection)
+{
+    RasterizeWall(FRONT_INDICES, XMMatrixTranslation(0.0f, 0.0f, WALL_Z));
+
+    const std::span<const float> depth = _occlusion.GetDepth();
+    const uint32_t width = _occlusion.GetWidth();
+    ASSERT_GE(width, WIDTH);
+    ASSERT_GE(_occlusion.GetHeight(), HEIGHT);
+
+    const float expected = GetProjectedDepth(WALL_Z);
+    for (uint32_t y = HEIGHT / 2 - 8; y < HEIGHT / 2 + 8; ++y)
+    {
+        for (uint32_t x = WIDTH / 2 - 8; x < WIDTH / 2 + 8; ++x)
+            EXPECT_NEAR(depth[y * width + x], expected, 1e-5f) << x << ", " << y;
+    }
+
+    // Nothing rasterized in the corners
+    EXPECT_GT(depth[0], expected);
+}
+
+TEST_F(SoftwareOcclusionTest, ClippedWallCoversTheScreen)
+{
+    // Reaches far past the guard band, the clipped triangles still cover every pixel
+    const XMMATRIX transform = XMMatrixMultiply(XMMatrixScaling(200.0f, 200.0f, 1.0f), XMMatrixTranslation(0.0f, 0.0f, 50.0f));
+    RasterizeWall(FRONT_INDICES, transform);
+    EXPECT_GT(_occlusion.GetTriangleCount(), 2u);
+
+    const float expected = GetProjectedDepth(50.0f);
+    const std::span<const float> depth = _occlusion.GetDepth();
+    const uint32_t width = _occlusion.GetWidth();
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+            ASSERT_NEAR(depth[y * width + x], expected, 1e-4f) << x << ", " << y;
+    }
+
+    EXPECT_FALSE(IsBoxVisible(0.0f, 0.0f, 61.0f, 1.0f));
+    EXPECT_TRUE(IsBoxVisible(0.0f, 0.0f, 41.0f, 1.0f));
+}
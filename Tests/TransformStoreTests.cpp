@@ -0,0 +1,98 @@
+#include "stdafx.h"
+
+#include "Scene/TransformStore.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t NODE_COUNT = 20000;
+    constexpr uint32_t ROOT_COUNT = 4;
+    constexpr uint32_t FRAME_COUNT = 10;
+    constexpr uint32_t MOVES_PER_FRAME = 20;
+    constexpr float TOLERANCE = 1e-3f;
+
+    XMMATRIX CreateLocalTransform(std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+        std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+        return XMMatrixRotationRollPitchYaw(angle(random), angle(random), angle(random)) * XMMatrixTranslation(offset(random), offset(random), offset(random));
+    }
+
+    // The global transform as ISceneNode computed it before the cache, the parent chain walked on every read
+    XMMATRIX WalkParentChain(const std::vector<uint32_t>& parents, const std::vector<XMMATRIX>& localTransforms, uint32_t index)
+    {
+        XMMATRIX transform = localTransforms[index];
+        for (uint32_t parent = parents[index]; parent != TransformStore::INVALID_INDEX; parent = parents[parent])
+            transform = transform * localTransforms[parent];
+        return transform;
+    }
+
+    void ExpectNear(const XMMATRIX& a, const XMMATRIX& b, uint32_t index)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            ASSERT_TRUE(XMVector4NearEqual(a.r[row], b.r[row], XMVectorReplicate(TOLERANCE))) << "Node " << index;
+        }
+    }
+}
+
+// Random trees with local transforms changing every frame: the global transforms match the parent chain
+// walk, and only the moved nodes and their subtrees are recomputed
+TEST(TransformStoreTest, UpdateMatchesParentChainWalk)
+{
+    std::mt19937 random(7);
+
+    // Every node a child of any node added before it
+    std::vector<uint32_t> parents(NODE_COUNT);
+    std::vector<XMMATRIX> localTransforms(NODE_COUNT);
+    TransformStore store;
+    for (uint32_t i = 0; i < NODE_COUNT; ++i)
+    {
+        parents[i] = i < ROOT_COUNT ? TransformStore::INVALID_INDEX : std::uniform_int_distribution<uint32_t>(0, i - 1)(random);
+        localTransforms[i] = CreateLocalTransform(random);
+        ASSERT_EQ(store.Add(parents[i], localTransforms[i]), i);
+    }
+
+    const std::vector<uint32_t> remap = store.Build();
+    ASSERT_EQ(remap.size(), NODE_COUNT);
+    EXPECT_EQ(store.Update(), NODE_COUNT);
+    EXPECT_EQ(store.Update(), 0u);
+
+    for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        std::vector<uint8_t> isMoved(NODE_COUNT, 0);
+        for (uint32_t move = 0; move < MOVES_PER_FRAME; ++move)
+        {
+            const uint32_t node = std::uniform_int_distribution<uint32_t>(0, NODE_COUNT - 1)(random);
+            localTransforms[node] = CreateLocalTransform(random);
+            store.SetLocalTransform(remap[node], localTransforms[node]);
+            isMoved[node] = 1;
+        }
+
+        // The parents come first, so a single pass marks the subtrees
+        size_t expectedCount = 0;
+        for (uint32_t i = 0; i < NODE_COUNT; ++i)
+        {
+            if (parents[i] != TransformStore::INVALID_INDEX)
+                isMoved[i] |= isMoved[parents[i]];
+            expectedCount += isMoved[i];
+        }
+
+        EXPECT_EQ(store.Update(), expectedCount) << frame;
+        for (uint32_t updated : store.GetUpdated())
+        {
+            const uint32_t node = static_cast<uint32_t>(std::find(remap.begin(), remap.end(), updated) - remap.begin());
+            ASSERT_TRUE(isMoved[node]) << "Node " << node << " updated without moving";
+        }
+
+        for (uint32_t i = 0; i < NODE_COUNT; ++i)
+        {
+            ExpectNear(store.GetGlobalTransform(remap[i]), WalkParentChain(parents, localTransforms, i), i);
+        }
+    }
+}